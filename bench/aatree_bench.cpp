@@ -0,0 +1,1004 @@
+// Copyright 2025, David H. Hovemeyer <david.hovemeyer@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// “Software”), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+// THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+// AATree benchmarks.
+//
+// Usage: aatree_bench [benchmark [num_nodes]]
+//
+// With no arguments, all of the benchmarks are run with their
+// default number of nodes.
+//
+// Where hardware performance counters are available (see
+// perf_counters.h), the searching and scanning benchmarks also
+// report counts per operation (cycles, instructions, L1D/LLC/dTLB
+// read misses, and branch mispredictions) for each batch of
+// operations they time.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <chrono>
+#include <new>
+#include "ds_aatree.h"
+#include "ds_aatreepar.h"
+#include "ds_aatreeserial.h"
+#include "ds_aatreeregion.h"
+#include "ds_aatreecheck.h"
+#include "ds_aatreeexport.h"
+#include "ds_aatreesnapshot.h"
+#include "ds_pool.h"
+#include "perf_counters.h"
+
+////////////////////////////////////////////////////////////////////////
+// Integer tree node type for benchmarking
+////////////////////////////////////////////////////////////////////////
+
+class IntAATreeNode : public dslib::AATreeNode {
+private:
+  int m_val;
+
+  NO_VALUE_SEMANTICS( IntAATreeNode );
+
+public:
+  IntAATreeNode( int val = 0 ) : m_val( val ) { }
+  ~IntAATreeNode() { }
+
+  void set_val( int val ) { m_val = val; }
+  int get_val() const { return m_val; }
+
+  static void free_node_fn( dslib::AATreeNode *node );
+  static void copy_node_fn( dslib::AATreeNode *from, dslib::AATreeNode *to );
+  static bool less_than_fn( const dslib::AATreeNode *left, const dslib::AATreeNode *right );
+  static dslib::AATreeNode *relocate_node_fn( dslib::AATreeNode *from, void *to );
+
+  static int64_t get_key_fn( const dslib::AATreeNode *node ) {
+    return static_cast< const IntAATreeNode* >( node )->m_val;
+  }
+};
+
+// Bounds of the buffer nodes are relocated into (if any): nodes within it
+// must not be deleted individually
+char *relayout_buf_begin, *relayout_buf_end;
+
+void IntAATreeNode::free_node_fn( dslib::AATreeNode *node_ ) {
+  IntAATreeNode *node = static_cast< IntAATreeNode* >( node_ );
+  char *p = reinterpret_cast< char* >( node );
+  if ( p >= relayout_buf_begin && p < relayout_buf_end )
+    node->~IntAATreeNode();
+  else
+    delete node;
+}
+
+void IntAATreeNode::copy_node_fn( dslib::AATreeNode *from_, dslib::AATreeNode *to_ ) {
+  IntAATreeNode *from = static_cast< IntAATreeNode* >( from_ );
+  IntAATreeNode *to = static_cast< IntAATreeNode* >( to_ );
+
+  to->set_val( from->get_val() );
+}
+
+bool IntAATreeNode::less_than_fn( const dslib::AATreeNode *left_, const dslib::AATreeNode *right_ ) {
+  const IntAATreeNode *left = static_cast< const IntAATreeNode* >( left_ );
+  const IntAATreeNode *right = static_cast< const IntAATreeNode* >( right_ );
+  return left->m_val < right->m_val;
+}
+
+dslib::AATreeNode *IntAATreeNode::relocate_node_fn( dslib::AATreeNode *from_, void *to ) {
+  IntAATreeNode *from = static_cast< IntAATreeNode* >( from_ );
+  IntAATreeNode *moved = new ( to ) IntAATreeNode( from->get_val() );
+  delete from;
+  return moved;
+}
+
+typedef dslib::AATree< IntAATreeNode > IntAATree;
+
+// Integer tree node type with parent links
+class IntAATreeParentNode : public dslib::AATreeParentNode {
+private:
+  int m_val;
+
+  NO_VALUE_SEMANTICS( IntAATreeParentNode );
+
+public:
+  IntAATreeParentNode( int val = 0 ) : m_val( val ) { }
+  ~IntAATreeParentNode() { }
+
+  int get_val() const { return m_val; }
+
+  static void free_node_fn( dslib::AATreeNode *node ) {
+    delete static_cast< IntAATreeParentNode* >( node );
+  }
+
+  static bool less_than_fn( const dslib::AATreeNode *left, const dslib::AATreeNode *right ) {
+    return static_cast< const IntAATreeParentNode* >( left )->m_val
+         < static_cast< const IntAATreeParentNode* >( right )->m_val;
+  }
+};
+
+typedef dslib::AATree< IntAATreeParentNode > IntParentAATree;
+
+////////////////////////////////////////////////////////////////////////
+// Benchmark support
+////////////////////////////////////////////////////////////////////////
+
+typedef std::chrono::steady_clock Clock;
+
+double elapsed_secs( Clock::time_point start ) {
+  return std::chrono::duration< double >( Clock::now() - start ).count();
+}
+
+PerfCounters g_counters;
+
+// Times a batch of operations, counting hardware events while
+// doing so: finish() prints the counts per operation (if the
+// counters are available), and returns the elapsed time in seconds
+class Batch {
+private:
+  const char *m_what;
+  size_t m_num_ops;
+  Clock::time_point m_start;
+
+public:
+  Batch( const char *what, size_t num_ops )
+    : m_what( what ), m_num_ops( num_ops ) {
+    g_counters.reset();
+    g_counters.start();
+    m_start = Clock::now();
+  }
+
+  double finish() {
+    double secs = elapsed_secs( m_start );
+    g_counters.stop();
+    if ( g_counters.is_available() ) {
+      char counts[ 512 ];
+      g_counters.format_text( counts, sizeof( counts ), m_num_ops );
+      printf( "  counters per op (%s): %s\n", m_what, counts );
+    }
+    return secs;
+  }
+};
+
+// Get num_vals distinct values in random order
+std::vector< int > shuffled_vals( int num_vals, unsigned seed ) {
+  std::vector< int > vals;
+  for ( int i = 0; i < num_vals; ++i )
+    vals.push_back( i );
+  std::shuffle( vals.begin(), vals.end(), std::default_random_engine( seed ) );
+  return vals;
+}
+
+void insert_all( IntAATree &tree, const std::vector< int > &vals ) {
+  for ( auto i = vals.begin(); i != vals.end(); ++i )
+    tree.insert( new IntAATreeNode( *i ) );
+}
+
+// Time find() for each of the given search keys: returns the
+// number of finds per second
+double time_finds( const IntAATree &tree, const std::vector< IntAATreeNode* > &keys ) {
+  Batch batch( "find", keys.size() );
+  size_t found = 0;
+  for ( auto i = keys.begin(); i != keys.end(); ++i )
+    if ( tree.find( **i ) != nullptr )
+      ++found;
+  double secs = batch.finish();
+  if ( found != keys.size() )
+    printf( "  warning: only %zu/%zu searches succeeded\n", found, keys.size() );
+  return double( keys.size() ) / secs;
+}
+
+std::vector< IntAATreeNode* > make_search_keys( int num_nodes, int num_keys, unsigned seed ) {
+  std::default_random_engine rng( seed );
+  std::uniform_int_distribution< int > dist( 0, num_nodes - 1 );
+  std::vector< IntAATreeNode* > keys;
+  for ( int i = 0; i < num_keys; ++i )
+    keys.push_back( new IntAATreeNode( dist( rng ) ) );
+  return keys;
+}
+
+void free_search_keys( std::vector< IntAATreeNode* > &keys ) {
+  for ( auto i = keys.begin(); i != keys.end(); ++i )
+    delete *i;
+  keys.clear();
+}
+
+////////////////////////////////////////////////////////////////////////
+// Benchmarks
+////////////////////////////////////////////////////////////////////////
+
+// find() throughput on a tree built by random insertions, before and
+// after moving the nodes into breadth-first order with relayout()
+void bench_relayout_find( int num_nodes ) {
+  std::vector< char > buf;
+
+  {
+    IntAATree tree( &IntAATreeNode::less_than_fn, &IntAATreeNode::copy_node_fn, &IntAATreeNode::free_node_fn );
+    insert_all( tree, shuffled_vals( num_nodes, 1 ) );
+
+    std::vector< IntAATreeNode* > keys = make_search_keys( num_nodes, 2000000, 2 );
+
+    double before = time_finds( tree, keys );
+
+    buf.resize( size_t( num_nodes ) * sizeof( IntAATreeNode ) );
+    relayout_buf_begin = buf.data();
+    relayout_buf_end = buf.data() + buf.size();
+    auto start = Clock::now();
+    tree.relayout( buf.data(), num_nodes, &IntAATreeNode::relocate_node_fn );
+    double relayout_secs = elapsed_secs( start );
+
+    double after = time_finds( tree, keys );
+
+    printf( "relayout_find: nodes=%d before=%.3f Mfind/s after=%.3f Mfind/s "
+            "speedup=%.2fx relayout=%.3f s\n",
+            num_nodes, before / 1e6, after / 1e6, after / before, relayout_secs );
+
+    free_search_keys( keys );
+  }
+
+  relayout_buf_begin = relayout_buf_end = nullptr;
+}
+
+// find_many() throughput as a function of the number of keys
+// passed to each call, compared with calling find() for each key
+void bench_find_many( int num_nodes ) {
+  IntAATree tree( &IntAATreeNode::less_than_fn, &IntAATreeNode::copy_node_fn, &IntAATreeNode::free_node_fn );
+  insert_all( tree, shuffled_vals( num_nodes, 1 ) );
+
+  std::vector< IntAATreeNode* > keys = make_search_keys( num_nodes, 2000000, 2 );
+  std::vector< IntAATreeNode* > results( keys.size() );
+
+  double single = time_finds( tree, keys );
+  printf( "find_many: nodes=%d find=%.3f Mfind/s\n", num_nodes, single / 1e6 );
+
+  for ( size_t batch = 1; batch <= 256; batch *= 2 ) {
+    Batch timed( "find_many", keys.size() );
+    for ( size_t i = 0; i < keys.size(); i += batch ) {
+      size_t count = std::min( batch, keys.size() - i );
+      tree.find_many( keys.data() + i, count, results.data() + i );
+    }
+    double rate = double( keys.size() ) / timed.finish();
+
+    size_t found = std::count_if( results.begin(), results.end(),
+                                  []( IntAATreeNode *n ) { return n != nullptr; } );
+    if ( found != keys.size() )
+      printf( "  warning: only %zu/%zu searches succeeded\n", found, keys.size() );
+
+    printf( "find_many: nodes=%d batch=%zu %.3f Mfind/s speedup=%.2fx\n",
+            num_nodes, batch, rate / 1e6, rate / single );
+  }
+
+  free_search_keys( keys );
+}
+
+// Searches of read-only snapshots of a tree, compared with find() on
+// the tree itself. AATreeIntSnapshot::find_many() searches four keys
+// at a time if the library is built with AVX2 (as it is for
+// build/aatree_bench_avx2.)
+void bench_snapshot( int num_nodes ) {
+  IntAATree tree( &IntAATreeNode::less_than_fn, &IntAATreeNode::copy_node_fn, &IntAATreeNode::free_node_fn );
+  insert_all( tree, shuffled_vals( num_nodes, 1 ) );
+
+  std::vector< IntAATreeNode* > keys = make_search_keys( num_nodes, 2000000, 2 );
+  std::vector< int64_t > int_keys;
+  for ( IntAATreeNode *key : keys )
+    int_keys.push_back( key->get_val() );
+  std::vector< IntAATreeNode* > results( keys.size() );
+
+  double tree_rate = time_finds( tree, keys );
+
+  std::vector< dslib::AATreeNode* > buf( size_t( num_nodes ) + 1 );
+  dslib::AATreeSnapshot< IntAATreeNode > snap;
+  snap.build( tree, buf.data(), buf.size() );
+  double snap_rate;
+  {
+    Batch batch( "snapshot find", keys.size() );
+    for ( size_t i = 0; i < keys.size(); ++i )
+      results[ i ] = snap.find( *keys[ i ] );
+    snap_rate = double( keys.size() ) / batch.finish();
+  }
+
+  std::vector< int64_t > key_buf( size_t( num_nodes ) + 1 );
+  std::vector< dslib::AATreeNode* > node_buf( size_t( num_nodes ) + 1 );
+  dslib::AATreeIntSnapshot< IntAATreeNode > int_snap;
+  int_snap.build( tree, &IntAATreeNode::get_key_fn, key_buf.data(), node_buf.data(), key_buf.size() );
+  double int_rate;
+  {
+    Batch batch( "int snapshot find", keys.size() );
+    for ( size_t i = 0; i < keys.size(); ++i )
+      results[ i ] = int_snap.find( int_keys[ i ] );
+    int_rate = double( keys.size() ) / batch.finish();
+  }
+
+  double many_rate;
+  {
+    Batch batch( "int snapshot find_many", keys.size() );
+    int_snap.find_many( int_keys.data(), int_keys.size(), results.data() );
+    many_rate = double( keys.size() ) / batch.finish();
+  }
+
+  size_t found = std::count_if( results.begin(), results.end(),
+                                []( IntAATreeNode *n ) { return n != nullptr; } );
+  if ( found != keys.size() )
+    printf( "  warning: only %zu/%zu searches succeeded\n", found, keys.size() );
+
+#ifdef __AVX2__
+  const char *simd = "avx2";
+#else
+  const char *simd = "none";
+#endif
+  printf( "snapshot: nodes=%d tree=%.3f snapshot=%.3f int_snapshot=%.3f int_find_many=%.3f Mfind/s simd=%s\n",
+          num_nodes, tree_rate / 1e6, snap_rate / 1e6, int_rate / 1e6, many_rate / 1e6, simd );
+
+  free_search_keys( keys );
+}
+
+// Run a random mix of insertions and removals, with keys in the range
+// 0..key_range-1, on the given tree: returns the number of operations
+// per second
+double time_mix( IntAATree &tree, int num_ops, int insert_percent, int key_range, unsigned seed ) {
+  std::default_random_engine rng( seed );
+  std::uniform_int_distribution< int > key_dist( 0, key_range - 1 );
+  std::uniform_int_distribution< int > op_dist( 0, 99 );
+
+  std::vector< int > ops;
+  for ( int i = 0; i < num_ops; ++i ) {
+    int key = key_dist( rng );
+    // encode removals as negative values
+    ops.push_back( op_dist( rng ) < insert_percent ? key : -key - 1 );
+  }
+
+  Batch batch( "update", size_t( num_ops ) );
+  for ( auto i = ops.begin(); i != ops.end(); ++i ) {
+    if ( *i >= 0 ) {
+      IntAATreeNode *node = new IntAATreeNode( *i );
+      if ( !tree.insert( node ) )
+        delete node;
+    } else {
+      tree.remove( IntAATreeNode( -*i - 1 ) );
+    }
+  }
+  return double( num_ops ) / batch.finish();
+}
+
+// Insert-heavy mix (90% insertions) starting from an empty tree,
+// and delete-heavy mix (90% removals) starting from a full tree
+void bench_update_mix( int num_nodes ) {
+  {
+    IntAATree tree( &IntAATreeNode::less_than_fn, &IntAATreeNode::copy_node_fn, &IntAATreeNode::free_node_fn );
+    double rate = time_mix( tree, num_nodes, 90, num_nodes, 3 );
+    printf( "update_mix: nodes=%d insert-heavy %.3f Mop/s\n", num_nodes, rate / 1e6 );
+  }
+
+  {
+    IntAATree tree( &IntAATreeNode::less_than_fn, &IntAATreeNode::copy_node_fn, &IntAATreeNode::free_node_fn );
+    insert_all( tree, shuffled_vals( num_nodes, 1 ) );
+    double rate = time_mix( tree, num_nodes, 10, num_nodes, 4 );
+    printf( "update_mix: nodes=%d delete-heavy %.3f Mop/s\n", num_nodes, rate / 1e6 );
+  }
+}
+
+typedef dslib::Pool< IntAATreeNode > IntNodePool;
+
+// Random allocations and frees (55% allocations), starting with
+// num_nodes live nodes: returns the number of operations per second
+template< typename AllocFn, typename FreeFn >
+double time_churn( int num_nodes, AllocFn alloc_fn, FreeFn free_fn ) {
+  std::default_random_engine rng( 5 );
+  std::uniform_int_distribution< int > op_dist( 0, 99 );
+  std::vector< IntAATreeNode* > live;
+  for ( int i = 0; i < num_nodes; ++i )
+    live.push_back( alloc_fn( i ) );
+  std::vector< unsigned > choices;
+  for ( int i = 0; i < 2 * num_nodes; ++i )
+    choices.push_back( unsigned( rng() ) );
+
+  Batch batch( "alloc/free", choices.size() );
+  for ( unsigned choice : choices ) {
+    if ( live.empty() || choice % 100 < 55 ) {
+      live.push_back( alloc_fn( int( choice ) ) );
+    } else {
+      size_t index = ( choice / 100 ) % live.size();
+      std::swap( live[ index ], live.back() );
+      free_fn( live.back() );
+      live.pop_back();
+    }
+  }
+  double rate = double( choices.size() ) / batch.finish();
+
+  for ( IntAATreeNode *node : live )
+    free_fn( node );
+  return rate;
+}
+
+// Run an even mix of insertions and removals on a tree of num_nodes
+// nodes, whose nodes are allocated with alloc_fn (and freed by the
+// tree's free node function): returns the number of operations
+// per second
+template< typename AllocFn >
+double time_pooled_mix( IntAATree &tree, int num_nodes, AllocFn alloc_fn ) {
+  for ( int val : shuffled_vals( num_nodes, 1 ) )
+    tree.insert( alloc_fn( 2 * val ) );
+
+  std::default_random_engine rng( 6 );
+  std::uniform_int_distribution< int > key_dist( 0, 2 * num_nodes - 1 );
+  std::vector< int > keys;
+  for ( int i = 0; i < 2 * num_nodes; ++i )
+    keys.push_back( key_dist( rng ) );
+
+  // Insert odd keys, and remove even keys, so that the tree's size
+  // stays about the same
+  Batch batch( "tree update", keys.size() );
+  for ( int key : keys ) {
+    if ( key % 2 == 1 ) {
+      IntAATreeNode *node = alloc_fn( key );
+      if ( !tree.insert( node ) )
+        tree.get_impl().free_node( node );
+    } else {
+      tree.remove( IntAATreeNode( key ) );
+    }
+  }
+  return double( keys.size() ) / batch.finish();
+}
+
+// Node churn with new/delete (malloc) and with a Pool: random
+// allocations and frees, and insertions and removals in a tree
+void bench_pool( int num_nodes ) {
+  double heap_churn = time_churn( num_nodes,
+    []( int val ) { return new IntAATreeNode( val ); },
+    []( IntAATreeNode *node ) { delete node; } );
+
+  IntNodePool pool;
+  double pool_churn = time_churn( num_nodes,
+    [&pool]( int val ) { return pool.create( val ); },
+    [&pool]( IntAATreeNode *node ) { pool.destroy( node ); } );
+
+  printf( "pool: nodes=%d alloc/free: new/delete=%.3f Mop/s pool=%.3f Mop/s speedup=%.2fx\n",
+          num_nodes, heap_churn / 1e6, pool_churn / 1e6, pool_churn / heap_churn );
+
+  double heap_mix;
+  {
+    IntAATree tree( &IntAATreeNode::less_than_fn, &IntAATreeNode::copy_node_fn, &IntAATreeNode::free_node_fn );
+    heap_mix = time_pooled_mix( tree, num_nodes, []( int val ) { return new IntAATreeNode( val ); } );
+  }
+
+  // The tree's context is the pool, so removed nodes go straight
+  // back to it
+  double pool_mix;
+  {
+    IntAATree tree( &IntAATreeNode::less_than_fn, &IntAATreeNode::copy_node_fn,
+                    &IntNodePool::free_node_ctx_fn< dslib::AATreeNode >, &pool );
+    pool_mix = time_pooled_mix( tree, num_nodes, [&pool]( int val ) { return pool.create( val ); } );
+  }
+
+  printf( "pool: nodes=%d tree update: new/delete=%.3f Mop/s pool=%.3f Mop/s speedup=%.2fx slabs=%zu\n",
+          num_nodes, heap_mix / 1e6, pool_mix / 1e6, pool_mix / heap_mix, pool.get_num_slabs() );
+}
+
+// Sum the values of the first max_nodes nodes visited by an iterator
+template< typename Iter >
+long scan( Iter it, int max_nodes ) {
+  long sum = 0;
+  for ( int i = 0; i < max_nodes && it.has_next(); ++i )
+    sum += it.next()->get_val();
+  return sum;
+}
+
+// In-order iteration with the stack-based iterator and with the
+// threaded iterator: full scans, and many short scans (where
+// creating the iterator is a significant part of the cost)
+void bench_scan( int num_nodes ) {
+  IntAATree tree( &IntAATreeNode::less_than_fn, &IntAATreeNode::copy_node_fn, &IntAATreeNode::free_node_fn );
+  IntAATree ttree( &IntAATreeNode::less_than_fn, &IntAATreeNode::copy_node_fn, &IntAATreeNode::free_node_fn, dslib::AA_TREE_THREADED );
+  std::vector< int > vals = shuffled_vals( num_nodes, 1 );
+  insert_all( tree, vals );
+  insert_all( ttree, vals );
+
+  const int SHORT_SCAN = 16, NUM_SHORT_SCANS = 1000000;
+  long check = 0;
+
+  Batch full_batch( "full scan, iterator, per node", size_t( num_nodes ) );
+  check += scan( tree.iterator(), num_nodes );
+  double full = double( num_nodes ) / full_batch.finish();
+
+  Batch tfull_batch( "full scan, threaded, per node", size_t( num_nodes ) );
+  check -= scan( ttree.threaded_iterator(), num_nodes );
+  double tfull = double( num_nodes ) / tfull_batch.finish();
+
+  Batch brief_batch( "short scan, iterator", NUM_SHORT_SCANS );
+  for ( int i = 0; i < NUM_SHORT_SCANS; ++i )
+    check += scan( tree.iterator(), SHORT_SCAN );
+  double brief = double( NUM_SHORT_SCANS ) / brief_batch.finish();
+
+  Batch tbrief_batch( "short scan, threaded", NUM_SHORT_SCANS );
+  for ( int i = 0; i < NUM_SHORT_SCANS; ++i )
+    check -= scan( ttree.threaded_iterator(), SHORT_SCAN );
+  double tbrief = double( NUM_SHORT_SCANS ) / tbrief_batch.finish();
+
+  if ( check != 0 )
+    printf( "  warning: scans don't agree\n" );
+
+  printf( "scan: nodes=%d full: iterator=%.3f Mnode/s threaded=%.3f Mnode/s speedup=%.2fx\n",
+          num_nodes, full / 1e6, tfull / 1e6, tfull / full );
+  printf( "scan: nodes=%d %d-node scans: iterator=%.3f Mscan/s threaded=%.3f Mscan/s speedup=%.2fx\n",
+          num_nodes, SHORT_SCAN, brief / 1e6, tbrief / 1e6, tbrief / brief );
+}
+
+// Removing nodes we already have pointers to: remove() (searching
+// by key) in a regular tree and in a tree with parent links, and
+// remove_node() in a tree with parent links
+void bench_remove_node( int num_nodes ) {
+  std::vector< int > vals = shuffled_vals( num_nodes, 1 );
+  std::vector< int > victims = shuffled_vals( num_nodes, 2 );
+  victims.resize( num_nodes / 2 );
+
+  double by_key;
+  {
+    IntAATree tree( &IntAATreeNode::less_than_fn, &IntAATreeNode::copy_node_fn, &IntAATreeNode::free_node_fn );
+    insert_all( tree, vals );
+    auto start = Clock::now();
+    for ( auto i = victims.begin(); i != victims.end(); ++i )
+      tree.remove( IntAATreeNode( *i ) );
+    by_key = double( victims.size() ) / elapsed_secs( start );
+  }
+
+  double parent_by_key, by_node;
+  for ( int use_remove_node = 0; use_remove_node < 2; ++use_remove_node ) {
+    IntParentAATree tree( &IntAATreeParentNode::less_than_fn, nullptr, &IntAATreeParentNode::free_node_fn );
+    std::vector< IntAATreeParentNode* > nodes( num_nodes );
+    for ( auto i = vals.begin(); i != vals.end(); ++i ) {
+      nodes[ *i ] = new IntAATreeParentNode( *i );
+      tree.insert( nodes[ *i ] );
+    }
+
+    auto start = Clock::now();
+    for ( auto i = victims.begin(); i != victims.end(); ++i ) {
+      if ( use_remove_node )
+        tree.remove_node( nodes[ *i ] );
+      else
+        tree.remove( IntAATreeParentNode( *i ) );
+    }
+    double rate = double( victims.size() ) / elapsed_secs( start );
+    ( use_remove_node ? by_node : parent_by_key ) = rate;
+  }
+
+  printf( "remove_node: nodes=%d remove=%.3f Mop/s parent-links remove=%.3f Mop/s "
+          "remove_node=%.3f Mop/s speedup=%.2fx\n",
+          num_nodes, by_key / 1e6, parent_by_key / 1e6, by_node / 1e6, by_node / by_key );
+}
+
+// Full scans with parallel_reduce(), summing the node values,
+// using increasing numbers of threads
+void bench_parallel_scan( int num_nodes ) {
+  IntAATree tree( &IntAATreeNode::less_than_fn, &IntAATreeNode::copy_node_fn, &IntAATreeNode::free_node_fn );
+  insert_all( tree, shuffled_vals( num_nodes, 1 ) );
+
+  auto start = Clock::now();
+  long expected = scan( tree.iterator(), num_nodes );
+  double sequential = double( num_nodes ) / elapsed_secs( start );
+  printf( "parallel_scan: nodes=%d sequential=%.3f Mnode/s\n", num_nodes, sequential / 1e6 );
+
+  for ( int num_threads = 1; num_threads <= 16; num_threads *= 2 ) {
+    start = Clock::now();
+    long sum = dslib::parallel_reduce( tree, 0L,
+      []( IntAATreeNode *node ) { return long( node->get_val() ); },
+      []( long left, long right ) { return left + right; },
+      num_threads );
+    double rate = double( num_nodes ) / elapsed_secs( start );
+    if ( sum != expected )
+      printf( "  warning: parallel sum doesn't agree\n" );
+    printf( "parallel_scan: nodes=%d threads=%d rate=%.3f Mnode/s speedup=%.2fx\n",
+            num_nodes, num_threads, rate / 1e6, rate / sequential );
+  }
+}
+
+// Time building a tree from num_nodes sorted nodes with the given
+// build function (not counting allocation of the nodes): returns
+// the number of nodes per second
+template< typename BuildFn >
+double time_build( int num_nodes, BuildFn build_fn ) {
+  std::vector< IntAATreeNode* > nodes;
+  for ( int i = 0; i < num_nodes; ++i )
+    nodes.push_back( new IntAATreeNode( i ) );
+
+  IntAATree tree( &IntAATreeNode::less_than_fn, &IntAATreeNode::copy_node_fn, &IntAATreeNode::free_node_fn );
+  auto start = Clock::now();
+  build_fn( tree, nodes );
+  double rate = double( num_nodes ) / elapsed_secs( start );
+  if ( tree.get_size() != size_t( num_nodes ) )
+    printf( "  warning: tree has the wrong number of nodes\n" );
+  return rate;
+}
+
+// Building a tree from sorted nodes: by inserting them one at a time,
+// with build(), and with parallel_build() using increasing numbers
+// of threads
+void bench_build( int num_nodes ) {
+  double inserts = time_build( num_nodes, []( IntAATree &tree, std::vector< IntAATreeNode* > &nodes ) {
+    for ( auto i = nodes.begin(); i != nodes.end(); ++i )
+      tree.insert( *i );
+  } );
+  double sequential = time_build( num_nodes, []( IntAATree &tree, std::vector< IntAATreeNode* > &nodes ) {
+    tree.build( nodes.data(), nodes.size() );
+  } );
+  printf( "build: nodes=%d insert=%.3f Mnode/s build=%.3f Mnode/s speedup=%.2fx\n",
+          num_nodes, inserts / 1e6, sequential / 1e6, sequential / inserts );
+
+  for ( int num_threads = 1; num_threads <= 16; num_threads *= 2 ) {
+    double rate = time_build( num_nodes, [num_threads]( IntAATree &tree, std::vector< IntAATreeNode* > &nodes ) {
+      dslib::parallel_build( tree, nodes.data(), nodes.size(), num_threads );
+    } );
+    printf( "build: nodes=%d threads=%d parallel_build=%.3f Mnode/s time=%.3f s speedup=%.2fx\n",
+            num_nodes, num_threads, rate / 1e6, num_nodes / rate, rate / sequential );
+  }
+}
+
+// Build a tree from the given sorted values
+void build_from_vals( IntAATree &tree, const std::vector< int > &vals ) {
+  std::vector< IntAATreeNode* > nodes;
+  for ( auto i = vals.begin(); i != vals.end(); ++i )
+    nodes.push_back( new IntAATreeNode( *i ) );
+  tree.build( nodes.data(), nodes.size() );
+}
+
+// Time a set operation on trees with the given (sorted) values:
+// returns the elapsed time in seconds
+template< typename SetOpFn >
+double time_set_op( const std::vector< int > &a, const std::vector< int > &b, SetOpFn set_op_fn ) {
+  IntAATree tree( &IntAATreeNode::less_than_fn, &IntAATreeNode::copy_node_fn, &IntAATreeNode::free_node_fn );
+  IntAATree other( &IntAATreeNode::less_than_fn, &IntAATreeNode::copy_node_fn, &IntAATreeNode::free_node_fn );
+  build_from_vals( tree, a );
+  build_from_vals( other, b );
+
+  auto start = Clock::now();
+  set_op_fn( tree, other );
+  return elapsed_secs( start );
+}
+
+// Time inserting nodes with the given values, one at a time, into
+// a tree built from the (sorted) values in a: returns the elapsed
+// time in seconds
+double time_union_inserts( const std::vector< int > &a, const std::vector< int > &b ) {
+  IntAATree tree( &IntAATreeNode::less_than_fn, &IntAATreeNode::copy_node_fn, &IntAATreeNode::free_node_fn );
+  build_from_vals( tree, a );
+  std::vector< IntAATreeNode* > nodes;
+  for ( auto i = b.begin(); i != b.end(); ++i )
+    nodes.push_back( new IntAATreeNode( *i ) );
+
+  auto start = Clock::now();
+  for ( auto i = nodes.begin(); i != nodes.end(); ++i ) {
+    if ( !tree.insert( *i ) )
+      delete *i;
+  }
+  return elapsed_secs( start );
+}
+
+// Join-based set operations on two trees with about half of their
+// values in common, and a union of a large tree with a small one.
+// The union is compared to inserting the other tree's values one at
+// a time, and the parallel versions use increasing numbers of threads.
+void bench_set_ops( int num_nodes ) {
+  auto sorted_sample = []( int n, int max_val, unsigned seed ) {
+    std::vector< int > vals = shuffled_vals( max_val, seed );
+    vals.resize( n );
+    std::sort( vals.begin(), vals.end() );
+    return vals;
+  };
+  std::vector< int > a = sorted_sample( num_nodes, 2*num_nodes, 1 );
+  std::vector< int > b = sorted_sample( num_nodes, 2*num_nodes, 2 );
+  std::vector< int > small = sorted_sample( num_nodes / 1000, 2*num_nodes, 3 );
+
+  double inserts = time_union_inserts( a, b );
+  double seq = time_set_op( a, b, []( IntAATree &tree, IntAATree &other ) { tree.set_union( other ); } );
+  printf( "set_ops: nodes=%d union: insert=%.3f s set_union=%.3f s speedup=%.2fx\n",
+          num_nodes, inserts, seq, inserts / seq );
+
+  double small_inserts = time_union_inserts( a, small );
+  double small_seq = time_set_op( a, small, []( IntAATree &tree, IntAATree &other ) { tree.set_union( other ); } );
+  printf( "set_ops: nodes=%d other=%zu union: insert=%.6f s set_union=%.6f s speedup=%.2fx\n",
+          num_nodes, small.size(), small_inserts, small_seq, small_inserts / small_seq );
+
+  const char *const NAMES[] = { "union", "intersection", "difference" };
+  for ( int op = 0; op < 3; ++op ) {
+    double sequential = time_set_op( a, b, [op]( IntAATree &tree, IntAATree &other ) {
+      if ( op == 0 )
+        tree.set_union( other );
+      else if ( op == 1 )
+        tree.set_intersection( other );
+      else
+        tree.set_difference( other );
+    } );
+    printf( "set_ops: nodes=%d %s: sequential=%.3f s\n", num_nodes, NAMES[ op ], sequential );
+
+    for ( int num_threads = 1; num_threads <= 16; num_threads *= 2 ) {
+      double secs = time_set_op( a, b, [op, num_threads]( IntAATree &tree, IntAATree &other ) {
+        if ( op == 0 )
+          dslib::parallel_union( tree, other, num_threads );
+        else if ( op == 1 )
+          dslib::parallel_intersection( tree, other, num_threads );
+        else
+          dslib::parallel_difference( tree, other, num_threads );
+      } );
+      printf( "set_ops: nodes=%d %s: threads=%d time=%.3f s speedup=%.2fx\n",
+              num_nodes, NAMES[ op ], num_threads, secs, sequential / secs );
+    }
+  }
+}
+
+class VectorWriter : public dslib::AATreeWriter {
+public:
+  std::vector< unsigned char > data;
+
+  virtual bool write( const void *p, size_t n ) {
+    const unsigned char *bytes = static_cast< const unsigned char* >( p );
+    data.insert( data.end(), bytes, bytes + n );
+    return true;
+  }
+};
+
+class VectorReader : public dslib::AATreeReader {
+private:
+  const std::vector< unsigned char > &m_data;
+  size_t m_pos;
+
+public:
+  VectorReader( const std::vector< unsigned char > &data ) : m_data( data ), m_pos( 0 ) { }
+
+  virtual size_t read( void *buf, size_t n ) {
+    n = std::min( n, m_data.size() - m_pos );
+    memcpy( buf, m_data.data() + m_pos, n );
+    m_pos += n;
+    return n;
+  }
+};
+
+size_t encode_int_node( const dslib::AATreeNode *node, void *buf, size_t size ) {
+  int val = static_cast< const IntAATreeNode* >( node )->get_val();
+  if ( size >= sizeof( val ) )
+    memcpy( buf, &val, sizeof( val ) );
+  return sizeof( val );
+}
+
+dslib::AATreeNode *decode_int_node( const void *data, size_t size ) {
+  int val;
+  if ( size != sizeof( val ) )
+    return nullptr;
+  memcpy( &val, data, sizeof( val ) );
+  return new IntAATreeNode( val );
+}
+
+// Writing a tree with serialize(), and reloading it with load(),
+// compared to reloading it by decoding the same data and inserting
+// the nodes one at a time
+void bench_serialize( int num_nodes ) {
+  VectorWriter writer;
+  double write_rate;
+  {
+    IntAATree tree( &IntAATreeNode::less_than_fn, &IntAATreeNode::copy_node_fn, &IntAATreeNode::free_node_fn );
+    insert_all( tree, shuffled_vals( num_nodes, 1 ) );
+    auto start = Clock::now();
+    if ( !dslib::serialize( tree, writer, &encode_int_node ) )
+      printf( "  warning: serialize failed\n" );
+    write_rate = double( num_nodes ) / elapsed_secs( start );
+  }
+
+  double load_rate;
+  {
+    IntAATree tree( &IntAATreeNode::less_than_fn, &IntAATreeNode::copy_node_fn, &IntAATreeNode::free_node_fn );
+    VectorReader reader( writer.data );
+    auto start = Clock::now();
+    if ( !dslib::load( tree, reader, &decode_int_node ) )
+      printf( "  warning: load failed\n" );
+    load_rate = double( num_nodes ) / elapsed_secs( start );
+  }
+
+  // The records start after the 24 byte header, and each one is a
+  // 1 byte length followed by the 4 byte value
+  double insert_rate;
+  {
+    IntAATree tree( &IntAATreeNode::less_than_fn, &IntAATreeNode::copy_node_fn, &IntAATreeNode::free_node_fn );
+    auto start = Clock::now();
+    for ( int i = 0; i < num_nodes; ++i )
+      tree.insert( static_cast< IntAATreeNode* >( decode_int_node( writer.data.data() + 24 + 5*i + 1, 4 ) ) );
+    insert_rate = double( num_nodes ) / elapsed_secs( start );
+  }
+
+  printf( "serialize: nodes=%d bytes=%zu serialize=%.3f Mnode/s load=%.3f Mnode/s "
+          "insert=%.3f Mnode/s speedup=%.2fx\n",
+          num_nodes, writer.data.size(), write_rate / 1e6, load_rate / 1e6, insert_rate / 1e6,
+          load_rate / insert_rate );
+}
+
+class IntRegionNode : public dslib::AATreeRegionNode {
+private:
+  int m_val;
+
+  NO_VALUE_SEMANTICS( IntRegionNode );
+
+public:
+  IntRegionNode( int val = 0 ) : m_val( val ) { }
+  ~IntRegionNode() { }
+
+  static bool less_than_fn( const dslib::AATreeRegionNode *left, const dslib::AATreeRegionNode *right ) {
+    return static_cast< const IntRegionNode* >( left )->m_val
+         < static_cast< const IntRegionNode* >( right )->m_val;
+  }
+};
+
+// Insertion and find() throughput of a region tree (in an ordinary
+// heap buffer), compared to an AATree
+void bench_region( int num_nodes ) {
+  std::vector< int > vals = shuffled_vals( num_nodes, 1 );
+  std::vector< IntAATreeNode* > keys = make_search_keys( num_nodes, 2000000, 2 );
+
+  double insert_rate, find_rate;
+  {
+    IntAATree tree( &IntAATreeNode::less_than_fn, &IntAATreeNode::copy_node_fn, &IntAATreeNode::free_node_fn );
+    auto start = Clock::now();
+    insert_all( tree, vals );
+    insert_rate = double( num_nodes ) / elapsed_secs( start );
+    find_rate = time_finds( tree, keys );
+  }
+
+  double region_insert_rate, region_find_rate;
+  {
+    size_t size = 4096 + size_t( num_nodes ) * sizeof( IntRegionNode );
+    std::vector< std::max_align_t > buf( size / sizeof( std::max_align_t ) + 1 );
+    dslib::AATreeRegion< IntRegionNode >::format( buf.data(), size );
+    dslib::AATreeRegion< IntRegionNode > tree( buf.data(), &IntRegionNode::less_than_fn );
+
+    auto start = Clock::now();
+    for ( auto i = vals.begin(); i != vals.end(); ++i )
+      tree.insert( new ( tree.alloc() ) IntRegionNode( *i ) );
+    region_insert_rate = double( num_nodes ) / elapsed_secs( start );
+
+    start = Clock::now();
+    size_t found = 0;
+    for ( auto i = keys.begin(); i != keys.end(); ++i )
+      if ( tree.find( IntRegionNode( ( *i )->get_val() ) ) != nullptr )
+        ++found;
+    region_find_rate = double( keys.size() ) / elapsed_secs( start );
+    if ( found != keys.size() )
+      printf( "  warning: only %zu/%zu searches succeeded\n", found, keys.size() );
+  }
+
+  printf( "region: nodes=%d insert=%.3f Mop/s region_insert=%.3f Mop/s "
+          "find=%.3f Mfind/s region_find=%.3f Mfind/s\n",
+          num_nodes, insert_rate / 1e6, region_insert_rate / 1e6,
+          find_rate / 1e6, region_find_rate / 1e6 );
+
+  free_search_keys( keys );
+}
+
+// Checking a tree incrementally (a chunk of nodes at a time),
+// compared to scanning it with an iterator
+void bench_check( int num_nodes ) {
+  IntAATree tree( &IntAATreeNode::less_than_fn, &IntAATreeNode::copy_node_fn, &IntAATreeNode::free_node_fn );
+  insert_all( tree, shuffled_vals( num_nodes, 1 ) );
+
+  const size_t CHUNK = 4096;
+
+  auto start = Clock::now();
+  long check = scan( tree.iterator(), num_nodes );
+  double scan_rate = double( num_nodes ) / elapsed_secs( start );
+
+  start = Clock::now();
+  dslib::AATreeChecker< IntAATreeNode > checker( tree );
+  int num_chunks = 0;
+  while ( !checker.check( CHUNK ) )
+    ++num_chunks;
+  double check_rate = double( num_nodes ) / elapsed_secs( start );
+
+  const dslib::AATreeShape &shape = checker.get_shape();
+  if ( !checker.is_valid() || shape.num_nodes != size_t( num_nodes ) || check == 0 )
+    printf( "  warning: check failed\n" );
+
+  printf( "check: nodes=%d chunks=%d scan=%.3f Mnode/s check=%.3f Mnode/s "
+          "height=%d avg_depth=%.2f bytes=%zu\n",
+          num_nodes, num_chunks + 1, scan_rate / 1e6, check_rate / 1e6,
+          shape.height, shape.get_average_depth(), shape.bytes_used );
+}
+
+// Writer that just counts the bytes written
+class CountingWriter : public dslib::AATreeWriter {
+public:
+  size_t count = 0;
+
+  virtual bool write( const void *, size_t n ) {
+    count += n;
+    return true;
+  }
+};
+
+size_t int_label_fn( const dslib::AATreeNode *node, char *buf, size_t size ) {
+  return size_t( snprintf( buf, size, "%d", static_cast< const IntAATreeNode* >( node )->get_val() ) );
+}
+
+// Exporting a whole tree as DOT and as JSON
+void bench_export( int num_nodes ) {
+  IntAATree tree( &IntAATreeNode::less_than_fn, &IntAATreeNode::copy_node_fn, &IntAATreeNode::free_node_fn );
+  insert_all( tree, shuffled_vals( num_nodes, 1 ) );
+
+  const dslib::AATreeExportFormat FORMATS[] = { dslib::AA_TREE_EXPORT_DOT, dslib::AA_TREE_EXPORT_JSON };
+  const char *const NAMES[] = { "dot", "json" };
+  for ( int i = 0; i < 2; ++i ) {
+    dslib::AATreeExportOptions options;
+    options.format = FORMATS[ i ];
+    CountingWriter writer;
+    auto start = Clock::now();
+    if ( !dslib::export_tree( tree, writer, &int_label_fn, options ) )
+      printf( "  warning: export failed\n" );
+    double secs = elapsed_secs( start );
+    printf( "export: nodes=%d %s: time=%.3f s rate=%.3f Mnode/s output=%.1f MB (%.1f MB/s)\n",
+            num_nodes, NAMES[ i ], secs, double( num_nodes ) / secs / 1e6,
+            double( writer.count ) / 1e6, double( writer.count ) / secs / 1e6 );
+  }
+}
+
+////////////////////////////////////////////////////////////////////////
+// Benchmark program
+////////////////////////////////////////////////////////////////////////
+
+struct Benchmark {
+  const char *name;
+  void (*fn)( int num_nodes );
+  int default_num_nodes;
+};
+
+const Benchmark BENCHMARKS[] = {
+  { "relayout_find", &bench_relayout_find, 10000000 },
+  { "find_many", &bench_find_many, 10000000 },
+  { "snapshot", &bench_snapshot, 10000000 },
+  { "update_mix", &bench_update_mix, 1000000 },
+  { "scan", &bench_scan, 1000000 },
+  { "remove_node", &bench_remove_node, 1000000 },
+  { "parallel_scan", &bench_parallel_scan, 10000000 },
+  { "build", &bench_build, 10000000 },
+  { "set_ops", &bench_set_ops, 2000000 },
+  { "serialize", &bench_serialize, 10000000 },
+  { "region", &bench_region, 10000000 },
+  { "check", &bench_check, 10000000 },
+  { "export", &bench_export, 10000000 },
+  { "pool", &bench_pool, 1000000 },
+};
+
+int main( int argc, char **argv ) {
+  const char *name = ( argc > 1 ) ? argv[1] : nullptr;
+  int num_nodes = ( argc > 2 ) ? atoi( argv[2] ) : 0;
+
+  if ( !g_counters.is_available() )
+    fprintf( stderr, "Hardware performance counters are unavailable: reporting times only\n" );
+
+  bool ran = false;
+  for ( const Benchmark &b : BENCHMARKS ) {
+    if ( name == nullptr || strcmp( name, b.name ) == 0 ) {
+      b.fn( num_nodes > 0 ? num_nodes : b.default_num_nodes );
+      ran = true;
+    }
+  }
+
+  if ( !ran ) {
+    fprintf( stderr, "Unknown benchmark: %s\n", name );
+    return 1;
+  }
+
+  return 0;
+}
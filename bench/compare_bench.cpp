@@ -0,0 +1,613 @@
+// Copyright 2025, David H. Hovemeyer <david.hovemeyer@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// “Software”), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+// THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+// Benchmarks comparing dslib containers to the standard library:
+// AATree to std::set and std::map, and List to std::list.
+//
+// Usage: compare_bench [max_size [min_size]]
+//
+// Each workload is run with container sizes from min_size (default
+// 1000) up to max_size (default 1000000), in powers of 10 (the
+// tree workloads have been run with up to 100M elements, given
+// enough memory.) The results are written to standard output as
+// JSON, so they can be saved and compared between versions:
+//
+//   {"benchmark":"compare","results":[
+//     {"container":"aatree","workload":"find","keys":"zipfian",
+//      "size":1000,"ops":200000,"secs":0.0123,"mops_per_sec":16.26,
+//      "cycles_per_op":151.2,"instructions_per_op":212.7,...},
+//     ...]}
+//
+// Where hardware performance counters are available (see
+// perf_counters.h), the counts per operation are included: cycles,
+// instructions, L1D/LLC/dTLB read misses, and branch mispredictions.
+// Unavailable counters are null.
+//
+// Workloads:
+//
+//   insert   insert size keys into an empty container
+//   find     look up keys in a container of size elements
+//   remove   remove size keys from a container of size elements
+//   iterate  visit every element in order
+//   mixed    50% finds, 25% inserts, 25% removals on a container
+//            of about size elements
+//
+// Key patterns (keys are in [0, size)):
+//
+//   sequential  0, 1, 2, ...
+//   random      uniformly random
+//   zipfian     Zipf-distributed (theta = 0.99), with the hot keys
+//               scattered over the key space
+//   adversarial alternating between the smallest and largest keys
+//               not used yet (0, size-1, 1, size-2, ...), which
+//               keeps rebalancing at both edges of a tree
+//
+// The List workloads (insert = append, remove = remove_first,
+// mixed = a queue with appends and removals) don't depend on keys,
+// so they are only run with sequential keys.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <set>
+#include <map>
+#include <list>
+#include <algorithm>
+#include <random>
+#include <chrono>
+#include "ds_aatree.h"
+#include "ds_list.h"
+#include "perf_counters.h"
+
+////////////////////////////////////////////////////////////////////////
+// Node types
+////////////////////////////////////////////////////////////////////////
+
+class IntAATreeNode : public dslib::AATreeNode {
+private:
+  int m_val;
+
+  NO_VALUE_SEMANTICS( IntAATreeNode );
+
+public:
+  IntAATreeNode( int val = 0 ) : m_val( val ) { }
+  ~IntAATreeNode() { }
+
+  int get_val() const { return m_val; }
+  void set_val( int val ) { m_val = val; }
+
+  static void free_node_fn( dslib::AATreeNode *node ) {
+    delete static_cast< IntAATreeNode* >( node );
+  }
+
+  static void copy_node_fn( dslib::AATreeNode *from, dslib::AATreeNode *to ) {
+    static_cast< IntAATreeNode* >( to )->m_val = static_cast< IntAATreeNode* >( from )->m_val;
+  }
+
+  static bool less_than_fn( const dslib::AATreeNode *left, const dslib::AATreeNode *right ) {
+    return static_cast< const IntAATreeNode* >( left )->m_val
+         < static_cast< const IntAATreeNode* >( right )->m_val;
+  }
+};
+
+class IntListNode : public dslib::ListNode {
+private:
+  int m_val;
+
+  NO_VALUE_SEMANTICS( IntListNode );
+
+public:
+  IntListNode( int val ) : m_val( val ) { }
+
+  int get_val() const { return m_val; }
+
+  static void free_node_fn( dslib::ListNode *node ) {
+    delete static_cast< IntListNode* >( node );
+  }
+};
+
+////////////////////////////////////////////////////////////////////////
+// Containers, with a common interface
+////////////////////////////////////////////////////////////////////////
+
+class AATreeContainer {
+private:
+  dslib::AATree< IntAATreeNode > m_tree;
+
+public:
+  static const char *name() { return "aatree"; }
+
+  AATreeContainer()
+    : m_tree( &IntAATreeNode::less_than_fn, &IntAATreeNode::copy_node_fn, &IntAATreeNode::free_node_fn ) { }
+
+  bool insert( int key ) {
+    IntAATreeNode *node = new IntAATreeNode( key );
+    if ( m_tree.insert( node ) )
+      return true;
+    delete node;
+    return false;
+  }
+
+  bool find( int key ) const { return m_tree.find( IntAATreeNode( key ) ) != nullptr; }
+  bool remove( int key ) { return m_tree.remove( IntAATreeNode( key ) ); }
+
+  long iterate() const {
+    long sum = 0;
+    for ( auto it = m_tree.iterator(); it.has_next(); )
+      sum += it.next()->get_val();
+    return sum;
+  }
+};
+
+class SetContainer {
+private:
+  std::set< int > m_set;
+
+public:
+  static const char *name() { return "std::set"; }
+
+  bool insert( int key ) { return m_set.insert( key ).second; }
+  bool find( int key ) const { return m_set.find( key ) != m_set.end(); }
+  bool remove( int key ) { return m_set.erase( key ) != 0; }
+
+  long iterate() const {
+    long sum = 0;
+    for ( int key : m_set )
+      sum += key;
+    return sum;
+  }
+};
+
+class MapContainer {
+private:
+  std::map< int, int > m_map;
+
+public:
+  static const char *name() { return "std::map"; }
+
+  bool insert( int key ) { return m_map.emplace( key, key ).second; }
+  bool find( int key ) const { return m_map.find( key ) != m_map.end(); }
+  bool remove( int key ) { return m_map.erase( key ) != 0; }
+
+  long iterate() const {
+    long sum = 0;
+    for ( const auto &kv : m_map )
+      sum += kv.second;
+    return sum;
+  }
+};
+
+// The lists are used as queues: insert appends, and remove
+// removes the first element
+class ListContainer {
+private:
+  dslib::List< IntListNode > m_list;
+
+public:
+  static const char *name() { return "list"; }
+
+  ListContainer() : m_list( &IntListNode::free_node_fn ) { }
+
+  bool insert( int key ) {
+    m_list.append( new IntListNode( key ) );
+    return true;
+  }
+
+  bool remove( int ) {
+    if ( m_list.is_empty() )
+      return false;
+    delete m_list.remove_first();
+    return true;
+  }
+
+  long iterate() const {
+    long sum = 0;
+    for ( IntListNode *p = m_list.get_first(); p != nullptr; p = m_list.next( p ) )
+      sum += p->get_val();
+    return sum;
+  }
+};
+
+class StdListContainer {
+private:
+  std::list< int > m_list;
+
+public:
+  static const char *name() { return "std::list"; }
+
+  bool insert( int key ) {
+    m_list.push_back( key );
+    return true;
+  }
+
+  bool remove( int ) {
+    if ( m_list.empty() )
+      return false;
+    m_list.pop_front();
+    return true;
+  }
+
+  long iterate() const {
+    long sum = 0;
+    for ( int key : m_list )
+      sum += key;
+    return sum;
+  }
+};
+
+////////////////////////////////////////////////////////////////////////
+// Keys
+////////////////////////////////////////////////////////////////////////
+
+enum KeyPattern {
+  KEYS_SEQUENTIAL,
+  KEYS_RANDOM,
+  KEYS_ZIPFIAN,
+  KEYS_ADVERSARIAL,
+};
+
+const char *const KEY_PATTERN_NAMES[] = { "sequential", "random", "zipfian", "adversarial" };
+
+// Zipf-distributed ranks in [0, n), using the method of Gray et al.,
+// "Quickly Generating Billion-Record Synthetic Databases" (as in YCSB)
+class ZipfGenerator {
+private:
+  uint64_t m_n;
+  double m_theta, m_alpha, m_zetan, m_eta;
+
+public:
+  ZipfGenerator( uint64_t n, double theta )
+    : m_n( n ), m_theta( theta ), m_alpha( 1.0 / ( 1.0 - theta ) ), m_zetan( zeta( n, theta ) ) {
+    double zeta2 = 1.0 + 1.0 / pow( 2.0, theta );
+    m_eta = ( 1.0 - pow( 2.0 / double( n ), 1.0 - theta ) ) / ( 1.0 - zeta2 / m_zetan );
+  }
+
+  // zeta(n) = sum of 1/i^theta for i in [1, n]. This takes n calls to
+  // pow(), so it is computed once for each size, and reused by every
+  // workload and container.
+  static double zeta( uint64_t n, double theta ) {
+    static std::map< std::pair< uint64_t, double >, double > cache;
+    auto i = cache.find( std::make_pair( n, theta ) );
+    if ( i != cache.end() )
+      return i->second;
+    double sum = 0.0;
+    for ( uint64_t j = 1; j <= n; ++j )
+      sum += 1.0 / pow( double( j ), theta );
+    cache[ std::make_pair( n, theta ) ] = sum;
+    return sum;
+  }
+
+  template< typename Rng >
+  uint64_t next( Rng &rng ) {
+    double u = std::uniform_real_distribution< double >( 0.0, 1.0 )( rng );
+    double uz = u * m_zetan;
+    if ( uz < 1.0 )
+      return 0;
+    if ( uz < 1.0 + pow( 0.5, m_theta ) )
+      return 1;
+    uint64_t rank = uint64_t( double( m_n ) * pow( m_eta * u - m_eta + 1.0, m_alpha ) );
+    return rank < m_n ? rank : m_n - 1;
+  }
+};
+
+// Get count keys in [0, n) following the given pattern
+std::vector< int > make_keys( KeyPattern pattern, int n, size_t count, unsigned seed ) {
+  std::vector< int > keys;
+  keys.reserve( count );
+  std::mt19937_64 rng( seed );
+
+  switch ( pattern ) {
+  case KEYS_SEQUENTIAL:
+    for ( size_t i = 0; i < count; ++i )
+      keys.push_back( int( i % size_t( n ) ) );
+    break;
+
+  case KEYS_RANDOM:
+    if ( count == size_t( n ) ) {
+      // A permutation, so that every key is used once
+      for ( int i = 0; i < n; ++i )
+        keys.push_back( i );
+      std::shuffle( keys.begin(), keys.end(), rng );
+    } else {
+      std::uniform_int_distribution< int > dist( 0, n - 1 );
+      for ( size_t i = 0; i < count; ++i )
+        keys.push_back( dist( rng ) );
+    }
+    break;
+
+  case KEYS_ZIPFIAN: {
+    // Scatter the ranks with a multiplicative hash, so the hot keys
+    // aren't all next to each other
+    ZipfGenerator zipf( uint64_t( n ), 0.99 );
+    for ( size_t i = 0; i < count; ++i )
+      keys.push_back( int( zipf.next( rng ) * 2654435761ULL % uint64_t( n ) ) );
+    break;
+  }
+
+  case KEYS_ADVERSARIAL:
+    for ( size_t i = 0; i < count; ++i ) {
+      size_t j = i % size_t( n );
+      keys.push_back( ( j % 2 == 0 ) ? int( j / 2 ) : n - 1 - int( j / 2 ) );
+    }
+    break;
+  }
+
+  return keys;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Workloads
+////////////////////////////////////////////////////////////////////////
+
+typedef std::chrono::steady_clock Clock;
+
+double elapsed_secs( Clock::time_point start ) {
+  return std::chrono::duration< double >( Clock::now() - start ).count();
+}
+
+PerfCounters g_counters;
+
+// Times a batch of operations (which may be done in several
+// intervals, leaving out setup work), and counts hardware events
+class Measurement {
+private:
+  double m_secs;
+  Clock::time_point m_start;
+
+public:
+  Measurement() : m_secs( 0.0 ) { g_counters.reset(); }
+
+  void start() {
+    g_counters.start();
+    m_start = Clock::now();
+  }
+
+  void stop() {
+    m_secs += elapsed_secs( m_start );
+    g_counters.stop();
+  }
+
+  double get_secs() const { return m_secs; }
+};
+
+// Workloads on small containers are repeated until they have done
+// at least this many operations, so that they take long enough to time
+const size_t MIN_OPS = 200000;
+
+size_t num_reps( int n ) {
+  return std::max( size_t( 1 ), MIN_OPS / size_t( n ) );
+}
+
+// Checksum of the results of all of the operations (printed at the
+// end, so the compiler can't optimize the operations away)
+long g_check;
+
+bool g_first_result = true;
+
+void print_result( const char *container, const char *workload, KeyPattern pattern,
+                   int n, size_t ops, const Measurement &m ) {
+  char counters[ 512 ];
+  g_counters.format_json( counters, sizeof( counters ), ops );
+  printf( "%s\n    {\"container\":\"%s\",\"workload\":\"%s\",\"keys\":\"%s\","
+          "\"size\":%d,\"ops\":%zu,\"secs\":%.6f,\"mops_per_sec\":%.3f%s}",
+          g_first_result ? "" : ",", container, workload, KEY_PATTERN_NAMES[ pattern ],
+          n, ops, m.get_secs(), double( ops ) / m.get_secs() / 1e6, counters );
+  fflush( stdout );
+  g_first_result = false;
+}
+
+// Fill a container with the keys 0..n-1, inserted in random order
+template< typename Container >
+void fill( Container &c, int n ) {
+  for ( int key : make_keys( KEYS_RANDOM, n, size_t( n ), 1 ) )
+    c.insert( key );
+}
+
+template< typename Container >
+void bench_insert( int n, KeyPattern pattern ) {
+  std::vector< int > keys = make_keys( pattern, n, size_t( n ), 2 );
+  size_t reps = num_reps( n );
+  Measurement m;
+  for ( size_t r = 0; r < reps; ++r ) {
+    Container c;
+    m.start();
+    for ( int key : keys )
+      g_check += c.insert( key );
+    m.stop();
+  }
+  print_result( Container::name(), "insert", pattern, n, reps * keys.size(), m );
+}
+
+template< typename Container >
+void bench_find( int n, KeyPattern pattern ) {
+  Container c;
+  fill( c, n );
+  std::vector< int > keys = make_keys( pattern, n, std::max( MIN_OPS, size_t( n ) ), 3 );
+  Measurement m;
+  m.start();
+  for ( int key : keys )
+    g_check += c.find( key );
+  m.stop();
+  print_result( Container::name(), "find", pattern, n, keys.size(), m );
+}
+
+template< typename Container >
+void bench_remove( int n, KeyPattern pattern ) {
+  std::vector< int > keys = make_keys( pattern, n, size_t( n ), 4 );
+  size_t reps = num_reps( n );
+  Measurement m;
+  for ( size_t r = 0; r < reps; ++r ) {
+    Container c;
+    fill( c, n );
+    m.start();
+    for ( int key : keys )
+      g_check += c.remove( key );
+    m.stop();
+  }
+  print_result( Container::name(), "remove", pattern, n, reps * keys.size(), m );
+}
+
+template< typename Container >
+void bench_iterate( int n, KeyPattern pattern ) {
+  Container c;
+  fill( c, n );
+  size_t reps = num_reps( n );
+  Measurement m;
+  m.start();
+  for ( size_t r = 0; r < reps; ++r )
+    g_check += c.iterate();
+  m.stop();
+  print_result( Container::name(), "iterate", pattern, n, reps * size_t( n ), m );
+}
+
+template< typename Container >
+void bench_mixed( int n, KeyPattern pattern ) {
+  Container c;
+  fill( c, n );
+  size_t num_ops = std::max( MIN_OPS, size_t( n ) );
+  std::vector< int > keys = make_keys( pattern, n, num_ops, 5 );
+  std::vector< unsigned char > ops( num_ops );
+  std::mt19937 rng( 6 );
+  for ( auto &op : ops )
+    op = (unsigned char) ( rng() % 4 );
+  Measurement m;
+  m.start();
+  for ( size_t i = 0; i < num_ops; ++i ) {
+    switch ( ops[ i ] ) {
+    case 0: g_check += c.insert( keys[ i ] ); break;
+    case 1: g_check += c.remove( keys[ i ] ); break;
+    default: g_check += c.find( keys[ i ] ); break;
+    }
+  }
+  m.stop();
+  print_result( Container::name(), "mixed", pattern, n, num_ops, m );
+}
+
+// The list workloads
+template< typename Container >
+void bench_list_insert( int n ) {
+  size_t reps = num_reps( n );
+  Measurement m;
+  for ( size_t r = 0; r < reps; ++r ) {
+    Container c;
+    m.start();
+    for ( int i = 0; i < n; ++i )
+      g_check += c.insert( i );
+    m.stop();
+  }
+  print_result( Container::name(), "insert", KEYS_SEQUENTIAL, n, reps * size_t( n ), m );
+}
+
+template< typename Container >
+void bench_list_remove( int n ) {
+  size_t reps = num_reps( n );
+  Measurement m;
+  for ( size_t r = 0; r < reps; ++r ) {
+    Container c;
+    for ( int i = 0; i < n; ++i )
+      c.insert( i );
+    m.start();
+    for ( int i = 0; i < n; ++i )
+      g_check += c.remove( i );
+    m.stop();
+  }
+  print_result( Container::name(), "remove", KEYS_SEQUENTIAL, n, reps * size_t( n ), m );
+}
+
+template< typename Container >
+void bench_list_iterate( int n ) {
+  Container c;
+  for ( int i = 0; i < n; ++i )
+    c.insert( i );
+  size_t reps = num_reps( n );
+  Measurement m;
+  m.start();
+  for ( size_t r = 0; r < reps; ++r )
+    g_check += c.iterate();
+  m.stop();
+  print_result( Container::name(), "iterate", KEYS_SEQUENTIAL, n, reps * size_t( n ), m );
+}
+
+// A queue of about n elements: each step appends one element and
+// removes the oldest
+template< typename Container >
+void bench_list_mixed( int n ) {
+  Container c;
+  for ( int i = 0; i < n; ++i )
+    c.insert( i );
+  size_t num_steps = std::max( MIN_OPS, size_t( n ) ) / 2;
+  Measurement m;
+  m.start();
+  for ( size_t i = 0; i < num_steps; ++i ) {
+    g_check += c.insert( int( i ) );
+    g_check += c.remove( 0 );
+  }
+  m.stop();
+  print_result( Container::name(), "mixed", KEYS_SEQUENTIAL, n, 2 * num_steps, m );
+}
+
+template< typename Container >
+void bench_tree( int n ) {
+  for ( int p = KEYS_SEQUENTIAL; p <= KEYS_ADVERSARIAL; ++p ) {
+    KeyPattern pattern = KeyPattern( p );
+    bench_insert< Container >( n, pattern );
+    bench_find< Container >( n, pattern );
+    bench_remove< Container >( n, pattern );
+    bench_mixed< Container >( n, pattern );
+  }
+  // Iteration doesn't depend on the keys
+  bench_iterate< Container >( n, KEYS_SEQUENTIAL );
+}
+
+template< typename Container >
+void bench_list( int n ) {
+  bench_list_insert< Container >( n );
+  bench_list_remove< Container >( n );
+  bench_list_iterate< Container >( n );
+  bench_list_mixed< Container >( n );
+}
+
+////////////////////////////////////////////////////////////////////////
+// Benchmark program
+////////////////////////////////////////////////////////////////////////
+
+int main( int argc, char **argv ) {
+  long max_size = ( argc > 1 ) ? atol( argv[1] ) : 1000000;
+  long min_size = ( argc > 2 ) ? atol( argv[2] ) : 1000;
+  if ( min_size < 1 || max_size < min_size || max_size > 1000000000 ) {
+    fprintf( stderr, "Usage: %s [max_size [min_size]]\n", argv[0] );
+    return 1;
+  }
+
+  printf( "{\"benchmark\":\"compare\",\"results\":[" );
+  for ( long n = min_size; n <= max_size; n *= 10 ) {
+    bench_tree< AATreeContainer >( int( n ) );
+    bench_tree< SetContainer >( int( n ) );
+    bench_tree< MapContainer >( int( n ) );
+    bench_list< ListContainer >( int( n ) );
+    bench_list< StdListContainer >( int( n ) );
+  }
+  printf( "\n  ],\n  \"check\":%ld}\n", g_check );
+
+  return 0;
+}
@@ -0,0 +1,223 @@
+// Copyright 2025, David H. Hovemeyer <david.hovemeyer@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// “Software”), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+// THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+// Hardware performance counters for the benchmarks, using Linux's
+// perf_event_open(). Counters which can't be opened (because the
+// kernel doesn't allow it, or there is no PMU, as in many virtual
+// machines and containers, or on other systems) are just reported
+// as unavailable, and the benchmarks are timed as usual. Only user
+// mode events are counted, which perf_event_paranoid levels up to 2
+// allow. Set DSLIB_BENCH_PERF=0 in the environment to turn the
+// counters off.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+class PerfCounters {
+public:
+  enum {
+    CYCLES,
+    INSTRUCTIONS,
+    L1D_MISSES,
+    LLC_MISSES,
+    DTLB_MISSES,
+    BRANCH_MISSES,
+    NUM_COUNTERS,
+  };
+
+private:
+  int m_fds[ NUM_COUNTERS ];
+  double m_values[ NUM_COUNTERS ];
+
+  PerfCounters( const PerfCounters & ) = delete;
+  PerfCounters &operator=( const PerfCounters & ) = delete;
+
+public:
+  // Names of the counters (as used in the JSON output)
+  static const char *name( int i ) {
+    static const char *const NAMES[] = {
+      "cycles", "instructions", "l1d_misses", "llc_misses", "dtlb_misses", "branch_misses",
+    };
+    return NAMES[ i ];
+  }
+
+  PerfCounters() {
+    const char *env = getenv( "DSLIB_BENCH_PERF" );
+    bool enabled = ( env == nullptr || strcmp( env, "0" ) != 0 );
+    for ( int i = 0; i < NUM_COUNTERS; ++i ) {
+      m_fds[ i ] = enabled ? open_counter( i ) : -1;
+      m_values[ i ] = 0.0;
+    }
+  }
+
+  ~PerfCounters() {
+#ifdef __linux__
+    for ( int i = 0; i < NUM_COUNTERS; ++i )
+      if ( m_fds[ i ] >= 0 )
+        close( m_fds[ i ] );
+#endif
+  }
+
+  // @return true if any counter is available
+  bool is_available() const {
+    for ( int i = 0; i < NUM_COUNTERS; ++i )
+      if ( m_fds[ i ] >= 0 )
+        return true;
+    return false;
+  }
+
+  // @return true if the given counter is available
+  bool is_available( int i ) const { return m_fds[ i ] >= 0; }
+
+  // Reset the counts to 0.
+  void reset() {
+    for ( int i = 0; i < NUM_COUNTERS; ++i ) {
+#ifdef __linux__
+      if ( m_fds[ i ] >= 0 )
+        ioctl( m_fds[ i ], PERF_EVENT_IOC_RESET, 0 );
+#endif
+      m_values[ i ] = 0.0;
+    }
+  }
+
+  // Start (or resume) counting.
+  void start() {
+#ifdef __linux__
+    for ( int i = 0; i < NUM_COUNTERS; ++i )
+      if ( m_fds[ i ] >= 0 )
+        ioctl( m_fds[ i ], PERF_EVENT_IOC_ENABLE, 0 );
+#endif
+  }
+
+  // Stop counting, and read the counts so far.
+  void stop() {
+#ifdef __linux__
+    for ( int i = 0; i < NUM_COUNTERS; ++i )
+      if ( m_fds[ i ] >= 0 )
+        ioctl( m_fds[ i ], PERF_EVENT_IOC_DISABLE, 0 );
+    for ( int i = 0; i < NUM_COUNTERS; ++i ) {
+      if ( m_fds[ i ] < 0 )
+        continue;
+      // If there are more events than hardware counters, the kernel
+      // time-multiplexes them, so the count is scaled up to the whole
+      // time the event was enabled
+      uint64_t data[ 3 ];
+      if ( read( m_fds[ i ], data, sizeof( data ) ) != ssize_t( sizeof( data ) ) )
+        continue;
+      m_values[ i ] = ( data[ 2 ] == 0 ) ? 0.0 : double( data[ 0 ] ) * double( data[ 1 ] ) / double( data[ 2 ] );
+    }
+#endif
+  }
+
+  // @return the count for the given counter (as of the last stop())
+  double get( int i ) const { return m_values[ i ]; }
+
+  // Format the counts per operation as JSON fields (",name":value
+  // for each counter, with null for unavailable counters).
+  // @param buf the buffer
+  // @param size the size of the buffer
+  // @param num_ops the number of operations counted
+  void format_json( char *buf, size_t size, size_t num_ops ) const {
+    size_t len = 0;
+    buf[ 0 ] = '\0';
+    for ( int i = 0; i < NUM_COUNTERS && len < size; ++i ) {
+      if ( is_available( i ) )
+        len += snprintf( buf + len, size - len, ",\"%s_per_op\":%.3f", name( i ), get( i ) / double( num_ops ) );
+      else
+        len += snprintf( buf + len, size - len, ",\"%s_per_op\":null", name( i ) );
+    }
+  }
+
+  // Format the counts per operation for humans ("name=value" for
+  // each available counter, separated by spaces.)
+  // @param buf the buffer
+  // @param size the size of the buffer
+  // @param num_ops the number of operations counted
+  void format_text( char *buf, size_t size, size_t num_ops ) const {
+    size_t len = 0;
+    buf[ 0 ] = '\0';
+    for ( int i = 0; i < NUM_COUNTERS && len < size; ++i )
+      if ( is_available( i ) )
+        len += snprintf( buf + len, size - len, "%s%s=%.3f", ( len > 0 ) ? " " : "",
+                         name( i ), get( i ) / double( num_ops ) );
+    if ( len == 0 )
+      snprintf( buf, size, "unavailable" );
+  }
+
+private:
+  static int open_counter( int i ) {
+#ifdef __linux__
+    struct perf_event_attr attr;
+    memset( &attr, 0, sizeof( attr ) );
+    attr.size = sizeof( attr );
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    const uint64_t READ_MISS = ( PERF_COUNT_HW_CACHE_OP_READ << 8 ) | ( PERF_COUNT_HW_CACHE_RESULT_MISS << 16 );
+    switch ( i ) {
+    case CYCLES:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_CPU_CYCLES;
+      break;
+    case INSTRUCTIONS:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+      break;
+    case L1D_MISSES:
+      attr.type = PERF_TYPE_HW_CACHE;
+      attr.config = PERF_COUNT_HW_CACHE_L1D | READ_MISS;
+      break;
+    case LLC_MISSES:
+      attr.type = PERF_TYPE_HW_CACHE;
+      attr.config = PERF_COUNT_HW_CACHE_LL | READ_MISS;
+      break;
+    case DTLB_MISSES:
+      attr.type = PERF_TYPE_HW_CACHE;
+      attr.config = PERF_COUNT_HW_CACHE_DTLB | READ_MISS;
+      break;
+    case BRANCH_MISSES:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+      break;
+    }
+
+    return int( syscall( SYS_perf_event_open, &attr, 0, -1, -1, 0 ) );
+#else
+    (void) i;
+    return -1;
+#endif
+  }
+};
+
+#endif // PERF_COUNTERS_H
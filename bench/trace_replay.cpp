@@ -0,0 +1,487 @@
+// Copyright 2025, David H. Hovemeyer <david.hovemeyer@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// “Software”), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+// THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+// Replays an operation trace (recorded with a TracedAATree or
+// TracedList: see ds_trace.h) against each of the containers that
+// can run it, so that they can be compared on a real workload.
+//
+// Usage: trace_replay <trace file> [repeats]
+//        trace_replay --example <trace file> [num_ops]
+//
+// The trace is read into memory before it is replayed, and each key
+// is replaced by its rank among the distinct keys in the trace (with
+// the encoded keys compared bytewise), so every container sees the
+// same order of keys, and comparisons are cheap. The operations are
+// replayed as fast as possible (the recorded times aren't used), each
+// replay starting with empty containers, and the fastest of repeats
+// (default 3) replays is reported. The results are written to
+// standard output as JSON, in the same form as compare_bench's:
+//
+//   {"benchmark":"trace_replay","trace":"app.trace","ops":1000000,
+//    "keys":52113,"results":[
+//     {"container":"aatree","secs":0.4301,"mops_per_sec":2.325,
+//      "cycles_per_op":...},
+//     ...]}
+//
+// Tree traces are replayed against an AATree (plain, threaded, and
+// with parent links) and std::set, and list traces against a List
+// and std::list.
+//
+// With --example, an example trace of random insertions, finds, and
+// removals on a tree is recorded instead (with keys encoded
+// big-endian, so that their bytewise order is their numeric order.)
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <set>
+#include <list>
+#include <unordered_map>
+#include <algorithm>
+#include <random>
+#include <chrono>
+#include "ds_aatree.h"
+#include "ds_list.h"
+#include "ds_trace.h"
+#include "perf_counters.h"
+
+////////////////////////////////////////////////////////////////////////
+// Node types
+////////////////////////////////////////////////////////////////////////
+
+// Tree node with a key rank: Base is AATreeNode or AATreeParentNode
+template< typename Base >
+class KeyAATreeNode : public Base {
+private:
+  uint32_t m_key;
+
+  NO_VALUE_SEMANTICS( KeyAATreeNode );
+
+public:
+  KeyAATreeNode( uint32_t key = 0 ) : m_key( key ) { }
+
+  uint32_t get_key() const { return m_key; }
+
+  static void free_node_fn( dslib::AATreeNode *node ) {
+    delete static_cast< KeyAATreeNode* >( node );
+  }
+
+  static void copy_node_fn( dslib::AATreeNode *from, dslib::AATreeNode *to ) {
+    static_cast< KeyAATreeNode* >( to )->m_key = static_cast< KeyAATreeNode* >( from )->m_key;
+  }
+
+  static bool less_than_fn( const dslib::AATreeNode *left, const dslib::AATreeNode *right ) {
+    return static_cast< const KeyAATreeNode* >( left )->m_key
+         < static_cast< const KeyAATreeNode* >( right )->m_key;
+  }
+};
+
+class KeyListNode : public dslib::ListNode {
+private:
+  uint32_t m_key;
+
+  NO_VALUE_SEMANTICS( KeyListNode );
+
+public:
+  KeyListNode( uint32_t key ) : m_key( key ) { }
+
+  uint32_t get_key() const { return m_key; }
+
+  static void free_node_fn( dslib::ListNode *node ) {
+    delete static_cast< KeyListNode* >( node );
+  }
+};
+
+////////////////////////////////////////////////////////////////////////
+// Traces
+////////////////////////////////////////////////////////////////////////
+
+struct Op {
+  dslib::TraceOp op;
+  uint32_t key;
+};
+
+struct Trace {
+  dslib::TraceKind kind;
+  std::vector< Op > ops;
+  uint32_t num_keys;
+};
+
+// Read a trace, replacing keys by their ranks: returns false
+// (after printing a message) if it can't be read
+bool load_trace( const char *filename, Trace &trace ) {
+  FILE *in = fopen( filename, "rb" );
+  if ( in == nullptr ) {
+    perror( filename );
+    return false;
+  }
+
+  dslib::AATreeFileReader reader( in );
+  dslib::TraceReader tr( reader );
+  std::unordered_map< std::string, uint32_t > key_ids;
+  std::vector< const std::string* > keys;
+  dslib::TraceRecord rec;
+  while ( tr.next( rec ) ) {
+    auto ins = key_ids.emplace( std::string( reinterpret_cast< const char* >( rec.key ), rec.key_size ),
+                                uint32_t( keys.size() ) );
+    if ( ins.second )
+      keys.push_back( &ins.first->first );
+    trace.ops.push_back( { rec.op, ins.first->second } );
+  }
+  fclose( in );
+  if ( !tr.is_done() || !tr.is_valid() ) {
+    fprintf( stderr, "%s: invalid or truncated trace\n", filename );
+    return false;
+  }
+  trace.kind = tr.get_kind();
+
+  // Rank the keys in bytewise order (which is std::string's order)
+  std::vector< uint32_t > order( keys.size() );
+  for ( uint32_t i = 0; i < order.size(); ++i )
+    order[ i ] = i;
+  std::sort( order.begin(), order.end(),
+             [&keys]( uint32_t a, uint32_t b ) { return *keys[ a ] < *keys[ b ]; } );
+  std::vector< uint32_t > rank( keys.size() );
+  for ( uint32_t i = 0; i < order.size(); ++i )
+    rank[ order[ i ] ] = i;
+  for ( auto &op : trace.ops )
+    op.key = rank[ op.key ];
+  trace.num_keys = uint32_t( keys.size() );
+  return true;
+}
+
+size_t encode_example_key( const dslib::AATreeNode *node, void *buf, size_t size ) {
+  uint32_t key = static_cast< const KeyAATreeNode< dslib::AATreeNode >* >( node )->get_key();
+  if ( size >= 4 ) {
+    unsigned char *p = static_cast< unsigned char* >( buf );
+    for ( int i = 0; i < 4; ++i )
+      p[ i ] = (unsigned char) ( key >> ( 8*( 3 - i ) ) );
+  }
+  return 4;
+}
+
+// Record an example trace: a tree that grows to about 100K keys,
+// with 50% finds, 30% insertions, and 20% removals
+bool record_example( const char *filename, long num_ops ) {
+  FILE *out = fopen( filename, "wb" );
+  if ( out == nullptr ) {
+    perror( filename );
+    return false;
+  }
+
+  typedef KeyAATreeNode< dslib::AATreeNode > Node;
+  dslib::AATree< Node > tree( &Node::less_than_fn, &Node::copy_node_fn, &Node::free_node_fn );
+  dslib::AATreeFileWriter writer( out );
+  dslib::TraceRecorder recorder( writer, dslib::TRACE_AATREE );
+  dslib::TracedAATree< Node > traced( tree, recorder, &encode_example_key );
+
+  std::mt19937 gen( 1 );
+  std::uniform_int_distribution< uint32_t > key_dist( 0, 199999 );
+  std::uniform_int_distribution< int > op_dist( 0, 9 );
+  for ( long i = 0; i < num_ops; ++i ) {
+    int op = op_dist( gen );
+    uint32_t key = key_dist( gen );
+    if ( op < 5 ) {
+      traced.find( Node( key ) );
+    } else if ( op < 8 ) {
+      Node *node = new Node( key );
+      if ( !traced.insert( node ) )
+        delete node;
+    } else {
+      traced.remove( Node( key ) );
+    }
+  }
+
+  bool ok = recorder.finish();
+  ok = ( fclose( out ) == 0 ) && ok;
+  if ( !ok )
+    fprintf( stderr, "%s: write error\n", filename );
+  return ok;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Containers, with a common interface
+////////////////////////////////////////////////////////////////////////
+
+template< typename Base, unsigned FLAGS >
+class AATreeContainer {
+private:
+  typedef KeyAATreeNode< Base > Node;
+  dslib::AATree< Node > m_tree;
+
+public:
+  AATreeContainer( uint32_t )
+    : m_tree( &Node::less_than_fn, &Node::copy_node_fn, &Node::free_node_fn, FLAGS ) { }
+
+  bool insert( uint32_t key ) {
+    Node *node = new Node( key );
+    if ( m_tree.insert( node ) )
+      return true;
+    delete node;
+    return false;
+  }
+
+  bool find( uint32_t key ) const { return m_tree.find( Node( key ) ) != nullptr; }
+  bool remove( uint32_t key ) { return m_tree.remove( Node( key ) ); }
+};
+
+typedef AATreeContainer< dslib::AATreeNode, 0 > PlainAATreeContainer;
+typedef AATreeContainer< dslib::AATreeNode, dslib::AA_TREE_THREADED > ThreadedAATreeContainer;
+typedef AATreeContainer< dslib::AATreeParentNode, 0 > ParentAATreeContainer;
+
+class SetContainer {
+private:
+  std::set< uint32_t > m_set;
+
+public:
+  SetContainer( uint32_t ) { }
+
+  bool insert( uint32_t key ) { return m_set.insert( key ).second; }
+  bool find( uint32_t key ) const { return m_set.find( key ) != m_set.end(); }
+  bool remove( uint32_t key ) { return m_set.erase( key ) != 0; }
+};
+
+// A list's nodes are also indexed by key, so that List::remove() can
+// be replayed (with the most recently inserted node with the key)
+class ListContainer {
+private:
+  dslib::List< KeyListNode > m_list;
+  std::vector< std::vector< KeyListNode* > > m_by_key;
+
+  void unindex( KeyListNode *node ) {
+    auto &nodes = m_by_key[ node->get_key() ];
+    nodes.erase( std::find( nodes.begin(), nodes.end(), node ) );
+  }
+
+public:
+  ListContainer( uint32_t num_keys ) : m_list( &KeyListNode::free_node_fn ), m_by_key( num_keys ) { }
+
+  void append( uint32_t key ) {
+    KeyListNode *node = new KeyListNode( key );
+    m_list.append( node );
+    m_by_key[ key ].push_back( node );
+  }
+
+  void prepend( uint32_t key ) {
+    KeyListNode *node = new KeyListNode( key );
+    m_list.prepend( node );
+    m_by_key[ key ].push_back( node );
+  }
+
+  bool remove( uint32_t key ) {
+    if ( m_by_key[ key ].empty() )
+      return false;
+    KeyListNode *node = m_by_key[ key ].back();
+    m_by_key[ key ].pop_back();
+    m_list.remove( node );
+    delete node;
+    return true;
+  }
+
+  bool remove_first() {
+    if ( m_list.is_empty() )
+      return false;
+    KeyListNode *node = m_list.remove_first();
+    unindex( node );
+    delete node;
+    return true;
+  }
+
+  bool remove_last() {
+    if ( m_list.is_empty() )
+      return false;
+    KeyListNode *node = m_list.remove_last();
+    unindex( node );
+    delete node;
+    return true;
+  }
+};
+
+class StdListContainer {
+private:
+  typedef std::list< uint32_t >::iterator Iter;
+  std::list< uint32_t > m_list;
+  std::vector< std::vector< Iter > > m_by_key;
+
+  void unindex( Iter it ) {
+    auto &its = m_by_key[ *it ];
+    its.erase( std::find( its.begin(), its.end(), it ) );
+  }
+
+public:
+  StdListContainer( uint32_t num_keys ) : m_by_key( num_keys ) { }
+
+  void append( uint32_t key ) { m_by_key[ key ].push_back( m_list.insert( m_list.end(), key ) ); }
+  void prepend( uint32_t key ) { m_by_key[ key ].push_back( m_list.insert( m_list.begin(), key ) ); }
+
+  bool remove( uint32_t key ) {
+    if ( m_by_key[ key ].empty() )
+      return false;
+    m_list.erase( m_by_key[ key ].back() );
+    m_by_key[ key ].pop_back();
+    return true;
+  }
+
+  bool remove_first() {
+    if ( m_list.empty() )
+      return false;
+    unindex( m_list.begin() );
+    m_list.pop_front();
+    return true;
+  }
+
+  bool remove_last() {
+    if ( m_list.empty() )
+      return false;
+    unindex( std::prev( m_list.end() ) );
+    m_list.pop_back();
+    return true;
+  }
+};
+
+////////////////////////////////////////////////////////////////////////
+// Replaying
+////////////////////////////////////////////////////////////////////////
+
+typedef std::chrono::steady_clock Clock;
+
+PerfCounters g_counters;
+
+// Sum of operation results, so that the operations can't be
+// optimized away
+long g_check;
+
+bool g_first_result = true;
+
+template< typename Container >
+void apply_tree_op( Container &c, const Op &op ) {
+  switch ( op.op ) {
+  case dslib::TRACE_INSERT: g_check += c.insert( op.key ); break;
+  case dslib::TRACE_FIND:   g_check += c.find( op.key ); break;
+  case dslib::TRACE_REMOVE: g_check += c.remove( op.key ); break;
+  default: break;
+  }
+}
+
+template< typename Container >
+void apply_list_op( Container &c, const Op &op ) {
+  switch ( op.op ) {
+  case dslib::TRACE_APPEND:       c.append( op.key ); break;
+  case dslib::TRACE_PREPEND:      c.prepend( op.key ); break;
+  case dslib::TRACE_REMOVE:       g_check += c.remove( op.key ); break;
+  case dslib::TRACE_REMOVE_FIRST: g_check += c.remove_first(); break;
+  case dslib::TRACE_REMOVE_LAST:  g_check += c.remove_last(); break;
+  default: break;
+  }
+}
+
+// Replay the trace repeats times, and print the fastest replay
+// (and its counters)
+template< typename Container, void Apply( Container &, const Op & ) >
+void replay( const char *name, const Trace &trace, int repeats ) {
+  double best_secs = 0.0;
+  char best_counters[ 512 ] = "";
+  for ( int r = 0; r < repeats; ++r ) {
+    Container *c = new Container( trace.num_keys );
+    g_counters.reset();
+    g_counters.start();
+    auto start = Clock::now();
+    for ( const Op &op : trace.ops )
+      Apply( *c, op );
+    double secs = std::chrono::duration< double >( Clock::now() - start ).count();
+    g_counters.stop();
+    // (the container is destroyed outside of the timed region)
+    delete c;
+    if ( r == 0 || secs < best_secs ) {
+      best_secs = secs;
+      g_counters.format_json( best_counters, sizeof( best_counters ), trace.ops.size() );
+    }
+  }
+
+  printf( "%s\n    {\"container\":\"%s\",\"secs\":%.6f,\"mops_per_sec\":%.3f%s}",
+          g_first_result ? "" : ",", name, best_secs,
+          double( trace.ops.size() ) / best_secs / 1e6, best_counters );
+  fflush( stdout );
+  g_first_result = false;
+}
+
+// Print a string as a (quoted) JSON string, escaping quotes,
+// backslashes, and control characters
+void print_json_string( const char *s ) {
+  putchar( '"' );
+  for ( ; *s != '\0'; ++s ) {
+    unsigned char c = static_cast< unsigned char >( *s );
+    switch ( c ) {
+    case '"': fputs( "\\\"", stdout ); break;
+    case '\\': fputs( "\\\\", stdout ); break;
+    case '\n': fputs( "\\n", stdout ); break;
+    case '\r': fputs( "\\r", stdout ); break;
+    case '\t': fputs( "\\t", stdout ); break;
+    default:
+      if ( c < 0x20 )
+        printf( "\\u%04x", c );
+      else
+        putchar( c );
+    }
+  }
+  putchar( '"' );
+}
+
+int main( int argc, char **argv ) {
+  if ( argc >= 3 && strcmp( argv[1], "--example" ) == 0 ) {
+    long num_ops = ( argc > 3 ) ? atol( argv[3] ) : 1000000;
+    if ( num_ops < 1 ) {
+      fprintf( stderr, "Usage: %s --example <trace file> [num_ops]\n", argv[0] );
+      return 1;
+    }
+    return record_example( argv[2], num_ops ) ? 0 : 1;
+  }
+
+  int repeats = ( argc > 2 ) ? atoi( argv[2] ) : 3;
+  if ( argc < 2 || argc > 3 || repeats < 1 ) {
+    fprintf( stderr, "Usage: %s <trace file> [repeats]\n", argv[0] );
+    fprintf( stderr, "       %s --example <trace file> [num_ops]\n", argv[0] );
+    return 1;
+  }
+
+  Trace trace;
+  if ( !load_trace( argv[1], trace ) )
+    return 1;
+
+  printf( "{\"benchmark\":\"trace_replay\",\"trace\":" );
+  print_json_string( argv[1] );
+  printf( ",\"ops\":%zu,\"keys\":%u,\"results\":[", trace.ops.size(), trace.num_keys );
+  if ( trace.kind == dslib::TRACE_AATREE ) {
+    replay< PlainAATreeContainer, apply_tree_op< PlainAATreeContainer > >( "aatree", trace, repeats );
+    replay< ThreadedAATreeContainer, apply_tree_op< ThreadedAATreeContainer > >( "aatree_threaded", trace, repeats );
+    replay< ParentAATreeContainer, apply_tree_op< ParentAATreeContainer > >( "aatree_parent", trace, repeats );
+    replay< SetContainer, apply_tree_op< SetContainer > >( "std::set", trace, repeats );
+  } else {
+    replay< ListContainer, apply_list_op< ListContainer > >( "list", trace, repeats );
+    replay< StdListContainer, apply_list_op< StdListContainer > >( "std::list", trace, repeats );
+  }
+  printf( "\n  ],\n  \"check\":%ld}\n", g_check );
+
+  return 0;
+}
@@ -22,28 +22,113 @@
 #ifndef DS_AATREE_H
 #define DS_AATREE_H
 
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
 #include "ds_util.h"
+#include "ds_stats.h"
+#include "ds_latency.h"
 
 namespace dslib {
 
-// Some empirical testing of tree height:
+// Some empirical testing of tree height (and root level) with
+// random insertions:
 //
 //    100,000 nodes: tree height is 23
-//  1,000,000 nodes: tree height is 29
-// 10,000,000 nodes: tree height is 32
+//  1,000,000 nodes: tree height is 29 (root level 16)
+// 10,000,000 nodes: tree height is 32 (root level 19)
 //
-// If you need more capacity, modify AA_TREE_MAX_HEIGHT below.
+// Each level of an AA-tree contributes at most two nodes to any path
+// from the root, so a tree whose root is at level L has height at
+// most 2L, and at least 2^L - 1 nodes. An AATree refuses insertions
+// that would raise the level of the root above half its maximum
+// height (see AATree::set_max_height()), so the path stacks can
+// never overflow.
+//
+// The default of 64 allows at least 2^32 - 1 nodes. For smaller
+// stack frames (and smaller iterators), or for more capacity,
+// define DSLIB_AA_TREE_MAX_HEIGHT when compiling both the library
+// and the code using it.
+
+#ifndef DSLIB_AA_TREE_MAX_HEIGHT
+#define DSLIB_AA_TREE_MAX_HEIGHT 64
+#endif
 
-//! Assume that the height of an AA-tree will never be greater than this:
+//! The height of an AA-tree will never be greater than this:
 //! allows for using fixed-size arrays to keep track of nodes along
 //! a path from root to leaf.
-const constexpr int AA_TREE_MAX_HEIGHT = 36;
-
+const constexpr int AA_TREE_MAX_HEIGHT = DSLIB_AA_TREE_MAX_HEIGHT;
+
+//! Number of searches that AATreeImpl::find_many() advances in lockstep.
+const constexpr int AA_TREE_FIND_MANY_GROUP = 16;
+
+//! In a threaded AATree, a right link with this bit set is a "thread"
+//! to the node's in-order successor, rather than a link to a right
+//! child. (Nodes are at least pointer-aligned, so the bit is
+//! otherwise unused.)
+const constexpr uintptr_t AA_TREE_THREAD_TAG = 0x1;
+
+//! AATree option flag: keep threads to in-order successors
+//! (see AATree::threaded_iterator())
+const constexpr unsigned AA_TREE_THREADED = 0x1;
+
+//! AATree option flag: keep parent links (the nodes must derive
+//! from AATreeParentNode.) AATree sets this automatically when its
+//! node type derives from AATreeParentNode. It can't be combined
+//! with AA_TREE_THREADED.
+const constexpr unsigned AA_TREE_PARENT_LINKS = 0x2;
+
+//! AATree option flag: don't free the remaining nodes when the tree
+//! is destroyed (for nodes in an Arena which will be reset as a
+//! whole: see ds_arena.h.) The free node function is still used for
+//! nodes removed from the tree.
+const constexpr unsigned AA_TREE_NO_FREE_ON_DESTROY = 0x4;
+
+class AATreeNode;
 class AATreeImpl;
 class AATreeIterImpl;
+class AATreeThreadedIterImpl;
 class AATreePostfixIterImpl;
-#ifdef DSLIB_CHECK_INTEGRITY
-class TreePrintContext;
+class AATreeFingerImpl;
+class AATreeCheckerImpl;
+class AATreeExportImpl;
+
+//! Links and level of a node in an AATreeStatic, which are computed
+//! at compile time, and passed to the node's constructor.
+struct AATreeStaticLinks {
+  AATreeNode *left, *right;
+  int level;
+};
+
+#ifdef DSLIB_STATS
+//! Snapshot of an AATree's operation counters (see AATree::get_stats())
+struct AATreeStats {
+  //! Calls to the node comparison function
+  uint64_t comparisons;
+  //! Nodes visited by searches, insertions and removals
+  uint64_t nodes_visited;
+  //! Skews which rotated a node
+  uint64_t skews;
+  //! Splits which rotated a node
+  uint64_t splits;
+  //! Nodes whose level was lowered after a removal
+  uint64_t level_decrements;
+  //! Deepest path from the root kept by an insertion or removal
+  uint64_t max_path_depth;
+};
+#endif
+
+#ifdef DSLIB_LATENCY
+//! Snapshot of an AATree's latency histograms (see AATree::get_latency())
+struct AATreeLatency {
+  //! Latencies of find() (and contains())
+  LatencySnapshot find;
+  //! Latencies of insert()
+  LatencySnapshot insert;
+  //! Latencies of remove() and remove_node()
+  LatencySnapshot remove;
+};
 #endif
 
 //! Intrusive AA tree node base class.
@@ -57,18 +142,29 @@ private:
 
 public:
   AATreeNode() : m_left( nullptr ), m_right( nullptr ), m_level( 1 ) { }
-  ~AATreeNode() { }
+
+  //! Constructor for a node of an AATreeStatic.
+  constexpr explicit AATreeNode( const AATreeStaticLinks &links )
+    : m_left( links.left ), m_right( links.right ), m_level( links.level ) { }
+
+  // (trivial, so that nodes can be constexpr: see AATreeStatic)
+  ~AATreeNode() = default;
 
   // Allow certain implementation classes direct access to
   // children pointers and level information
   friend class AATreeImpl;
   friend class AATreeIterImpl;
+  friend class AATreeThreadedIterImpl;
   friend class AATreePostfixIterImpl;
-#ifdef DSLIB_CHECK_INTEGRITY
-  friend class TreePrintContext;
-#endif
+  friend class AATreeFingerImpl;
+  friend class AATreeParImpl;
+  friend class AATreeCheckerImpl;
+  friend class AATreeExportImpl;
 
 private:
+  // Constructor for the nil node
+  constexpr explicit AATreeNode( int level ) : m_left( nullptr ), m_right( nullptr ), m_level( level ) { }
+
   AATreeNode *get_left() const { return m_left; }
   AATreeNode *get_right() const { return m_right; }
   int get_level() const { return m_level; }
@@ -78,6 +174,42 @@ private:
   void set_level( int level ) { m_level = level; }
   AATreeNode **get_ptr_to_left() { return &m_left; }
   AATreeNode **get_ptr_to_right() { return &m_right; }
+
+  // Threads (in a threaded tree, a node with no right child has a
+  // thread to its in-order successor, which is nullptr for the
+  // last node)
+  static bool is_thread( const AATreeNode *link ) {
+    return ( reinterpret_cast< uintptr_t >( link ) & AA_TREE_THREAD_TAG ) != 0;
+  }
+  bool has_thread() const { return is_thread( m_right ); }
+  AATreeNode *get_thread() const {
+    return reinterpret_cast< AATreeNode* >( reinterpret_cast< uintptr_t >( m_right ) & ~AA_TREE_THREAD_TAG );
+  }
+  void set_thread( AATreeNode *succ ) {
+    m_right = reinterpret_cast< AATreeNode* >( reinterpret_cast< uintptr_t >( succ ) | AA_TREE_THREAD_TAG );
+  }
+};
+
+//! Intrusive AA tree node base class with a link to the parent node.
+//! Derive your node type from this class (rather than AATreeNode) to
+//! allow nodes to be removed, and the tree to be traversed, starting
+//! from a node pointer, with no comparisons and no path stack.
+class AATreeParentNode : public AATreeNode {
+private:
+  AATreeNode *m_parent;
+
+  NO_VALUE_SEMANTICS( AATreeParentNode );
+
+public:
+  AATreeParentNode() : m_parent( nullptr ) { }
+  ~AATreeParentNode() { }
+
+  friend class AATreeImpl;
+  friend class AATreeCheckerImpl;
+
+private:
+  AATreeNode *get_parent() const { return m_parent; }
+  void set_parent( AATreeNode *parent ) { m_parent = parent; }
 };
 
 //! Fixed-size stack of pointers.
@@ -98,6 +230,7 @@ public:
   ~AATreePtrStackImpl();
 
   bool is_empty() const;
+  int get_size() const { return m_num_items; }
   void push( void *p );
   void *top() const;
   void *pop();
@@ -123,6 +256,9 @@ public:
   //! @return true if the stack is empty, false if not
   bool is_empty() const { return m_impl.is_empty(); }
 
+  //! @return the number of pointers on the stack
+  int get_size() const { return m_impl.get_size(); }
+
   //! Push a pointer onto the stack.
   //! @param p the pointer to push on the stack
   void push( PtrType p ) { m_impl.push( static_cast< void* >( p ) ); }
@@ -141,8 +277,7 @@ public:
 class AATreeIterImpl {
 private:
   AATreePtrStack< AATreeNode* > m_stack;
-  const AATreeImpl *m_tree;
-  
+
   // Note that this class DOES have value semantics
 
 public:
@@ -154,6 +289,28 @@ public:
 
   friend class AATreeImpl;
 
+private:
+  void init( AATreeNode *root );
+};
+
+//! Threaded in-order iterator implementation.
+//! Don't use this directly: use AATreeThreadedIter instead,
+//! parametized with the actual node type.
+class AATreeThreadedIterImpl {
+private:
+  AATreeNode *m_next;
+
+  // Note that this class DOES have value semantics
+
+public:
+  AATreeThreadedIterImpl();
+  ~AATreeThreadedIterImpl();
+
+  bool has_next() const;
+  AATreeNode *next();
+
+  friend class AATreeImpl;
+
 private:
   void init( const AATreeImpl *tree );
 };
@@ -187,6 +344,28 @@ private:
   static AATreeNode *mark_right_visited( AATreeNode *node );
 };
 
+//! Finger search implementation.
+//! Don't use this directly: use AATreeFinger instead,
+//! parametized with the actual node type.
+class AATreeFingerImpl {
+private:
+  AATreePtrStack< AATreeNode* > m_stack;
+  const AATreeImpl *m_tree;
+
+  // Note that this class DOES have value semantics
+
+public:
+  AATreeFingerImpl();
+  ~AATreeFingerImpl();
+
+  AATreeNode *find( const AATreeNode &node );
+
+  friend class AATreeImpl;
+
+private:
+  void init( const AATreeImpl *tree );
+};
+
 //! AA tree implementation.
 //! Don't use this directly: instead, use AATree, parametized with
 //! the actual tree node type.
@@ -206,54 +385,260 @@ public:
   //! Node free function type
   typedef void FreeNodeFn( AATreeNode *node );
 
+  //! Variants of the comparison, copy, and free functions which are
+  //! also passed a context pointer (the one given to the tree's
+  //! constructor), for per-tree state such as a collation or the
+  //! pool the nodes are allocated from. A tree can have all three,
+  //! or just a free function which takes a context pointer.
+  typedef bool LessThanCtxFn( const AATreeNode *left, const AATreeNode *right, void *ctx );
+  typedef void CopyNodeCtxFn( AATreeNode *from, AATreeNode *to, void *ctx );
+  typedef void FreeNodeCtxFn( AATreeNode *node, void *ctx );
+
+  //! A tree's comparison function, with its context pointer if it
+  //! takes one. Calling it compares two nodes.
+  class LessThan {
+  private:
+    LessThanFn *m_fn;
+    LessThanCtxFn *m_ctx_fn;
+    void *m_ctx;
+
+  public:
+    LessThan( LessThanFn *fn = nullptr ) : m_fn( fn ), m_ctx_fn( nullptr ), m_ctx( nullptr ) { }
+    LessThan( LessThanCtxFn *fn, void *ctx ) : m_fn( nullptr ), m_ctx_fn( fn ), m_ctx( ctx ) { }
+
+    bool operator()( const AATreeNode *left, const AATreeNode *right ) const {
+      return ( m_ctx_fn != nullptr ) ? m_ctx_fn( left, right, m_ctx ) : m_fn( left, right );
+    }
+
+    bool operator==( const LessThan &other ) const {
+      return m_fn == other.m_fn && m_ctx_fn == other.m_ctx_fn && m_ctx == other.m_ctx;
+    }
+  };
+
+  //! Type of node relocation function, used by relayout().
+  //! It should move the contents of the node "from" into the
+  //! uninitialized storage at "to" (e.g., using placement new),
+  //! dispose of the original node, and return a pointer to the
+  //! AATreeNode part of the relocated node. The tree takes care of
+  //! the child links and level of the relocated node, so they don't
+  //! need to be copied.
+  typedef AATreeNode *RelocateNodeFn( AATreeNode *from, void *to );
+
+  //! Type of function to get the node at a given position in
+  //! the array of nodes passed to build().
+  typedef AATreeNode *NodeAtFn( const void *nodes, size_t i );
+
+  //! Set operations (see set_op())
+  enum SetOp {
+    SET_UNION,
+    SET_INTERSECTION,
+    SET_DIFFERENCE,
+  };
+
 private:
+  // A range of the array of nodes passed to build(), which will
+  // become the subtree at the given link
+  struct BuildRange {
+    size_t begin, end;
+    AATreeNode **link;
+    AATreeNode *parent;
+  };
+  typedef void DeferRangeFn( void *ctx, const BuildRange &range );
+
+  // One step of a set operation on subtrees t1 and t2 (see
+  // set_op_divide()): the result is the pivot node joined with the
+  // results for left1/left2 and right1/right2, or just the results
+  // joined together if pivot is nullptr
+  struct SetOpSplit {
+    AATreeNode *left1, *left2;
+    AATreeNode *right1, *right2;
+    AATreeNode *pivot;
+  };
+
   AATreeNode *m_root;
-  AATreeNode m_nil;
-  LessThanFn *m_less_than_fn;
+
+  // The special level-0 "nil" node, pointed to by all "missing"
+  // level-1 links. It is never modified, so it is shared by every
+  // tree, which allows subtrees to be moved from one tree to another.
+  static AATreeNode s_nil;
+
+  LessThan m_less_than;
   CopyNodeFn *m_copy_node_fn;
   FreeNodeFn *m_free_node_fn;
+  CopyNodeCtxFn *m_copy_node_ctx_fn;
+  FreeNodeCtxFn *m_free_node_ctx_fn;
+  void *m_context;
+  bool m_threaded;
+  bool m_parent_links;
+  bool m_free_on_destroy;
+  int m_max_height;
+
+#ifdef DSLIB_STATS
+  // Operation counters (see get_stats())
+  struct Counters {
+    StatCounter comparisons, nodes_visited;
+    StatCounter skews, splits, level_decrements;
+    StatCounter max_path_depth;
+  };
+  mutable Counters m_stats;
+#endif
+
+#ifdef DSLIB_LATENCY
+  // Latency histograms (see get_latency()), allocated only when
+  // enabled by enable_latency()
+  struct Latencies {
+    LatencyHistogram find, insert, remove;
+  };
+  Latencies *m_latency;
+#endif
 
   NO_VALUE_SEMANTICS( AATreeImpl );
 
 public:
-  AATreeImpl( LessThanFn *less_than_fn, CopyNodeFn *copy_node_fn, FreeNodeFn *free_node_fn );
+  AATreeImpl( LessThanFn *less_than_fn, CopyNodeFn *copy_node_fn, FreeNodeFn *free_node_fn, unsigned flags = 0 );
+  AATreeImpl( LessThanCtxFn *less_than_fn, CopyNodeCtxFn *copy_node_fn, FreeNodeCtxFn *free_node_fn,
+              void *context, unsigned flags = 0 );
+  AATreeImpl( LessThanFn *less_than_fn, CopyNodeFn *copy_node_fn, FreeNodeCtxFn *free_node_fn,
+              void *context, unsigned flags = 0 );
   ~AATreeImpl();
 
-  bool is_empty() const { return m_root == &m_nil; }
+  bool is_empty() const { return m_root == &s_nil; }
+  bool is_threaded() const { return m_threaded; }
+  bool has_parent_links() const { return m_parent_links; }
+  int get_max_height() const { return m_max_height; }
+  void set_max_height( int max_height );
+  static int max_height_for_size( size_t num_nodes );
 
   bool insert( AATreeNode *node );
   AATreeNode *find( const AATreeNode &node ) const;
+  static AATreeNode *find_in_subtree( AATreeNode *root, const AATreeNode &node, const LessThan &less_than );
+  void find_many( const AATreeNode *const *keys, size_t n, AATreeNode **results ) const;
   bool contains( const AATreeNode &node ) const;
   bool remove( const AATreeNode &node );
+  void remove_node( AATreeNode *node );
+  AATreeNode *successor( AATreeNode *node ) const;
+  AATreeNode *predecessor( AATreeNode *node ) const;
+  size_t get_size() const;
+  size_t relayout( void *buf, size_t node_size, size_t capacity, RelocateNodeFn *relocate_fn );
+  bool build( const void *nodes, size_t n, NodeAtFn *node_at_fn );
+  bool set_op( SetOp op, AATreeImpl &other );
+
+  // The nil node is shared by every tree (including AATreeStatic trees)
+  static constexpr const AATreeNode *nil() { return &s_nil; }
+  const LessThan &get_less_than() const { return m_less_than; }
+  void *get_context() const { return m_context; }
+
+  // Call the copy and free functions (with the context pointer,
+  // if they take one)
+  void copy_node( AATreeNode *from, AATreeNode *to ) const {
+    if ( m_copy_node_ctx_fn != nullptr )
+      m_copy_node_ctx_fn( from, to, m_context );
+    else
+      m_copy_node_fn( from, to );
+  }
+  void free_node( AATreeNode *node ) const {
+    if ( m_free_node_ctx_fn != nullptr )
+      m_free_node_ctx_fn( node, m_context );
+    else
+      m_free_node_fn( node );
+  }
+
+  // Get pointer to root node
+  AATreeNode *get_root() const { return m_root; }
 
-  const AATreeNode *nil() const { return &m_nil; }
+  // Get the right child of a node, or the nil node if it
+  // has no right child (i.e., if it has a thread instead)
+  static AATreeNode *right_of( const AATreeNode *t ) {
+    return t->has_thread() ? const_cast< AATreeNode* >( &s_nil ) : t->get_right();
+  }
 
   AATreeIterImpl iterator() const;
+  static AATreeIterImpl subtree_iterator( AATreeNode *root );
+  AATreeThreadedIterImpl threaded_iterator() const;
   AATreePostfixIterImpl postfix_iterator() const;
+  AATreeFingerImpl finger() const;
 
-#ifdef DSLIB_CHECK_INTEGRITY
-  // Does AA-tree rooted at given node satisfy the AA-tree properties?
-  bool is_valid( AATreeNode *node, int expected_level ) const;
+#ifdef DSLIB_STATS
+  AATreeStats get_stats() const;
+  void reset_stats();
+#endif
 
-  // Does the overall AA-tree satisfy the AA-tree properties?
-  bool is_valid() const {
-    if ( m_root == nullptr )
-      return true;
-    return is_valid( m_root, m_root->get_level() );
-  }
+#ifdef DSLIB_LATENCY
+  bool enable_latency();
+  void disable_latency();
+  bool is_latency_enabled() const { return m_latency != nullptr; }
+  AATreeLatency get_latency() const;
+  void reset_latency();
+#endif
 
-  // Get pointer to root node
-  AATreeNode *get_root() const { return m_root; }
+#ifdef DSLIB_CHECK_INTEGRITY
+  // Does the AA-tree satisfy the AA-tree properties? (This checks
+  // the whole tree at once with an AATreeCheckerImpl: see
+  // ds_aatreecheck.h)
+  bool is_valid() const;
 
   // Get tree height (because of the possibility of right nodes at the
   // same level as the parent, level is not the same as height)
-  int get_height( AATreeNode *node ) const;
+  int get_height() const;
 #endif
 
 private:
+  // Comparisons and nodes visited by a single operation
+  class OpCounts;
+  static AATreeNode *search( AATreeNode *root, const AATreeNode &node, const LessThan &less_than, OpCounts &counts );
+
+  static bool is_empty_link( const AATreeNode *link ) {
+    return link == &s_nil || AATreeNode::is_thread( link );
+  }
+  AATreeNode *unlink_replacement( AATreeNode *t, bool right_link );
+  void unlink_node( AATreeNode *t );
+
+  // Parent links (only used if m_parent_links is set)
+  static AATreeNode *get_parent( const AATreeNode *node ) {
+    return static_cast< const AATreeParentNode* >( node )->get_parent();
+  }
+  void set_parent( AATreeNode *node, AATreeNode *parent ) {
+    if ( node != &s_nil )
+      static_cast< AATreeParentNode* >( node )->set_parent( parent );
+  }
+  AATreeNode **get_link_to( AATreeNode *node );
+  void swap_with_successor( AATreeNode *t, AATreeNode *succ );
+
+  void rethread();
+
+  // Rebalancing (shared with AATreeRegionImpl: see ds_aatreebalance.h)
+  class BalanceOps;
   AATreeNode *skew( AATreeNode *t );
   AATreeNode *split( AATreeNode *t );
   void adjust_level( AATreeNode *t );
+  AATreeNode *rebalance( AATreeNode *t );
+  static AATreeNode *relocate( AATreeNode *node, void *to, RelocateNodeFn *relocate_fn );
+
+  // Building a tree from a sorted array of nodes (the parallel
+  // build defers the ranges at cut_depth to the worker threads)
+  bool can_build( const void *nodes, size_t n, NodeAtFn *node_at_fn ) const;
+  void build_range( const void *nodes, size_t n, NodeAtFn *node_at_fn, const BuildRange &range,
+                    int cut_depth, DeferRangeFn *defer_fn, void *ctx );
+
+  // Set operations, in the style of "Just Join for Parallel Ordered
+  // Sets" (Blelloch, Ferizovic and Sun): split one tree by the root
+  // of the other, operate on the two halves, and join the results
+  bool can_set_op( SetOp op, const AATreeImpl &other ) const;
+  static size_t count_nodes( AATreeNode *root, size_t limit );
+  bool set_op_divide( SetOp op, AATreeNode *t1, AATreeNode *t2, SetOpSplit &s, AATreeNode *&result );
+  AATreeNode *set_op_combine( const SetOpSplit &s, AATreeNode *left, AATreeNode *right );
+  AATreeNode *set_op_subtrees( SetOp op, AATreeNode *t1, AATreeNode *t2 );
+  void finish_set_op( AATreeImpl &other, AATreeNode *root );
+  void link_left( AATreeNode *t, AATreeNode *left );
+  void link_right( AATreeNode *t, AATreeNode *right );
+  AATreeNode *join( AATreeNode *left, AATreeNode *k, AATreeNode *right );
+  AATreeNode *join2( AATreeNode *left, AATreeNode *right );
+  AATreeNode *split_at( AATreeNode *t, const AATreeNode *key, AATreeNode *&left, AATreeNode *&right );
+  AATreeNode *remove_last( AATreeNode *t, AATreeNode *&last );
+  void free_subtree( AATreeNode *t );
+
+  friend class AATreeParImpl;
+  friend class AATreeFingerImpl;
 };
 
 //! In-order iterator over nodes in an AATree.
@@ -290,6 +675,47 @@ public:
   }
 };
 
+//! In-order iterator over nodes in a threaded AATree.
+//! Unlike AATreeIter, it consists of a single pointer, and each
+//! step follows at most one thread or a chain of left links,
+//! with no path stack. This makes it cheap to create and to store,
+//! which suits short scans. Note that for long scans of a tree that
+//! doesn't fit in cache, AATreeIter may be faster: it knows where
+//! the next node is (from its stack) before the current node has
+//! been loaded, so more cache misses can overlap.
+//! @tparam ActualNodeType the actual tree node type
+template< typename ActualNodeType >
+class AATreeThreadedIter {
+private:
+  AATreeThreadedIterImpl m_impl;
+
+public:
+  //! Constructor. This shouldn't be used directly:
+  //! instead, call AATree::threaded_iterator().
+  //! @param impl the underlying AATreeThreadedIterImpl positioned
+  //!             at the first node
+  AATreeThreadedIter( const AATreeThreadedIterImpl &impl )
+    : m_impl( impl ) {
+
+  }
+
+  //! Destructor.
+  ~AATreeThreadedIter() { }
+
+  //! @return true if the iterator can return at least one more node,
+  //!         false if there are no more nodes to return
+  bool has_next() const {
+    return m_impl.has_next();
+  }
+
+  //! Get the next node, and advance to the node that follows
+  //! in order. Don't call this unless has_next() has returned true.
+  //! @return the next node in the sequence
+  ActualNodeType *next() {
+    return static_cast< ActualNodeType* >( m_impl.next() );
+  }
+};
+
 //! Postfix iterator over the nodes in an AATree.
 //! @tparam ActualNodeType the actual tree node type
 template< typename ActualNodeType >
@@ -325,6 +751,44 @@ public:
   }
 };
 
+//! Finger for searching an AATree for a sequence of nodes in
+//! ascending order. The finger remembers the path to the node found
+//! by the previous search, and each search starts from the lowest
+//! node on that path whose subtree could contain the node being
+//! searched for, rather than from the root. So, over a whole sequence
+//! of searches, each tree node is visited at most a small constant
+//! number of times. The tree must not be modified while the finger
+//! is in use.
+//! @tparam ActualNodeType the actual tree node type
+template< typename ActualNodeType >
+class AATreeFinger {
+private:
+  AATreeFingerImpl m_impl;
+
+public:
+  //! Constructor. This shouldn't be used directly:
+  //! instead, call AATree::finger().
+  //! @param impl the underlying AATreeFingerImpl
+  AATreeFinger( const AATreeFingerImpl &impl )
+    : m_impl( impl ) {
+
+  }
+
+  //! Destructor.
+  ~AATreeFinger() { }
+
+  //! Search for a node in the tree comparing as equal to the given one.
+  //! The given node must not compare as less than the node passed to
+  //! the previous call to find().
+  //! @param node a node
+  //! @return pointer to a tree node equal to the given node,
+  //!         or nullptr if the tree does not contain a node equal to
+  //!         the given one
+  ActualNodeType *find( const ActualNodeType &node ) {
+    return static_cast< ActualNodeType* >( m_impl.find( node ) );
+  }
+};
+
 //! Balanced binary search tree class.
 //! @tparam ActualNodeType the actual tree node type, which needs
 //!         to derive from AATreeNode
@@ -342,23 +806,96 @@ public:
   //! @param copy_node_fn function to copy the contents of a node to a different
   //!                     node (necessary when removing an interior node)
   //! @param free_node_fn function to delete a tree node
-  AATree( AATreeImpl::LessThanFn *less_than_fn, AATreeImpl::CopyNodeFn *copy_node_fn, AATreeImpl::FreeNodeFn *free_node_fn )
-    : m_impl( less_than_fn, copy_node_fn, free_node_fn )
+  //! @param flags option flags: AA_TREE_THREADED to keep threads to
+  //!              in-order successors, allowing the use of
+  //!              threaded_iterator() (parent links are enabled
+  //!              automatically if ActualNodeType derives from
+  //!              AATreeParentNode), and AA_TREE_NO_FREE_ON_DESTROY
+  //!              to leave the remaining nodes alone when the tree
+  //!              is destroyed
+  AATree( AATreeImpl::LessThanFn *less_than_fn, AATreeImpl::CopyNodeFn *copy_node_fn, AATreeImpl::FreeNodeFn *free_node_fn,
+          unsigned flags = 0 )
+    : m_impl( less_than_fn, copy_node_fn, free_node_fn,
+              flags | ( std::is_base_of< AATreeParentNode, ActualNodeType >::value ? AA_TREE_PARENT_LINKS : 0 ) )
+  { }
+
+  //! Constructor for functions which take a context pointer.
+  //! @param less_than_fn function to compare two tree nodes to determine
+  //!                     whether the left node is less than the right node
+  //! @param copy_node_fn function to copy the contents of a node to a different
+  //!                     node (necessary when removing an interior node)
+  //! @param free_node_fn function to delete a tree node
+  //! @param context the context pointer passed to each of the functions
+  //!                (for example, the Pool the nodes are allocated
+  //!                from: see Pool::free_node_ctx_fn())
+  //! @param flags option flags (as for the other constructor)
+  AATree( AATreeImpl::LessThanCtxFn *less_than_fn, AATreeImpl::CopyNodeCtxFn *copy_node_fn,
+          AATreeImpl::FreeNodeCtxFn *free_node_fn, void *context, unsigned flags = 0 )
+    : m_impl( less_than_fn, copy_node_fn, free_node_fn, context,
+              flags | ( std::is_base_of< AATreeParentNode, ActualNodeType >::value ? AA_TREE_PARENT_LINKS : 0 ) )
+  { }
+
+  //! Constructor for a free node function which takes a context
+  //! pointer, with ordinary comparison and copy functions (for
+  //! example, for a tree whose nodes are allocated from a Pool,
+  //! with Pool::free_node_ctx_fn() as the free node function.)
+  //! @param less_than_fn function to compare two tree nodes to determine
+  //!                     whether the left node is less than the right node
+  //! @param copy_node_fn function to copy the contents of a node to a different
+  //!                     node (necessary when removing an interior node)
+  //! @param free_node_fn function to delete a tree node
+  //! @param context the context pointer passed to free_node_fn
+  //! @param flags option flags (as for the other constructors)
+  AATree( AATreeImpl::LessThanFn *less_than_fn, AATreeImpl::CopyNodeFn *copy_node_fn,
+          AATreeImpl::FreeNodeCtxFn *free_node_fn, void *context, unsigned flags = 0 )
+    : m_impl( less_than_fn, copy_node_fn, free_node_fn, context,
+              flags | ( std::is_base_of< AATreeParentNode, ActualNodeType >::value ? AA_TREE_PARENT_LINKS : 0 ) )
   { }
 
   //! Destructor.
   ~AATree() { }
 
+  //! @return the underlying AATreeImpl (this is meant for use by
+  //!         other dslib classes, such as AATreeSnapshot)
+  const AATreeImpl &get_impl() const { return m_impl; }
+  AATreeImpl &get_impl() { return m_impl; }
+
   //! Check whether the AATree is empty.
   //! @return true if the tree is empty, false if it has at least one node
   bool is_empty() const { return m_impl.is_empty(); }
 
+  //! @return true if the tree is threaded, false if not
+  bool is_threaded() const { return m_impl.is_threaded(); }
+
+  //! @return the tree's maximum height
+  int get_max_height() const { return m_impl.get_max_height(); }
+
+  //! Set the tree's maximum height, which is initially (and at most)
+  //! AA_TREE_MAX_HEIGHT. Once the level of the root reaches half the
+  //! maximum height, insert() refuses nodes that would raise it
+  //! further, so the tree can always be traversed with a path stack
+  //! of the maximum height. Use max_height_for_size() to find the
+  //! maximum height needed for a given number of nodes.
+  //! @param max_height the maximum height (at least 2)
+  void set_max_height( int max_height ) { m_impl.set_max_height( max_height ); }
+
+  //! Get the maximum height that guarantees that a tree can hold the
+  //! given number of nodes (a tree with random insertions can
+  //! usually hold many more.)
+  //! @param num_nodes the number of nodes
+  //! @return the maximum height to use for the tree
+  static int max_height_for_size( size_t num_nodes ) {
+    return AATreeImpl::max_height_for_size( num_nodes );
+  }
+
   //! Insert given node into the AATree.
   //! @param node the node to insert
   //! @return true if the node is inserted successfully, in which case
   //!         the AATree assumes ownership of it, or false if a node
-  //!         comparing as equal already exists in the AATree,
-  //!         in which case the node remains the caller's responsibility
+  //!         comparing as equal already exists in the AATree (or if
+  //!         inserting the node could make the tree's height exceed
+  //!         the maximum height), in which case the node remains
+  //!         the caller's responsibility
   bool insert( ActualNodeType *node ) {
     return m_impl.insert( node );
   }
@@ -372,6 +909,51 @@ public:
     return static_cast< ActualNodeType* >( m_impl.find( node ) );
   }
 
+  //! Search for the nodes comparing as equal to each of the given ones.
+  //! The searches are carried out in groups, with each search in a group
+  //! advancing one level at a time, and prefetching the next node it
+  //! will visit. So, on a large tree, the cache misses of the searches
+  //! in the group overlap, rather than happening one after another.
+  //! @param keys array of pointers to nodes to search for
+  //! @param n number of nodes to search for
+  //! @param results array where the results are stored: results[i] is
+  //!                the tree node equal to keys[i], or nullptr if
+  //!                the tree does not contain a node equal to keys[i]
+  void find_many( const ActualNodeType *const *keys, size_t n, ActualNodeType **results ) const {
+    const AATreeNode *impl_keys[ AA_TREE_FIND_MANY_GROUP ];
+    AATreeNode *impl_results[ AA_TREE_FIND_MANY_GROUP ];
+
+    for ( size_t i = 0; i < n; i += AA_TREE_FIND_MANY_GROUP ) {
+      size_t count = n - i;
+      if ( count > size_t( AA_TREE_FIND_MANY_GROUP ) )
+        count = AA_TREE_FIND_MANY_GROUP;
+      for ( size_t j = 0; j < count; ++j )
+        impl_keys[ j ] = keys[ i + j ];
+      m_impl.find_many( impl_keys, count, impl_results );
+      for ( size_t j = 0; j < count; ++j )
+        results[ i + j ] = static_cast< ActualNodeType* >( impl_results[ j ] );
+    }
+  }
+
+  //! Search for each of a sequence of nodes in ascending order,
+  //! using an AATreeFinger. This is much faster than separate calls
+  //! to find() when there are many nodes to search for, for example
+  //! in a merge join.
+  //! @tparam Fn type of function to call with the result of each search
+  //! @param keys array of pointers to nodes to search for, which must
+  //!             be sorted in ascending order
+  //! @param n number of nodes to search for
+  //! @param fn function to call for each search: it is called as
+  //!           fn( keys[i], found ), where found is the tree node
+  //!           equal to keys[i], or nullptr if the tree does not
+  //!           contain a node equal to keys[i]
+  template< typename Fn >
+  void find_sorted( const ActualNodeType *const *keys, size_t n, Fn fn ) const {
+    AATreeFinger< ActualNodeType > f = finger();
+    for ( size_t i = 0; i < n; ++i )
+      fn( keys[ i ], f.find( *keys[ i ] ) );
+  }
+
   //! Determine if the tree contains a node equal to the given one.
   //! @param node a node
   //! @return true if the tree contains a node equal to the given one,
@@ -388,18 +970,189 @@ public:
     return m_impl.remove( node );
   }
 
+  //! Remove the given node, which must be in the tree, and delete it
+  //! using the free node function. No comparisons are needed, since
+  //! the node's parent links lead back to the root. Unlike remove(),
+  //! this never copies node contents between nodes, so pointers to
+  //! the remaining nodes stay valid. (In fact, with parent links,
+  //! remove() also works this way.) ActualNodeType must derive from
+  //! AATreeParentNode.
+  //! @param node the node to remove
+  void remove_node( ActualNodeType *node ) {
+    static_assert( std::is_base_of< AATreeParentNode, ActualNodeType >::value,
+                   "remove_node() requires parent links" );
+    m_impl.remove_node( node );
+  }
+
+  //! Get the node following the given one in order.
+  //! ActualNodeType must derive from AATreeParentNode.
+  //! @param node a node in the tree
+  //! @return the next node, or nullptr if node is the last node
+  ActualNodeType *successor( ActualNodeType *node ) const {
+    static_assert( std::is_base_of< AATreeParentNode, ActualNodeType >::value,
+                   "successor() requires parent links" );
+    return static_cast< ActualNodeType* >( m_impl.successor( node ) );
+  }
+
+  //! Get the node preceding the given one in order.
+  //! ActualNodeType must derive from AATreeParentNode.
+  //! @param node a node in the tree
+  //! @return the previous node, or nullptr if node is the first node
+  ActualNodeType *predecessor( ActualNodeType *node ) const {
+    static_assert( std::is_base_of< AATreeParentNode, ActualNodeType >::value,
+                   "predecessor() requires parent links" );
+    return static_cast< ActualNodeType* >( m_impl.predecessor( node ) );
+  }
+
+  //! @return the number of nodes in the tree (note that this involves
+  //!         an O(N) traversal of the tree)
+  size_t get_size() const { return m_impl.get_size(); }
+
+  //! Move the tree's nodes into a contiguous buffer, in breadth-first
+  //! (level-by-level) order, so that the upper levels of the tree
+  //! (which every search visits) are packed into as few cache lines
+  //! and pages as possible. The nodes are moved using the given
+  //! relocation function, and all links are updated. If the buffer
+  //! is too small to hold every node, the nodes nearest the root are
+  //! moved and the rest stay where they are. Note that the tree's
+  //! free node function will subsequently be called on nodes that
+  //! live in the buffer, so it needs to be able to tell them apart
+  //! from individually allocated nodes (or the buffer needs to be
+  //! large enough to hold every node.)
+  //! @param buf buffer with room for capacity nodes of type ActualNodeType
+  //! @param capacity number of nodes the buffer can hold
+  //! @param relocate_fn function to move a node into the buffer
+  //! @return the number of nodes moved into the buffer
+  size_t relayout( void *buf, size_t capacity, AATreeImpl::RelocateNodeFn *relocate_fn ) {
+    return m_impl.relayout( buf, sizeof( ActualNodeType ), capacity, relocate_fn );
+  }
+
+  //! Build the tree from an array of nodes in linear time, without
+  //! any comparisons. The tree must be empty, and the nodes must be
+  //! sorted in ascending order, with no two nodes comparing as equal.
+  //! The resulting tree is as balanced as possible. See also
+  //! parallel_build() in ds_aatreepar.h.
+  //! @param nodes array of pointers to the nodes
+  //! @param n number of nodes
+  //! @return true if the tree was built, in which case the AATree
+  //!         assumes ownership of the nodes, or false if the tree
+  //!         isn't empty (or if the tree's height would exceed the
+  //!         maximum height), in which case the nodes remain
+  //!         the caller's responsibility
+  bool build( ActualNodeType *const *nodes, size_t n ) {
+    return m_impl.build( nodes, n, &node_at );
+  }
+
+  //! Move the nodes of another tree that aren't already in this
+  //! tree into this tree, leaving the other tree empty. The other
+  //! tree's nodes that compare as equal to nodes in this tree are
+  //! deleted using the free node function. The work is
+  //! O(m log(n/m + 1)), where m and n are the sizes of the smaller
+  //! and larger trees. The trees must be different trees with the
+  //! same functions (and context pointer) and parent link mode, and
+  //! must not be threaded. The result must also fit within this tree's
+  //! maximum height: if the trees' levels don't rule out a result that
+  //! is too high, their nodes are counted first, which takes linear
+  //! time. See also parallel_union() in ds_aatreepar.h.
+  //! @param other the other tree
+  //! @return true if the operation was done, or false if the trees
+  //!         don't meet the requirements (or the result could exceed
+  //!         the maximum height), in which case neither tree is changed
+  bool set_union( AATree &other ) {
+    return m_impl.set_op( AATreeImpl::SET_UNION, other.m_impl );
+  }
+
+  //! Keep only the nodes of this tree that compare as equal to a
+  //! node in another tree, leaving the other tree empty. The removed
+  //! nodes and the other tree's nodes are deleted using the free
+  //! node function. The same requirements apply as for set_union(),
+  //! and the same bound, plus the cost of deleting the nodes.
+  //! @param other the other tree
+  //! @return true if the operation was done, or false if not (see
+  //!         set_union()), in which case neither tree is changed
+  bool set_intersection( AATree &other ) {
+    return m_impl.set_op( AATreeImpl::SET_INTERSECTION, other.m_impl );
+  }
+
+  //! Remove the nodes of this tree that compare as equal to a node
+  //! in another tree, leaving the other tree empty. The removed nodes
+  //! and the other tree's nodes are deleted using the free node
+  //! function. The same requirements apply as for set_union(), and
+  //! the same bound, plus the cost of deleting the nodes.
+  //! @param other the other tree
+  //! @return true if the operation was done, or false if not (see
+  //!         set_union()), in which case neither tree is changed
+  bool set_difference( AATree &other ) {
+    return m_impl.set_op( AATreeImpl::SET_DIFFERENCE, other.m_impl );
+  }
+
+  //! Get the node at a given position in an array of pointers to
+  //! ActualNodeType, as an AATreeNode. Used as the AATreeImpl::NodeAtFn
+  //! for build().
+  static AATreeNode *node_at( const void *nodes, size_t i ) {
+    return static_cast< ActualNodeType *const * >( nodes )[ i ];
+  }
+
   //! Get an iterator positioned at the first (i.e., overall least) node.
   //! @return an iterator positioned at the first (overall least) node
   AATreeIter< ActualNodeType > iterator() const {
     return AATreeIter< ActualNodeType >( m_impl.iterator() );
   }
 
+  //! Get a threaded iterator positioned at the first (i.e., overall
+  //! least) node. The tree must have been constructed as threaded.
+  //! @return a threaded iterator positioned at the first (overall least) node
+  AATreeThreadedIter< ActualNodeType > threaded_iterator() const {
+    return AATreeThreadedIter< ActualNodeType >( m_impl.threaded_iterator() );
+  }
+
   //! Get a postfix iterator positioned at the first node in postfix order.
   //! @return a postfix iterator positioned at the first node in postfix order
   AATreePostfixIter< ActualNodeType > postfix_iterator() const {
     return AATreePostfixIter< ActualNodeType >( m_impl.postfix_iterator() );
   }
 
+  //! Get a finger for searching for a sequence of nodes in ascending order.
+  //! @return a finger
+  AATreeFinger< ActualNodeType > finger() const {
+    return AATreeFinger< ActualNodeType >( m_impl.finger() );
+  }
+
+#ifdef DSLIB_STATS
+  //! Get a snapshot of the tree's operation counters. (Only
+  //! available if DSLIB_STATS is defined.)
+  //! @return the counters
+  AATreeStats get_stats() const { return m_impl.get_stats(); }
+
+  //! Reset the tree's operation counters to 0.
+  void reset_stats() { m_impl.reset_stats(); }
+#endif
+
+#ifdef DSLIB_LATENCY
+  //! Start recording the latencies of the tree's operations. (Only
+  //! available if DSLIB_LATENCY is defined.) Until this is called,
+  //! operations aren't timed, and the tree has no histograms. This
+  //! must not be called while other operations are in progress.
+  //! @return true if successful, false if the histograms couldn't
+  //!         be allocated
+  bool enable_latency() { return m_impl.enable_latency(); }
+
+  //! Stop recording latencies, and discard the histograms. This must
+  //! not be called while other operations are in progress.
+  void disable_latency() { m_impl.disable_latency(); }
+
+  //! @return true if latencies are being recorded
+  bool is_latency_enabled() const { return m_impl.is_latency_enabled(); }
+
+  //! Get a snapshot of the tree's latency histograms (which are
+  //! empty if latencies aren't being recorded.)
+  //! @return the histograms
+  AATreeLatency get_latency() const { return m_impl.get_latency(); }
+
+  //! Reset the tree's latency histograms, so that they are empty.
+  void reset_latency() { m_impl.reset_latency(); }
+#endif
+
 #ifdef DSLIB_CHECK_INTEGRITY
   //! Check whether the tree satisfies the AST-tree properties
   //! @return true if the tree satisfies the AA-tree properties,
@@ -410,7 +1163,7 @@ public:
 
   //! Get tree height.
   int get_height() const {
-    return m_impl.get_height( m_impl.get_root() );
+    return m_impl.get_height();
   }
 #endif
 };
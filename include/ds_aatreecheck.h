@@ -0,0 +1,166 @@
+// Copyright 2025, David H. Hovemeyer <david.hovemeyer@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// “Software”), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+// THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef DS_AATREECHECK_H
+#define DS_AATREECHECK_H
+
+#include <cstddef>
+#include <cstdint>
+#include "ds_aatree.h"
+
+namespace dslib {
+
+// Checking an AATree, and measuring its shape, without recursion and
+// without having to do the whole tree at once. A checker visits the
+// nodes in order, keeping the path to the current node on a stack
+// of bounded size, so it can be used on large trees from threads
+// with small stacks. Each call to check() visits a limited number
+// of nodes, and the next call resumes where it left off, so the
+// tree only needs to be locked against modification for that long.
+// If the tree is modified between calls, the check must be
+// restarted (see AATreeChecker::restart()).
+//
+// The checks are:
+//
+//   - nodes are in strictly ascending order
+//   - each node's left child is one level below it, and its right
+//     child is at the same level or one level below (the nil node
+//     is at level 0, so leaves are at level 1)
+//   - if the right child is at the same level, its right child is
+//     at a lower level
+//   - no path from the root is longer than AA_TREE_MAX_HEIGHT
+//   - in a threaded tree, threads lead to in-order successors
+//   - in a tree with parent links, children link back to their
+//     parents, and the root has no parent
+
+//! Shape of an AATree, as measured by an AATreeChecker.
+struct AATreeShape {
+  //! Number of nodes
+  size_t num_nodes;
+  //! Number of nodes on the longest path from the root
+  int height;
+  //! Number of nodes at each level (index 0 is unused, since only
+  //! the nil node is at level 0)
+  size_t level_counts[ AA_TREE_MAX_HEIGHT + 1 ];
+  //! Sum of the depths of the nodes (the root is at depth 0)
+  uint64_t total_depth;
+  //! Bytes used by the nodes (not counting any allocator overhead)
+  size_t bytes_used;
+
+  //! @return the average depth of a node, or 0 if there are no nodes
+  double get_average_depth() const {
+    return ( num_nodes == 0 ) ? 0.0 : double( total_depth ) / double( num_nodes );
+  }
+};
+
+//! Incremental checker implementation.
+//! Don't use this directly: use AATreeChecker instead.
+class AATreeCheckerImpl {
+private:
+  struct Frame {
+    AATreeNode *node;
+    int depth;
+  };
+
+  const AATreeImpl *m_tree;
+  size_t m_node_size;
+  // Nodes whose left subtree is being visited (the node at the top
+  // of the stack is visited next, once next_subtree is done)
+  Frame m_stack[ AA_TREE_MAX_HEIGHT ];
+  int m_num_frames;
+  // Subtree whose left spine hasn't been pushed onto the stack yet
+  AATreeNode *m_next_subtree;
+  int m_next_depth;
+  // The most recently visited node
+  AATreeNode *m_prev;
+  bool m_done, m_valid;
+  AATreeShape m_shape;
+
+  NO_VALUE_SEMANTICS( AATreeCheckerImpl );
+
+public:
+  AATreeCheckerImpl( const AATreeImpl *tree, size_t node_size );
+  ~AATreeCheckerImpl();
+
+  void restart();
+  bool check( size_t max_nodes );
+  bool check_all();
+  bool is_done() const { return m_done; }
+  bool is_valid() const { return m_valid; }
+  const AATreeShape &get_shape() const { return m_shape; }
+
+private:
+  bool visit( AATreeNode *node, int depth );
+  bool finish();
+  bool fail();
+};
+
+//! Incremental checker for an AATree, which also measures the
+//! tree's shape. The tree must not be modified while a check is
+//! in progress: if it is, call restart() before continuing.
+//! @tparam ActualNodeType the actual tree node type
+template< typename ActualNodeType >
+class AATreeChecker {
+private:
+  AATreeCheckerImpl m_impl;
+
+  NO_VALUE_SEMANTICS( AATreeChecker );
+
+public:
+  //! Constructor.
+  //! @param tree the tree to check
+  explicit AATreeChecker( const AATree< ActualNodeType > &tree )
+    : m_impl( &tree.get_impl(), sizeof( ActualNodeType ) ) { }
+
+  //! Destructor.
+  ~AATreeChecker() { }
+
+  //! Start the check over from the beginning (e.g., because the tree
+  //! was modified.)
+  void restart() { m_impl.restart(); }
+
+  //! Continue the check.
+  //! @param max_nodes maximum number of nodes to visit
+  //! @return true if the check is done, false if there are more
+  //!         nodes to check
+  bool check( size_t max_nodes ) { return m_impl.check( max_nodes ); }
+
+  //! Check the rest of the tree.
+  //! @return true if the tree is valid, false if not
+  bool check_all() { return m_impl.check_all(); }
+
+  //! @return true if the check is done (either because the whole tree
+  //!         has been checked, or because a problem was found)
+  bool is_done() const { return m_impl.is_done(); }
+
+  //! @return false if a problem has been found, true otherwise
+  bool is_valid() const { return m_impl.is_valid(); }
+
+  //! Get the shape of the tree. This is complete once the check is done
+  //! (if the tree is valid): until then, it covers the nodes checked
+  //! so far.
+  //! @return the shape of the tree
+  const AATreeShape &get_shape() const { return m_impl.get_shape(); }
+};
+
+} // end namespace dslib
+
+#endif // DS_AATREECHECK_H
@@ -0,0 +1,118 @@
+// Copyright 2025, David H. Hovemeyer <david.hovemeyer@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// “Software”), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+// THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef DS_AATREEEXPORT_H
+#define DS_AATREEEXPORT_H
+
+#include <cstddef>
+#include "ds_aatree.h"
+#include "ds_aatreeserial.h"
+
+namespace dslib {
+
+// Exporting the structure of an AATree (for viewing, or for offline
+// analysis) as a Graphviz DOT graph, or as JSON. The tree is walked
+// without recursion (the path is kept on a stack of bounded size),
+// and the output is buffered and passed to an AATreeWriter a chunk
+// at a time, so large trees can be exported quickly. To keep the
+// output manageable, subtrees below a given depth can be left out,
+// and so can all but one in every N subtrees at a given depth.
+// Left-out subtrees are shown as "elided".
+//
+// In DOT output, each node is labeled with its level and its label
+// (see AATreeExportImpl::NodeLabelFn), and each edge with L or R.
+// Horizontal links (from a node to a right child at the same level)
+// are dashed.
+//
+// JSON output looks like this, where each left and right child is a
+// node object, null (no child), or "elided":
+//
+//   {"root":{"id":0,"level":2,"label":"4",
+//            "left":{"id":1,"level":1,"label":"2","left":null,"right":null},
+//            "right":"elided"}}
+//
+// Node ids are assigned in preorder.
+
+//! Export formats
+enum AATreeExportFormat {
+  AA_TREE_EXPORT_DOT,
+  AA_TREE_EXPORT_JSON,
+};
+
+//! Maximum length of a node label: longer labels are truncated.
+const size_t AA_TREE_EXPORT_MAX_LABEL = 256;
+
+//! Options for exporting a tree.
+struct AATreeExportOptions {
+  //! Output format
+  AATreeExportFormat format;
+  //! Nodes deeper than this are left out (the root is at depth 0).
+  //! If negative, there is no limit.
+  int max_depth;
+  //! Depth of the subtrees that are sampled
+  int sample_depth;
+  //! Only one in every sample_interval subtrees at sample_depth
+  //! (from left to right, starting with the first) is exported.
+  //! If 1, all of them are exported.
+  unsigned sample_interval;
+
+  //! Constructor: by default, the whole tree is exported as DOT.
+  AATreeExportOptions()
+    : format( AA_TREE_EXPORT_DOT )
+    , max_depth( -1 )
+    , sample_depth( 0 )
+    , sample_interval( 1 ) { }
+};
+
+//! Export implementation.
+//! Don't use this directly: use the export_tree() function
+//! template instead.
+class AATreeExportImpl {
+public:
+  //! Type of function to get a node's label. The label (which need
+  //! not be NUL-terminated) should be stored in the buffer, and its
+  //! length returned: if it doesn't fit, only the part that does
+  //! is exported.
+  typedef size_t NodeLabelFn( const AATreeNode *node, char *buf, size_t size );
+
+  static bool export_tree( const AATreeImpl &tree, AATreeWriter &writer,
+                           NodeLabelFn *label_fn, const AATreeExportOptions &options );
+};
+
+//! Export the structure of an AATree to an AATreeWriter.
+//! @tparam ActualNodeType the actual tree node type
+//! @param tree the tree
+//! @param writer the AATreeWriter
+//! @param label_fn function to get a node's label, or nullptr if
+//!                 the nodes shouldn't be labeled
+//! @param options the output format, and which nodes to export
+//! @return true if successful, false if there was a write error
+//!         (or the tree is deeper than any valid tree can be)
+template< typename ActualNodeType >
+bool export_tree( const AATree< ActualNodeType > &tree, AATreeWriter &writer,
+                  AATreeExportImpl::NodeLabelFn *label_fn,
+                  const AATreeExportOptions &options = AATreeExportOptions() ) {
+  return AATreeExportImpl::export_tree( tree.get_impl(), writer, label_fn, options );
+}
+
+} // end namespace dslib
+
+#endif // DS_AATREEEXPORT_H
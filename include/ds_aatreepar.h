@@ -0,0 +1,255 @@
+// Copyright 2025, David H. Hovemeyer <david.hovemeyer@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// “Software”), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+// THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef DS_AATREEPAR_H
+#define DS_AATREEPAR_H
+
+#include <vector>
+#include "ds_aatree.h"
+
+namespace dslib {
+
+// Parallel operations on AATrees. The tree is cut into disjoint
+// pieces near the root: whole subtrees at a fixed depth, plus the
+// individual nodes above them. Pieces are numbered in order, and are
+// handed out to a pool of worker threads, each of which starts with
+// a contiguous range of pieces and steals from the other workers
+// when its own range runs out. Each worker traverses its subtrees
+// with an ordinary (bounded stack) AATree iterator.
+//
+// The tree must not be modified while a parallel operation is
+// in progress.
+
+//! Parallel operations implementation.
+//! Don't use this directly: use the parallel_for_each() and
+//! parallel_reduce() function templates instead.
+class AATreeParImpl {
+public:
+  //! Type of function to run one of a set of tasks.
+  //! @param ctx context pointer
+  //! @param task index of the task
+  //! @param worker index of the worker thread running the task
+  typedef void TaskFn( void *ctx, size_t task, int worker );
+
+  //! Type of function to visit a node.
+  //! @param ctx context pointer
+  //! @param piece index of the piece of the tree the node is in:
+  //!              the nodes of each piece are visited in order,
+  //!              by a single thread
+  //! @param node the node
+  typedef void VisitFn( void *ctx, size_t piece, AATreeNode *node );
+
+private:
+  struct Piece {
+    AATreeNode *node;
+    bool whole_subtree; // if false, just the node itself
+  };
+
+  const AATreeImpl *m_tree;
+  int m_num_threads;
+  std::vector< Piece > m_pieces;
+
+  NO_VALUE_SEMANTICS( AATreeParImpl );
+
+public:
+  AATreeParImpl( const AATreeImpl &tree, int num_threads );
+  ~AATreeParImpl();
+
+  int get_num_threads() const { return m_num_threads; }
+  size_t get_num_pieces() const { return m_pieces.size(); }
+  void for_each( VisitFn *fn, void *ctx ) const;
+
+  static bool build( AATreeImpl &tree, const void *nodes, size_t n,
+                     AATreeImpl::NodeAtFn *node_at_fn, int num_threads );
+  static bool set_op( AATreeImpl &tree, AATreeImpl &other, AATreeImpl::SetOp op, int num_threads );
+
+  static int default_num_threads();
+  static void run_tasks( size_t num_tasks, TaskFn *fn, void *ctx, int num_threads );
+
+private:
+  struct VisitContext;
+  static void visit_piece( void *ctx, size_t piece, int worker );
+
+  struct BuildContext;
+  static void defer_range( void *ctx, const AATreeImpl::BuildRange &range );
+  static void build_piece( void *ctx, size_t piece, int worker );
+
+  struct SetOpTask;
+  struct SetOpContext;
+  static void init_set_op_task( SetOpTask *task, AATreeNode *t1, AATreeNode *t2, SetOpTask *parent, int side );
+  static void set_op_worker( SetOpContext *sc, int worker );
+  static void run_set_op_task( SetOpContext *sc, SetOpTask *task, int worker );
+  static void complete_set_op_task( SetOpContext *sc, SetOpTask *task, AATreeNode *result );
+};
+
+//! Call a function on every node in an AATree, using multiple threads.
+//! The function is called concurrently from the worker threads (and
+//! the calling thread), so it must be thread-safe. Nodes are not
+//! visited in any particular order.
+//! @tparam ActualNodeType the actual tree node type
+//! @tparam Fn type of function to call on each node: it is called as
+//!            fn( node ), where node is an ActualNodeType*
+//! @param tree the tree
+//! @param fn the function to call on each node
+//! @param num_threads number of threads to use (0 to use one thread
+//!                    per available CPU core)
+template< typename ActualNodeType, typename Fn >
+void parallel_for_each( const AATree< ActualNodeType > &tree, Fn fn, int num_threads = 0 ) {
+  struct Visitor {
+    static void visit( void *ctx, size_t, AATreeNode *node ) {
+      ( *static_cast< Fn* >( ctx ) )( static_cast< ActualNodeType* >( node ) );
+    }
+  };
+
+  AATreeParImpl par( tree.get_impl(), num_threads );
+  par.for_each( &Visitor::visit, &fn );
+}
+
+//! Compute a reduction over the nodes of an AATree, in order,
+//! using multiple threads. Each piece of the tree is reduced
+//! separately, and the results for the pieces are then combined
+//! in order, so the result is the same as
+//! combine_fn( ... combine_fn( combine_fn( identity, map_fn( n1 ) ),
+//! map_fn( n2 ) ) ..., map_fn( nN ) ), provided that combine_fn is
+//! associative and identity is its identity element. map_fn is called
+//! concurrently from multiple threads, and must be thread-safe.
+//! @tparam ActualNodeType the actual tree node type
+//! @tparam Result type of the result
+//! @tparam MapFn type of function to compute the result for a single
+//!               node: called as map_fn( node )
+//! @tparam CombineFn type of function to combine two results: called
+//!                   as combine_fn( left, right )
+//! @param tree the tree
+//! @param identity identity element for combine_fn
+//! @param map_fn function to compute the result for a single node
+//! @param combine_fn function to combine results
+//! @param num_threads number of threads to use (0 to use one thread
+//!                    per available CPU core)
+//! @return the combined result for all of the nodes
+template< typename ActualNodeType, typename Result, typename MapFn, typename CombineFn >
+Result parallel_reduce( const AATree< ActualNodeType > &tree, const Result &identity,
+                        MapFn map_fn, CombineFn combine_fn, int num_threads = 0 ) {
+  // Each piece's result is in its own cache line, since
+  // neighboring pieces are usually reduced by different threads
+  struct alignas( 64 ) Slot {
+    Result result;
+  };
+
+  struct Reducer {
+    MapFn &map_fn;
+    CombineFn &combine_fn;
+    std::vector< Slot > &slots;
+
+    static void visit( void *ctx, size_t piece, AATreeNode *node ) {
+      Reducer *r = static_cast< Reducer* >( ctx );
+      Result &result = r->slots[ piece ].result;
+      result = r->combine_fn( result, r->map_fn( static_cast< ActualNodeType* >( node ) ) );
+    }
+  };
+
+  AATreeParImpl par( tree.get_impl(), num_threads );
+  std::vector< Slot > slots( par.get_num_pieces(), Slot{ identity } );
+  Reducer reducer{ map_fn, combine_fn, slots };
+  par.for_each( &Reducer::visit, &reducer );
+
+  Result result = identity;
+  for ( auto i = slots.begin(); i != slots.end(); ++i )
+    result = combine_fn( result, i->result );
+  return result;
+}
+
+//! Build an AATree from an array of nodes, using multiple threads.
+//! The top levels of the tree are built by the calling thread,
+//! and the subtrees below them are built concurrently by the worker
+//! threads. The result is the same as AATree::build(), and the same
+//! requirements apply: the tree must be empty, and the nodes must be
+//! sorted in ascending order, with no two nodes comparing as equal.
+//! @tparam ActualNodeType the actual tree node type
+//! @param tree the tree
+//! @param nodes array of pointers to the nodes
+//! @param n number of nodes
+//! @param num_threads number of threads to use (0 to use one thread
+//!                    per available CPU core)
+//! @return true if the tree was built, in which case the AATree
+//!         assumes ownership of the nodes, or false if the tree
+//!         isn't empty (or if the tree's height would exceed the
+//!         maximum height), in which case the nodes remain
+//!         the caller's responsibility
+template< typename ActualNodeType >
+bool parallel_build( AATree< ActualNodeType > &tree, ActualNodeType *const *nodes, size_t n,
+                     int num_threads = 0 ) {
+  return AATreeParImpl::build( tree.get_impl(), nodes, n, &AATree< ActualNodeType >::node_at, num_threads );
+}
+
+//! Union of two AATrees, using multiple threads: see AATree::set_union().
+//! The tree is split by the root of the other tree, and the two halves
+//! of the problem become tasks, which are divided in the same way,
+//! and which idle worker threads steal from each other. Each task's
+//! halves are joined back together by whichever thread finishes the
+//! second half. Problems where either subtree is small are done
+//! sequentially. The work is the same as for set_union(), and the
+//! span is polylogarithmic in the sizes of the trees (not counting
+//! the cost of deleting nodes, for an intersection or difference.)
+//! The free node function may be called concurrently from multiple
+//! threads.
+//! @tparam ActualNodeType the actual tree node type
+//! @param tree the tree that receives the result
+//! @param other the other tree, which is left empty
+//! @param num_threads number of threads to use (0 to use one thread
+//!                    per available CPU core)
+//! @return true if the operation was done, or false if not (see
+//!         AATree::set_union()), in which case neither tree is changed
+template< typename ActualNodeType >
+bool parallel_union( AATree< ActualNodeType > &tree, AATree< ActualNodeType > &other, int num_threads = 0 ) {
+  return AATreeParImpl::set_op( tree.get_impl(), other.get_impl(), AATreeImpl::SET_UNION, num_threads );
+}
+
+//! Intersection of two AATrees, using multiple threads: see
+//! AATree::set_intersection() and parallel_union().
+//! @tparam ActualNodeType the actual tree node type
+//! @param tree the tree that receives the result
+//! @param other the other tree, which is left empty
+//! @param num_threads number of threads to use (0 to use one thread
+//!                    per available CPU core)
+//! @return true if the operation was done, or false if not (see
+//!         AATree::set_union()), in which case neither tree is changed
+template< typename ActualNodeType >
+bool parallel_intersection( AATree< ActualNodeType > &tree, AATree< ActualNodeType > &other, int num_threads = 0 ) {
+  return AATreeParImpl::set_op( tree.get_impl(), other.get_impl(), AATreeImpl::SET_INTERSECTION, num_threads );
+}
+
+//! Difference of two AATrees, using multiple threads: see
+//! AATree::set_difference() and parallel_union().
+//! @tparam ActualNodeType the actual tree node type
+//! @param tree the tree that receives the result
+//! @param other the other tree, which is left empty
+//! @param num_threads number of threads to use (0 to use one thread
+//!                    per available CPU core)
+//! @return true if the operation was done, or false if not (see
+//!         AATree::set_union()), in which case neither tree is changed
+template< typename ActualNodeType >
+bool parallel_difference( AATree< ActualNodeType > &tree, AATree< ActualNodeType > &other, int num_threads = 0 ) {
+  return AATreeParImpl::set_op( tree.get_impl(), other.get_impl(), AATreeImpl::SET_DIFFERENCE, num_threads );
+}
+
+} // end namespace dslib
+
+#endif // DS_AATREEPAR_H
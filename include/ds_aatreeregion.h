@@ -0,0 +1,354 @@
+// Copyright 2025, David H. Hovemeyer <david.hovemeyer@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// “Software”), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+// THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef DS_AATREEREGION_H
+#define DS_AATREEREGION_H
+
+#include <cstddef>
+#include <cstdint>
+#include "ds_aatree.h"
+
+namespace dslib {
+
+// A region tree is an AA tree that lives entirely inside a single
+// block of memory provided by the caller, such as a memory-mapped
+// file. Every link is stored as the offset of its target from the
+// link itself, so the region can be used in place wherever it is
+// mapped, with no load phase and no pointer fixups.
+//
+// The region starts with a header (recording the node size, the
+// root, a free list, and the tree's nil node), followed by the
+// nodes. Nodes are allocated from the region: either from the free
+// list of removed nodes, or from the unused space at the end. So
+// the nodes all have the same size, and their contents must not
+// contain pointers (or anything else that depends on where the
+// region is mapped.) The comparison function isn't stored in the
+// region, so it is provided each time a tree is attached to one.
+//
+// Nothing is done to keep the region consistent if the process
+// stops in the middle of an update: making sure that the region
+// is written back (e.g., with msync()) is the caller's job.
+//
+// AATreeRegion::check() checks the header of a region, including
+// that the root and the head of the free list are nodes within the
+// region, but it doesn't follow the links from there: the links in
+// the nodes (and in the free list) of a region that passes check()
+// are trusted.
+
+//! Version of the region format written by AATreeRegion::format().
+const uint32_t AA_TREE_REGION_VERSION = 1;
+
+class AATreeRegionImpl;
+class AATreeRegionIterImpl;
+
+//! Link stored as the offset of its target from the link itself.
+//! You should not need to use this directly. Note that a link
+//! can't be copied, since the copy would point somewhere else.
+class AATreeRegionLink {
+private:
+  int64_t m_offset;
+
+  NO_VALUE_SEMANTICS( AATreeRegionLink );
+
+public:
+  AATreeRegionLink() : m_offset( 0 ) { }
+  ~AATreeRegionLink() { }
+
+  void *get() const {
+    return const_cast< char* >( reinterpret_cast< const char* >( this ) ) + m_offset;
+  }
+
+  int64_t get_offset() const { return m_offset; }
+
+  void set( const void *target ) {
+    m_offset = static_cast< const char* >( target ) - reinterpret_cast< const char* >( this );
+  }
+};
+
+//! Intrusive region tree node base class.
+//! Your node type must derive from this class.
+class AATreeRegionNode {
+private:
+  AATreeRegionLink m_left, m_right;
+  int m_level;
+
+  NO_VALUE_SEMANTICS( AATreeRegionNode );
+
+public:
+  AATreeRegionNode() : m_level( 1 ) { }
+  ~AATreeRegionNode() { }
+
+  friend class AATreeRegionImpl;
+  friend class AATreeRegionIterImpl;
+
+private:
+  AATreeRegionNode *get_left() const { return static_cast< AATreeRegionNode* >( m_left.get() ); }
+  AATreeRegionNode *get_right() const { return static_cast< AATreeRegionNode* >( m_right.get() ); }
+  int get_level() const { return m_level; }
+
+  void set_left( AATreeRegionNode *left ) { m_left.set( left ); }
+  void set_right( AATreeRegionNode *right ) { m_right.set( right ); }
+  void set_level( int level ) { m_level = level; }
+  AATreeRegionLink *get_link_to_left() { return &m_left; }
+  AATreeRegionLink *get_link_to_right() { return &m_right; }
+};
+
+//! In-order iterator implementation for region trees.
+//! Don't use this directly: use AATreeRegionIter instead,
+//! parametized with the actual node type.
+class AATreeRegionIterImpl {
+private:
+  AATreePtrStack< AATreeRegionNode* > m_stack;
+  const AATreeRegionNode *m_nil;
+
+  // Note that this class DOES have value semantics
+
+public:
+  AATreeRegionIterImpl();
+  ~AATreeRegionIterImpl();
+
+  bool has_next() const;
+  AATreeRegionNode *next();
+
+  friend class AATreeRegionImpl;
+
+private:
+  void push_left_spine( AATreeRegionNode *node );
+};
+
+//! Region tree implementation.
+//! Don't use this directly: instead, use AATreeRegion, parametized
+//! with the actual tree node type.
+class AATreeRegionImpl {
+public:
+  //! Type of node comparison function: returns true IFF left node
+  //! compares as less than right node
+  typedef bool LessThanFn( const AATreeRegionNode *left, const AATreeRegionNode *right );
+
+private:
+  struct Header;
+  static const size_t SLOTS_BEGIN;
+
+  Header *m_header;
+  AATreeRegionNode *m_nil;
+  LessThanFn *m_less_than_fn;
+
+  NO_VALUE_SEMANTICS( AATreeRegionImpl );
+
+public:
+  AATreeRegionImpl( void *region, LessThanFn *less_than_fn );
+  ~AATreeRegionImpl();
+
+  static bool format( void *region, size_t size, size_t node_size );
+  static bool check( const void *region, size_t size, size_t node_size );
+
+  bool is_empty() const { return get_root() == m_nil; }
+  void *alloc_slot();
+  void free_slot( void *slot );
+  bool insert( AATreeRegionNode *node );
+  AATreeRegionNode *find( const AATreeRegionNode &node ) const;
+  AATreeRegionNode *remove( const AATreeRegionNode &node );
+  size_t get_size() const;
+  AATreeRegionIterImpl iterator() const;
+
+#ifdef DSLIB_CHECK_INTEGRITY
+  // Does the tree satisfy the AA-tree properties? (Like
+  // AATreeCheckerImpl, this visits the nodes in order using a
+  // bounded stack, rather than recursively.)
+  bool is_valid() const;
+#endif
+
+private:
+  static bool is_slot_offset( const Header *header, uint64_t offset );
+  static bool is_slot_link( const Header *header, const AATreeRegionLink *link );
+
+  AATreeRegionNode *get_root() const;
+  AATreeRegionLink *get_link_to_root();
+
+  // Rebalancing (shared with AATreeImpl: see ds_aatreebalance.h)
+  class BalanceOps;
+  AATreeRegionNode *skew( AATreeRegionNode *t );
+  AATreeRegionNode *split( AATreeRegionNode *t );
+  AATreeRegionNode *rebalance( AATreeRegionNode *t );
+};
+
+//! In-order iterator over the nodes in an AATreeRegion.
+//! @tparam ActualNodeType the actual tree node type
+template< typename ActualNodeType >
+class AATreeRegionIter {
+private:
+  AATreeRegionIterImpl m_impl;
+
+public:
+  //! Constructor. This shouldn't be used directly:
+  //! instead, call AATreeRegion::iterator().
+  //! @param impl the underlying AATreeRegionIterImpl positioned at
+  //!             the first node
+  AATreeRegionIter( const AATreeRegionIterImpl &impl )
+    : m_impl( impl ) {
+
+  }
+
+  //! Destructor.
+  ~AATreeRegionIter() { }
+
+  //! @return true if the iterator can return at least one more node,
+  //!         false if there are no more nodes to return
+  bool has_next() const {
+    return m_impl.has_next();
+  }
+
+  //! Get the next node, and advance to the node that follows
+  //! in order. Don't call this unless has_next() has returned true.
+  //! @return the next node in the sequence
+  ActualNodeType *next() {
+    return static_cast< ActualNodeType* >( m_impl.next() );
+  }
+};
+
+//! Balanced binary search tree stored in a region of memory
+//! (for example, a memory-mapped file) that can be used in place
+//! wherever the region is mapped.
+//! @tparam ActualNodeType the actual tree node type, which needs
+//!         to derive from AATreeRegionNode
+template< typename ActualNodeType >
+class AATreeRegion {
+private:
+  AATreeRegionImpl m_impl;
+
+  NO_VALUE_SEMANTICS( AATreeRegion );
+
+public:
+  //! Prepare a region to hold an empty tree. The region must be
+  //! aligned suitably for ActualNodeType (memory returned by mmap()
+  //! or malloc() is.)
+  //! @param region the region
+  //! @param size size of the region in bytes
+  //! @return true if successful, false if the region is too small
+  //!         to hold the header and at least one node
+  static bool format( void *region, size_t size ) {
+    return AATreeRegionImpl::format( region, size, sizeof( ActualNodeType ) );
+  }
+
+  //! Check whether a region was prepared by format() for this node
+  //! type (with a compatible version of the library), so that it
+  //! can be attached to.
+  //! @param region the region
+  //! @param size size of the region in bytes
+  //! @return true if the region can be attached to, false if not
+  static bool check( const void *region, size_t size ) {
+    return AATreeRegionImpl::check( region, size, sizeof( ActualNodeType ) );
+  }
+
+  //! Constructor: attach to a region prepared by format(). Any nodes
+  //! that were inserted into the tree (wherever the region was mapped
+  //! at the time) are part of it.
+  //! @param region the region
+  //! @param less_than_fn function to compare two tree nodes to determine
+  //!                     whether the left node is less than the right node
+  AATreeRegion( void *region, AATreeRegionImpl::LessThanFn *less_than_fn )
+    : m_impl( region, less_than_fn )
+  { }
+
+  //! Destructor. The nodes stay in the region.
+  ~AATreeRegion() { }
+
+  //! Check whether the tree is empty.
+  //! @return true if the tree is empty, false if it has at least one node
+  bool is_empty() const { return m_impl.is_empty(); }
+
+  //! Allocate storage for a node from the region. Construct the node
+  //! with placement new, and then insert it (or free it.)
+  //! @return the storage for a node, or nullptr if the region is full
+  void *alloc() { return m_impl.alloc_slot(); }
+
+  //! Destroy a node that isn't in the tree, and return its storage
+  //! to the region.
+  //! @param node the node, which must have been allocated using alloc()
+  void free( ActualNodeType *node ) {
+    node->~ActualNodeType();
+    m_impl.free_slot( node );
+  }
+
+  //! Insert given node into the tree.
+  //! @param node the node to insert, which must have been allocated
+  //!             using alloc()
+  //! @return true if the node is inserted successfully, or false if a
+  //!         node comparing as equal already exists in the tree (or if
+  //!         inserting the node could make the tree's height exceed
+  //!         AA_TREE_MAX_HEIGHT), in which case the node remains
+  //!         the caller's responsibility
+  bool insert( ActualNodeType *node ) {
+    return m_impl.insert( node );
+  }
+
+  //! Search for a node in the tree comparing as equal to the given one.
+  //! @param node a node (which doesn't need to be in the region)
+  //! @return pointer to a tree node equal to the given node,
+  //!         or nullptr if the tree does not contain a node equal to
+  //!         the given one
+  ActualNodeType *find( const ActualNodeType &node ) const {
+    return static_cast< ActualNodeType* >( m_impl.find( node ) );
+  }
+
+  //! Determine if the tree contains a node equal to the given one.
+  //! @param node a node
+  //! @return true if the tree contains a node equal to the given one,
+  //!         false otherwise
+  bool contains( const ActualNodeType &node ) const {
+    return m_impl.find( node ) != nullptr;
+  }
+
+  //! Remove the node equal to the given one, and free it. The other
+  //! nodes aren't moved or copied, so pointers to them stay valid.
+  //! @return true if a node was removed, false if the tree did not
+  //!         contain a node equal to the given one
+  bool remove( const ActualNodeType &node ) {
+    AATreeRegionNode *removed = m_impl.remove( node );
+    if ( removed == nullptr )
+      return false;
+    free( static_cast< ActualNodeType* >( removed ) );
+    return true;
+  }
+
+  //! @return the number of nodes in the tree (note that this involves
+  //!         an O(N) traversal of the tree)
+  size_t get_size() const { return m_impl.get_size(); }
+
+  //! Get an iterator positioned at the first (i.e., overall least) node.
+  //! @return an iterator positioned at the first (overall least) node
+  AATreeRegionIter< ActualNodeType > iterator() const {
+    return AATreeRegionIter< ActualNodeType >( m_impl.iterator() );
+  }
+
+#ifdef DSLIB_CHECK_INTEGRITY
+  //! Check whether the tree satisfies the AA-tree properties
+  //! @return true if the tree satisfies the AA-tree properties,
+  //!         false if not
+  bool is_valid() const {
+    return m_impl.is_valid();
+  }
+#endif
+};
+
+} // end namespace dslib
+
+#endif // DS_AATREEREGION_H
@@ -0,0 +1,156 @@
+// Copyright 2025, David H. Hovemeyer <david.hovemeyer@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// “Software”), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+// THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef DS_AATREESERIAL_H
+#define DS_AATREESERIAL_H
+
+#include <cstdio>
+#include <cstdint>
+#include "ds_aatree.h"
+
+namespace dslib {
+
+// Binary serialization of AATrees. The nodes are written in order,
+// so a tree can be loaded in linear time (with AATree::build()),
+// with no comparisons other than those needed to check the order.
+// Writing and reading are done in chunks, so the serialized tree
+// never needs to be in memory all at once.
+//
+// Format (integers are little-endian):
+//
+//   magic     8 bytes, "DSAATREE"
+//   version   uint32 (currently 1)
+//   reserved  uint32 (0)
+//   count     uint64, number of nodes
+//   records   count times: length (unsigned LEB128), then the
+//             node's encoding (length bytes)
+//   checksum  uint64, FNV-1a hash of the records
+
+//! Version of the serialization format written by serialize().
+const uint32_t AA_TREE_SERIAL_VERSION = 1;
+
+//! Destination for serialized data.
+class AATreeWriter {
+public:
+  AATreeWriter();
+  virtual ~AATreeWriter();
+
+  //! Write data.
+  //! @param data the data
+  //! @param n number of bytes to write
+  //! @return true if successful, false if there was an error
+  virtual bool write( const void *data, size_t n ) = 0;
+};
+
+//! Source of serialized data.
+class AATreeReader {
+public:
+  AATreeReader();
+  virtual ~AATreeReader();
+
+  //! Read data.
+  //! @param buf buffer to read into
+  //! @param n maximum number of bytes to read
+  //! @return number of bytes read, which is 0 only at the end of
+  //!         the data (or if there was an error)
+  virtual size_t read( void *buf, size_t n ) = 0;
+};
+
+//! AATreeWriter that writes to a stdio FILE.
+class AATreeFileWriter : public AATreeWriter {
+private:
+  FILE *m_out;
+
+  NO_VALUE_SEMANTICS( AATreeFileWriter );
+
+public:
+  AATreeFileWriter( FILE *out );
+  virtual ~AATreeFileWriter();
+
+  virtual bool write( const void *data, size_t n );
+};
+
+//! AATreeReader that reads from a stdio FILE.
+class AATreeFileReader : public AATreeReader {
+private:
+  FILE *m_in;
+
+  NO_VALUE_SEMANTICS( AATreeFileReader );
+
+public:
+  AATreeFileReader( FILE *in );
+  virtual ~AATreeFileReader();
+
+  virtual size_t read( void *buf, size_t n );
+};
+
+//! Serialization implementation.
+//! Don't use this directly: use the serialize() and load()
+//! function templates instead.
+class AATreeSerialImpl {
+public:
+  //! Type of function to encode a node. If the encoding fits in the
+  //! buffer, it should be stored there. Either way, the function
+  //! returns the size of the encoding: if it's larger than the buffer,
+  //! the function is called again with a large enough buffer.
+  typedef size_t EncodeNodeFn( const AATreeNode *node, void *buf, size_t size );
+
+  //! Type of function to decode a node: it returns a newly allocated
+  //! node (which can be freed with the tree's free node function),
+  //! or nullptr if the encoding is invalid.
+  typedef AATreeNode *DecodeNodeFn( const void *data, size_t size );
+
+  static bool serialize( const AATreeImpl &tree, AATreeWriter &writer, EncodeNodeFn *encode_fn );
+  static bool load( AATreeImpl &tree, AATreeReader &reader, DecodeNodeFn *decode_fn );
+};
+
+//! Write the nodes of an AATree, in order, to an AATreeWriter.
+//! @tparam ActualNodeType the actual tree node type
+//! @param tree the tree
+//! @param writer the AATreeWriter
+//! @param encode_fn function to encode a node
+//! @return true if successful, false if there was a write error
+template< typename ActualNodeType >
+bool serialize( const AATree< ActualNodeType > &tree, AATreeWriter &writer,
+                AATreeSerialImpl::EncodeNodeFn *encode_fn ) {
+  return AATreeSerialImpl::serialize( tree.get_impl(), writer, encode_fn );
+}
+
+//! Load the nodes written by serialize() into an empty AATree.
+//! The data is checked: if its magic number, version, order of
+//! nodes, or checksum is wrong, if it is truncated, or if a node
+//! can't be decoded, the load fails and the tree is left empty.
+//! @tparam ActualNodeType the actual tree node type
+//! @param tree the tree, which must be empty
+//! @param reader the AATreeReader
+//! @param decode_fn function to decode a node
+//! @return true if successful, false if the data is invalid (or
+//!         the tree isn't empty, or would be taller than its
+//!         maximum height)
+template< typename ActualNodeType >
+bool load( AATree< ActualNodeType > &tree, AATreeReader &reader,
+           AATreeSerialImpl::DecodeNodeFn *decode_fn ) {
+  return AATreeSerialImpl::load( tree.get_impl(), reader, decode_fn );
+}
+
+} // end namespace dslib
+
+#endif // DS_AATREESERIAL_H
@@ -0,0 +1,201 @@
+// Copyright 2025, David H. Hovemeyer <david.hovemeyer@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// “Software”), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+// THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef DS_AATREESNAPSHOT_H
+#define DS_AATREESNAPSHOT_H
+
+#include <cstdint>
+#include "ds_aatree.h"
+
+namespace dslib {
+
+// A snapshot is a read-only copy of the structure of an AATree,
+// stored in a single array in Eytzinger order: the node at index k
+// has children at indices 2k and 2k+1 (index 0 is unused). Searches
+// need no pointer chasing, and the next few levels of the search
+// can be prefetched, since their location is known in advance.
+//
+// A snapshot refers to the nodes of the tree it was built from,
+// so it must be rebuilt after the tree is modified. (The AATree
+// itself remains the "source of truth".) The storage for a snapshot
+// is provided by the caller: an array with room for one more element
+// than the number of nodes in the tree.
+
+//! Snapshot implementation.
+//! Don't use this directly: use AATreeSnapshot instead,
+//! parametized with the actual node type.
+class AATreeSnapshotImpl {
+private:
+  AATreeNode **m_nodes;
+  size_t m_size;
+  AATreeImpl::LessThan m_less_than;
+
+  NO_VALUE_SEMANTICS( AATreeSnapshotImpl );
+
+public:
+  AATreeSnapshotImpl();
+  ~AATreeSnapshotImpl();
+
+  bool build( const AATreeImpl &tree, AATreeNode **buf, size_t capacity );
+  size_t get_size() const { return m_size; }
+  AATreeNode *find( const AATreeNode &node ) const;
+};
+
+//! Integer key snapshot implementation.
+//! Don't use this directly: use AATreeIntSnapshot instead,
+//! parametized with the actual node type.
+class AATreeIntSnapshotImpl {
+public:
+  //! Type of function to get the integer key of a node.
+  //! Keys must be ordered consistently with the tree's
+  //! less than function.
+  typedef int64_t GetKeyFn( const AATreeNode *node );
+
+private:
+  int64_t *m_keys;
+  AATreeNode **m_nodes;
+  size_t m_size;
+  int m_depth;
+
+  NO_VALUE_SEMANTICS( AATreeIntSnapshotImpl );
+
+public:
+  AATreeIntSnapshotImpl();
+  ~AATreeIntSnapshotImpl();
+
+  bool build( const AATreeImpl &tree, GetKeyFn *get_key_fn, int64_t *key_buf, AATreeNode **node_buf, size_t capacity );
+  size_t get_size() const { return m_size; }
+  AATreeNode *find( int64_t key ) const;
+  void find_many( const int64_t *keys, size_t n, AATreeNode **results ) const;
+
+private:
+  size_t lower_bound( int64_t key ) const;
+};
+
+//! Read-only snapshot of an AATree, supporting fast searches.
+//! @tparam ActualNodeType the actual tree node type
+template< typename ActualNodeType >
+class AATreeSnapshot {
+private:
+  AATreeSnapshotImpl m_impl;
+
+  NO_VALUE_SEMANTICS( AATreeSnapshot );
+
+public:
+  //! Constructor. The snapshot is empty until build() is called.
+  AATreeSnapshot() { }
+
+  //! Destructor.
+  ~AATreeSnapshot() { }
+
+  //! Build the snapshot from the current contents of a tree.
+  //! @param tree the tree
+  //! @param buf array to store the snapshot in
+  //! @param capacity number of elements in buf, which must be
+  //!                 greater than the number of nodes in the tree
+  //! @return true if successful, false if buf is too small
+  bool build( const AATree< ActualNodeType > &tree, AATreeNode **buf, size_t capacity ) {
+    return m_impl.build( tree.get_impl(), buf, capacity );
+  }
+
+  //! @return the number of nodes in the snapshot
+  size_t get_size() const { return m_impl.get_size(); }
+
+  //! Search for a node comparing as equal to the given one.
+  //! @param node a node
+  //! @return pointer to the node equal to the given one, or nullptr
+  //!         if the snapshot doesn't contain an equal node
+  ActualNodeType *find( const ActualNodeType &node ) const {
+    return static_cast< ActualNodeType* >( m_impl.find( node ) );
+  }
+};
+
+//! Read-only snapshot of an AATree whose nodes are ordered by an
+//! integer key. The keys are stored in the snapshot, so searches
+//! only touch the nodes that match. If the library is compiled with
+//! AVX2 support, find_many() searches for four keys at a time.
+//! @tparam ActualNodeType the actual tree node type
+template< typename ActualNodeType >
+class AATreeIntSnapshot {
+private:
+  AATreeIntSnapshotImpl m_impl;
+
+  NO_VALUE_SEMANTICS( AATreeIntSnapshot );
+
+public:
+  //! Constructor. The snapshot is empty until build() is called.
+  AATreeIntSnapshot() { }
+
+  //! Destructor.
+  ~AATreeIntSnapshot() { }
+
+  //! Build the snapshot from the current contents of a tree.
+  //! For best performance, key_buf should be aligned on a
+  //! 64 byte boundary.
+  //! @param tree the tree
+  //! @param get_key_fn function to get the key of a node
+  //! @param key_buf array to store the keys in
+  //! @param node_buf array to store the node pointers in
+  //! @param capacity number of elements in key_buf and node_buf,
+  //!                 which must be greater than the number of
+  //!                 nodes in the tree
+  //! @return true if successful, false if the arrays are too small
+  bool build( const AATree< ActualNodeType > &tree, AATreeIntSnapshotImpl::GetKeyFn *get_key_fn,
+              int64_t *key_buf, AATreeNode **node_buf, size_t capacity ) {
+    return m_impl.build( tree.get_impl(), get_key_fn, key_buf, node_buf, capacity );
+  }
+
+  //! @return the number of nodes in the snapshot
+  size_t get_size() const { return m_impl.get_size(); }
+
+  //! Search for the node with the given key.
+  //! @param key the key
+  //! @return pointer to the node with the given key, or nullptr
+  //!         if there is no such node
+  ActualNodeType *find( int64_t key ) const {
+    return static_cast< ActualNodeType* >( m_impl.find( key ) );
+  }
+
+  //! Search for the nodes with the given keys.
+  //! @param keys array of keys
+  //! @param n number of keys
+  //! @param results array where the results are stored: results[i]
+  //!                is the node with key keys[i], or nullptr if
+  //!                there is no such node
+  void find_many( const int64_t *keys, size_t n, ActualNodeType **results ) const {
+    // (AA_TREE_FIND_MANY_GROUP is a multiple of 4, so each group
+    // is searched four keys at a time if possible)
+    AATreeNode *impl_results[ AA_TREE_FIND_MANY_GROUP ];
+
+    for ( size_t i = 0; i < n; i += AA_TREE_FIND_MANY_GROUP ) {
+      size_t count = n - i;
+      if ( count > size_t( AA_TREE_FIND_MANY_GROUP ) )
+        count = AA_TREE_FIND_MANY_GROUP;
+      m_impl.find_many( keys + i, count, impl_results );
+      for ( size_t j = 0; j < count; ++j )
+        results[ i + j ] = static_cast< ActualNodeType* >( impl_results[ j ] );
+    }
+  }
+};
+
+} // end namespace dslib
+
+#endif // DS_AATREESNAPSHOT_H
@@ -0,0 +1,160 @@
+// Copyright 2025, David H. Hovemeyer <david.hovemeyer@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// “Software”), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+// THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef DS_AATREESTATIC_H
+#define DS_AATREESTATIC_H
+
+#include <cstddef>
+#include <utility>
+#include "ds_aatree.h"
+
+namespace dslib {
+
+// A static tree is a read-only AA tree whose nodes, links and levels
+// are all computed at compile time from a sorted array of values, so
+// a constexpr static tree can be placed in read-only memory (in
+// .rodata, or .data.rel.ro for position-independent code), with no
+// work at all done at startup. The tree has the same shape as one
+// produced by AATree::build(), with the nodes stored in order in an
+// array, and it is searched and iterated over using the same code
+// as an AATree.
+//
+// The actual node type must have a constexpr constructor taking
+// the node's links (which it passes on to the AATreeNode
+// constructor) and a value, and, like all types of constexpr
+// objects, a trivial destructor. For example:
+//
+//   class Setting : public dslib::AATreeNode {
+//   public:
+//     struct Value { int key; int val; };
+//     constexpr Setting( const dslib::AATreeStaticLinks &links, const Value &v )
+//       : AATreeNode( links ), m_key( v.key ), m_val( v.val ) { }
+//     ...
+//   };
+//
+//   constexpr Setting::Value VALUES[] = { { 1, 100 }, { 4, 250 }, ... };
+//   constexpr dslib::AATreeStatic< Setting, 8 > SETTINGS( VALUES, &Setting::less_than_fn );
+
+//! Read-only balanced binary search tree built at compile time.
+//! @tparam ActualNodeType the actual tree node type, which needs
+//!         to derive from AATreeNode
+//! @tparam N the number of nodes
+template< typename ActualNodeType, size_t N >
+class AATreeStatic {
+  static_assert( N > 0, "an AATreeStatic must have at least one node" );
+
+private:
+  ActualNodeType m_nodes[ N ];
+  AATreeImpl::LessThanFn *m_less_than_fn;
+
+  NO_VALUE_SEMANTICS( AATreeStatic );
+
+public:
+  //! Constructor.
+  //! @tparam ValueType type of the values the nodes are constructed from
+  //! @param vals the values, which must be sorted in ascending order
+  //!             (according to less_than_fn), with no duplicates
+  //! @param less_than_fn function to compare two tree nodes to determine
+  //!                     whether the left node is less than the right node
+  template< typename ValueType >
+  constexpr AATreeStatic( const ValueType (&vals)[ N ], AATreeImpl::LessThanFn *less_than_fn )
+    : AATreeStatic( vals, less_than_fn, std::make_index_sequence< N >() )
+  { }
+
+  //! @return the number of nodes in the tree
+  constexpr size_t get_size() const { return N; }
+
+  //! Get the node at a given position in order.
+  //! @param i the position (less than N)
+  //! @return the node at position i
+  constexpr const ActualNodeType &operator[]( size_t i ) const { return m_nodes[ i ]; }
+
+  //! Search for a node in the tree comparing as equal to the given one.
+  //! @param node a node
+  //! @return pointer to a tree node equal to the given node,
+  //!         or nullptr if the tree does not contain a node equal to
+  //!         the given one
+  const ActualNodeType *find( const ActualNodeType &node ) const {
+    return static_cast< const ActualNodeType* >(
+      AATreeImpl::find_in_subtree( get_root(), node, m_less_than_fn ) );
+  }
+
+  //! Determine if the tree contains a node equal to the given one.
+  //! @param node a node
+  //! @return true if the tree contains a node equal to the given one,
+  //!         false otherwise
+  bool contains( const ActualNodeType &node ) const {
+    return find( node ) != nullptr;
+  }
+
+  //! Get an iterator positioned at the first (i.e., overall least) node.
+  //! @return an iterator positioned at the first (overall least) node
+  AATreeIter< const ActualNodeType > iterator() const {
+    return AATreeIter< const ActualNodeType >( AATreeImpl::subtree_iterator( get_root() ) );
+  }
+
+private:
+  template< typename ValueType, size_t... I >
+  constexpr AATreeStatic( const ValueType (&vals)[ N ], AATreeImpl::LessThanFn *less_than_fn,
+                          std::index_sequence< I... > )
+    : m_nodes{ ActualNodeType( links( I ), vals[ I ] )... }
+    , m_less_than_fn( less_than_fn )
+  { }
+
+  // The root of the range [begin, end) is its middle node (rounding
+  // down), at level floor(log2(end - begin + 1)), as in
+  // AATreeImpl::build_range()
+  static constexpr size_t mid( size_t begin, size_t end ) {
+    return begin + ( end - begin - 1 ) / 2;
+  }
+
+  static constexpr int level( size_t size ) {
+    int result = 0;
+    for ( size_t m = size + 1; m > 1; m >>= 1 )
+      ++result;
+    return result;
+  }
+
+  constexpr AATreeNode *link( size_t begin, size_t end ) {
+    return ( begin < end ) ? &m_nodes[ mid( begin, end ) ] : const_cast< AATreeNode* >( AATreeImpl::nil() );
+  }
+
+  // Find the range the node at position i is the root of,
+  // and link it to the roots of the two halves
+  constexpr AATreeStaticLinks links( size_t i ) {
+    size_t begin = 0, end = N;
+    while ( mid( begin, end ) != i ) {
+      if ( i < mid( begin, end ) )
+        end = mid( begin, end );
+      else
+        begin = mid( begin, end ) + 1;
+    }
+    return { link( begin, i ), link( i + 1, end ), level( end - begin ) };
+  }
+
+  AATreeNode *get_root() const {
+    return const_cast< ActualNodeType* >( &m_nodes[ mid( 0, N ) ] );
+  }
+};
+
+} // end namespace dslib
+
+#endif // DS_AATREESTATIC_H
@@ -0,0 +1,148 @@
+// Copyright 2025, David H. Hovemeyer <david.hovemeyer@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// “Software”), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+// THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef DS_ARENA_H
+#define DS_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include "ds_util.h"
+
+namespace dslib {
+
+// Arenas, for containers that are built, used for a while, and then
+// discarded all at once (for example, per request.) An arena
+// allocates objects by bumping a pointer through large chunks of
+// memory, and never frees objects individually: instead, reset()
+// releases everything allocated from the arena at once.
+//
+// To discard a container whose nodes are in an arena without visiting
+// each node, create it with AA_TREE_NO_FREE_ON_DESTROY (for an AATree)
+// or LIST_NO_FREE_ON_DESTROY (for a List), so that its destructor
+// doesn't call its free node function, and then reset (or destroy)
+// the arena. Arena::free_node_fn() can be used as the container's
+// free node function: it runs the node's destructor, but leaves its
+// memory in the arena.
+//
+// Chunks are 2 MiB by default (the usual size of a huge page on
+// x86-64.) With ARENA_HUGE_PAGES, chunks are allocated with mmap(),
+// aligned to 2 MiB, and the kernel is asked to back them with huge
+// pages (madvise(MADV_HUGEPAGE), where available), which can reduce
+// TLB misses when searching a large container. Arenas never throw
+// exceptions: if a chunk can't be allocated, allocation returns
+// nullptr. An arena is not thread safe.
+
+//! Default size of the chunks an arena allocates.
+const constexpr size_t ARENA_CHUNK_SIZE = 2 * 1024 * 1024;
+
+//! Arena option flag: back the chunks with huge pages if possible.
+const constexpr unsigned ARENA_HUGE_PAGES = 0x1;
+
+//! Bump-pointer arena.
+class Arena {
+private:
+  // Header at the start of each chunk
+  struct Chunk {
+    Chunk *next;
+    size_t size;
+  };
+
+  Chunk *m_chunks;
+  char *m_pos, *m_end;
+  size_t m_chunk_size;
+  bool m_huge_pages;
+  size_t m_bytes_allocated;
+
+  NO_VALUE_SEMANTICS( Arena );
+
+public:
+  //! Constructor. No memory is allocated until the first allocation.
+  //! @param chunk_size size of the chunks to allocate memory from
+  //!                   (larger allocations get a chunk of their own)
+  //! @param flags option flags: ARENA_HUGE_PAGES to back the chunks
+  //!              with huge pages if possible
+  explicit Arena( size_t chunk_size = ARENA_CHUNK_SIZE, unsigned flags = 0 );
+
+  //! Destructor: releases all of the arena's memory. Objects in the
+  //! arena aren't destroyed.
+  ~Arena();
+
+  //! Allocate memory.
+  //! @param size number of bytes to allocate
+  //! @param align required alignment (a power of 2)
+  //! @return the memory, or nullptr if it couldn't be allocated
+  void *alloc( size_t size, size_t align = alignof( std::max_align_t ) ) {
+    DS_ASSERT( align != 0 && ( align & ( align - 1 ) ) == 0 );
+    uintptr_t pos = ( reinterpret_cast< uintptr_t >( m_pos ) + align - 1 ) & ~uintptr_t( align - 1 );
+    uintptr_t end = reinterpret_cast< uintptr_t >( m_end );
+    if ( m_pos == nullptr || pos > end || size > end - pos )
+      return alloc_slow( size, align );
+    m_pos = reinterpret_cast< char* >( pos ) + size;
+    m_bytes_allocated += size;
+    return reinterpret_cast< void* >( pos );
+  }
+
+  //! Allocate and construct an object.
+  //! @tparam T the type of object
+  //! @param args the arguments to T's constructor
+  //! @return the object, or nullptr if memory couldn't be allocated
+  template< typename T, typename... Args >
+  T *create( Args&&... args ) {
+    void *p = alloc( sizeof( T ), alignof( T ) );
+    return ( p != nullptr ) ? new ( p ) T( std::forward< Args >( args )... ) : nullptr;
+  }
+
+  //! Release everything allocated from the arena, all at once. The
+  //! first chunk is kept, for reuse, and the others are freed.
+  //! Objects in the arena aren't destroyed, and any container whose
+  //! nodes are in the arena must have been destroyed (or must not be
+  //! used again.)
+  void reset();
+
+  //! @return the number of bytes allocated since the arena was
+  //!         created or last reset (not including alignment padding)
+  size_t get_bytes_allocated() const { return m_bytes_allocated; }
+
+  //! @return the number of chunks the arena has
+  size_t get_num_chunks() const;
+
+  //! Free node function for an AATree or List whose nodes are in an
+  //! arena: it destroys the node, but leaves its memory in the arena.
+  //! For example, `&Arena::free_node_fn< MyNode, AATreeNode >`.
+  //! @tparam T the actual node type
+  //! @tparam Base the node base class (AATreeNode or ListNode)
+  //! @param node the node to destroy
+  template< typename T, typename Base >
+  static void free_node_fn( Base *node ) {
+    static_cast< T* >( node )->~T();
+  }
+
+private:
+  void *alloc_slow( size_t size, size_t align );
+  Chunk *new_chunk( size_t size );
+  void free_chunk( Chunk *chunk );
+};
+
+} // end namespace dslib
+
+#endif // DS_ARENA_H
@@ -0,0 +1,168 @@
+// Copyright 2025, David H. Hovemeyer <david.hovemeyer@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// “Software”), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+// THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef DS_LATENCY_H
+#define DS_LATENCY_H
+
+// Latency histograms, for finding out how long individual container
+// operations take (averages hide the occasional slow insertion or
+// removal that rebalances all the way up the tree.) Like the
+// operation counters in ds_stats.h, they are only compiled in if
+// DSLIB_LATENCY is defined, which must be done when compiling both
+// the library and the code using it. Otherwise, DS_LATENCY() expands
+// to nothing. Even when they are compiled in, a container only has
+// histograms, and only times its operations, once enable_latency()
+// has been called on it.
+//
+// The histograms are log-linear, in the style of HdrHistogram: each
+// power of 2 range of latencies is divided into 16 equal buckets, so
+// a latency is recorded with a relative error of at most 1/16, and
+// recording one is a couple of relaxed atomic additions.
+
+#ifdef DSLIB_LATENCY
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include "ds_util.h"
+
+#define DS_LATENCY( stmt ) stmt
+
+namespace dslib {
+
+// Histogram geometry: values below 2^LATENCY_SUB_BITS nanoseconds
+// have a bucket each, and each power of 2 above that has
+// 2^(LATENCY_SUB_BITS-1) buckets. Values are clamped to
+// LATENCY_MAX_NS (about 18 minutes.)
+const int LATENCY_SUB_BITS = 5;
+const int LATENCY_MAX_BITS = 40;
+const uint64_t LATENCY_MAX_NS = ( uint64_t( 1 ) << LATENCY_MAX_BITS ) - 1;
+const int LATENCY_NUM_BUCKETS =
+  ( 1 << LATENCY_SUB_BITS ) + ( LATENCY_MAX_BITS - LATENCY_SUB_BITS ) * ( 1 << ( LATENCY_SUB_BITS - 1 ) );
+
+//! Snapshot of a LatencyHistogram. Snapshots are ordinary values,
+//! so they can be copied, kept, and merged (for example, to combine
+//! the histograms of several containers.)
+class LatencySnapshot {
+private:
+  uint64_t m_counts[ LATENCY_NUM_BUCKETS ];
+  uint64_t m_count, m_total_ns, m_min_ns, m_max_ns;
+
+  friend class LatencyHistogram;
+
+public:
+  //! Constructor: the snapshot is initially empty.
+  LatencySnapshot();
+
+  //! @return the number of latencies recorded
+  uint64_t get_count() const { return m_count; }
+
+  //! @return the shortest latency recorded, in nanoseconds
+  //!         (0 if none were recorded)
+  uint64_t get_min() const { return m_count > 0 ? m_min_ns : 0; }
+
+  //! @return the longest latency recorded, in nanoseconds
+  uint64_t get_max() const { return m_max_ns; }
+
+  //! @return the mean latency, in nanoseconds (0 if none were recorded)
+  double get_mean() const { return m_count > 0 ? double( m_total_ns ) / m_count : 0.0; }
+
+  //! Get the latency at the given percentile: the result is the
+  //! upper bound of the bucket containing it (but no more than the
+  //! longest latency recorded.)
+  //! @param percentile the percentile, from 0 to 100
+  //! @return the latency, in nanoseconds (0 if none were recorded)
+  uint64_t get_percentile( double percentile ) const;
+
+  //! Add the latencies recorded in another snapshot to this one.
+  //! @param other the other snapshot
+  void merge( const LatencySnapshot &other );
+
+  //! Get the bucket a latency is recorded in.
+  //! @param ns the latency, in nanoseconds
+  //! @return the bucket index
+  static int bucket_of( uint64_t ns );
+
+  //! Get the highest latency recorded in a bucket.
+  //! @param bucket the bucket index
+  //! @return the latency, in nanoseconds
+  static uint64_t bucket_upper_bound( int bucket );
+};
+
+//! Latency histogram. Buckets are updated with relaxed atomic
+//! operations, so that operations which only read a container (and
+//! so may be done by several threads at once) can record latencies.
+class LatencyHistogram {
+private:
+  std::atomic< uint64_t > m_counts[ LATENCY_NUM_BUCKETS ];
+  std::atomic< uint64_t > m_count, m_total_ns, m_min_ns, m_max_ns;
+
+  NO_VALUE_SEMANTICS( LatencyHistogram );
+
+public:
+  //! Constructor: the histogram is initially empty.
+  LatencyHistogram();
+
+  //! Record a latency.
+  //! @param ns the latency, in nanoseconds
+  void record( uint64_t ns );
+
+  //! @return a snapshot of the histogram
+  LatencySnapshot snapshot() const;
+
+  //! Reset the histogram, so that it is empty.
+  void reset();
+};
+
+//! Records the time between its construction and destruction in
+//! a LatencyHistogram (if it isn't null.)
+class LatencyTimer {
+private:
+  LatencyHistogram *m_histogram;
+  std::chrono::steady_clock::time_point m_start;
+
+  NO_VALUE_SEMANTICS( LatencyTimer );
+
+public:
+  explicit LatencyTimer( LatencyHistogram *histogram )
+    : m_histogram( histogram ) {
+    if ( m_histogram != nullptr )
+      m_start = std::chrono::steady_clock::now();
+  }
+
+  ~LatencyTimer() {
+    if ( m_histogram != nullptr ) {
+      auto elapsed = std::chrono::steady_clock::now() - m_start;
+      m_histogram->record( uint64_t( std::chrono::duration_cast< std::chrono::nanoseconds >( elapsed ).count() ) );
+    }
+  }
+};
+
+} // end namespace dslib
+
+#else
+
+#define DS_LATENCY( stmt )
+
+#endif
+
+#endif // DS_LATENCY_H
@@ -23,11 +23,40 @@
 #define DS_LIST_H
 
 #include "ds_util.h"
+#include "ds_stats.h"
+#include "ds_latency.h"
 
 namespace dslib {
 
 class ListImpl;
 
+//! List option flag: don't free the remaining nodes when the list
+//! is destroyed (for nodes in an Arena which will be reset as a
+//! whole: see ds_arena.h.)
+const constexpr unsigned LIST_NO_FREE_ON_DESTROY = 0x1;
+
+#ifdef DSLIB_STATS
+//! Snapshot of a List's operation counters (see List::get_stats())
+struct ListStats {
+  //! Nodes appended, prepended, or inserted
+  uint64_t insertions;
+  //! Nodes removed
+  uint64_t removals;
+  //! Nodes visited by traversals of the whole list (get_size())
+  uint64_t nodes_visited;
+};
+#endif
+
+#ifdef DSLIB_LATENCY
+//! Snapshot of a List's latency histograms (see List::get_latency())
+struct ListLatency {
+  //! Latencies of append(), prepend(), insert_before(), and insert_after()
+  LatencySnapshot insert;
+  //! Latencies of remove(), remove_first(), and remove_last()
+  LatencySnapshot remove;
+};
+#endif
+
 //! Intrusive list node base class.
 class ListNode {
 private:
@@ -68,16 +97,39 @@ public:
   //! Node free function type.
   typedef void FreeNodeFn( ListNode *node );
 
+  //! Node free function type, for functions which are also passed
+  //! a context pointer (the one given to the list's constructor.)
+  typedef void FreeNodeCtxFn( ListNode *node, void *ctx );
+
 private:
   FreeNodeFn *m_free_node_fn;
+  FreeNodeCtxFn *m_free_node_ctx_fn;
+  void *m_context;
+  bool m_free_on_destroy;
   // Fake head and tail nodes: same trick as lists in Pintos,
   // this eliminates special cases in insertions and deletions
   ListNode m_head, m_tail;
 
+#ifdef DSLIB_STATS
+  // Operation counters (see get_stats())
+  StatCounter m_insertions, m_removals;
+  mutable StatCounter m_nodes_visited;
+#endif
+
+#ifdef DSLIB_LATENCY
+  // Latency histograms (see get_latency()), allocated only when
+  // enabled by enable_latency()
+  struct Latencies {
+    LatencyHistogram insert, remove;
+  };
+  Latencies *m_latency;
+#endif
+
   NO_VALUE_SEMANTICS( ListImpl );
 
 public:
-  ListImpl( FreeNodeFn *free_node_fn );
+  ListImpl( FreeNodeFn *free_node_fn, unsigned flags = 0 );
+  ListImpl( FreeNodeCtxFn *free_node_fn, void *context, unsigned flags = 0 );
   ~ListImpl();
 
   bool is_empty() const;
@@ -94,6 +146,22 @@ public:
 
   ListNode *next( ListNode *node ) const;
   ListNode *prev( ListNode *node ) const;
+
+#ifdef DSLIB_STATS
+  ListStats get_stats() const;
+  void reset_stats();
+#endif
+
+#ifdef DSLIB_LATENCY
+  bool enable_latency();
+  void disable_latency();
+  bool is_latency_enabled() const { return m_latency != nullptr; }
+  ListLatency get_latency() const;
+  void reset_latency();
+#endif
+
+private:
+  void unlink( ListNode *node_to_remove );
 };
 
 //! List class, storing a sequence of nodes.
@@ -111,12 +179,23 @@ public:
   //! @param free_node_fn function to free a list node (called from
   //                      the destructor if the list is non-empty to
   //                      to free all remaining nodes)
-  List( ListImpl::FreeNodeFn *free_node_fn )
-    : m_impl( free_node_fn ) { }
+  //! @param flags option flags: LIST_NO_FREE_ON_DESTROY to leave the
+  //!              remaining nodes alone when the list is destroyed
+  List( ListImpl::FreeNodeFn *free_node_fn, unsigned flags = 0 )
+    : m_impl( free_node_fn, flags ) { }
+
+  //! Constructor for a free node function which takes a context pointer.
+  //! @param free_node_fn function to free a list node
+  //! @param context the context pointer passed to free_node_fn (for
+  //!                example, the Pool the nodes are allocated from:
+  //!                see Pool::free_node_ctx_fn())
+  //! @param flags option flags (as for the other constructor)
+  List( ListImpl::FreeNodeCtxFn *free_node_fn, void *context, unsigned flags = 0 )
+    : m_impl( free_node_fn, context, flags ) { }
   
   //! Destructor.
   //! Uses the list's free node function to delete any remaining
-  //! nodes.
+  //! nodes (unless the list was created with LIST_NO_FREE_ON_DESTROY.)
   ~List() { }
 
   //! Get the list node that follows the given one.
@@ -205,6 +284,39 @@ public:
   //! @return the number of nodes in the list (note that this involves
   //           an O(N) traversal of the list nodes)
   unsigned get_size() const { return m_impl.get_size(); }
+
+#ifdef DSLIB_STATS
+  //! Get a snapshot of the list's operation counters. (Only
+  //! available if DSLIB_STATS is defined.)
+  //! @return the counters
+  ListStats get_stats() const { return m_impl.get_stats(); }
+
+  //! Reset the list's operation counters to 0.
+  void reset_stats() { m_impl.reset_stats(); }
+#endif
+
+#ifdef DSLIB_LATENCY
+  //! Start recording the latencies of the list's operations. (Only
+  //! available if DSLIB_LATENCY is defined.) Until this is called,
+  //! operations aren't timed, and the list has no histograms.
+  //! @return true if successful, false if the histograms couldn't
+  //!         be allocated
+  bool enable_latency() { return m_impl.enable_latency(); }
+
+  //! Stop recording latencies, and discard the histograms.
+  void disable_latency() { m_impl.disable_latency(); }
+
+  //! @return true if latencies are being recorded
+  bool is_latency_enabled() const { return m_impl.is_latency_enabled(); }
+
+  //! Get a snapshot of the list's latency histograms (which are
+  //! empty if latencies aren't being recorded.)
+  //! @return the histograms
+  ListLatency get_latency() const { return m_impl.get_latency(); }
+
+  //! Reset the list's latency histograms, so that they are empty.
+  void reset_latency() { m_impl.reset_latency(); }
+#endif
 };
 
 } // end namespace dslib
@@ -0,0 +1,244 @@
+// Copyright 2025, David H. Hovemeyer <david.hovemeyer@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// “Software”), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+// THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef DS_POOL_H
+#define DS_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include "ds_util.h"
+#include "ds_list.h"
+
+namespace dslib {
+
+// Fixed-size object pools, for allocating the nodes of a container
+// without going through malloc for each one. Objects are carved out
+// of slabs (large, aligned blocks of memory), each of which keeps a
+// free list of its objects. A pool keeps its slabs on three lists:
+// partial (some objects free), full (no objects free), and empty
+// (all objects free). Objects are allocated from a partial slab if
+// there is one, then from an empty slab, and only then from a new
+// slab. A few empty slabs are kept for reuse, and the rest are
+// returned to malloc.
+//
+// Since slabs are aligned to their size, the slab (and the pool) an
+// object belongs to can be found from its address. This is what
+// allows Pool::free_node_fn() to be used as the free node function
+// of an AATree or List: it frees a node to whichever pool it came
+// from.
+//
+// Pools never throw exceptions: if a new slab can't be allocated,
+// allocation returns nullptr. A pool is not thread safe.
+//
+// The slab size is 64 KiB by default. To change it, define
+// DSLIB_POOL_SLAB_SIZE (which must be a power of 2) when compiling
+// both the library and the code using it.
+
+#ifndef DSLIB_POOL_SLAB_SIZE
+#define DSLIB_POOL_SLAB_SIZE 65536
+#endif
+
+//! Size (and alignment) of the slabs that pools allocate objects from.
+const constexpr size_t POOL_SLAB_SIZE = DSLIB_POOL_SLAB_SIZE;
+
+static_assert( ( POOL_SLAB_SIZE & ( POOL_SLAB_SIZE - 1 ) ) == 0, "DSLIB_POOL_SLAB_SIZE must be a power of 2" );
+
+//! Default maximum number of empty slabs a pool keeps for reuse.
+const constexpr size_t POOL_MAX_EMPTY_SLABS = 1;
+
+//! Minimum number of objects a slab must be able to hold: objects
+//! too large for this can't be allocated from a pool.
+const constexpr size_t POOL_MIN_OBJECTS_PER_SLAB = 8;
+
+class PoolImpl;
+
+//! Header at the start of each slab. (This is internal to the pool
+//! implementation.)
+class PoolSlab : public ListNode {
+private:
+  PoolImpl *m_pool;
+  // Free objects that have been allocated before
+  void *m_free;
+  // Number of free objects, including those never allocated
+  size_t m_num_free;
+  // Number of objects (at the end of the slab) never allocated
+  size_t m_num_unused;
+
+  NO_VALUE_SEMANTICS( PoolSlab );
+
+  friend class PoolImpl;
+
+public:
+  PoolSlab( PoolImpl *pool, size_t num_objects )
+    : m_pool( pool ), m_free( nullptr ), m_num_free( num_objects ), m_num_unused( num_objects ) { }
+};
+
+//! Pool implementation class.
+//! Don't use this directly: instead, use Pool, parametized with the
+//! type of object to allocate.
+class PoolImpl {
+private:
+  size_t m_object_size, m_first_offset, m_objects_per_slab;
+  size_t m_max_empty_slabs;
+  List< PoolSlab > m_partial, m_full, m_empty;
+  size_t m_num_slabs, m_num_empty_slabs, m_num_allocated;
+
+  NO_VALUE_SEMANTICS( PoolImpl );
+
+public:
+  PoolImpl( size_t object_size, size_t object_align, size_t max_empty_slabs = POOL_MAX_EMPTY_SLABS );
+  ~PoolImpl();
+
+  void *alloc();
+  void free( void *obj );
+  void release_empty_slabs();
+
+  //! Check whether objects of a given size and alignment are small
+  //! enough to be allocated from a pool.
+  //! @param object_size the object size
+  //! @param object_align the object alignment
+  //! @return true if a slab can hold POOL_MIN_OBJECTS_PER_SLAB of them
+  static constexpr bool can_hold( size_t object_size, size_t object_align ) {
+    return round_up( sizeof( PoolSlab ), object_align )
+         + POOL_MIN_OBJECTS_PER_SLAB * round_up( object_size, object_align ) <= POOL_SLAB_SIZE;
+  }
+
+  //! Get the pool an object was allocated from.
+  //! @param obj the object, which must have been allocated from a pool
+  //! @return the pool
+  static PoolImpl *owner_of( const void *obj ) {
+    return slab_of( obj )->m_pool;
+  }
+
+  size_t get_object_size() const { return m_object_size; }
+  size_t get_objects_per_slab() const { return m_objects_per_slab; }
+  size_t get_num_slabs() const { return m_num_slabs; }
+  size_t get_num_allocated() const { return m_num_allocated; }
+
+private:
+  static constexpr size_t round_up( size_t n, size_t align ) {
+    return ( n + align - 1 ) / align * align;
+  }
+
+  static PoolSlab *slab_of( const void *obj ) {
+    return reinterpret_cast< PoolSlab* >( reinterpret_cast< uintptr_t >( obj ) & ~uintptr_t( POOL_SLAB_SIZE - 1 ) );
+  }
+
+  void slab_emptied( PoolSlab *slab );
+  static void free_slab( ListNode *slab );
+};
+
+//! Pool of objects of a single type.
+//! @tparam T the type of object (for example, a tree or list node type)
+template< typename T >
+class Pool {
+private:
+  PoolImpl m_impl;
+
+  static_assert( PoolImpl::can_hold( sizeof( T ), alignof( T ) ),
+                 "objects are too large to allocate from a pool (see DSLIB_POOL_SLAB_SIZE)" );
+
+  NO_VALUE_SEMANTICS( Pool );
+
+public:
+  //! Constructor.
+  //! @param max_empty_slabs maximum number of empty slabs to keep
+  //!                        for reuse, rather than freeing them
+  explicit Pool( size_t max_empty_slabs = POOL_MAX_EMPTY_SLABS )
+    : m_impl( sizeof( T ), alignof( T ), max_empty_slabs ) { }
+
+  //! Destructor. All of the pool's slabs are freed, so any objects
+  //! still allocated from it become invalid (and aren't destroyed.)
+  ~Pool() { }
+
+  //! Allocate and construct an object.
+  //! @param args the arguments to T's constructor
+  //! @return the object, or nullptr if memory couldn't be allocated
+  template< typename... Args >
+  T *create( Args&&... args ) {
+    void *p = m_impl.alloc();
+    return ( p != nullptr ) ? new ( p ) T( std::forward< Args >( args )... ) : nullptr;
+  }
+
+  //! Destroy an object, and return its memory to this pool.
+  //! @param obj the object, which must have been allocated from
+  //!            this pool
+  void destroy( T *obj ) {
+    DS_ASSERT( PoolImpl::owner_of( obj ) == &m_impl );
+    obj->~T();
+    m_impl.free( obj );
+  }
+
+  //! Destroy an object, and return its memory to the pool it was
+  //! allocated from.
+  //! @param obj the object, which must have been allocated from a
+  //!            Pool< T >
+  static void destroy_pooled( T *obj ) {
+    obj->~T();
+    PoolImpl::owner_of( obj )->free( obj );
+  }
+
+  //! Free node function for an AATree or List whose nodes are
+  //! allocated from Pool< T > objects: for example,
+  //! `&Pool< MyNode >::free_node_fn< AATreeNode >`.
+  //! @tparam Base the node base class (AATreeNode or ListNode)
+  //! @param node the node to destroy and free
+  template< typename Base >
+  static void free_node_fn( Base *node ) {
+    destroy_pooled( static_cast< T* >( node ) );
+  }
+
+  //! Free node function for an AATree or List whose context pointer
+  //! is the Pool< T > its nodes are allocated from: for example,
+  //! `&Pool< MyNode >::free_node_ctx_fn< ListNode >`, with `&pool`
+  //! as the context. Unlike free_node_fn(), it doesn't need to find
+  //! each node's pool from the node's slab.
+  //! @tparam Base the node base class (AATreeNode or ListNode)
+  //! @param node the node to destroy and free
+  //! @param ctx the pool
+  template< typename Base >
+  static void free_node_ctx_fn( Base *node, void *ctx ) {
+    static_cast< Pool* >( ctx )->destroy( static_cast< T* >( node ) );
+  }
+
+  //! Free all of the empty slabs kept for reuse.
+  void release_empty_slabs() { m_impl.release_empty_slabs(); }
+
+  //! @return the size of each object's memory (sizeof(T), rounded
+  //!         up to a multiple of the object alignment)
+  size_t get_object_size() const { return m_impl.get_object_size(); }
+
+  //! @return the number of objects each slab holds
+  size_t get_objects_per_slab() const { return m_impl.get_objects_per_slab(); }
+
+  //! @return the number of slabs the pool has allocated (including
+  //!         empty slabs kept for reuse)
+  size_t get_num_slabs() const { return m_impl.get_num_slabs(); }
+
+  //! @return the number of objects currently allocated
+  size_t get_num_allocated() const { return m_impl.get_num_allocated(); }
+};
+
+} // end namespace dslib
+
+#endif // DS_POOL_H
@@ -0,0 +1,83 @@
+// Copyright 2025, David H. Hovemeyer <david.hovemeyer@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// “Software”), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+// THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef DS_STATS_H
+#define DS_STATS_H
+
+// Operation counters, for finding out where the time in a container
+// goes (comparisons, long descents, rebalancing). They are only
+// compiled in if DSLIB_STATS is defined, which must be done when
+// compiling both the library and the code using it, since it changes
+// the layout of the containers. Otherwise, DS_STAT() expands to
+// nothing, and the containers have no counters at all.
+
+#ifdef DSLIB_STATS
+
+#include <atomic>
+#include <cstdint>
+#include "ds_util.h"
+
+#define DS_STAT( stmt ) stmt
+
+namespace dslib {
+
+//! Operation counter. Counters are updated with relaxed atomic
+//! operations, so that operations which only read a container (and
+//! so may be done by several threads at once) can update them.
+class StatCounter {
+private:
+  std::atomic< uint64_t > m_count;
+
+  NO_VALUE_SEMANTICS( StatCounter );
+
+public:
+  //! Constructor.
+  StatCounter() : m_count( 0 ) { }
+
+  //! Add to the counter.
+  //! @param n the amount to add
+  void add( uint64_t n ) { m_count.fetch_add( n, std::memory_order_relaxed ); }
+
+  //! Raise the counter to the given value, if it is less (for
+  //! high-water marks.)
+  //! @param n the value to raise the counter to
+  void raise_to( uint64_t n ) {
+    uint64_t count = m_count.load( std::memory_order_relaxed );
+    while ( count < n && !m_count.compare_exchange_weak( count, n, std::memory_order_relaxed ) )
+      ;
+  }
+
+  //! @return the current value of the counter
+  uint64_t get() const { return m_count.load( std::memory_order_relaxed ); }
+
+  //! Reset the counter to 0.
+  void reset() { m_count.store( 0, std::memory_order_relaxed ); }
+};
+
+} // end namespace dslib
+
+#else
+
+#define DS_STAT( stmt )
+
+#endif
+
+#endif // DS_STATS_H
@@ -0,0 +1,299 @@
+// Copyright 2025, David H. Hovemeyer <david.hovemeyer@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// “Software”), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+// THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef DS_TRACE_H
+#define DS_TRACE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
+#include <vector>
+#include "ds_aatree.h"
+#include "ds_aatreeserial.h"
+#include "ds_list.h"
+
+namespace dslib {
+
+class ChunkWriter;
+class ChunkReader;
+
+// Operation traces. A TracedAATree or TracedList wraps a container,
+// and records each operation done through it (with the key it was
+// done with) in a trace, which can later be read back with a
+// TraceReader and replayed against any container (see
+// bench/trace_replay.cpp.) Traces are written and read in chunks
+// using the AATreeWriter and AATreeReader interfaces, like serialized
+// trees.
+//
+// Keys are encoded by a function supplied by the caller, with the
+// same conventions as the node encoding functions used to serialize
+// trees. The encoding can be the key itself, or (if keys are large
+// or sensitive) a hash of it. Replaying only depends on the order
+// of the encoded keys, compared bytewise (so integer keys should be
+// encoded big-endian if their order matters.)
+//
+// Format (integers are little-endian):
+//
+//   magic     8 bytes, "DSLTRACE"
+//   version   uint32 (currently 1)
+//   kind      uint32, the kind of container (a TraceKind)
+//   records   op (one byte, a TraceOp), time since the previous
+//             record in nanoseconds (unsigned LEB128), key length
+//             (unsigned LEB128), then the key (length bytes)
+//   end       one zero byte, then uint64 number of records, then
+//             uint64 FNV-1a hash of the records
+
+//! Version of the trace format written by TraceRecorder.
+const uint32_t TRACE_VERSION = 1;
+
+//! Kinds of container that can be traced.
+enum TraceKind {
+  TRACE_AATREE = 1,
+  TRACE_LIST = 2,
+};
+
+//! Traced operations. The key of a List operation is the key of the
+//! node inserted or removed.
+enum TraceOp {
+  TRACE_INSERT = 1,       //!< AATree::insert()
+  TRACE_FIND = 2,         //!< AATree::find() or AATree::contains()
+  TRACE_REMOVE = 3,       //!< AATree::remove(), AATree::remove_node(), or List::remove()
+  TRACE_APPEND = 4,       //!< List::append()
+  TRACE_PREPEND = 5,      //!< List::prepend()
+  TRACE_REMOVE_FIRST = 6, //!< List::remove_first()
+  TRACE_REMOVE_LAST = 7,  //!< List::remove_last()
+};
+
+//! Writes a trace to an AATreeWriter. A TraceRecorder is not thread
+//! safe: the container it records must only be used by one thread
+//! at a time.
+class TraceRecorder {
+public:
+  //! Type of function to encode the key of a List node (see
+  //! AATreeSerialImpl::EncodeNodeFn for the conventions.)
+  typedef size_t EncodeListNodeFn( const ListNode *node, void *buf, size_t size );
+
+private:
+  ChunkWriter *m_out;
+  std::vector< unsigned char > m_key;
+  std::chrono::steady_clock::time_point m_last;
+  uint64_t m_count, m_hash;
+  bool m_finished;
+
+  NO_VALUE_SEMANTICS( TraceRecorder );
+
+public:
+  //! Constructor. The trace's header is written immediately.
+  //! @param writer the AATreeWriter to write the trace to
+  //! @param kind the kind of container being traced
+  TraceRecorder( AATreeWriter &writer, TraceKind kind );
+
+  //! Destructor: finishes the trace, if finish() hasn't been called.
+  ~TraceRecorder();
+
+  //! Record an operation on an AATree.
+  //! @param op the operation
+  //! @param node the node (or key) the operation is done with
+  //! @param encode_fn function to encode the node's key
+  void record( TraceOp op, const AATreeNode *node, AATreeSerialImpl::EncodeNodeFn *encode_fn );
+
+  //! Record an operation on a List.
+  //! @param op the operation
+  //! @param node the node inserted or removed
+  //! @param encode_fn function to encode the node's key
+  void record( TraceOp op, const ListNode *node, EncodeListNodeFn *encode_fn );
+
+  //! @return the number of operations recorded
+  uint64_t get_count() const { return m_count; }
+
+  //! Finish the trace, by writing its end marker and flushing any
+  //! buffered data. No more operations can be recorded.
+  //! @return true if the whole trace was written successfully,
+  //!         false if there was a write error
+  bool finish();
+
+private:
+  void record_key( TraceOp op, size_t key_size );
+};
+
+//! One operation read from a trace.
+struct TraceRecord {
+  //! The operation
+  TraceOp op;
+  //! Time since the start of the trace, in nanoseconds
+  uint64_t time_ns;
+  //! The encoded key (valid until the next record is read)
+  const unsigned char *key;
+  //! Length of the encoded key
+  size_t key_size;
+};
+
+//! Reads a trace written by a TraceRecorder.
+class TraceReader {
+private:
+  ChunkReader *m_in;
+  std::vector< unsigned char > m_key;
+  TraceKind m_kind;
+  uint64_t m_time_ns, m_count, m_hash;
+  bool m_ok, m_done;
+
+  NO_VALUE_SEMANTICS( TraceReader );
+
+public:
+  //! Constructor. The trace's header is read immediately: if it is
+  //! invalid, is_valid() returns false, and no records can be read.
+  //! @param reader the AATreeReader to read the trace from
+  TraceReader( AATreeReader &reader );
+  ~TraceReader();
+
+  //! @return the kind of container the trace was recorded from
+  TraceKind get_kind() const { return m_kind; }
+
+  //! Read the next record.
+  //! @param rec the TraceRecord to store the record in
+  //! @return true if a record was read, false at the end of the
+  //!         trace, or if the trace is invalid
+  bool next( TraceRecord &rec );
+
+  //! Check whether the trace is valid. Once next() has returned
+  //! false, this is true only if the whole trace was read, and its
+  //! end marker (number of records and hash) matched the records.
+  //! @return true if the trace is valid (so far)
+  bool is_valid() const { return m_ok; }
+
+  //! @return true if the end of the trace has been reached
+  bool is_done() const { return m_done; }
+};
+
+//! Wrapper for an AATree which records the operations done through
+//! it. The wrapper doesn't own the tree or the recorder.
+//! @tparam ActualNodeType the actual tree node type
+template< typename ActualNodeType >
+class TracedAATree {
+private:
+  AATree< ActualNodeType > &m_tree;
+  TraceRecorder &m_recorder;
+  AATreeSerialImpl::EncodeNodeFn *m_encode_fn;
+
+  NO_VALUE_SEMANTICS( TracedAATree );
+
+public:
+  //! Constructor.
+  //! @param tree the tree
+  //! @param recorder the TraceRecorder (which should have been
+  //!                 created with TRACE_AATREE)
+  //! @param encode_fn function to encode the key of a node
+  TracedAATree( AATree< ActualNodeType > &tree, TraceRecorder &recorder,
+                AATreeSerialImpl::EncodeNodeFn *encode_fn )
+    : m_tree( tree ), m_recorder( recorder ), m_encode_fn( encode_fn ) { }
+
+  //! @return the tree
+  AATree< ActualNodeType > &get_tree() const { return m_tree; }
+
+  //! See AATree::insert().
+  bool insert( ActualNodeType *node ) {
+    m_recorder.record( TRACE_INSERT, node, m_encode_fn );
+    return m_tree.insert( node );
+  }
+
+  //! See AATree::find().
+  ActualNodeType *find( const ActualNodeType &node ) const {
+    m_recorder.record( TRACE_FIND, &node, m_encode_fn );
+    return m_tree.find( node );
+  }
+
+  //! See AATree::contains().
+  bool contains( const ActualNodeType &node ) const {
+    return find( node ) != nullptr;
+  }
+
+  //! See AATree::remove().
+  bool remove( const ActualNodeType &node ) {
+    m_recorder.record( TRACE_REMOVE, &node, m_encode_fn );
+    return m_tree.remove( node );
+  }
+
+  //! See AATree::remove_node().
+  void remove_node( ActualNodeType *node ) {
+    m_recorder.record( TRACE_REMOVE, node, m_encode_fn );
+    m_tree.remove_node( node );
+  }
+};
+
+//! Wrapper for a List which records the insertions and removals done
+//! through it. The wrapper doesn't own the list or the recorder.
+//! @tparam ActualNodeType the actual list node type
+template< typename ActualNodeType >
+class TracedList {
+private:
+  List< ActualNodeType > &m_list;
+  TraceRecorder &m_recorder;
+  TraceRecorder::EncodeListNodeFn *m_encode_fn;
+
+  NO_VALUE_SEMANTICS( TracedList );
+
+public:
+  //! Constructor.
+  //! @param list the list
+  //! @param recorder the TraceRecorder (which should have been
+  //!                 created with TRACE_LIST)
+  //! @param encode_fn function to encode the key of a node
+  TracedList( List< ActualNodeType > &list, TraceRecorder &recorder,
+              TraceRecorder::EncodeListNodeFn *encode_fn )
+    : m_list( list ), m_recorder( recorder ), m_encode_fn( encode_fn ) { }
+
+  //! @return the list
+  List< ActualNodeType > &get_list() const { return m_list; }
+
+  //! See List::append().
+  void append( ActualNodeType *node ) {
+    m_recorder.record( TRACE_APPEND, node, m_encode_fn );
+    m_list.append( node );
+  }
+
+  //! See List::prepend().
+  void prepend( ActualNodeType *node ) {
+    m_recorder.record( TRACE_PREPEND, node, m_encode_fn );
+    m_list.prepend( node );
+  }
+
+  //! See List::remove().
+  void remove( ActualNodeType *node ) {
+    m_recorder.record( TRACE_REMOVE, node, m_encode_fn );
+    m_list.remove( node );
+  }
+
+  //! See List::remove_first().
+  ActualNodeType *remove_first() {
+    m_recorder.record( TRACE_REMOVE_FIRST, m_list.get_first(), m_encode_fn );
+    return m_list.remove_first();
+  }
+
+  //! See List::remove_last().
+  ActualNodeType *remove_last() {
+    m_recorder.record( TRACE_REMOVE_LAST, m_list.get_last(), m_encode_fn );
+    return m_list.remove_last();
+  }
+};
+
+} // end namespace dslib
+
+#endif // DS_TRACE_H
@@ -28,6 +28,14 @@
   Type( const Type & ) = delete; \
   Type &operator=( const Type & ) = delete
 
+// Hint that the memory at the given address will be read soon.
+// This is a no-op for compilers that don't support it.
+#ifdef __GNUC__
+#define DS_PREFETCH( addr ) __builtin_prefetch( addr )
+#else
+#define DS_PREFETCH( addr )
+#endif
+
 #ifndef NDEBUG
 namespace dslib {
 
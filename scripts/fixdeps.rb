@@ -2,11 +2,16 @@
 
 # Fix automatic header dependencies output by g++ -M.
 # Specifically, change object file targets so that they are
-# in the "build" directory.
+# in the "build" directory. If an argument is given, it is
+# appended to the object file basenames (e.g., "_opt" for
+# the optimized objects used by the benchmarks.)
+
+suffix = ARGV.shift || ''
 
 STDIN.each_line do |line|
   if /^\S/.match(line)
     line = "build/#{line}"
+    line = line.sub(/\.o:/, "#{suffix}.o:")
   end
   print line
 end
@@ -20,7 +20,10 @@
 // THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include <cstdint>
+#include <new>
 #include "ds_aatree.h"
+#include "ds_aatreebalance.h"
+#include "ds_aatreecheck.h"
 
 namespace dslib {
 
@@ -28,29 +31,177 @@ namespace dslib {
 // AATreeImpl implementation
 ////////////////////////////////////////////////////////////////////////
 
-AATreeImpl::AATreeImpl( LessThanFn *less_than_fn, CopyNodeFn *copy_node_fn, FreeNodeFn *free_node_fn )
+AATreeNode AATreeImpl::s_nil( 0 );
+
+// Node access for the rebalancing operations (see ds_aatreebalance.h)
+class AATreeImpl::BalanceOps {
+private:
+  AATreeImpl *m_tree;
+
+public:
+  typedef AATreeNode Node;
+
+  explicit BalanceOps( AATreeImpl *tree ) : m_tree( tree ) { }
+
+  AATreeNode *nil() const { return &s_nil; }
+  AATreeNode *left( AATreeNode *t ) const { return t->get_left(); }
+  AATreeNode *right( AATreeNode *t ) const { return m_tree->right_of( t ); }
+  void set_left( AATreeNode *t, AATreeNode *child ) const { t->set_left( child ); }
+  void set_right( AATreeNode *t, AATreeNode *child ) const { t->set_right( child ); }
+  int level( AATreeNode *t ) const { return t->get_level(); }
+
+  void set_level( AATreeNode *t, int level ) const {
+    DS_STAT( if ( level < t->get_level() ) m_tree->m_stats.level_decrements.add( 1 ) );
+    t->set_level( level );
+  }
+
+  void clear_right( AATreeNode *t, AATreeNode *succ ) const {
+    if ( m_tree->m_threaded )
+      t->set_thread( succ );
+    else
+      t->set_right( &s_nil );
+  }
+
+  void rotated( AATreeNode *top, AATreeNode *t, AATreeNode *moved ) const {
+    // A skew moves t down to the right of top, and a split
+    // moves it down to the left
+    DS_STAT( ( top->get_left() == t ? m_tree->m_stats.splits : m_tree->m_stats.skews ).add( 1 ) );
+    if ( m_tree->m_parent_links ) {
+      m_tree->set_parent( top, get_parent( t ) );
+      m_tree->set_parent( t, top );
+      m_tree->set_parent( moved, t );
+    }
+  }
+};
+
+// The search loops count comparisons and nodes visited here, and
+// the counts are added to the tree's counters (if there is a tree)
+// when the operation is done, so the loops don't update shared
+// memory. Without DSLIB_STATS, this does nothing.
+class AATreeImpl::OpCounts {
+#ifdef DSLIB_STATS
+private:
+  const AATreeImpl *m_tree;
+  uint64_t m_comparisons, m_nodes_visited;
+  int m_path_depth;
+
+public:
+  explicit OpCounts( const AATreeImpl *tree )
+    : m_tree( tree ), m_comparisons( 0 ), m_nodes_visited( 0 ), m_path_depth( 0 ) { }
+
+  ~OpCounts() {
+    if ( m_tree == nullptr )
+      return;
+    Counters &stats = m_tree->m_stats;
+    stats.comparisons.add( m_comparisons );
+    stats.nodes_visited.add( m_nodes_visited );
+    if ( m_path_depth > 0 )
+      stats.max_path_depth.raise_to( uint64_t( m_path_depth ) );
+  }
+
+  bool less( const LessThan &less_than, const AATreeNode *left, const AATreeNode *right ) {
+    ++m_comparisons;
+    return less_than( left, right );
+  }
+
+  void visit() { ++m_nodes_visited; }
+
+  void path_depth( int depth ) {
+    if ( depth > m_path_depth )
+      m_path_depth = depth;
+  }
+#else
+public:
+  explicit OpCounts( const AATreeImpl * ) { }
+
+  bool less( const LessThan &less_than, const AATreeNode *left, const AATreeNode *right ) {
+    return less_than( left, right );
+  }
+
+  void visit() { }
+  void path_depth( int ) { }
+#endif
+
+  NO_VALUE_SEMANTICS( OpCounts );
+};
+
+AATreeImpl::AATreeImpl( LessThanFn *less_than_fn, CopyNodeFn *copy_node_fn, FreeNodeFn *free_node_fn, unsigned flags )
   : m_root( nullptr )
-  , m_less_than_fn( less_than_fn )
+  , m_less_than( less_than_fn )
   , m_copy_node_fn( copy_node_fn )
-  , m_free_node_fn( free_node_fn ) {
-  // The special level-0 "nil" node is pointed to by all
-  // "missing" level-1 links.
-  m_nil.set_level( 0 );
-  m_root = &m_nil;
+  , m_free_node_fn( free_node_fn )
+  , m_copy_node_ctx_fn( nullptr )
+  , m_free_node_ctx_fn( nullptr )
+  , m_context( nullptr )
+  , m_threaded( ( flags & AA_TREE_THREADED ) != 0 )
+  , m_parent_links( ( flags & AA_TREE_PARENT_LINKS ) != 0 )
+  , m_free_on_destroy( ( flags & AA_TREE_NO_FREE_ON_DESTROY ) == 0 )
+  , m_max_height( AA_TREE_MAX_HEIGHT ) {
+  // Threads and parent links can't be combined
+  DS_ASSERT( !( m_threaded && m_parent_links ) );
+  DS_LATENCY( m_latency = nullptr );
+
+  m_root = &s_nil;
+}
+
+AATreeImpl::AATreeImpl( LessThanCtxFn *less_than_fn, CopyNodeCtxFn *copy_node_fn, FreeNodeCtxFn *free_node_fn,
+                        void *context, unsigned flags )
+  : m_root( nullptr )
+  , m_less_than( less_than_fn, context )
+  , m_copy_node_fn( nullptr )
+  , m_free_node_fn( nullptr )
+  , m_copy_node_ctx_fn( copy_node_fn )
+  , m_free_node_ctx_fn( free_node_fn )
+  , m_context( context )
+  , m_threaded( ( flags & AA_TREE_THREADED ) != 0 )
+  , m_parent_links( ( flags & AA_TREE_PARENT_LINKS ) != 0 )
+  , m_free_on_destroy( ( flags & AA_TREE_NO_FREE_ON_DESTROY ) == 0 )
+  , m_max_height( AA_TREE_MAX_HEIGHT ) {
+  DS_ASSERT( !( m_threaded && m_parent_links ) );
+  DS_LATENCY( m_latency = nullptr );
+
+  m_root = &s_nil;
+}
+
+AATreeImpl::AATreeImpl( LessThanFn *less_than_fn, CopyNodeFn *copy_node_fn, FreeNodeCtxFn *free_node_fn,
+                        void *context, unsigned flags )
+  : m_root( nullptr )
+  , m_less_than( less_than_fn )
+  , m_copy_node_fn( copy_node_fn )
+  , m_free_node_fn( nullptr )
+  , m_copy_node_ctx_fn( nullptr )
+  , m_free_node_ctx_fn( free_node_fn )
+  , m_context( context )
+  , m_threaded( ( flags & AA_TREE_THREADED ) != 0 )
+  , m_parent_links( ( flags & AA_TREE_PARENT_LINKS ) != 0 )
+  , m_free_on_destroy( ( flags & AA_TREE_NO_FREE_ON_DESTROY ) == 0 )
+  , m_max_height( AA_TREE_MAX_HEIGHT ) {
+  DS_ASSERT( !( m_threaded && m_parent_links ) );
+  DS_LATENCY( m_latency = nullptr );
+
+  m_root = &s_nil;
 }
 
 AATreeImpl::~AATreeImpl() {
+  DS_LATENCY( delete m_latency );
+
+  // The nodes belong to an arena, which will free them all at once
+  if ( !m_free_on_destroy )
+    return;
+
   // It should be completely safe to delete the nodes in
   // postfix order (this should eliminate any possibility
   // of using a node after it has been deleted)
   AATreePostfixIterImpl it = postfix_iterator();
   while ( it.has_next() ) {
     AATreeNode *node = it.next();
-    m_free_node_fn( node );
+    free_node( node );
   }
 }
 
 bool AATreeImpl::insert( AATreeNode *node ) {
+  DS_LATENCY( LatencyTimer timer( m_latency != nullptr ? &m_latency->insert : nullptr ) );
+
   // The node should be in its initial state
   DS_ASSERT( node->get_left() == nullptr );
   DS_ASSERT( node->get_right() == nullptr );
@@ -60,43 +211,104 @@ bool AATreeImpl::insert( AATreeNode *node ) {
   AATreePtrStack< AATreeNode** > path;
   AATreeNode **link = &m_root;
 
+  // If the root is at the maximum level, check whether every
+  // pseudo-node on the path has two nodes: if so, the insertion
+  // would split all of them, and raise the level of the root.
+  // (Each pseudo-node is entered via its first node, which has
+  // a horizontal right link if there is a second node.)
+  bool check_full = ( m_root->get_level() >= m_max_height / 2 );
+  bool all_full = true;
+  int prev_level = 0;
+
+  OpCounts counts( this );
+
   // Find a place where we can attach the node being inserted
-  while ( *link != &m_nil ) {
+  while ( !is_empty_link( *link ) ) {
     path.push( link );
+    counts.visit();
+
+    if ( check_full && (*link)->get_level() != prev_level ) {
+      prev_level = (*link)->get_level();
+      if ( right_of( *link )->get_level() != prev_level )
+        all_full = false;
+    }
 
-    if ( m_less_than_fn( node, *link ) )
+    if ( counts.less( m_less_than, node, *link ) )
       link = (*link)->get_ptr_to_left();
     else {
-      if ( !m_less_than_fn( *link, node ) )
+      if ( !counts.less( m_less_than, *link, node ) )
         return false; // node compares as equal to an existing node
       link = (*link)->get_ptr_to_right();
     }
   }
+  counts.path_depth( path.get_size() );
+
+  if ( check_full && all_full )
+    return false; // the tree is as high as it is allowed to be
 
   // Attach the node
+  AATreeNode *empty_link = *link;
   *link = node;
 
   // Make the nil node the left and right child of the
   // inserted node
-  node->set_left( &m_nil );
-  node->set_right( &m_nil );
+  node->set_left( &s_nil );
+  node->set_right( &s_nil );
+
+  if ( m_parent_links )
+    set_parent( node, path.is_empty() ? nullptr : *path.top() );
+
+  if ( m_threaded ) {
+    // If the node is attached as a right child, it takes over
+    // its parent's thread. Otherwise, its parent (if any) is
+    // its successor.
+    if ( AATreeNode::is_thread( empty_link ) )
+      node->set_right( empty_link );
+    else
+      node->set_thread( path.is_empty() ? nullptr : *path.top() );
+  }
 
-  // Rebalance
+  // Rebalance. A parent only looks at the root of each child
+  // subtree, the root's right child, and their levels. During
+  // insertion, those change only when skew or split rotates the
+  // root of a subtree (a skew followed by a split can leave the
+  // original root on top, but one level higher). Once two
+  // consecutive subtrees on the path are unchanged, nothing above
+  // them can change, so we stop there rather than popping the rest
+  // of the path.
+  bool changed_below = true; // attaching the node changed its parent's subtree
   while ( !path.is_empty() ) {
     link = path.pop();
-    *link = skew( *link );
-    *link = split( *link );
+    AATreeNode *t = *link;
+    int level = t->get_level();
+    *link = split( skew( t ) );
+    bool changed = ( *link != t || t->get_level() != level );
+    if ( !changed && !changed_below )
+      break;
+    changed_below = changed;
   }
 
   return true;
 }
 
 AATreeNode *AATreeImpl::find( const AATreeNode &node ) const {
-  AATreeNode *p = m_root;
-  while ( p != &m_nil ) {
-    if ( m_less_than_fn( &node, p ) )
+  DS_LATENCY( LatencyTimer timer( m_latency != nullptr ? &m_latency->find : nullptr ) );
+  OpCounts counts( this );
+  return search( m_root, node, m_less_than, counts );
+}
+
+AATreeNode *AATreeImpl::find_in_subtree( AATreeNode *root, const AATreeNode &node, const LessThan &less_than ) {
+  OpCounts counts( nullptr );
+  return search( root, node, less_than, counts );
+}
+
+AATreeNode *AATreeImpl::search( AATreeNode *root, const AATreeNode &node, const LessThan &less_than, OpCounts &counts ) {
+  AATreeNode *p = root;
+  while ( !is_empty_link( p ) ) {
+    counts.visit();
+    if ( counts.less( less_than, &node, p ) )
       p = p->get_left();     // continue in left subtree
-    else if ( !m_less_than_fn( p, &node ) )
+    else if ( !counts.less( less_than, p, &node ) )
       return p;              // p is equal to the given node
     else
       p = p->get_right();    // continue in right subtree
@@ -104,33 +316,113 @@ AATreeNode *AATreeImpl::find( const AATreeNode &node ) const {
   return nullptr;            // search failed
 }
 
+void AATreeImpl::find_many( const AATreeNode *const *keys, size_t n, AATreeNode **results ) const {
+  // Current node of each search in the group, and the index
+  // (within the group) of the key each search is looking for.
+  // Searches that are still in progress are kept at the
+  // beginning of the arrays.
+  AATreeNode *cur[ AA_TREE_FIND_MANY_GROUP ];
+  int which[ AA_TREE_FIND_MANY_GROUP ];
+  OpCounts counts( this );
+
+  for ( size_t base = 0; base < n; base += AA_TREE_FIND_MANY_GROUP ) {
+    int active = AA_TREE_FIND_MANY_GROUP;
+    if ( n - base < size_t( active ) )
+      active = int( n - base );
+
+    for ( int i = 0; i < active; ++i ) {
+      cur[ i ] = m_root;
+      which[ i ] = i;
+    }
+
+    // Advance each search by one level per round. By the time a search
+    // gets its next turn, the node it prefetched has (hopefully) arrived.
+    while ( active > 0 ) {
+      for ( int i = 0; i < active; ) {
+        AATreeNode *p = cur[ i ];
+        const AATreeNode *key = keys[ base + which[ i ] ];
+        AATreeNode *next;
+
+        if ( is_empty_link( p ) ) {
+          results[ base + which[ i ] ] = nullptr; // search failed
+          next = nullptr;
+        } else {
+          counts.visit();
+          if ( counts.less( m_less_than, key, p ) ) {
+            next = p->get_left();
+          } else if ( !counts.less( m_less_than, p, key ) ) {
+            results[ base + which[ i ] ] = p;     // found a match
+            next = nullptr;
+          } else {
+            next = p->get_right();
+          }
+        }
+
+        if ( next == nullptr ) {
+          // This search is done, so move the last active search
+          // into its slot
+          --active;
+          cur[ i ] = cur[ active ];
+          which[ i ] = which[ active ];
+        } else {
+          DS_PREFETCH( next );
+          cur[ i ] = next;
+          ++i;
+        }
+      }
+    }
+  }
+}
+
 bool AATreeImpl::contains( const AATreeNode &node ) const {
   return find( node ) != nullptr;
 }
 
 bool AATreeImpl::remove( const AATreeNode &node ) {
+  DS_LATENCY( LatencyTimer timer( m_latency != nullptr ? &m_latency->remove : nullptr ) );
+
+  if ( m_parent_links ) {
+    // Removing by node keeps the other nodes where they are, rather
+    // than copying a victim node's contents, and the parent links
+    // take the place of the path stack
+    OpCounts counts( this );
+    AATreeNode *found = search( m_root, node, m_less_than, counts );
+    if ( found == nullptr )
+      return false;
+    unlink_node( found );
+    return true;
+  }
+
   // Keep track of pointers that may need to be updated
   AATreePtrStack< AATreeNode** > path;
   AATreeNode **link = &m_root;
+  bool right_link = false; // is link a right link?
+  OpCounts counts( this );
 
   // Find a node equal to the given one
-  while ( *link != &m_nil ) {
+  while ( !is_empty_link( *link ) ) {
     path.push( link );
+    counts.visit();
 
-    if ( m_less_than_fn( &node, *link ) )
+    if ( counts.less( m_less_than, &node, *link ) ) {
       // Node we're searching for is less than *link,
       // so continue in the left subtree
       link = (*link)->get_ptr_to_left();
-    else if ( !m_less_than_fn( *link, &node ) )
+      right_link = false;
+    } else if ( !counts.less( m_less_than, *link, &node ) )
        // *link is pointing to a matching node
       break;
-    else
+    else {
       // Node we're searching for is greater than the
       // current node, so continue in right subtree 
       link = (*link)->get_ptr_to_right();
+      right_link = true;
+    }
   }
 
-  if ( *link == &m_nil )
+  counts.path_depth( path.get_size() );
+
+  if ( is_empty_link( *link ) )
     return false;  // the tree doesn't contain a matching node
 
   // Refer to the node *link points to as "t". There are three cases:
@@ -143,61 +435,280 @@ bool AATreeImpl::remove( const AATreeNode &node ) {
   //    a "victim". The contents of the victim node are copied into
   //    t, and then the victim node is removed.
   AATreeNode *t = *link;
-  if ( t->get_left() == &m_nil && t->get_right() == &m_nil ) {
-    // Case 1
-    *link = &m_nil;
-    m_free_node_fn( t );
-  } else if ( t->get_left() == &m_nil ) {
-    // Case 2 (left subtree is empty)
-    *link = t->get_right();
-    m_free_node_fn( t );
-  } else if ( t->get_right() == &m_nil ) {
+  if ( t->get_left() == &s_nil || right_of( t ) == &s_nil ) {
+    // In cases 1 and 2, the subtree that replaces t (either empty,
+    // or a single level 1 node) needs no fixing up, so t's link
+    // is removed from the path
+    path.pop();
+  }
+
+  if ( t->get_left() == &s_nil ) {
+    // Case 1, or case 2 with an empty left subtree
+    *link = unlink_replacement( t, right_link );
+    free_node( t );
+  } else if ( right_of( t ) == &s_nil ) {
     // Case 2 (right subtree is empty)
     *link = t->get_left();
-    m_free_node_fn( t );
+    if ( m_threaded ) {
+      // t's predecessor (its left child) takes over its thread
+      t->get_left()->set_right( t->get_right() );
+    }
+    free_node( t );
   } else {
     // Case 3
     path.push( link );
 
     // Go to right subtree
     link = (*link)->get_ptr_to_right();
+    right_link = true;
 
     // Find the leftmost node in the subtree
-    while ( (*link)->get_left() != &m_nil ) {
+    while ( (*link)->get_left() != &s_nil ) {
       path.push( link );
+      counts.visit();
       link = (*link)->get_ptr_to_left();
+      right_link = false;
     }
+    counts.path_depth( path.get_size() );
 
     // Leftmost node in t's right subtree is the "victim"
     AATreeNode *victim = *link;
 
     // Copy the contents of the victim to the deleted node
-    m_copy_node_fn( victim, t );
+    copy_node( victim, t );
 
     // The subtree rooted by the victim node is replaced by the
     // victim node's right subtree.
-    DS_ASSERT( victim != &m_nil );
+    DS_ASSERT( victim != &s_nil );
     DS_ASSERT( victim->get_left() != nullptr );
     DS_ASSERT( victim->get_right() != nullptr );
-    *link = victim->get_right();
+    *link = unlink_replacement( victim, right_link );
 
     // Now we can delete the victim node
-    m_free_node_fn( victim );
+    free_node( victim );
   }
 
-  // Fix up all nodes
+  // Fix up the nodes on the path. As in insert(), we can stop once
+  // two consecutive subtrees on the path look the same to their
+  // parents as they did before the removal: same root, same right
+  // child of the root, and same levels for both.
+  bool changed_below = true; // the removal changed the bottom subtree
   while ( !path.is_empty() ) {
     link = path.pop();
-    adjust_level( *link );
-    *link = skew( *link );
-    *link = split( *link );
+    AATreeNode *t = *link;
+    AATreeNode *right = right_of( t );
+    int level = t->get_level(), right_level = right->get_level();
+
+    *link = rebalance( t );
+
+    bool changed = ( *link != t
+                     || t->get_level() != level
+                     || right_of( t ) != right
+                     || right->get_level() != right_level );
+    if ( !changed && !changed_below )
+      break;
+    changed_below = changed;
+  }
+
+  return true;
+}
+
+void AATreeImpl::set_max_height( int max_height ) {
+  DS_ASSERT( max_height >= 2 );
+  if ( max_height > AA_TREE_MAX_HEIGHT )
+    max_height = AA_TREE_MAX_HEIGHT;
+  m_max_height = max_height;
+}
+
+int AATreeImpl::max_height_for_size( size_t num_nodes ) {
+  // A tree whose root is at level L has at least 2^L - 1 nodes,
+  // so the root of a tree with num_nodes nodes is at most at
+  // level floor(log2(num_nodes + 1)), and the height is at most
+  // twice that. (An empty tree still needs room for one node.)
+  int level = 1;
+  while ( level < 63 && ( size_t( 1 ) << ( level + 1 ) ) - 1 <= num_nodes )
+    ++level;
+  return 2 * level;
+}
+
+void AATreeImpl::remove_node( AATreeNode *t ) {
+  DS_LATENCY( LatencyTimer timer( m_latency != nullptr ? &m_latency->remove : nullptr ) );
+  unlink_node( t );
+}
+
+// Remove a node from a tree with parent links
+void AATreeImpl::unlink_node( AATreeNode *t ) {
+  DS_ASSERT( m_parent_links );
+
+  // If t has two children, exchange it with its successor (the
+  // leftmost node in its right subtree), which has no left child.
+  // Then t has at most one child.
+  if ( t->get_left() != &s_nil && t->get_right() != &s_nil ) {
+    AATreeNode *succ = t->get_right();
+    while ( succ->get_left() != &s_nil )
+      succ = succ->get_left();
+    swap_with_successor( t, succ );
+  }
+
+  // Replace t with its only child (if any)
+  AATreeNode *parent = get_parent( t );
+  AATreeNode *child = ( t->get_left() != &s_nil ) ? t->get_left() : t->get_right();
+  *get_link_to( t ) = child;
+  set_parent( child, parent );
+  free_node( t );
+
+  // Fix up the nodes on the path to the root, stopping early as
+  // in remove()
+  bool changed_below = true;
+  while ( parent != nullptr ) {
+    AATreeNode *up = get_parent( parent );
+    AATreeNode **link = get_link_to( parent );
+
+    AATreeNode *right = parent->get_right();
+    int level = parent->get_level(), right_level = right->get_level();
+
+    *link = rebalance( parent );
+
+    bool changed = ( *link != parent
+                     || parent->get_level() != level
+                     || parent->get_right() != right
+                     || right->get_level() != right_level );
+    if ( !changed && !changed_below )
+      break;
+    changed_below = changed;
+    parent = up;
+  }
+}
+
+AATreeNode *AATreeImpl::successor( AATreeNode *node ) const {
+  DS_ASSERT( m_parent_links );
+
+  // Leftmost node in the right subtree, if there is one
+  if ( node->get_right() != &s_nil ) {
+    node = node->get_right();
+    while ( node->get_left() != &s_nil )
+      node = node->get_left();
+    return node;
+  }
+
+  // Otherwise, go up until we arrive from a left child
+  AATreeNode *parent = get_parent( node );
+  while ( parent != nullptr && node == parent->get_right() ) {
+    node = parent;
+    parent = get_parent( node );
+  }
+  return parent;
+}
+
+AATreeNode *AATreeImpl::predecessor( AATreeNode *node ) const {
+  DS_ASSERT( m_parent_links );
+
+  // Rightmost node in the left subtree, if there is one
+  if ( node->get_left() != &s_nil ) {
+    node = node->get_left();
+    while ( node->get_right() != &s_nil )
+      node = node->get_right();
+    return node;
+  }
+
+  // Otherwise, go up until we arrive from a right child
+  AATreeNode *parent = get_parent( node );
+  while ( parent != nullptr && node == parent->get_left() ) {
+    node = parent;
+    parent = get_parent( node );
+  }
+  return parent;
+}
+
+size_t AATreeImpl::get_size() const {
+  size_t count = 0;
+  AATreeIterImpl it = iterator();
+  while ( it.has_next() ) {
+    it.next();
+    ++count;
+  }
+  return count;
+}
+
+size_t AATreeImpl::relayout( void *buf, size_t node_size, size_t capacity, RelocateNodeFn *relocate_fn ) {
+  if ( m_root == &s_nil || capacity == 0 )
+    return 0;
+
+  // The buffer itself serves as the queue for the breadth-first
+  // traversal: the node in slot i has already been moved, and
+  // its children are moved into the next free slots. So, no
+  // recursion and no auxiliary storage are needed.
+  char *base = static_cast< char* >( buf );
+  m_root = relocate( m_root, base, relocate_fn );
+  if ( m_parent_links )
+    set_parent( m_root, nullptr );
+
+  // The offset of the AATreeNode within the actual node type is the
+  // same for every node, so it can be determined from the first
+  // relocated node
+  ptrdiff_t offset = reinterpret_cast< char* >( m_root ) - base;
+
+  size_t count = 1;
+  for ( size_t i = 0; i < count; ++i ) {
+    AATreeNode *t = reinterpret_cast< AATreeNode* >( base + i*node_size + offset );
+
+    AATreeNode *left = t->get_left();
+    if ( left != &s_nil && count < capacity ) {
+      t->set_left( relocate( left, base + count*node_size, relocate_fn ) );
+      ++count;
+    }
+
+    AATreeNode *right = right_of( t );
+    if ( right != &s_nil && count < capacity ) {
+      t->set_right( relocate( right, base + count*node_size, relocate_fn ) );
+      ++count;
+    }
+
+    // Children (whether moved or not) need to point to t's new location
+    if ( m_parent_links ) {
+      set_parent( t->get_left(), t );
+      set_parent( t->get_right(), t );
+    }
+  }
+
+  // Threads still point to where the relocated nodes used to be
+  if ( m_threaded )
+    rethread();
+
+  return count;
+}
+
+bool AATreeImpl::build( const void *nodes, size_t n, NodeAtFn *node_at_fn ) {
+  if ( !can_build( nodes, n, node_at_fn ) )
+    return false;
+
+  if ( n > 0 ) {
+    BuildRange range = { 0, n, &m_root, nullptr };
+    build_range( nodes, n, node_at_fn, range, -1, nullptr, nullptr );
   }
+  return true;
+}
 
+bool AATreeImpl::set_op( SetOp op, AATreeImpl &other ) {
+  if ( !can_set_op( op, other ) )
+    return false;
+  finish_set_op( other, set_op_subtrees( op, m_root, other.m_root ) );
   return true;
 }
 
 AATreeIterImpl AATreeImpl::iterator() const {
+  return subtree_iterator( m_root );
+}
+
+AATreeIterImpl AATreeImpl::subtree_iterator( AATreeNode *root ) {
   AATreeIterImpl it;
+  it.init( root );
+  return it;
+}
+
+AATreeThreadedIterImpl AATreeImpl::threaded_iterator() const {
+  DS_ASSERT( m_threaded );
+  AATreeThreadedIterImpl it;
   it.init( this );
   return it;
 }
@@ -208,146 +719,574 @@ AATreePostfixIterImpl AATreeImpl::postfix_iterator() const {
   return it;
 }
 
-AATreeNode *AATreeImpl::skew( AATreeNode *t ) {
-  if ( t == &m_nil )
-    return &m_nil;
+AATreeFingerImpl AATreeImpl::finger() const {
+  AATreeFingerImpl f;
+  f.init( this );
+  return f;
+}
 
-  AATreeNode *left = t->get_left();
+#ifdef DSLIB_STATS
+AATreeStats AATreeImpl::get_stats() const {
+  AATreeStats stats;
+  stats.comparisons = m_stats.comparisons.get();
+  stats.nodes_visited = m_stats.nodes_visited.get();
+  stats.skews = m_stats.skews.get();
+  stats.splits = m_stats.splits.get();
+  stats.level_decrements = m_stats.level_decrements.get();
+  stats.max_path_depth = m_stats.max_path_depth.get();
+  return stats;
+}
 
-  if ( left == &m_nil )
-    return t;
+void AATreeImpl::reset_stats() {
+  m_stats.comparisons.reset();
+  m_stats.nodes_visited.reset();
+  m_stats.skews.reset();
+  m_stats.splits.reset();
+  m_stats.level_decrements.reset();
+  m_stats.max_path_depth.reset();
+}
+#endif
+
+#ifdef DSLIB_LATENCY
+bool AATreeImpl::enable_latency() {
+  if ( m_latency == nullptr )
+    m_latency = new ( std::nothrow ) Latencies;
+  return m_latency != nullptr;
+}
 
-  if ( t->get_level() == left->get_level() ) {
-    // t has a left child at the same level, so the left child  //
-    // becomes the new root of this subtree, and t becomes its  //
-    // right child.                                             //
-    //                                                          //
-    //            |             |                               //
-    //            v             v                               //
-    //   left <-- t            left -->  t                      //
-    //  /   \      \   ==>    /         / \                     //
-    // A     B      R        A         B   R                    //
-    t->set_left( left->get_right() );
-    left->set_right( t );
-    return left;
+void AATreeImpl::disable_latency() {
+  delete m_latency;
+  m_latency = nullptr;
+}
+
+AATreeLatency AATreeImpl::get_latency() const {
+  AATreeLatency latency;
+  if ( m_latency != nullptr ) {
+    latency.find = m_latency->find.snapshot();
+    latency.insert = m_latency->insert.snapshot();
+    latency.remove = m_latency->remove.snapshot();
   }
+  return latency;
+}
 
-  return t;
+void AATreeImpl::reset_latency() {
+  if ( m_latency == nullptr )
+    return;
+  m_latency->find.reset();
+  m_latency->insert.reset();
+  m_latency->remove.reset();
 }
+#endif
 
-AATreeNode *AATreeImpl::split( AATreeNode *t ) {
-  if ( t == &m_nil )
-    return &m_nil;
-
-  AATreeNode *right = t->get_right();
-
-  if ( right == &m_nil )
-    return t;
-
-  AATreeNode *x = right->get_right();
-
-  if ( x == &m_nil )
-    return t;
-
-  if ( t->get_level() == x->get_level() ) {
-    // There are two horizontal right links, so t's right node  //
-    // needs to be pulled up.                                   //
-    //                                                          //
-    //      |                              |                    //
-    //      v                              v                    //
-    //      t -->  right --> x  ==>      right                  //
-    //     /      /                     /     \                 //
-    //    A      B                     t       x                //
-    //                                / \                       //
-    //                               A   B                      //
-    t->set_right( right->get_left() );
-    right->set_left( t );
-    right->set_level( right->get_level() + 1 );
-    return right;
+AATreeNode *AATreeImpl::unlink_replacement( AATreeNode *t, bool right_link ) {
+  // t has no left child, so when it is removed, its right child
+  // (if any) takes its place. If t has a thread instead, the link
+  // to t becomes empty, but a right link keeps the thread, since
+  // t's predecessor (the parent) now has t's successor.
+  DS_ASSERT( t->get_left() == &s_nil );
+  if ( t->has_thread() && !right_link )
+    return &s_nil;
+  return t->get_right();
+}
+
+void AATreeImpl::rethread() {
+  // Set each node's thread (if it has no right child) to the
+  // next node in order
+  AATreeNode *prev = nullptr;
+  AATreeIterImpl it = iterator();
+  while ( it.has_next() ) {
+    AATreeNode *node = it.next();
+    if ( prev != nullptr && right_of( prev ) == &s_nil )
+      prev->set_thread( node );
+    prev = node;
   }
+  if ( prev != nullptr )
+    prev->set_thread( nullptr );
+}
 
-  return t;
+AATreeNode **AATreeImpl::get_link_to( AATreeNode *node ) {
+  AATreeNode *parent = get_parent( node );
+  if ( parent == nullptr )
+    return &m_root;
+  return ( parent->get_left() == node ) ? parent->get_ptr_to_left() : parent->get_ptr_to_right();
+}
+
+void AATreeImpl::swap_with_successor( AATreeNode *t, AATreeNode *succ ) {
+  // succ is the leftmost node in t's right subtree. Exchange the
+  // positions (links, levels, and parents) of t and succ.
+  DS_ASSERT( succ->get_left() == &s_nil );
+
+  AATreeNode **t_link = get_link_to( t );
+  AATreeNode *t_parent = get_parent( t ), *succ_parent = get_parent( succ );
+  AATreeNode *t_left = t->get_left(), *t_right = t->get_right();
+  AATreeNode *succ_right = succ->get_right();
+  int t_level = t->get_level();
+
+  *t_link = succ;
+  set_parent( succ, t_parent );
+  succ->set_left( t_left );
+  set_parent( t_left, succ );
+  t->set_level( succ->get_level() );
+  succ->set_level( t_level );
+
+  t->set_left( &s_nil );
+  t->set_right( succ_right );
+  set_parent( succ_right, t );
+
+  if ( t_right == succ ) {
+    // succ was t's right child
+    succ->set_right( t );
+    set_parent( t, succ );
+  } else {
+    succ_parent->set_left( t );
+    set_parent( t, succ_parent );
+    succ->set_right( t_right );
+    set_parent( t_right, succ );
+  }
+}
+
+AATreeNode *AATreeImpl::skew( AATreeNode *t ) {
+  return AATreeBalance< BalanceOps >::skew( BalanceOps( this ), t );
+}
+
+AATreeNode *AATreeImpl::split( AATreeNode *t ) {
+  return AATreeBalance< BalanceOps >::split( BalanceOps( this ), t );
+}
+
+AATreeNode *AATreeImpl::relocate( AATreeNode *node, void *to, RelocateNodeFn *relocate_fn ) {
+  // The relocation function is allowed to dispose of the original
+  // node, so save its links and level first
+  AATreeNode *left = node->get_left(), *right = node->get_right();
+  int level = node->get_level();
+
+  AATreeNode *moved = relocate_fn( node, to );
+  moved->set_left( left );
+  moved->set_right( right );
+  moved->set_level( level );
+  return moved;
 }
 
 void AATreeImpl::adjust_level( AATreeNode *t ) {
-  if ( t == &m_nil )
-    return;
+  AATreeBalance< BalanceOps >::adjust_level( BalanceOps( this ), t );
+}
 
-  // From Andersson's paper (p.3, "Deletion"):
-  //   "If a pseudo-node is missing below p, i.e. if one of
-  //   p's children is two levels below p, decrease the level of
-  //   p by 1. If p's right child belonged to the same
-  //   pseudo-node as p, we decrease the level of that node too."
+AATreeNode *AATreeImpl::rebalance( AATreeNode *t ) {
+  return AATreeBalance< BalanceOps >::rebalance( BalanceOps( this ), t );
+}
 
-  DS_ASSERT( t->get_left() != nullptr );
-  DS_ASSERT( t->get_right() != nullptr );
+bool AATreeImpl::can_build( const void *nodes, size_t n, NodeAtFn *node_at_fn ) const {
+  if ( m_root != &s_nil )
+    return false;
 
-  AATreeNode *left = t->get_left(), *right = t->get_right();
+  // The built tree is perfectly balanced, so its height is the
+  // number of bits needed to represent n
+  int height = 0;
+  for ( size_t m = n; m > 0; m >>= 1 )
+    ++height;
+  if ( height > m_max_height )
+    return false;
 
-  int t_level = t->get_level(),
-      l_level = left->get_level(),
-      r_level = right->get_level();
-  
-  bool r_at_same_level = ( t_level == r_level );
+#ifdef DSLIB_CHECK_INTEGRITY
+  for ( size_t i = 1; i < n; ++i )
+    DS_ASSERT( m_less_than( node_at_fn( nodes, i - 1 ), node_at_fn( nodes, i ) ) );
+#endif
+
+  return true;
+}
 
-  if ( l_level == t_level-2 || r_level == t_level-2 ) {
-    t->set_level( t_level - 1 );
-    if ( r_at_same_level )
-      right->set_level( t_level - 1 );
+void AATreeImpl::build_range( const void *nodes, size_t n, NodeAtFn *node_at_fn, const BuildRange &range,
+                              int cut_depth, DeferRangeFn *defer_fn, void *ctx ) {
+  // The root of each (nonempty) range is its middle node, rounding
+  // down, so the right subtree is never smaller than the left. The
+  // level of a subtree's root is floor(log2(size + 1)). This makes
+  // the left child exactly one level lower, and the right child at
+  // most one level lower. If the right child is at the same level,
+  // the right subtree is a perfect tree, so its own right child is
+  // one level lower. So the result is a valid AA tree.
+  struct Frame {
+    BuildRange range;
+    int depth;
+  };
+
+  // Each step replaces the frame at the top of the stack with (at
+  // most) its two children, so there is at most one pending frame
+  // per level of the tree, plus one
+  Frame stack[ AA_TREE_MAX_HEIGHT + 1 ];
+  int top = 0;
+  stack[ top++ ] = { range, 0 };
+
+  while ( top > 0 ) {
+    Frame f = stack[ --top ];
+    if ( f.depth == cut_depth ) {
+      defer_fn( ctx, f.range );
+      continue;
+    }
+
+    size_t size = f.range.end - f.range.begin;
+    DS_ASSERT( size > 0 );
+    size_t mid = f.range.begin + ( size - 1 ) / 2;
+
+    AATreeNode *t = node_at_fn( nodes, mid );
+    t->set_level( 63 - __builtin_clzll( (unsigned long long) size + 1 ) );
+    *f.range.link = t;
+    if ( m_parent_links )
+      set_parent( t, f.range.parent );
+
+    if ( mid + 1 < f.range.end ) {
+      DS_ASSERT( top < AA_TREE_MAX_HEIGHT + 1 );
+      stack[ top++ ] = { { mid + 1, f.range.end, t->get_ptr_to_right(), t }, f.depth + 1 };
+    } else if ( m_threaded ) {
+      t->set_thread( f.range.end < n ? node_at_fn( nodes, f.range.end ) : nullptr );
+    } else {
+      t->set_right( &s_nil );
+    }
+
+    if ( mid > f.range.begin ) {
+      DS_ASSERT( top < AA_TREE_MAX_HEIGHT + 1 );
+      stack[ top++ ] = { { f.range.begin, mid, t->get_ptr_to_left(), t }, f.depth + 1 };
+    } else {
+      t->set_left( &s_nil );
+    }
   }
 }
 
-#ifdef DSLIB_CHECK_INTEGRITY
-bool AATreeImpl::is_valid( AATreeNode *node, int expected_level ) const {
-  if ( node == &m_nil )
+bool AATreeImpl::can_set_op( SetOp op, const AATreeImpl &other ) const {
+  // The other tree's nodes become part of this tree (or are freed
+  // using this tree's free function), and threads aren't maintained
+  if ( &other == this
+       || !( other.m_less_than == m_less_than )
+       || other.m_free_node_fn != m_free_node_fn
+       || other.m_free_node_ctx_fn != m_free_node_ctx_fn
+       || other.m_context != m_context
+       || other.m_parent_links != m_parent_links
+       || m_threaded || other.m_threaded )
+    return false;
+
+  // The result has at most n + m nodes (for a union) or n nodes
+  // (otherwise), and the root of a tree with s nodes is at most at
+  // level floor(log2(s + 1)), so the result (and every intermediate
+  // result) stays within the maximum height if the bound on its
+  // size is less than 2^(max level + 1) - 1. A tree whose root is
+  // at level L has at most 3^L - 1 nodes, which usually settles it
+  // without counting the nodes.
+  int max_level = m_max_height / 2;
+  size_t limit = ( size_t( 1 ) << ( max_level + 1 ) ) - 1;
+  auto max_size = []( const AATreeNode *root ) {
+    size_t size = 1;
+    for ( int level = root->get_level(); level > 0; --level ) {
+      if ( size > SIZE_MAX / 3 )
+        return SIZE_MAX;
+      size *= 3;
+    }
+    return size - 1;
+  };
+  size_t bound = max_size( m_root );
+  if ( op == SET_UNION )
+    bound = ( bound < SIZE_MAX - max_size( other.m_root ) ) ? bound + max_size( other.m_root ) : SIZE_MAX;
+  if ( bound < limit )
     return true;
 
-  AATreeNode *left = node->get_left(), *right = node->get_right();
+  // Count the nodes (but only up to the limit)
+  size_t size = count_nodes( m_root, limit );
+  if ( op == SET_UNION && size < limit )
+    size += count_nodes( other.m_root, limit - size );
+  return size < limit;
+}
 
-  // True leaf nodes must be at level 1
-  if ( left == &m_nil && right == &m_nil )
-    return node->get_level() == 1;
+size_t AATreeImpl::count_nodes( AATreeNode *root, size_t limit ) {
+  size_t count = 0;
+  AATreeIterImpl it = subtree_iterator( root );
+  while ( count < limit && it.has_next() ) {
+    it.next();
+    ++count;
+  }
+  return count;
+}
 
-  // If there is a left child, it must compare as less than this node
-  // and it must be at the next lower level
-  if ( left != &m_nil ) {
-    if ( !is_valid( left, expected_level - 1 ) )
-      return false;
-    if ( !m_less_than_fn( left, node ) )
-      return false;
+bool AATreeImpl::set_op_divide( SetOp op, AATreeNode *t1, AATreeNode *t2, SetOpSplit &s, AATreeNode *&result ) {
+  // Base cases: one of the subtrees is empty
+  if ( t1 == &s_nil || t2 == &s_nil ) {
+    if ( op == SET_UNION ) {
+      result = ( t1 == &s_nil ) ? t2 : t1;
+    } else if ( op == SET_INTERSECTION ) {
+      free_subtree( t1 );
+      free_subtree( t2 );
+      result = &s_nil;
+    } else {
+      free_subtree( t2 );
+      result = t1;
+    }
+    return true;
+  }
+
+  // Split t1 by the root of t2
+  AATreeNode *k = t2;
+  s.left2 = k->get_left();
+  s.right2 = k->get_right();
+  AATreeNode *dup = split_at( t1, k, s.left1, s.right1 );
+
+  // The node from t1 is kept in preference to the equal one from t2
+  if ( op == SET_UNION ) {
+    s.pivot = k;
+    if ( dup != nullptr ) {
+      free_node( k );
+      s.pivot = dup;
+    }
+  } else if ( op == SET_INTERSECTION ) {
+    free_node( k );
+    s.pivot = dup;
+  } else {
+    free_node( k );
+    if ( dup != nullptr )
+      free_node( dup );
+    s.pivot = nullptr;
   }
 
-  if ( right == &m_nil )
-    return true; // no right subtree
+  return false;
+}
 
-  // Right child must compare as greater than this node
-  if ( !m_less_than_fn( node, right ) )
-    return false;
+AATreeNode *AATreeImpl::set_op_combine( const SetOpSplit &s, AATreeNode *left, AATreeNode *right ) {
+  return ( s.pivot != nullptr ) ? join( left, s.pivot, right ) : join2( left, right );
+}
 
-  // Right child could be a level below the parent
-  if ( right->get_level() == expected_level - 1 )
-    return is_valid( right, expected_level - 1 );
-  else {
-    // Right node should be at same level as parent
-    // (i.e., part of the same pseudo-node)
-    if ( right->get_level() != expected_level )
-      return false;
+AATreeNode *AATreeImpl::set_op_subtrees( SetOp op, AATreeNode *t1, AATreeNode *t2 ) {
+  // The recursive algorithm is evaluated using an explicit stack
+  // of steps: dividing a pair of subtrees pushes the step that
+  // combines their results, followed by the steps that divide the
+  // right and left halves. Each step's result is pushed onto a
+  // stack of results, so when a combine step is reached, the
+  // results for its left and right halves are on top. Each division
+  // descends one level in t2, so the depth is at most t2's height.
+  struct Step {
+    AATreeNode *t1, *t2;
+    AATreeNode *pivot;
+    bool combine;
+  };
+  Step steps[ 2*AA_TREE_MAX_HEIGHT + 2 ];
+  AATreeNode *results[ AA_TREE_MAX_HEIGHT + 2 ];
+  int num_steps = 0, num_results = 0;
+
+  steps[ num_steps++ ] = { t1, t2, nullptr, false };
+  while ( num_steps > 0 ) {
+    Step step = steps[ --num_steps ];
+    if ( step.combine ) {
+      AATreeNode *right = results[ --num_results ];
+      AATreeNode *left = results[ --num_results ];
+      SetOpSplit s = { nullptr, nullptr, nullptr, nullptr, step.pivot };
+      results[ num_results++ ] = set_op_combine( s, left, right );
+      continue;
+    }
+
+    SetOpSplit s;
+    AATreeNode *result;
+    if ( set_op_divide( op, step.t1, step.t2, s, result ) ) {
+      DS_ASSERT( num_results < AA_TREE_MAX_HEIGHT + 2 );
+      results[ num_results++ ] = result;
+    } else {
+      DS_ASSERT( num_steps + 3 <= 2*AA_TREE_MAX_HEIGHT + 2 );
+      steps[ num_steps++ ] = { nullptr, nullptr, s.pivot, true };
+      steps[ num_steps++ ] = { s.right1, s.right2, nullptr, false };
+      steps[ num_steps++ ] = { s.left1, s.left2, nullptr, false };
+    }
+  }
+
+  DS_ASSERT( num_results == 1 );
+  return results[ 0 ];
+}
+
+void AATreeImpl::finish_set_op( AATreeImpl &other, AATreeNode *root ) {
+  m_root = root;
+  if ( m_parent_links )
+    set_parent( m_root, nullptr );
+  other.m_root = &s_nil;
+}
 
-    // If the right child has a right child, it must be one level below
-    if ( right->get_right() != nullptr )
-      if ( right->get_right()->get_level() != expected_level - 1 )
-        return false;
+void AATreeImpl::link_left( AATreeNode *t, AATreeNode *left ) {
+  t->set_left( left );
+  if ( m_parent_links )
+    set_parent( left, t );
+}
+
+void AATreeImpl::link_right( AATreeNode *t, AATreeNode *right ) {
+  t->set_right( right );
+  if ( m_parent_links )
+    set_parent( right, t );
+}
 
-    return is_valid( right, expected_level );
+AATreeNode *AATreeImpl::join( AATreeNode *left, AATreeNode *k, AATreeNode *right ) {
+  // Every node in left is less than k, and every node in right is
+  // greater. The level of an AA tree's root corresponds to the
+  // black height of a red-black tree, so this works like the
+  // red-black join: if the roots are at the same level, k becomes
+  // the new root. Otherwise, k is attached, at one level above the
+  // shorter tree, along the inner spine of the taller tree, and the
+  // path back up to the root is fixed up as in insert().
+  int left_level = left->get_level(), right_level = right->get_level();
+
+  if ( left_level == right_level ) {
+    link_left( k, left );
+    link_right( k, right );
+    k->set_level( left_level + 1 );
+    return k;
   }
+
+  AATreeNode *root;
+  AATreeNode **path[ AA_TREE_MAX_HEIGHT ];
+  int depth = 0;
+  AATreeNode **link;
+  AATreeNode *parent = nullptr;
+
+  if ( left_level > right_level ) {
+    // Descend the right spine of left to the first node at the same
+    // level as right (right children are at most one level lower
+    // than their parents, so there is one), and put k in its place
+    root = left;
+    link = &root;
+    while ( ( *link )->get_level() > right_level ) {
+      DS_ASSERT( depth < AA_TREE_MAX_HEIGHT );
+      path[ depth++ ] = link;
+      parent = *link;
+      link = parent->get_ptr_to_right();
+    }
+    link_left( k, *link );
+    link_right( k, right );
+    k->set_level( right_level + 1 );
+  } else {
+    // Same thing, along the left spine of right
+    root = right;
+    link = &root;
+    while ( ( *link )->get_level() > left_level ) {
+      DS_ASSERT( depth < AA_TREE_MAX_HEIGHT );
+      path[ depth++ ] = link;
+      parent = *link;
+      link = parent->get_ptr_to_left();
+    }
+    link_left( k, left );
+    link_right( k, *link );
+    k->set_level( left_level + 1 );
+  }
+
+  *link = k;
+  if ( m_parent_links )
+    set_parent( k, parent );
+
+  while ( depth > 0 ) {
+    link = path[ --depth ];
+    *link = skew( *link );
+    *link = split( *link );
+  }
+
+  return root;
 }
 
-int AATreeImpl::get_height( AATreeNode *node ) const {
-  if ( node == &m_nil )
-    return 0;
-  int l_height = get_height( node->get_left() );
-  int r_height = get_height( node->get_right() );
-  return 1 + ( l_height > r_height ? l_height : r_height );
+AATreeNode *AATreeImpl::join2( AATreeNode *left, AATreeNode *right ) {
+  // Every node in left is less than every node in right: the last
+  // node of left joins them
+  if ( left == &s_nil )
+    return right;
+  AATreeNode *last;
+  left = remove_last( left, last );
+  return join( left, last, right );
+}
+
+AATreeNode *AATreeImpl::split_at( AATreeNode *t, const AATreeNode *key, AATreeNode *&left, AATreeNode *&right ) {
+  // Search for the key, then work back up the path, joining each
+  // node (and its other subtree) onto the left or right part
+  struct Step {
+    AATreeNode *node;
+    bool went_left;
+  };
+  Step path[ AA_TREE_MAX_HEIGHT ];
+  int depth = 0;
+
+  AATreeNode *found = nullptr;
+  OpCounts counts( this );
+  while ( t != &s_nil ) {
+    DS_ASSERT( depth < AA_TREE_MAX_HEIGHT );
+    counts.visit();
+    if ( counts.less( m_less_than, key, t ) ) {
+      path[ depth++ ] = { t, true };
+      t = t->get_left();
+    } else if ( counts.less( m_less_than, t, key ) ) {
+      path[ depth++ ] = { t, false };
+      t = t->get_right();
+    } else {
+      found = t;
+      break;
+    }
+  }
+
+  counts.path_depth( depth );
+
+  left = ( found != nullptr ) ? found->get_left() : &s_nil;
+  right = ( found != nullptr ) ? found->get_right() : &s_nil;
+
+  while ( depth > 0 ) {
+    const Step &step = path[ --depth ];
+    AATreeNode *node = step.node;
+    if ( step.went_left )
+      right = join( right, node, node->get_right() );
+    else
+      left = join( node->get_left(), node, left );
+  }
+
+  return found;
+}
+
+AATreeNode *AATreeImpl::remove_last( AATreeNode *t, AATreeNode *&last ) {
+  // The last node has no right child, so it is at level 1 and has
+  // no children at all. After it is removed, the path back up to
+  // the root is rebalanced as in remove().
+  AATreeNode **path[ AA_TREE_MAX_HEIGHT ];
+  int depth = 0;
+  AATreeNode **link = &t;
+  while ( ( *link )->get_right() != &s_nil ) {
+    DS_ASSERT( depth < AA_TREE_MAX_HEIGHT );
+    path[ depth++ ] = link;
+    link = ( *link )->get_ptr_to_right();
+  }
+
+  last = *link;
+  DS_ASSERT( last->get_left() == &s_nil );
+  *link = &s_nil;
+
+  while ( depth > 0 ) {
+    link = path[ --depth ];
+    *link = rebalance( *link );
+  }
+
+  return t;
+}
+
+void AATreeImpl::free_subtree( AATreeNode *t ) {
+  // Rotate left children up until the node at the top has no
+  // left child, then free it and continue with its right child.
+  // This needs no stack, and visits each node a constant number
+  // of times.
+  while ( t != &s_nil ) {
+    AATreeNode *left = t->get_left();
+    if ( left != &s_nil ) {
+      t->set_left( left->get_right() );
+      left->set_right( t );
+      t = left;
+    } else {
+      AATreeNode *right = t->get_right();
+      free_node( t );
+      t = right;
+    }
+  }
+}
+
+#ifdef DSLIB_CHECK_INTEGRITY
+bool AATreeImpl::is_valid() const {
+  AATreeCheckerImpl checker( this, sizeof( AATreeNode ) );
+  return checker.check_all();
+}
+
+int AATreeImpl::get_height() const {
+  AATreeCheckerImpl checker( this, sizeof( AATreeNode ) );
+  checker.check_all();
+  return checker.get_shape().height;
 }
 
 #endif
@@ -390,11 +1329,9 @@ void *AATreePtrStackImpl::pop() {
 // AATreeIterImpl implementation
 ////////////////////////////////////////////////////////////////////////
 
-AATreeIterImpl::AATreeIterImpl()
-  : m_tree( nullptr ) {
+AATreeIterImpl::AATreeIterImpl() {
   // Note that AATreeImpl is a friend class, and has
-  // responsibility for initializing the stack and the
-  // m_tree pointer
+  // responsibility for initializing the stack
 }
 
 AATreeIterImpl::~AATreeIterImpl() {
@@ -402,7 +1339,6 @@ AATreeIterImpl::~AATreeIterImpl() {
 }
 
 bool AATreeIterImpl::has_next() const {
-  DS_ASSERT( m_tree != nullptr );
   return !m_stack.is_empty();
 }
 
@@ -422,11 +1358,11 @@ AATreeNode *AATreeIterImpl::next() {
   // 3. Otherwise, go up, traversing all right child links.
   //    The first node reachable via a left child link is next.
 
-  if ( node->get_right() != m_tree->nil() ) {
+  if ( AATreeImpl::right_of( node ) != AATreeImpl::nil() ) {
     // Case 1
     AATreeNode *next = node->get_right();
     m_stack.push( next );
-    while ( next->get_left() != m_tree->nil() ) {
+    while ( next->get_left() != AATreeImpl::nil() ) {
       next = next->get_left();
       m_stack.push( next );
     }
@@ -470,15 +1406,121 @@ AATreeNode *AATreeIterImpl::next() {
   return node;
 }
 
-void AATreeIterImpl::init( const AATreeImpl *tree ) {
-  m_tree = tree;
+void AATreeIterImpl::init( AATreeNode *root ) {
+  // Start with the left-most node in the (sub)tree
+  AATreeNode *n = root;
+  while ( n != AATreeImpl::nil() ) {
+    m_stack.push( n );
+    n = n->get_left();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////
+// AATreeThreadedIterImpl implementation
+////////////////////////////////////////////////////////////////////////
+
+AATreeThreadedIterImpl::AATreeThreadedIterImpl()
+  : m_next( nullptr ) {
+  // As with AATreeIterImpl, the AATreeImpl object will
+  // position the iterator at the first node
+}
+
+AATreeThreadedIterImpl::~AATreeThreadedIterImpl() {
+
+}
+
+bool AATreeThreadedIterImpl::has_next() const {
+  return m_next != nullptr;
+}
+
+AATreeNode *AATreeThreadedIterImpl::next() {
+  DS_ASSERT( has_next() );
 
+  AATreeNode *node = m_next;
+
+  // If there is a thread, it points to the next node. Otherwise,
+  // the next node is the leftmost node in the right subtree.
+  // Note that the nil node is the only node at level 0, which
+  // allows us to recognize it without a pointer to the tree.
+  if ( node->has_thread() )
+    m_next = node->get_thread();
+  else {
+    AATreeNode *next = node->get_right();
+    while ( next->get_left()->get_level() != 0 )
+      next = next->get_left();
+    m_next = next;
+  }
+
+  return node;
+}
+
+void AATreeThreadedIterImpl::init( const AATreeImpl *tree ) {
   // Start with the left-most node in the tree
-  AATreeNode *n = m_tree->get_root();
-  while ( n != m_tree->nil() ) {
-    m_stack.push( n );
+  AATreeNode *n = tree->get_root();
+  if ( n == tree->nil() )
+    return;
+  while ( n->get_left() != tree->nil() )
     n = n->get_left();
+  m_next = n;
+}
+
+////////////////////////////////////////////////////////////////////////
+// AATreeFingerImpl implementation
+////////////////////////////////////////////////////////////////////////
+
+AATreeFingerImpl::AATreeFingerImpl()
+  : m_tree( nullptr ) {
+  // As with the iterators, the AATreeImpl object will
+  // set the tree pointer
+}
+
+AATreeFingerImpl::~AATreeFingerImpl() {
+
+}
+
+AATreeNode *AATreeFingerImpl::find( const AATreeNode &node ) {
+  DS_ASSERT( m_tree != nullptr );
+
+  const AATreeNode *nil = m_tree->nil();
+  const AATreeImpl::LessThan &less_than = m_tree->get_less_than();
+  AATreeImpl::OpCounts counts( m_tree );
+
+  // The stack has the path from the root to the last node visited by
+  // the previous search. Go up until we reach a node whose subtree
+  // could contain the node being searched for. Because searches are
+  // in ascending order, only the upper bound of each subtree needs to
+  // be checked. The upper bound of a left child's subtree is its
+  // parent, and a right child's subtree has the same upper bound as
+  // its parent's subtree.
+  AATreeNode *p;
+  if ( m_stack.is_empty() )
+    p = m_tree->get_root();
+  else {
+    p = m_stack.pop();
+    while ( !m_stack.is_empty() ) {
+      AATreeNode *parent = m_stack.top();
+      if ( p == parent->get_left() && counts.less( less_than, &node, parent ) )
+        break; // p's subtree could contain the node
+      p = m_stack.pop();
+    }
   }
+
+  // Continue the search from p
+  while ( p != nil && !AATreeNode::is_thread( p ) ) {
+    m_stack.push( p );
+    counts.visit();
+    if ( counts.less( less_than, &node, p ) )
+      p = p->get_left();     // continue in left subtree
+    else if ( !counts.less( less_than, p, &node ) )
+      return p;              // p is equal to the given node
+    else
+      p = p->get_right();    // continue in right subtree
+  }
+  return nullptr;            // search failed
+}
+
+void AATreeFingerImpl::init( const AATreeImpl *tree ) {
+  m_tree = tree;
 }
 
 ////////////////////////////////////////////////////////////////////////
@@ -548,12 +1590,12 @@ AATreeNode *AATreePostfixIterImpl::next() {
     // yet, find the next leaf to visit in the right subtree.
 
     if ( !is_right_visited( parent ) ) {
-      AATreeNode *n = clean_ptr( parent )->get_right();
+      AATreeNode *n = m_tree->right_of( clean_ptr( parent ) );
       DS_ASSERT( n != m_tree->nil() );
       while ( n != m_tree->nil() ) {
         m_stack.push( n );
         AATreeNode *left = n->get_left();
-        n = ( left != m_tree->nil() ) ? left : n->get_right();
+        n = ( left != m_tree->nil() ) ? left : m_tree->right_of( n );
       }
     }
   }
@@ -571,14 +1613,14 @@ void AATreePostfixIterImpl::init( const AATreeImpl *tree ) {
   while ( n != m_tree->nil() ) {
     m_stack.push( n );
     AATreeNode *left = n->get_left();
-    n = ( left != m_tree->nil() ) ? left : n->get_right();
+    n = ( left != m_tree->nil() ) ? left : m_tree->right_of( n );
   }
 
   // Either the tree is empty, or the first node visited should
   // be a true leaf
   DS_ASSERT( m_stack.is_empty() ||
              ( m_stack.top()->get_left() == m_tree->nil() &&
-               m_stack.top()->get_right() == m_tree->nil() ) );
+               m_tree->right_of( m_stack.top() ) == m_tree->nil() ) );
 }
 
 AATreeNode *AATreePostfixIterImpl::clean_ptr( AATreeNode *node ) {
@@ -600,7 +1642,7 @@ bool AATreePostfixIterImpl::is_left_visited( AATreeNode *node ) {
 bool AATreePostfixIterImpl::is_right_visited( AATreeNode *node ) {
   // If there is no right child, then trivially it has already
   // been visitde
-  if ( clean_ptr( node )->get_right() == m_tree->nil() )
+  if ( m_tree->right_of( clean_ptr( node ) ) == m_tree->nil() )
     return true;
 
   // Check whether the RIGHT_VISITED bit is set
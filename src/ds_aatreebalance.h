@@ -0,0 +1,175 @@
+// Copyright 2025, David H. Hovemeyer <david.hovemeyer@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// “Software”), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+// THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef DS_AATREEBALANCE_H
+#define DS_AATREEBALANCE_H
+
+#include "ds_util.h"
+
+namespace dslib {
+
+// The AA-tree rebalancing operations: skew, split, and the level
+// adjustment and fixup done on the way back up after a removal.
+// They are shared by AATreeImpl and AATreeRegionImpl, whose nodes
+// represent links differently, so they access nodes through an Ops
+// object, which provides:
+//
+//   Node                          the node type
+//   Node *nil()                   the nil node (the only node at level 0)
+//   Node *left( Node *t )         t's left child
+//   Node *right( Node *t )        t's right child (nil if none)
+//   void set_left( Node *t, Node *child )
+//   void set_right( Node *t, Node *child )  (child is never nil)
+//   void clear_right( Node *t, Node *succ )
+//                                 t no longer has a right child:
+//                                 succ is its in-order successor
+//   int level( Node *t )
+//   void set_level( Node *t, int level )
+//   void rotated( Node *top, Node *t, Node *moved )
+//                                 a rotation moved top above t, and
+//                                 moved from top's subtree to t's
+//
+// This header is internal to the library.
+
+template< typename Ops >
+class AATreeBalance {
+public:
+  typedef typename Ops::Node Node;
+
+  static Node *skew( const Ops &ops, Node *t ) {
+    if ( t == ops.nil() )
+      return t;
+
+    Node *left = ops.left( t );
+
+    if ( left == ops.nil() )
+      return t;
+
+    if ( ops.level( t ) == ops.level( left ) ) {
+      // t has a left child at the same level, so the left child  //
+      // becomes the new root of this subtree, and t becomes its  //
+      // right child.                                             //
+      //                                                          //
+      //            |             |                               //
+      //            v             v                               //
+      //   left <-- t            left -->  t                      //
+      //  /   \      \   ==>    /         / \                     //
+      // A     B      R        A         B   R                    //
+      ops.set_left( t, ops.right( left ) );
+      ops.set_right( left, t );
+      ops.rotated( left, t, ops.left( t ) );
+      return left;
+    }
+
+    return t;
+  }
+
+  static Node *split( const Ops &ops, Node *t ) {
+    if ( t == ops.nil() )
+      return t;
+
+    Node *right = ops.right( t );
+
+    if ( right == ops.nil() )
+      return t;
+
+    Node *x = ops.right( right );
+
+    if ( x == ops.nil() )
+      return t;
+
+    if ( ops.level( t ) == ops.level( x ) ) {
+      // There are two horizontal right links, so t's right node  //
+      // needs to be pulled up.                                   //
+      //                                                          //
+      //      |                              |                    //
+      //      v                              v                    //
+      //      t -->  right --> x  ==>      right                  //
+      //     /      /                     /     \                 //
+      //    A      B                     t       x                //
+      //                                / \                       //
+      //                               A   B                      //
+      Node *b = ops.left( right );
+      if ( b == ops.nil() )
+        ops.clear_right( t, right );
+      else
+        ops.set_right( t, b );
+      ops.set_left( right, t );
+      ops.set_level( right, ops.level( right ) + 1 );
+      ops.rotated( right, t, b );
+      return right;
+    }
+
+    return t;
+  }
+
+  static void adjust_level( const Ops &ops, Node *t ) {
+    if ( t == ops.nil() )
+      return;
+
+    // From Andersson's paper (p.3, "Deletion"):
+    //   "If a pseudo-node is missing below p, i.e. if one of
+    //   p's children is two levels below p, decrease the level of
+    //   p by 1. If p's right child belonged to the same
+    //   pseudo-node as p, we decrease the level of that node too."
+
+    Node *left = ops.left( t ), *right = ops.right( t );
+
+    int t_level = ops.level( t ),
+        l_level = ops.level( left ),
+        r_level = ops.level( right );
+
+    bool r_at_same_level = ( t_level == r_level );
+
+    if ( l_level == t_level-2 || r_level == t_level-2 ) {
+      ops.set_level( t, t_level - 1 );
+      if ( r_at_same_level )
+        ops.set_level( right, t_level - 1 );
+    }
+  }
+
+  static Node *rebalance( const Ops &ops, Node *t ) {
+    // From Andersson's paper (p.3, "Deletion"): after decreasing the
+    // level of t, up to three skews and two splits are needed to
+    // restore the pseudo-node structure at t and to its right.
+    adjust_level( ops, t );
+
+    t = skew( ops, t );
+    Node *right = ops.right( t );
+    if ( right != ops.nil() ) {
+      right = skew( ops, right );
+      ops.set_right( t, right );
+      if ( ops.right( right ) != ops.nil() )
+        ops.set_right( right, skew( ops, ops.right( right ) ) );
+    }
+
+    t = split( ops, t );
+    right = ops.right( t );
+    if ( right != ops.nil() )
+      ops.set_right( t, split( ops, right ) );
+
+    return t;
+  }
+};
+
+} // end namespace dslib
+
+#endif // DS_AATREEBALANCE_H
@@ -0,0 +1,145 @@
+// Copyright 2025, David H. Hovemeyer <david.hovemeyer@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// “Software”), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+// THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <cstring>
+#include <cstdint>
+#include "ds_aatreecheck.h"
+
+namespace dslib {
+
+AATreeCheckerImpl::AATreeCheckerImpl( const AATreeImpl *tree, size_t node_size )
+  : m_tree( tree )
+  , m_node_size( node_size ) {
+  restart();
+}
+
+AATreeCheckerImpl::~AATreeCheckerImpl() {
+
+}
+
+void AATreeCheckerImpl::restart() {
+  m_num_frames = 0;
+  m_next_subtree = m_tree->get_root();
+  m_next_depth = 0;
+  m_prev = nullptr;
+  m_done = false;
+  m_valid = true;
+  memset( &m_shape, 0, sizeof( m_shape ) );
+
+  // The root has no parent
+  AATreeNode *root = m_tree->get_root();
+  if ( m_tree->has_parent_links() && root != m_tree->nil()
+       && static_cast< AATreeParentNode* >( root )->get_parent() != nullptr )
+    fail();
+}
+
+bool AATreeCheckerImpl::check( size_t max_nodes ) {
+  const AATreeNode *nil = m_tree->nil();
+
+  for ( ; !m_done && max_nodes > 0; --max_nodes ) {
+    // Push the left spine of the next subtree, so the least
+    // node in the subtree is at the top of the stack
+    for ( AATreeNode *t = m_next_subtree; t != nil; t = t->get_left() ) {
+      if ( m_next_depth >= AA_TREE_MAX_HEIGHT )
+        return fail(); // too deep (or there is a cycle)
+      m_stack[ m_num_frames++ ] = { t, m_next_depth++ };
+    }
+
+    if ( m_num_frames == 0 )
+      return finish();
+
+    Frame frame = m_stack[ --m_num_frames ];
+    if ( !visit( frame.node, frame.depth ) )
+      return fail();
+
+    m_next_subtree = AATreeImpl::right_of( frame.node );
+    m_next_depth = frame.depth + 1;
+  }
+
+  return m_done;
+}
+
+bool AATreeCheckerImpl::check_all() {
+  check( SIZE_MAX );
+  return m_valid;
+}
+
+bool AATreeCheckerImpl::visit( AATreeNode *node, int depth ) {
+  int level = node->get_level();
+  if ( level < 1 || level > AA_TREE_MAX_HEIGHT )
+    return false;
+
+  // Nodes are in ascending order, and each thread leads to the
+  // next node
+  if ( m_prev != nullptr ) {
+    if ( !m_tree->get_less_than()( m_prev, node ) )
+      return false;
+    if ( m_prev->has_thread() && m_prev->get_thread() != node )
+      return false;
+  }
+
+  // Levels of the children (and of the right child's right child,
+  // if the right child is in the same pseudo-node)
+  AATreeNode *left = node->get_left(), *right = AATreeImpl::right_of( node );
+  if ( left->get_level() != level - 1 )
+    return false;
+  if ( right->get_level() != level && right->get_level() != level - 1 )
+    return false;
+  if ( right->get_level() == level && AATreeImpl::right_of( right )->get_level() >= level )
+    return false;
+
+  // Children link back to their parent
+  if ( m_tree->has_parent_links() ) {
+    if ( left != m_tree->nil() && static_cast< AATreeParentNode* >( left )->get_parent() != node )
+      return false;
+    if ( right != m_tree->nil() && static_cast< AATreeParentNode* >( right )->get_parent() != node )
+      return false;
+  }
+
+  m_prev = node;
+
+  ++m_shape.num_nodes;
+  if ( depth + 1 > m_shape.height )
+    m_shape.height = depth + 1;
+  ++m_shape.level_counts[ level ];
+  m_shape.total_depth += uint64_t( depth );
+  m_shape.bytes_used += m_node_size;
+
+  return true;
+}
+
+bool AATreeCheckerImpl::finish() {
+  // In a threaded tree, the last node's thread is nullptr
+  if ( m_tree->is_threaded() && m_prev != nullptr
+       && !( m_prev->has_thread() && m_prev->get_thread() == nullptr ) )
+    return fail();
+
+  m_done = true;
+  return true;
+}
+
+bool AATreeCheckerImpl::fail() {
+  m_valid = false;
+  m_done = true;
+  return true;
+}
+
+} // end namespace dslib
@@ -0,0 +1,256 @@
+// Copyright 2025, David H. Hovemeyer <david.hovemeyer@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// “Software”), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+// THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <cstring>
+#include <cstdint>
+#include "ds_aatreeexport.h"
+#include "ds_chunkwriter.h"
+
+namespace dslib {
+
+namespace {
+
+// Size of the chunks in which output is written
+const size_t CHUNK_SIZE = 64 * 1024;
+
+// Formats the output (in either format)
+class ExportOut {
+private:
+  ChunkWriter m_out;
+  AATreeExportFormat m_format;
+
+  NO_VALUE_SEMANTICS( ExportOut );
+
+public:
+  ExportOut( AATreeWriter &writer, AATreeExportFormat format )
+    : m_out( writer, CHUNK_SIZE ), m_format( format ) { }
+
+  bool is_json() const { return m_format == AA_TREE_EXPORT_JSON; }
+
+  void str( const char *s ) {
+    m_out.write( reinterpret_cast< const unsigned char* >( s ), strlen( s ) );
+  }
+
+  void ch( char c ) {
+    m_out.write( reinterpret_cast< const unsigned char* >( &c ), 1 );
+  }
+
+  void num( uint64_t n ) {
+    char buf[ 20 ];
+    size_t len = 0;
+    do {
+      buf[ sizeof( buf ) - ++len ] = char( '0' + n % 10 );
+      n /= 10;
+    } while ( n > 0 );
+    m_out.write( reinterpret_cast< const unsigned char* >( buf + sizeof( buf ) - len ), len );
+  }
+
+  // Write label text (inside quotes), escaped as needed
+  void text( const char *s, size_t n ) {
+    static const char HEX[] = "0123456789abcdef";
+    for ( size_t i = 0; i < n; ++i ) {
+      unsigned char c = static_cast< unsigned char >( s[ i ] );
+      if ( c == '"' || c == '\\' ) {
+        ch( '\\' );
+        ch( char( c ) );
+      } else if ( c < 0x20 ) {
+        // JSON has escapes for control characters, but
+        // DOT doesn't, so they become spaces
+        if ( is_json() ) {
+          str( "\\u00" );
+          ch( HEX[ c >> 4 ] );
+          ch( HEX[ c & 0xf ] );
+        } else {
+          ch( ' ' );
+        }
+      } else {
+        ch( char( c ) );
+      }
+    }
+  }
+
+  void begin() {
+    str( is_json() ? "{\"root\":" : "digraph aatree {\n  node [shape=box];\n" );
+  }
+
+  void end() {
+    str( "}\n" );
+  }
+
+  // A node, which is the side ('L' or 'R') child of the parent node
+  // with the given id, unless it is the root (has_parent is false)
+  void node( uint64_t id, int level, const char *label, size_t label_len,
+             bool has_parent, uint64_t parent_id, char side, bool horizontal ) {
+    if ( is_json() ) {
+      str( "{\"id\":" );
+      num( id );
+      str( ",\"level\":" );
+      num( uint64_t( level ) );
+      if ( label != nullptr ) {
+        str( ",\"label\":\"" );
+        text( label, label_len );
+        ch( '"' );
+      }
+      str( ",\"left\":" );
+    } else {
+      str( "  n" );
+      num( id );
+      str( " [label=\"" );
+      num( uint64_t( level ) );
+      if ( label != nullptr ) {
+        str( ": " );
+        text( label, label_len );
+      }
+      str( "\"];\n" );
+      if ( has_parent )
+        edge( parent_id, side, id, '\0', horizontal );
+    }
+  }
+
+  // Between a node's left and right children
+  void between() {
+    if ( is_json() )
+      str( ",\"right\":" );
+  }
+
+  // After a node's right child
+  void close() {
+    if ( is_json() )
+      ch( '}' );
+  }
+
+  // A missing child
+  void none() {
+    if ( is_json() )
+      str( "null" );
+  }
+
+  // A child subtree that is left out
+  void elided( uint64_t parent_id, char side ) {
+    if ( is_json() ) {
+      str( "\"elided\"" );
+    } else {
+      str( "  n" );
+      num( parent_id );
+      ch( side );
+      str( " [label=\"...\", shape=plaintext];\n" );
+      edge( parent_id, side, parent_id, side, false );
+    }
+  }
+
+  bool flush() { return m_out.flush(); }
+
+private:
+  // A DOT edge to node n<id><suffix> (where the suffix is
+  // optional: it is used for elided subtrees)
+  void edge( uint64_t parent_id, char side, uint64_t id, char suffix, bool horizontal ) {
+    str( "  n" );
+    num( parent_id );
+    str( " -> n" );
+    num( id );
+    if ( suffix != '\0' )
+      ch( suffix );
+    str( " [label=\"" );
+    ch( side );
+    str( horizontal ? "\", style=dashed];\n" : "\"];\n" );
+  }
+};
+
+} // end anonymous namespace
+
+bool AATreeExportImpl::export_tree( const AATreeImpl &tree, AATreeWriter &writer,
+                                    NodeLabelFn *label_fn, const AATreeExportOptions &options ) {
+  // Nodes whose subtrees are being exported
+  struct Frame {
+    AATreeNode *node;
+    uint64_t id;
+    int depth;
+    bool left_done;
+  };
+  Frame stack[ AA_TREE_MAX_HEIGHT ];
+  int num_frames = 0;
+
+  const AATreeNode *nil = tree.nil();
+  uint64_t next_id = 0, num_sampled = 0;
+  char label[ AA_TREE_EXPORT_MAX_LABEL ];
+  ExportOut out( writer, options.format );
+
+  out.begin();
+
+  // The subtree to export next, which is the root, or a child of
+  // the node at the top of the stack
+  AATreeNode *t = tree.get_root();
+  int depth = 0;
+
+  for ( ;; ) {
+    const Frame *parent = ( num_frames > 0 ) ? &stack[ num_frames - 1 ] : nullptr;
+    char side = ( parent != nullptr && parent->left_done ) ? 'R' : 'L';
+
+    bool include = ( options.max_depth < 0 || depth <= options.max_depth );
+    if ( include && t != nil && depth == options.sample_depth && options.sample_interval > 1 )
+      include = ( num_sampled++ % options.sample_interval == 0 );
+
+    if ( t == nil ) {
+      out.none();
+    } else if ( !include && parent != nullptr ) {
+      out.elided( parent->id, side );
+    } else {
+      if ( num_frames >= AA_TREE_MAX_HEIGHT )
+        return false; // too deep (or there is a cycle)
+
+      size_t label_len = 0;
+      if ( label_fn != nullptr ) {
+        label_len = label_fn( t, label, sizeof( label ) );
+        if ( label_len > sizeof( label ) )
+          label_len = sizeof( label );
+      }
+      bool horizontal = ( side == 'R' && t->get_level() == parent->node->get_level() );
+      out.node( next_id, t->get_level(), ( label_fn != nullptr ) ? label : nullptr, label_len,
+                parent != nullptr, ( parent != nullptr ) ? parent->id : 0, side, horizontal );
+
+      stack[ num_frames++ ] = { t, next_id++, depth, false };
+      t = t->get_left();
+      ++depth;
+      continue;
+    }
+
+    // Go on to the right subtree of the nearest node whose
+    // left subtree has been exported
+    for ( ;; ) {
+      if ( num_frames == 0 ) {
+        out.end();
+        return out.flush();
+      }
+      Frame &top = stack[ num_frames - 1 ];
+      if ( !top.left_done ) {
+        top.left_done = true;
+        out.between();
+        t = AATreeImpl::right_of( top.node );
+        depth = top.depth + 1;
+        break;
+      }
+      out.close();
+      --num_frames;
+    }
+  }
+}
+
+} // end namespace dslib
@@ -0,0 +1,386 @@
+// Copyright 2025, David H. Hovemeyer <david.hovemeyer@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// “Software”), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+// THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <atomic>
+#include <deque>
+#include <new>
+#include <thread>
+#include <mutex>
+#include <utility>
+#include "ds_aatreepar.h"
+
+namespace dslib {
+
+namespace {
+
+// Number of pieces to cut the tree into for each worker thread:
+// more pieces means better load balancing, but more overhead
+const size_t PIECES_PER_THREAD = 8;
+
+// Set operations on subtrees are done sequentially (rather than
+// divided into tasks) once the root of either subtree is at or
+// below this level, i.e., once either has fewer than about
+// 2^SET_OP_GRAIN_LEVEL nodes
+const int SET_OP_GRAIN_LEVEL = 10;
+
+// Depth at which to cut a tree into pieces for the given
+// number of threads
+int cut_depth_for( int num_threads ) {
+  int cut_depth = 0;
+  while ( ( size_t( 1 ) << cut_depth ) < PIECES_PER_THREAD * size_t( num_threads ) )
+    ++cut_depth;
+  return cut_depth;
+}
+
+// Range of tasks not yet started by a worker
+struct WorkQueue {
+  std::mutex lock;
+  size_t begin, end;
+};
+
+// Take a task from the front of a worker's own queue, or (when
+// stealing from another worker) from the back
+bool take_task( WorkQueue &q, bool steal, size_t &task ) {
+  std::lock_guard< std::mutex > guard( q.lock );
+  if ( q.begin == q.end )
+    return false;
+  task = steal ? --q.end : q.begin++;
+  return true;
+}
+
+void run_worker( std::vector< WorkQueue > &queues, int worker, AATreeParImpl::TaskFn *fn, void *ctx ) {
+  int num_workers = int( queues.size() );
+  size_t task;
+
+  // Do our own tasks first, then steal until there
+  // are no tasks left anywhere
+  for ( ;; ) {
+    if ( take_task( queues[ worker ], false, task ) ) {
+      fn( ctx, task, worker );
+      continue;
+    }
+
+    bool stole = false;
+    for ( int i = 1; i < num_workers && !stole; ++i ) {
+      if ( take_task( queues[ ( worker + i ) % num_workers ], true, task ) ) {
+        fn( ctx, task, worker );
+        stole = true;
+      }
+    }
+    if ( !stole )
+      return;
+  }
+}
+
+} // end anonymous namespace
+
+struct AATreeParImpl::VisitContext {
+  const AATreeParImpl *par;
+  VisitFn *fn;
+  void *ctx;
+};
+
+struct AATreeParImpl::BuildContext {
+  AATreeImpl *tree;
+  const void *nodes;
+  size_t n;
+  AATreeImpl::NodeAtFn *node_at_fn;
+  std::vector< AATreeImpl::BuildRange > pieces;
+};
+
+// A set operation on subtrees t1 and t2. If the task divides the
+// problem, its two halves become tasks of their own, and the task
+// waits (without a thread) for both of them: whichever half finishes
+// last combines their results, and then completes the parent task.
+struct AATreeParImpl::SetOpTask {
+  AATreeNode *t1, *t2;
+  SetOpTask *parent;
+  int side; // 0 if this task is the parent's left half, 1 if the right
+  AATreeImpl::SetOpSplit split;
+  AATreeNode *results[ 2 ];
+  std::atomic< int > pending;
+};
+
+struct AATreeParImpl::SetOpContext {
+  // Tasks not yet started by a worker
+  struct TaskQueue {
+    std::mutex lock;
+    std::deque< SetOpTask* > tasks;
+  };
+
+  AATreeImpl *tree;
+  AATreeImpl::SetOp op;
+  std::vector< TaskQueue > queues;
+  std::atomic< bool > done;
+  AATreeNode *result;
+};
+
+AATreeParImpl::AATreeParImpl( const AATreeImpl &tree, int num_threads )
+  : m_tree( &tree )
+  , m_num_threads( num_threads > 0 ? num_threads : default_num_threads() ) {
+
+  // Depth at which to cut the tree into whole subtrees
+  int cut_depth = cut_depth_for( m_num_threads );
+
+  // In-order traversal of the part of the tree above the cut. Each
+  // stack entry is a node and its depth.
+  std::pair< AATreeNode*, int > stack[ AA_TREE_MAX_HEIGHT ];
+  int top = 0;
+  AATreeNode *n = tree.get_root();
+  int depth = 0;
+  for ( ;; ) {
+    while ( n != tree.nil() ) {
+      if ( depth == cut_depth ) {
+        m_pieces.push_back( { n, true } );
+        break;
+      }
+      stack[ top++ ] = { n, depth };
+      n = n->get_left();
+      ++depth;
+    }
+
+    if ( top == 0 )
+      break;
+
+    --top;
+    m_pieces.push_back( { stack[ top ].first, false } );
+    n = tree.right_of( stack[ top ].first );
+    depth = stack[ top ].second + 1;
+  }
+}
+
+AATreeParImpl::~AATreeParImpl() {
+
+}
+
+void AATreeParImpl::for_each( VisitFn *fn, void *ctx ) const {
+  VisitContext vc = { this, fn, ctx };
+  run_tasks( m_pieces.size(), &visit_piece, &vc, m_num_threads );
+}
+
+bool AATreeParImpl::build( AATreeImpl &tree, const void *nodes, size_t n,
+                           AATreeImpl::NodeAtFn *node_at_fn, int num_threads ) {
+  if ( !tree.can_build( nodes, n, node_at_fn ) )
+    return false;
+  if ( n == 0 )
+    return true;
+  if ( num_threads <= 0 )
+    num_threads = default_num_threads();
+
+  // Build the top of the tree, down to the depth at which it is cut
+  // into pieces. The level of each node depends only on the size of
+  // its subtree, so the pieces (built independently) fit right in.
+  BuildContext bc = { &tree, nodes, n, node_at_fn, {} };
+  AATreeImpl::BuildRange range = { 0, n, &tree.m_root, nullptr };
+  tree.build_range( nodes, n, node_at_fn, range, cut_depth_for( num_threads ), &defer_range, &bc );
+
+  run_tasks( bc.pieces.size(), &build_piece, &bc, num_threads );
+  return true;
+}
+
+bool AATreeParImpl::set_op( AATreeImpl &tree, AATreeImpl &other, AATreeImpl::SetOp op, int num_threads ) {
+  if ( !tree.can_set_op( op, other ) )
+    return false;
+  if ( num_threads <= 0 )
+    num_threads = default_num_threads();
+
+  SetOpTask *root = new ( std::nothrow ) SetOpTask;
+  if ( num_threads == 1 || root == nullptr ) {
+    delete root;
+    tree.finish_set_op( other, tree.set_op_subtrees( op, tree.m_root, other.m_root ) );
+    return true;
+  }
+
+  // The whole problem is the first task. The calling thread is
+  // worker 0.
+  SetOpContext sc;
+  sc.tree = &tree;
+  sc.op = op;
+  sc.queues = std::vector< SetOpContext::TaskQueue >( num_threads );
+  sc.done = false;
+  sc.result = nullptr;
+  init_set_op_task( root, tree.m_root, other.m_root, nullptr, 0 );
+  sc.queues[ 0 ].tasks.push_back( root );
+
+  std::vector< std::thread > threads;
+  for ( int i = 1; i < num_threads; ++i )
+    threads.emplace_back( &set_op_worker, &sc, i );
+  set_op_worker( &sc, 0 );
+  for ( auto i = threads.begin(); i != threads.end(); ++i )
+    i->join();
+
+  tree.finish_set_op( other, sc.result );
+  return true;
+}
+
+int AATreeParImpl::default_num_threads() {
+  unsigned n = std::thread::hardware_concurrency();
+  return n > 0 ? int( n ) : 1;
+}
+
+void AATreeParImpl::run_tasks( size_t num_tasks, TaskFn *fn, void *ctx, int num_threads ) {
+  if ( num_threads <= 0 )
+    num_threads = default_num_threads();
+  if ( size_t( num_threads ) > num_tasks )
+    num_threads = num_tasks > 0 ? int( num_tasks ) : 1;
+
+  // Each worker starts with a contiguous range of tasks
+  std::vector< WorkQueue > queues( num_threads );
+  for ( int i = 0; i < num_threads; ++i ) {
+    queues[ i ].begin = num_tasks * i / num_threads;
+    queues[ i ].end = num_tasks * ( i + 1 ) / num_threads;
+  }
+
+  // The calling thread is worker 0
+  std::vector< std::thread > threads;
+  for ( int i = 1; i < num_threads; ++i )
+    threads.emplace_back( &run_worker, std::ref( queues ), i, fn, ctx );
+  run_worker( queues, 0, fn, ctx );
+  for ( auto i = threads.begin(); i != threads.end(); ++i )
+    i->join();
+}
+
+void AATreeParImpl::visit_piece( void *ctx, size_t piece, int ) {
+  VisitContext *vc = static_cast< VisitContext* >( ctx );
+  const Piece &p = vc->par->m_pieces[ piece ];
+
+  if ( !p.whole_subtree ) {
+    vc->fn( vc->ctx, piece, p.node );
+    return;
+  }
+
+  AATreeIterImpl it = vc->par->m_tree->subtree_iterator( p.node );
+  while ( it.has_next() )
+    vc->fn( vc->ctx, piece, it.next() );
+}
+
+void AATreeParImpl::defer_range( void *ctx, const AATreeImpl::BuildRange &range ) {
+  static_cast< BuildContext* >( ctx )->pieces.push_back( range );
+}
+
+void AATreeParImpl::build_piece( void *ctx, size_t piece, int ) {
+  BuildContext *bc = static_cast< BuildContext* >( ctx );
+  bc->tree->build_range( bc->nodes, bc->n, bc->node_at_fn, bc->pieces[ piece ], -1, nullptr, nullptr );
+}
+
+void AATreeParImpl::init_set_op_task( SetOpTask *task, AATreeNode *t1, AATreeNode *t2, SetOpTask *parent, int side ) {
+  task->t1 = t1;
+  task->t2 = t2;
+  task->parent = parent;
+  task->side = side;
+  task->pending = 2;
+}
+
+void AATreeParImpl::set_op_worker( SetOpContext *sc, int worker ) {
+  int num_workers = int( sc->queues.size() );
+
+  // Take the most recently pushed task from our own queue (it is
+  // the smallest, and its subtrees are likely still in cache), or
+  // steal the oldest task (the largest) from another worker, until
+  // the whole problem is done
+  while ( !sc->done.load( std::memory_order_acquire ) ) {
+    SetOpTask *task = nullptr;
+    for ( int i = 0; i < num_workers && task == nullptr; ++i ) {
+      SetOpContext::TaskQueue &q = sc->queues[ ( worker + i ) % num_workers ];
+      std::lock_guard< std::mutex > guard( q.lock );
+      if ( !q.tasks.empty() ) {
+        if ( i == 0 ) {
+          task = q.tasks.back();
+          q.tasks.pop_back();
+        } else {
+          task = q.tasks.front();
+          q.tasks.pop_front();
+        }
+      }
+    }
+
+    if ( task != nullptr )
+      run_set_op_task( sc, task, worker );
+    else
+      std::this_thread::yield();
+  }
+}
+
+void AATreeParImpl::run_set_op_task( SetOpContext *sc, SetOpTask *task, int worker ) {
+  AATreeImpl &tree = *sc->tree;
+
+  for ( ;; ) {
+    // Problems where either tree is small aren't worth dividing
+    if ( task->t1->get_level() <= SET_OP_GRAIN_LEVEL || task->t2->get_level() <= SET_OP_GRAIN_LEVEL ) {
+      complete_set_op_task( sc, task, tree.set_op_subtrees( sc->op, task->t1, task->t2 ) );
+      return;
+    }
+
+    AATreeNode *result;
+    if ( tree.set_op_divide( sc->op, task->t1, task->t2, task->split, result ) ) {
+      complete_set_op_task( sc, task, result );
+      return;
+    }
+
+    // Push the right half, where another worker can steal it, and
+    // go on with the left half. (If there is no memory for the
+    // tasks, the halves are done here, sequentially.)
+    SetOpTask *left = new ( std::nothrow ) SetOpTask;
+    SetOpTask *right = new ( std::nothrow ) SetOpTask;
+    if ( left == nullptr || right == nullptr ) {
+      delete left;
+      delete right;
+      task->results[ 0 ] = tree.set_op_subtrees( sc->op, task->split.left1, task->split.left2 );
+      task->results[ 1 ] = tree.set_op_subtrees( sc->op, task->split.right1, task->split.right2 );
+      complete_set_op_task( sc, task, tree.set_op_combine( task->split, task->results[ 0 ], task->results[ 1 ] ) );
+      return;
+    }
+    init_set_op_task( left, task->split.left1, task->split.left2, task, 0 );
+    init_set_op_task( right, task->split.right1, task->split.right2, task, 1 );
+    {
+      SetOpContext::TaskQueue &q = sc->queues[ worker ];
+      std::lock_guard< std::mutex > guard( q.lock );
+      q.tasks.push_back( right );
+    }
+    task = left;
+  }
+}
+
+void AATreeParImpl::complete_set_op_task( SetOpContext *sc, SetOpTask *task, AATreeNode *result ) {
+  // Pass the result up to the parent task. If the parent's other
+  // half is done too, combine their results, and continue with
+  // the parent.
+  for ( ;; ) {
+    SetOpTask *parent = task->parent;
+    int side = task->side;
+    delete task;
+
+    if ( parent == nullptr ) {
+      sc->result = result;
+      sc->done.store( true, std::memory_order_release );
+      return;
+    }
+
+    parent->results[ side ] = result;
+    if ( parent->pending.fetch_sub( 1, std::memory_order_acq_rel ) != 1 )
+      return;
+
+    task = parent;
+    result = sc->tree->set_op_combine( task->split, task->results[ 0 ], task->results[ 1 ] );
+  }
+}
+
+} // end namespace dslib
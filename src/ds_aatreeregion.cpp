@@ -0,0 +1,464 @@
+// Copyright 2025, David H. Hovemeyer <david.hovemeyer@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// “Software”), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+// THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <cstring>
+#include <new>
+#include "ds_aatreeregion.h"
+#include "ds_aatreebalance.h"
+
+namespace dslib {
+
+namespace {
+
+const char MAGIC[ 8 ] = { 'D', 'S', 'A', 'A', 'R', 'E', 'G', 'N' };
+
+// Nodes start at this alignment within the region
+const size_t SLOT_ALIGN = alignof( std::max_align_t );
+
+} // end anonymous namespace
+
+////////////////////////////////////////////////////////////////////////
+// AATreeRegionImpl implementation
+////////////////////////////////////////////////////////////////////////
+
+// The header at the start of the region. Every link in the region
+// points within the region: the free list is a chain of links stored
+// at the start of each free slot, ending at the nil node.
+struct AATreeRegionImpl::Header {
+  char magic[ 8 ];
+  uint32_t version;
+  uint32_t node_size;
+  uint64_t size;             // size of the region
+  uint64_t used;             // offset of the unused space at the end
+  AATreeRegionLink root;
+  AATreeRegionLink free_list;
+  AATreeRegionNode nil;
+};
+
+// Offset of the first node in the region
+const size_t AATreeRegionImpl::SLOTS_BEGIN = ( sizeof( Header ) + SLOT_ALIGN - 1 ) & ~( SLOT_ALIGN - 1 );
+
+// Node access for the rebalancing operations (see ds_aatreebalance.h)
+class AATreeRegionImpl::BalanceOps {
+private:
+  AATreeRegionNode *m_nil;
+
+public:
+  typedef AATreeRegionNode Node;
+
+  explicit BalanceOps( AATreeRegionNode *nil ) : m_nil( nil ) { }
+
+  AATreeRegionNode *nil() const { return m_nil; }
+  AATreeRegionNode *left( AATreeRegionNode *t ) const { return t->get_left(); }
+  AATreeRegionNode *right( AATreeRegionNode *t ) const { return t->get_right(); }
+  void set_left( AATreeRegionNode *t, AATreeRegionNode *child ) const { t->set_left( child ); }
+  void set_right( AATreeRegionNode *t, AATreeRegionNode *child ) const { t->set_right( child ); }
+  void clear_right( AATreeRegionNode *t, AATreeRegionNode * ) const { t->set_right( m_nil ); }
+  int level( AATreeRegionNode *t ) const { return t->get_level(); }
+  void set_level( AATreeRegionNode *t, int level ) const { t->set_level( level ); }
+  void rotated( AATreeRegionNode *, AATreeRegionNode *, AATreeRegionNode * ) const { }
+};
+
+AATreeRegionImpl::AATreeRegionImpl( void *region, LessThanFn *less_than_fn )
+  : m_header( static_cast< Header* >( region ) )
+  , m_nil( &m_header->nil )
+  , m_less_than_fn( less_than_fn ) {
+  DS_ASSERT( memcmp( m_header->magic, MAGIC, sizeof( MAGIC ) ) == 0 );
+}
+
+AATreeRegionImpl::~AATreeRegionImpl() {
+
+}
+
+bool AATreeRegionImpl::format( void *region, size_t size, size_t node_size ) {
+  DS_ASSERT( node_size >= sizeof( AATreeRegionNode ) );
+  DS_ASSERT( reinterpret_cast< uintptr_t >( region ) % SLOT_ALIGN == 0 );
+  if ( size < SLOTS_BEGIN + node_size )
+    return false;
+
+  Header *header = new ( region ) Header;
+  memcpy( header->magic, MAGIC, sizeof( MAGIC ) );
+  header->version = AA_TREE_REGION_VERSION;
+  header->node_size = uint32_t( node_size );
+  header->size = size;
+  header->used = SLOTS_BEGIN;
+  header->nil.set_level( 0 );
+  header->root.set( &header->nil );
+  header->free_list.set( &header->nil );
+  return true;
+}
+
+bool AATreeRegionImpl::check( const void *region, size_t size, size_t node_size ) {
+  if ( size < SLOTS_BEGIN || reinterpret_cast< uintptr_t >( region ) % SLOT_ALIGN != 0 )
+    return false;
+  const Header *header = static_cast< const Header* >( region );
+  return memcmp( header->magic, MAGIC, sizeof( MAGIC ) ) == 0
+      && header->version == AA_TREE_REGION_VERSION
+      && header->node_size == node_size
+      && node_size >= sizeof( AATreeRegionNode )
+      && header->size <= size
+      && header->used >= SLOTS_BEGIN
+      && header->used <= header->size
+      && ( header->used - SLOTS_BEGIN ) % node_size == 0
+      && is_slot_link( header, &header->root )
+      && is_slot_link( header, &header->free_list );
+}
+
+// Is the given offset (from the start of the region) the start of
+// an allocated slot?
+bool AATreeRegionImpl::is_slot_offset( const Header *header, uint64_t offset ) {
+  return offset >= SLOTS_BEGIN && offset < header->used
+      && ( offset - SLOTS_BEGIN ) % header->node_size == 0;
+}
+
+// Does a link in the header lead to the nil node or to a slot?
+// (The target is computed from offsets, so a corrupt link is never
+// followed.)
+bool AATreeRegionImpl::is_slot_link( const Header *header, const AATreeRegionLink *link ) {
+  int64_t link_offset = reinterpret_cast< const char* >( link ) - reinterpret_cast< const char* >( header );
+  int64_t nil_offset = reinterpret_cast< const char* >( &header->nil ) - reinterpret_cast< const char* >( header );
+  if ( link->get_offset() > INT64_MAX - link_offset || link->get_offset() < -link_offset )
+    return false; // the target isn't within the region
+  int64_t target = link_offset + link->get_offset();
+  return target == nil_offset || is_slot_offset( header, uint64_t( target ) );
+}
+
+void *AATreeRegionImpl::alloc_slot() {
+  // Reuse a free slot if there is one
+  void *slot = m_header->free_list.get();
+  if ( slot != m_nil ) {
+    m_header->free_list.set( static_cast< AATreeRegionLink* >( slot )->get() );
+    return slot;
+  }
+
+  // Otherwise, take one from the unused space
+  if ( m_header->size - m_header->used < m_header->node_size )
+    return nullptr;
+  slot = reinterpret_cast< char* >( m_header ) + m_header->used;
+  m_header->used += m_header->node_size;
+  return slot;
+}
+
+void AATreeRegionImpl::free_slot( void *slot ) {
+  DS_ASSERT( static_cast< char* >( slot ) >= reinterpret_cast< char* >( m_header ) + SLOTS_BEGIN );
+  DS_ASSERT( static_cast< char* >( slot ) < reinterpret_cast< char* >( m_header ) + m_header->used );
+
+  AATreeRegionLink *link = new ( slot ) AATreeRegionLink;
+  link->set( m_header->free_list.get() );
+  m_header->free_list.set( slot );
+}
+
+bool AATreeRegionImpl::insert( AATreeRegionNode *node ) {
+  // The node should be in its initial state
+  DS_ASSERT( node->get_level() == 1 );
+
+  // Keep track of links that may need to be updated
+  AATreePtrStack< AATreeRegionLink* > path;
+  AATreeRegionLink *link = get_link_to_root();
+
+  // As in AATreeImpl::insert(), refuse to raise the level of the root
+  // beyond half the maximum height
+  AATreeRegionNode *t = static_cast< AATreeRegionNode* >( link->get() );
+  bool check_full = ( t->get_level() >= AA_TREE_MAX_HEIGHT / 2 );
+  bool all_full = true;
+  int prev_level = 0;
+
+  // Find a place where we can attach the node being inserted
+  while ( t != m_nil ) {
+    path.push( link );
+
+    if ( check_full && t->get_level() != prev_level ) {
+      prev_level = t->get_level();
+      if ( t->get_right()->get_level() != prev_level )
+        all_full = false;
+    }
+
+    if ( m_less_than_fn( node, t ) )
+      link = t->get_link_to_left();
+    else {
+      if ( !m_less_than_fn( t, node ) )
+        return false; // node compares as equal to an existing node
+      link = t->get_link_to_right();
+    }
+    t = static_cast< AATreeRegionNode* >( link->get() );
+  }
+
+  if ( check_full && all_full )
+    return false; // the tree is as high as it is allowed to be
+
+  // Attach the node
+  link->set( node );
+  node->set_left( m_nil );
+  node->set_right( m_nil );
+
+  // Rebalance, stopping early as in AATreeImpl::insert()
+  bool changed_below = true;
+  while ( !path.is_empty() ) {
+    link = path.pop();
+    t = static_cast< AATreeRegionNode* >( link->get() );
+    int level = t->get_level();
+    AATreeRegionNode *top = split( skew( t ) );
+    link->set( top );
+    bool changed = ( top != t || t->get_level() != level );
+    if ( !changed && !changed_below )
+      break;
+    changed_below = changed;
+  }
+
+  return true;
+}
+
+AATreeRegionNode *AATreeRegionImpl::find( const AATreeRegionNode &node ) const {
+  AATreeRegionNode *p = get_root();
+  while ( p != m_nil ) {
+    if ( m_less_than_fn( &node, p ) )
+      p = p->get_left();     // continue in left subtree
+    else if ( !m_less_than_fn( p, &node ) )
+      return p;              // p is equal to the given node
+    else
+      p = p->get_right();    // continue in right subtree
+  }
+  return nullptr;            // search failed
+}
+
+AATreeRegionNode *AATreeRegionImpl::remove( const AATreeRegionNode &node ) {
+  // Links on the path from the root to the node being removed.
+  // (This is an array rather than an AATreePtrStack, since one of
+  // the links may need to be replaced.)
+  AATreeRegionLink *path[ AA_TREE_MAX_HEIGHT ];
+  int depth = 0;
+  AATreeRegionLink *link = get_link_to_root();
+  AATreeRegionNode *t;
+
+  // Find a node equal to the given one
+  for (;;) {
+    t = static_cast< AATreeRegionNode* >( link->get() );
+    if ( t == m_nil )
+      return nullptr; // the tree doesn't contain a matching node
+    if ( m_less_than_fn( &node, t ) ) {
+      DS_ASSERT( depth < AA_TREE_MAX_HEIGHT );
+      path[ depth++ ] = link;
+      link = t->get_link_to_left();
+    } else if ( !m_less_than_fn( t, &node ) ) {
+      break;
+    } else {
+      DS_ASSERT( depth < AA_TREE_MAX_HEIGHT );
+      path[ depth++ ] = link;
+      link = t->get_link_to_right();
+    }
+  }
+
+  if ( t->get_left() == m_nil ) {
+    // t's right child (if any) takes its place
+    link->set( t->get_right() );
+  } else if ( t->get_right() == m_nil ) {
+    // t's left child takes its place
+    link->set( t->get_left() );
+  } else {
+    // t has two children. Rather than copying the contents of its
+    // successor (the leftmost node in its right subtree) into t,
+    // which would move a node that the caller may have a pointer to,
+    // the successor is unlinked, and then put in t's place.
+    DS_ASSERT( depth < AA_TREE_MAX_HEIGHT );
+    int t_depth = depth;
+    path[ depth++ ] = link;
+
+    AATreeRegionLink *succ_link = t->get_link_to_right();
+    AATreeRegionNode *succ = t->get_right();
+    while ( succ->get_left() != m_nil ) {
+      DS_ASSERT( depth < AA_TREE_MAX_HEIGHT );
+      path[ depth++ ] = succ_link;
+      succ_link = succ->get_link_to_left();
+      succ = succ->get_left();
+    }
+    succ_link->set( succ->get_right() );
+
+    succ->set_left( t->get_left() );
+    succ->set_right( t->get_right() );
+    succ->set_level( t->get_level() );
+    link->set( succ );
+
+    // The link to the right subtree (if it's on the path)
+    // is now succ's
+    if ( depth > t_depth + 1 )
+      path[ t_depth + 1 ] = succ->get_link_to_right();
+  }
+
+  // Fix up the nodes on the path, stopping early as in
+  // AATreeImpl::remove()
+  bool changed_below = true;
+  while ( depth > 0 ) {
+    link = path[ --depth ];
+    AATreeRegionNode *p = static_cast< AATreeRegionNode* >( link->get() );
+    AATreeRegionNode *right = p->get_right();
+    int level = p->get_level(), right_level = right->get_level();
+
+    AATreeRegionNode *top = rebalance( p );
+    link->set( top );
+
+    bool changed = ( top != p
+                     || p->get_level() != level
+                     || p->get_right() != right
+                     || right->get_level() != right_level );
+    if ( !changed && !changed_below )
+      break;
+    changed_below = changed;
+  }
+
+  return t;
+}
+
+size_t AATreeRegionImpl::get_size() const {
+  size_t count = 0;
+  AATreeRegionIterImpl it = iterator();
+  while ( it.has_next() ) {
+    it.next();
+    ++count;
+  }
+  return count;
+}
+
+AATreeRegionIterImpl AATreeRegionImpl::iterator() const {
+  AATreeRegionIterImpl it;
+  it.m_nil = m_nil;
+  it.push_left_spine( get_root() );
+  return it;
+}
+
+AATreeRegionNode *AATreeRegionImpl::get_root() const {
+  return static_cast< AATreeRegionNode* >( m_header->root.get() );
+}
+
+AATreeRegionLink *AATreeRegionImpl::get_link_to_root() {
+  return &m_header->root;
+}
+
+AATreeRegionNode *AATreeRegionImpl::skew( AATreeRegionNode *t ) {
+  return AATreeBalance< BalanceOps >::skew( BalanceOps( m_nil ), t );
+}
+
+AATreeRegionNode *AATreeRegionImpl::split( AATreeRegionNode *t ) {
+  return AATreeBalance< BalanceOps >::split( BalanceOps( m_nil ), t );
+}
+
+AATreeRegionNode *AATreeRegionImpl::rebalance( AATreeRegionNode *t ) {
+  return AATreeBalance< BalanceOps >::rebalance( BalanceOps( m_nil ), t );
+}
+
+#ifdef DSLIB_CHECK_INTEGRITY
+bool AATreeRegionImpl::is_valid() const {
+  // Same checks as AATreeCheckerImpl: an in-order traversal with a
+  // stack bounded by the maximum height, checking that the nodes are
+  // allocated slots in ascending order, and the levels of each node's
+  // children
+  struct Frame {
+    AATreeRegionNode *node;
+    int depth;
+  };
+  Frame stack[ AA_TREE_MAX_HEIGHT ];
+  int num_frames = 0;
+  AATreeRegionNode *next_subtree = get_root(), *prev = nullptr;
+  int next_depth = 0;
+
+  // Is a node the nil node or an allocated slot? (This is checked
+  // before a node is used.)
+  auto is_node = [this]( const AATreeRegionNode *t ) {
+    return t == m_nil
+        || is_slot_offset( m_header, uint64_t( reinterpret_cast< const char* >( t )
+                                               - reinterpret_cast< const char* >( m_header ) ) );
+  };
+  if ( !is_node( next_subtree ) )
+    return false;
+
+  for (;;) {
+    for ( AATreeRegionNode *t = next_subtree; t != m_nil; t = t->get_left() ) {
+      if ( next_depth >= AA_TREE_MAX_HEIGHT )
+        return false; // too deep (or there is a cycle)
+      if ( !is_node( t->get_left() ) )
+        return false;
+      stack[ num_frames++ ] = { t, next_depth++ };
+    }
+
+    if ( num_frames == 0 )
+      return true;
+
+    Frame frame = stack[ --num_frames ];
+    AATreeRegionNode *node = frame.node;
+    int level = node->get_level();
+    if ( level < 1 || level > AA_TREE_MAX_HEIGHT )
+      return false;
+    if ( prev != nullptr && !m_less_than_fn( prev, node ) )
+      return false;
+
+    AATreeRegionNode *left = node->get_left(), *right = node->get_right();
+    if ( !is_node( right ) || ( right != m_nil && !is_node( right->get_right() ) ) )
+      return false;
+    if ( left->get_level() != level - 1 )
+      return false;
+    if ( right->get_level() != level && right->get_level() != level - 1 )
+      return false;
+    if ( right->get_level() == level && right->get_right()->get_level() >= level )
+      return false;
+
+    prev = node;
+    next_subtree = right;
+    next_depth = frame.depth + 1;
+  }
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////
+// AATreeRegionIterImpl implementation
+////////////////////////////////////////////////////////////////////////
+
+AATreeRegionIterImpl::AATreeRegionIterImpl()
+  : m_nil( nullptr ) {
+  // AATreeRegionImpl positions the iterator at the first node
+}
+
+AATreeRegionIterImpl::~AATreeRegionIterImpl() {
+
+}
+
+bool AATreeRegionIterImpl::has_next() const {
+  DS_ASSERT( m_nil != nullptr );
+  return !m_stack.is_empty();
+}
+
+AATreeRegionNode *AATreeRegionIterImpl::next() {
+  DS_ASSERT( has_next() );
+
+  // The stack holds the nodes whose left subtrees are being (or have
+  // been) visited, so the top is the next node. After it come the
+  // nodes of its right subtree, starting with the leftmost.
+  AATreeRegionNode *node = m_stack.pop();
+  push_left_spine( node->get_right() );
+  return node;
+}
+
+void AATreeRegionIterImpl::push_left_spine( AATreeRegionNode *node ) {
+  while ( node != m_nil ) {
+    m_stack.push( node );
+    node = node->get_left();
+  }
+}
+
+} // end namespace dslib
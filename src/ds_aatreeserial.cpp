@@ -0,0 +1,207 @@
+// Copyright 2025, David H. Hovemeyer <david.hovemeyer@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// “Software”), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+// THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <cstring>
+#include <vector>
+#include "ds_aatreeserial.h"
+#include "ds_chunkwriter.h"
+#include "ds_chunkreader.h"
+#include "ds_binenc.h"
+
+namespace dslib {
+
+namespace {
+
+const char MAGIC[ 8 ] = { 'D', 'S', 'A', 'A', 'T', 'R', 'E', 'E' };
+const size_t HEADER_SIZE = 24;
+
+// Size of the chunks in which data is written and read
+const size_t CHUNK_SIZE = 64 * 1024;
+
+AATreeNode *node_at( const void *nodes, size_t i ) {
+  return static_cast< AATreeNode *const * >( nodes )[ i ];
+}
+
+} // end anonymous namespace
+
+////////////////////////////////////////////////////////////////////////
+// AATreeWriter and AATreeReader implementation
+////////////////////////////////////////////////////////////////////////
+
+AATreeWriter::AATreeWriter() {
+
+}
+
+AATreeWriter::~AATreeWriter() {
+
+}
+
+AATreeReader::AATreeReader() {
+
+}
+
+AATreeReader::~AATreeReader() {
+
+}
+
+AATreeFileWriter::AATreeFileWriter( FILE *out )
+  : m_out( out ) {
+
+}
+
+AATreeFileWriter::~AATreeFileWriter() {
+
+}
+
+bool AATreeFileWriter::write( const void *data, size_t n ) {
+  return fwrite( data, 1, n, m_out ) == n;
+}
+
+AATreeFileReader::AATreeFileReader( FILE *in )
+  : m_in( in ) {
+
+}
+
+AATreeFileReader::~AATreeFileReader() {
+
+}
+
+size_t AATreeFileReader::read( void *buf, size_t n ) {
+  return fread( buf, 1, n, m_in );
+}
+
+////////////////////////////////////////////////////////////////////////
+// AATreeSerialImpl implementation
+////////////////////////////////////////////////////////////////////////
+
+bool AATreeSerialImpl::serialize( const AATreeImpl &tree, AATreeWriter &writer, EncodeNodeFn *encode_fn ) {
+  ChunkWriter out( writer, CHUNK_SIZE );
+
+  unsigned char header[ HEADER_SIZE ];
+  memcpy( header, MAGIC, sizeof( MAGIC ) );
+  put_le( header + 8, AA_TREE_SERIAL_VERSION, 4 );
+  put_le( header + 12, 0, 4 );
+  put_le( header + 16, tree.get_size(), 8 );
+  out.write( header, HEADER_SIZE );
+
+  // Each record is encoded after room for the longest possible
+  // length, so the length can be put right in front of it
+  std::vector< unsigned char > buf( 256 );
+  uint64_t hash = FNV_OFFSET_BASIS;
+  AATreeIterImpl it = tree.iterator();
+  while ( it.has_next() ) {
+    AATreeNode *node = it.next();
+    size_t size = encode_fn( node, buf.data() + MAX_VARINT_SIZE, buf.size() - MAX_VARINT_SIZE );
+    if ( size > buf.size() - MAX_VARINT_SIZE ) {
+      buf.resize( size + MAX_VARINT_SIZE );
+      encode_fn( node, buf.data() + MAX_VARINT_SIZE, size );
+    }
+
+    unsigned char len[ MAX_VARINT_SIZE ];
+    size_t len_size = put_varint( len, size );
+    unsigned char *record = buf.data() + MAX_VARINT_SIZE - len_size;
+    memcpy( record, len, len_size );
+    out.write( record, len_size + size );
+    hash = fnv1a( hash, record, len_size + size );
+  }
+
+  unsigned char trailer[ 8 ];
+  put_le( trailer, hash, 8 );
+  out.write( trailer, sizeof( trailer ) );
+
+  return out.flush();
+}
+
+bool AATreeSerialImpl::load( AATreeImpl &tree, AATreeReader &reader, DecodeNodeFn *decode_fn ) {
+  if ( !tree.is_empty() )
+    return false;
+
+  ChunkReader in( reader, CHUNK_SIZE );
+  const unsigned char *header = in.peek( HEADER_SIZE );
+  if ( header == nullptr
+       || memcmp( header, MAGIC, sizeof( MAGIC ) ) != 0
+       || get_le( header + 8, 4 ) != AA_TREE_SERIAL_VERSION )
+    return false;
+  uint64_t count = get_le( header + 16, 8 );
+  in.skip( HEADER_SIZE );
+
+  // The count isn't trusted until the nodes have actually been read,
+  // so the array of nodes grows as they are
+  std::vector< AATreeNode* > nodes;
+  std::vector< unsigned char > record;
+  const AATreeImpl::LessThan &less_than = tree.get_less_than();
+  uint64_t hash = FNV_OFFSET_BASIS;
+  bool ok = true;
+
+  for ( uint64_t i = 0; i < count && ok; ++i ) {
+    uint64_t size;
+    size_t len_size = in.read_varint( size );
+    if ( len_size == 0 ) {
+      ok = false;
+      break;
+    }
+    unsigned char len[ MAX_VARINT_SIZE ];
+    hash = fnv1a( hash, len, put_varint( len, size ) );
+
+    // Records that fit in a chunk are decoded in place
+    const unsigned char *data = nullptr;
+    if ( size <= CHUNK_SIZE ) {
+      data = in.peek( size );
+    } else {
+      record.clear();
+      if ( in.read( record, size ) )
+        data = record.data();
+    }
+    if ( data == nullptr ) {
+      ok = false;
+      break;
+    }
+    hash = fnv1a( hash, data, size );
+
+    AATreeNode *node = decode_fn( data, size );
+    if ( size <= CHUNK_SIZE )
+      in.skip( size );
+    if ( node == nullptr ) {
+      ok = false;
+      break;
+    }
+    nodes.push_back( node );
+    if ( nodes.size() > 1 && !less_than( nodes[ nodes.size() - 2 ], node ) )
+      ok = false;
+  }
+
+  if ( ok ) {
+    const unsigned char *trailer = in.peek( 8 );
+    ok = trailer != nullptr && get_le( trailer, 8 ) == hash;
+  }
+
+  if ( ok )
+    ok = tree.build( nodes.data(), nodes.size(), &node_at );
+
+  if ( !ok ) {
+    for ( auto i = nodes.begin(); i != nodes.end(); ++i )
+      tree.free_node( *i );
+  }
+
+  return ok;
+}
+
+} // end namespace dslib
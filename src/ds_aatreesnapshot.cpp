@@ -0,0 +1,228 @@
+// Copyright 2025, David H. Hovemeyer <david.hovemeyer@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// “Software”), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+// THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "ds_aatreesnapshot.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace dslib {
+
+namespace {
+
+// Eytzinger index of the first (leftmost) element of a
+// snapshot with n elements, or 0 if n is 0
+size_t eytzinger_first( size_t n ) {
+  if ( n == 0 )
+    return 0;
+  size_t k = 1;
+  while ( 2*k <= n )
+    k = 2*k;
+  return k;
+}
+
+// Eytzinger index of the element following the one at index k,
+// or 0 if k is the last element
+size_t eytzinger_next( size_t k, size_t n ) {
+  if ( 2*k + 1 <= n ) {
+    // Leftmost element of the right subtree
+    k = 2*k + 1;
+    while ( 2*k <= n )
+      k = 2*k;
+    return k;
+  }
+
+  // Go up until we arrive from a left child
+  while ( k & 1 )
+    k >>= 1;
+  return k >> 1;
+}
+
+// A descent through the snapshot that goes left when the key is less
+// than or equal to the element, and right otherwise, ends at an index
+// whose binary representation is the path taken. Discarding the
+// trailing right turns (1 bits) and the final left turn (0 bit) yields
+// the index of the first element not less than the key, or 0 if there
+// is no such element.
+size_t eytzinger_lower_bound_index( size_t k ) {
+  return k >> __builtin_ffsll( ~(long long) k );
+}
+
+// Snapshot nodes are in slots 1..n, and the descent uses the slot
+// 8 times the current one: that's three levels further down, and
+// (since a node pointer or key is 8 bytes) the 8 slots at that level
+// fill one cache line.
+const size_t PREFETCH_FACTOR = 8;
+
+} // end anonymous namespace
+
+////////////////////////////////////////////////////////////////////////
+// AATreeSnapshotImpl implementation
+////////////////////////////////////////////////////////////////////////
+
+AATreeSnapshotImpl::AATreeSnapshotImpl()
+  : m_nodes( nullptr )
+  , m_size( 0 )
+  , m_less_than() {
+
+}
+
+AATreeSnapshotImpl::~AATreeSnapshotImpl() {
+
+}
+
+bool AATreeSnapshotImpl::build( const AATreeImpl &tree, AATreeNode **buf, size_t capacity ) {
+  size_t n = tree.get_size();
+  if ( capacity < n + 1 )
+    return false;
+
+  m_nodes = buf;
+  m_size = n;
+  m_less_than = tree.get_less_than();
+  m_nodes[0] = nullptr;
+
+  // The in-order traversal of the tree visits the nodes in the
+  // same order as an in-order traversal of the snapshot
+  size_t k = eytzinger_first( n );
+  AATreeIterImpl it = tree.iterator();
+  while ( it.has_next() ) {
+    DS_ASSERT( k != 0 );
+    m_nodes[k] = it.next();
+    k = eytzinger_next( k, n );
+  }
+  DS_ASSERT( k == 0 );
+
+  return true;
+}
+
+AATreeNode *AATreeSnapshotImpl::find( const AATreeNode &node ) const {
+  size_t k = 1;
+  while ( k <= m_size ) {
+    DS_PREFETCH( m_nodes + PREFETCH_FACTOR*k );
+    k = 2*k + m_less_than( m_nodes[k], &node );
+  }
+  k = eytzinger_lower_bound_index( k );
+
+  if ( k == 0 || m_less_than( &node, m_nodes[k] ) )
+    return nullptr;
+  return m_nodes[k];
+}
+
+////////////////////////////////////////////////////////////////////////
+// AATreeIntSnapshotImpl implementation
+////////////////////////////////////////////////////////////////////////
+
+AATreeIntSnapshotImpl::AATreeIntSnapshotImpl()
+  : m_keys( nullptr )
+  , m_nodes( nullptr )
+  , m_size( 0 )
+  , m_depth( 0 ) {
+
+}
+
+AATreeIntSnapshotImpl::~AATreeIntSnapshotImpl() {
+
+}
+
+bool AATreeIntSnapshotImpl::build( const AATreeImpl &tree, GetKeyFn *get_key_fn, int64_t *key_buf, AATreeNode **node_buf, size_t capacity ) {
+  size_t n = tree.get_size();
+  if ( capacity < n + 1 )
+    return false;
+
+  m_keys = key_buf;
+  m_nodes = node_buf;
+  m_size = n;
+  m_keys[0] = 0;
+  m_nodes[0] = nullptr;
+
+  // Number of levels: every search takes exactly this many steps,
+  // or one fewer if it ends on the (partial) bottom level
+  m_depth = 0;
+  for ( size_t k = 1; k <= n; k = 2*k )
+    ++m_depth;
+
+  size_t k = eytzinger_first( n );
+  AATreeIterImpl it = tree.iterator();
+  while ( it.has_next() ) {
+    DS_ASSERT( k != 0 );
+    AATreeNode *node = it.next();
+    m_keys[k] = get_key_fn( node );
+    m_nodes[k] = node;
+    k = eytzinger_next( k, n );
+  }
+  DS_ASSERT( k == 0 );
+
+  return true;
+}
+
+AATreeNode *AATreeIntSnapshotImpl::find( int64_t key ) const {
+  size_t k = lower_bound( key );
+  return ( k != 0 && m_keys[k] == key ) ? m_nodes[k] : nullptr;
+}
+
+void AATreeIntSnapshotImpl::find_many( const int64_t *keys, size_t n, AATreeNode **results ) const {
+  size_t i = 0;
+
+#ifdef __AVX2__
+  // Search for four keys at a time, one per 64-bit lane. Each step
+  // gathers the keys at the current index in each lane, compares,
+  // and moves each lane to the left or right child. Lanes that have
+  // run off the bottom of the snapshot are masked off.
+  const __m256i one = _mm256_set1_epi64x( 1 );
+  const __m256i size = _mm256_set1_epi64x( (long long) m_size );
+  const long long *base = reinterpret_cast< const long long* >( m_keys );
+  for ( ; i + 4 <= n; i += 4 ) {
+    __m256i q = _mm256_loadu_si256( reinterpret_cast< const __m256i* >( keys + i ) );
+    __m256i k = one;
+    for ( int level = 0; level < m_depth; ++level ) {
+      // Lanes where k <= size are still active
+      __m256i active = _mm256_xor_si256( _mm256_cmpgt_epi64( k, size ), _mm256_set1_epi64x( -1 ) );
+      __m256i elt = _mm256_mask_i64gather_epi64( _mm256_setzero_si256(), base, k, active, 8 );
+      // lt is all 1s (i.e., -1) in lanes where the element is less than the key
+      __m256i lt = _mm256_cmpgt_epi64( q, elt );
+      __m256i next = _mm256_sub_epi64( _mm256_add_epi64( k, k ), lt );
+      k = _mm256_blendv_epi8( k, next, active );
+    }
+
+    alignas( 32 ) uint64_t lanes[ 4 ];
+    _mm256_store_si256( reinterpret_cast< __m256i* >( lanes ), k );
+    for ( int j = 0; j < 4; ++j ) {
+      size_t idx = eytzinger_lower_bound_index( lanes[ j ] );
+      results[ i + j ] = ( idx != 0 && m_keys[ idx ] == keys[ i + j ] ) ? m_nodes[ idx ] : nullptr;
+    }
+  }
+#endif
+
+  for ( ; i < n; ++i )
+    results[ i ] = find( keys[ i ] );
+}
+
+size_t AATreeIntSnapshotImpl::lower_bound( int64_t key ) const {
+  size_t k = 1;
+  while ( k <= m_size ) {
+    DS_PREFETCH( m_keys + PREFETCH_FACTOR*k );
+    k = 2*k + ( m_keys[k] < key );
+  }
+  return eytzinger_lower_bound_index( k );
+}
+
+} // end namespace dslib
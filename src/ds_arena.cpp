@@ -0,0 +1,168 @@
+// Copyright 2025, David H. Hovemeyer <david.hovemeyer@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// “Software”), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+// THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <cstdlib>
+#include <sys/mman.h>
+#include "ds_arena.h"
+
+namespace dslib {
+
+namespace {
+
+// Huge page size (and alignment) for ARENA_HUGE_PAGES chunks
+const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+size_t round_up( size_t n, size_t align ) {
+  return ( n + align - 1 ) / align * align;
+}
+
+} // end anonymous namespace
+
+Arena::Arena( size_t chunk_size, unsigned flags )
+  : m_chunks( nullptr )
+  , m_pos( nullptr )
+  , m_end( nullptr )
+  , m_chunk_size( chunk_size )
+  , m_huge_pages( ( flags & ARENA_HUGE_PAGES ) != 0 )
+  , m_bytes_allocated( 0 ) {
+  DS_ASSERT( chunk_size > sizeof( Chunk ) );
+  if ( m_huge_pages )
+    m_chunk_size = round_up( m_chunk_size, HUGE_PAGE_SIZE );
+}
+
+Arena::~Arena() {
+  while ( m_chunks != nullptr ) {
+    Chunk *next = m_chunks->next;
+    free_chunk( m_chunks );
+    m_chunks = next;
+  }
+}
+
+void Arena::reset() {
+  // Keep one regular-sized chunk for reuse, and free the others
+  Chunk *keep = nullptr;
+  while ( m_chunks != nullptr ) {
+    Chunk *next = m_chunks->next;
+    if ( keep == nullptr && m_chunks->size == m_chunk_size ) {
+      keep = m_chunks;
+      keep->next = nullptr;
+    } else {
+      free_chunk( m_chunks );
+    }
+    m_chunks = next;
+  }
+
+  m_chunks = keep;
+  if ( keep != nullptr ) {
+    m_pos = reinterpret_cast< char* >( keep ) + sizeof( Chunk );
+    m_end = reinterpret_cast< char* >( keep ) + keep->size;
+  } else {
+    m_pos = m_end = nullptr;
+  }
+  m_bytes_allocated = 0;
+}
+
+size_t Arena::get_num_chunks() const {
+  size_t count = 0;
+  for ( Chunk *chunk = m_chunks; chunk != nullptr; chunk = chunk->next )
+    ++count;
+  return count;
+}
+
+// The current chunk doesn't have room: allocate a new one
+void *Arena::alloc_slow( size_t size, size_t align ) {
+  // Refuse allocations too large to describe as a chunk size
+  if ( size > SIZE_MAX - sizeof( Chunk ) - align )
+    return nullptr;
+
+  // Allocations that wouldn't fit in a regular chunk get a chunk
+  // of their own
+  size_t needed = sizeof( Chunk ) + align + size;
+  Chunk *chunk = new_chunk( needed > m_chunk_size ? needed : m_chunk_size );
+  if ( chunk == nullptr )
+    return nullptr;
+
+  // The current chunk is at the head of the list. An oversized
+  // chunk only becomes the current chunk if there is no other.
+  bool current = ( chunk->size == m_chunk_size ) || m_chunks == nullptr;
+  if ( current ) {
+    chunk->next = m_chunks;
+    m_chunks = chunk;
+  } else {
+    chunk->next = m_chunks->next;
+    m_chunks->next = chunk;
+  }
+
+  char *base = reinterpret_cast< char* >( chunk ) + sizeof( Chunk );
+  uintptr_t pos = ( reinterpret_cast< uintptr_t >( base ) + align - 1 ) & ~uintptr_t( align - 1 );
+  char *p = reinterpret_cast< char* >( pos );
+  if ( current ) {
+    m_pos = p + size;
+    m_end = reinterpret_cast< char* >( chunk ) + chunk->size;
+  }
+  m_bytes_allocated += size;
+  return p;
+}
+
+Arena::Chunk *Arena::new_chunk( size_t size ) {
+  void *mem;
+  if ( m_huge_pages ) {
+    // Map an extra huge page, so that the chunk can be aligned to
+    // a huge page boundary, and unmap the parts outside it
+    if ( size > SIZE_MAX - 2 * HUGE_PAGE_SIZE )
+      return nullptr;
+    size = round_up( size, HUGE_PAGE_SIZE );
+    size_t map_size = size + HUGE_PAGE_SIZE;
+    void *map = mmap( nullptr, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+    if ( map == MAP_FAILED )
+      return nullptr;
+    uintptr_t start = reinterpret_cast< uintptr_t >( map );
+    uintptr_t aligned = round_up( start, HUGE_PAGE_SIZE );
+    if ( aligned > start )
+      munmap( map, aligned - start );
+    if ( aligned + size < start + map_size )
+      munmap( reinterpret_cast< void* >( aligned + size ), start + map_size - ( aligned + size ) );
+    mem = reinterpret_cast< void* >( aligned );
+#ifdef MADV_HUGEPAGE
+    // (this is only advice: if huge pages aren't available, the
+    // chunk is still usable)
+    madvise( mem, size, MADV_HUGEPAGE );
+#endif
+  } else {
+    mem = malloc( size );
+    if ( mem == nullptr )
+      return nullptr;
+  }
+
+  Chunk *chunk = static_cast< Chunk* >( mem );
+  chunk->next = nullptr;
+  chunk->size = size;
+  return chunk;
+}
+
+void Arena::free_chunk( Chunk *chunk ) {
+  if ( m_huge_pages )
+    munmap( chunk, chunk->size );
+  else
+    free( chunk );
+}
+
+} // end namespace dslib
@@ -0,0 +1,72 @@
+// Copyright 2025, David H. Hovemeyer <david.hovemeyer@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// “Software”), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+// THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef DS_BINENC_H
+#define DS_BINENC_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace dslib {
+
+// Helpers for binary formats (used by the serialization and trace
+// code): little-endian integers, unsigned LEB128 integers, and
+// FNV-1a hashing.
+//
+// This header is internal to the library.
+
+// Maximum size of an unsigned LEB128-encoded 64-bit integer
+const size_t MAX_VARINT_SIZE = 10;
+
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+const uint64_t FNV_PRIME = 1099511628211ULL;
+
+inline uint64_t fnv1a( uint64_t hash, const unsigned char *data, size_t n ) {
+  for ( size_t i = 0; i < n; ++i )
+    hash = ( hash ^ data[ i ] ) * FNV_PRIME;
+  return hash;
+}
+
+inline void put_le( unsigned char *p, uint64_t val, int n ) {
+  for ( int i = 0; i < n; ++i )
+    p[ i ] = (unsigned char) ( val >> ( 8*i ) );
+}
+
+inline uint64_t get_le( const unsigned char *p, int n ) {
+  uint64_t val = 0;
+  for ( int i = 0; i < n; ++i )
+    val |= uint64_t( p[ i ] ) << ( 8*i );
+  return val;
+}
+
+inline size_t put_varint( unsigned char *p, uint64_t val ) {
+  size_t n = 0;
+  do {
+    unsigned char b = val & 0x7f;
+    val >>= 7;
+    p[ n++ ] = b | ( val != 0 ? 0x80 : 0 );
+  } while ( val != 0 );
+  return n;
+}
+
+} // end namespace dslib
+
+#endif // DS_BINENC_H
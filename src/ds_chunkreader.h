@@ -0,0 +1,109 @@
+// Copyright 2025, David H. Hovemeyer <david.hovemeyer@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// “Software”), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+// THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef DS_CHUNKREADER_H
+#define DS_CHUNKREADER_H
+
+#include <cstring>
+#include <vector>
+#include "ds_aatreeserial.h"
+#include "ds_binenc.h"
+
+namespace dslib {
+
+// Reads input from an AATreeReader a chunk at a time (used by the
+// serialization and trace code.)
+//
+// This header is internal to the library.
+
+class ChunkReader {
+private:
+  AATreeReader &m_reader;
+  std::vector< unsigned char > m_buf;
+  size_t m_pos, m_end;
+
+  NO_VALUE_SEMANTICS( ChunkReader );
+
+public:
+  ChunkReader( AATreeReader &reader, size_t chunk_size )
+    : m_reader( reader ), m_buf( chunk_size ), m_pos( 0 ), m_end( 0 ) { }
+
+  // Get a pointer to the next n bytes (which must be no more than
+  // a chunk), reading more input if needed: returns nullptr if the
+  // input ends first
+  const unsigned char *peek( size_t n ) {
+    DS_ASSERT( n <= m_buf.size() );
+    if ( m_end - m_pos < n ) {
+      memmove( m_buf.data(), m_buf.data() + m_pos, m_end - m_pos );
+      m_end -= m_pos;
+      m_pos = 0;
+      while ( m_end < n ) {
+        size_t count = m_reader.read( m_buf.data() + m_end, m_buf.size() - m_end );
+        if ( count == 0 )
+          return nullptr;
+        m_end += count;
+      }
+    }
+    return m_buf.data() + m_pos;
+  }
+
+  void skip( size_t n ) {
+    DS_ASSERT( n <= m_end - m_pos );
+    m_pos += n;
+  }
+
+  // Append the next n bytes (any number) to buf: returns false if
+  // the input ends first. (buf grows as the data is read, so a bogus
+  // length can't cause a huge allocation.)
+  bool read( std::vector< unsigned char > &buf, uint64_t n ) {
+    while ( n > 0 ) {
+      size_t count = n < m_buf.size() ? size_t( n ) : m_buf.size();
+      const unsigned char *p = peek( count );
+      if ( p == nullptr )
+        return false;
+      buf.insert( buf.end(), p, p + count );
+      skip( count );
+      n -= count;
+    }
+    return true;
+  }
+
+  // Read an unsigned LEB128 integer: returns the number of bytes
+  // it occupied, or 0 if it's invalid or the input ends first
+  size_t read_varint( uint64_t &val ) {
+    val = 0;
+    for ( size_t i = 0; i < MAX_VARINT_SIZE; ++i ) {
+      const unsigned char *p = peek( 1 );
+      if ( p == nullptr )
+        return 0;
+      unsigned char b = *p;
+      skip( 1 );
+      val |= uint64_t( b & 0x7f ) << ( 7*i );
+      if ( ( b & 0x80 ) == 0 )
+        return i + 1;
+    }
+    return 0;
+  }
+};
+
+} // end namespace dslib
+
+#endif // DS_CHUNKREADER_H
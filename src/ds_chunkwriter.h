@@ -19,27 +19,54 @@
 // OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
 // THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
-#ifndef DS_TREEPRINT_H
-#define DS_TREEPRINT_H
+#ifndef DS_CHUNKWRITER_H
+#define DS_CHUNKWRITER_H
 
-#include <string>
+#include <cstring>
+#include <vector>
+#include "ds_aatreeserial.h"
 
 namespace dslib {
 
-#ifdef DSLIB_CHECK_INTEGRITY
-class AATreeNode;
+// Buffers output, and passes it to an AATreeWriter a chunk at a time
+// (used by the serialization and export code.)
+//
+// This header is internal to the library.
+
+class ChunkWriter {
+private:
+  AATreeWriter &m_writer;
+  std::vector< unsigned char > m_buf;
+  size_t m_len;
+  bool m_ok;
+
+  NO_VALUE_SEMANTICS( ChunkWriter );
 
-class AATreePrint {
 public:
-  AATreePrint();
-  virtual ~AATreePrint();
+  ChunkWriter( AATreeWriter &writer, size_t chunk_size )
+    : m_writer( writer ), m_buf( chunk_size ), m_len( 0 ), m_ok( true ) { }
 
-  void print( AATreeNode *t ) const;
+  void write( const unsigned char *data, size_t n ) {
+    if ( m_len + n > m_buf.size() ) {
+      flush();
+      // Data larger than a chunk is written directly
+      if ( n > m_buf.size() ) {
+        m_ok = m_ok && m_writer.write( data, n );
+        return;
+      }
+    }
+    memcpy( m_buf.data() + m_len, data, n );
+    m_len += n;
+  }
 
-  virtual std::string node_contents_to_str( AATreeNode *t ) const = 0;
+  bool flush() {
+    if ( m_len > 0 )
+      m_ok = m_ok && m_writer.write( m_buf.data(), m_len );
+    m_len = 0;
+    return m_ok;
+  }
 };
-#endif // DSLIB_CHECK_INTEGRITY
 
 } // end namespace dslib
 
-#endif // DS_TREEPRINT_H
+#endif // DS_CHUNKWRITER_H
@@ -0,0 +1,146 @@
+// Copyright 2025, David H. Hovemeyer <david.hovemeyer@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// “Software”), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+// THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "ds_latency.h"
+
+#ifdef DSLIB_LATENCY
+
+namespace dslib {
+
+namespace {
+
+const int HALF_BUCKETS = 1 << ( LATENCY_SUB_BITS - 1 );
+
+// Index of the highest 1 bit of a nonzero value
+int msb_of( uint64_t v ) {
+  return 63 - __builtin_clzll( v );
+}
+
+} // end anonymous namespace
+
+LatencySnapshot::LatencySnapshot()
+  : m_counts()
+  , m_count( 0 )
+  , m_total_ns( 0 )
+  , m_min_ns( UINT64_MAX )
+  , m_max_ns( 0 ) {
+}
+
+uint64_t LatencySnapshot::get_percentile( double percentile ) const {
+  if ( m_count == 0 )
+    return 0;
+
+  // Find the bucket containing the nearest-rank value
+  double rank = percentile / 100.0 * m_count;
+  uint64_t target = rank < 1.0 ? 1 : uint64_t( rank );
+  if ( double( target ) < rank )
+    ++target;
+  if ( target > m_count )
+    target = m_count;
+
+  uint64_t seen = 0;
+  for ( int i = 0; i < LATENCY_NUM_BUCKETS; ++i ) {
+    seen += m_counts[ i ];
+    if ( seen >= target ) {
+      uint64_t upper = bucket_upper_bound( i );
+      return upper < m_max_ns ? upper : m_max_ns;
+    }
+  }
+  return m_max_ns;
+}
+
+void LatencySnapshot::merge( const LatencySnapshot &other ) {
+  for ( int i = 0; i < LATENCY_NUM_BUCKETS; ++i )
+    m_counts[ i ] += other.m_counts[ i ];
+  m_count += other.m_count;
+  m_total_ns += other.m_total_ns;
+  if ( other.m_min_ns < m_min_ns )
+    m_min_ns = other.m_min_ns;
+  if ( other.m_max_ns > m_max_ns )
+    m_max_ns = other.m_max_ns;
+}
+
+int LatencySnapshot::bucket_of( uint64_t ns ) {
+  if ( ns > LATENCY_MAX_NS )
+    ns = LATENCY_MAX_NS;
+  if ( ns < uint64_t( 2*HALF_BUCKETS ) )
+    return int( ns );
+
+  // The top LATENCY_SUB_BITS bits of the value (the highest of which
+  // is 1) select the bucket within its power of 2 range
+  int msb = msb_of( ns );
+  int shift = msb - ( LATENCY_SUB_BITS - 1 );
+  return 2*HALF_BUCKETS + ( msb - LATENCY_SUB_BITS ) * HALF_BUCKETS + int( ns >> shift ) - HALF_BUCKETS;
+}
+
+uint64_t LatencySnapshot::bucket_upper_bound( int bucket ) {
+  if ( bucket < 2*HALF_BUCKETS )
+    return uint64_t( bucket );
+
+  int msb = ( bucket - 2*HALF_BUCKETS ) / HALF_BUCKETS + LATENCY_SUB_BITS;
+  int sub = ( bucket - 2*HALF_BUCKETS ) % HALF_BUCKETS;
+  int shift = msb - ( LATENCY_SUB_BITS - 1 );
+  uint64_t lower = uint64_t( HALF_BUCKETS + sub ) << shift;
+  return lower + ( uint64_t( 1 ) << shift ) - 1;
+}
+
+LatencyHistogram::LatencyHistogram() {
+  reset();
+}
+
+void LatencyHistogram::record( uint64_t ns ) {
+  m_counts[ LatencySnapshot::bucket_of( ns ) ].fetch_add( 1, std::memory_order_relaxed );
+  m_count.fetch_add( 1, std::memory_order_relaxed );
+  m_total_ns.fetch_add( ns, std::memory_order_relaxed );
+
+  uint64_t min = m_min_ns.load( std::memory_order_relaxed );
+  while ( ns < min && !m_min_ns.compare_exchange_weak( min, ns, std::memory_order_relaxed ) )
+    ;
+  uint64_t max = m_max_ns.load( std::memory_order_relaxed );
+  while ( ns > max && !m_max_ns.compare_exchange_weak( max, ns, std::memory_order_relaxed ) )
+    ;
+}
+
+LatencySnapshot LatencyHistogram::snapshot() const {
+  // Note that if latencies are being recorded concurrently, the
+  // snapshot's total count may not quite match its buckets
+  LatencySnapshot snap;
+  for ( int i = 0; i < LATENCY_NUM_BUCKETS; ++i )
+    snap.m_counts[ i ] = m_counts[ i ].load( std::memory_order_relaxed );
+  snap.m_count = m_count.load( std::memory_order_relaxed );
+  snap.m_total_ns = m_total_ns.load( std::memory_order_relaxed );
+  snap.m_min_ns = m_min_ns.load( std::memory_order_relaxed );
+  snap.m_max_ns = m_max_ns.load( std::memory_order_relaxed );
+  return snap;
+}
+
+void LatencyHistogram::reset() {
+  for ( int i = 0; i < LATENCY_NUM_BUCKETS; ++i )
+    m_counts[ i ].store( 0, std::memory_order_relaxed );
+  m_count.store( 0, std::memory_order_relaxed );
+  m_total_ns.store( 0, std::memory_order_relaxed );
+  m_min_ns.store( UINT64_MAX, std::memory_order_relaxed );
+  m_max_ns.store( 0, std::memory_order_relaxed );
+}
+
+} // end namespace dslib
+
+#endif
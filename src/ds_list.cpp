@@ -19,23 +19,47 @@
 // OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
 // THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
+#include <new>
 #include "ds_list.h"
 
 namespace dslib {
 
-ListImpl::ListImpl( FreeNodeFn *free_node_fn )
-  : m_free_node_fn( free_node_fn ) {
+ListImpl::ListImpl( FreeNodeFn *free_node_fn, unsigned flags )
+  : m_free_node_fn( free_node_fn )
+  , m_free_node_ctx_fn( nullptr )
+  , m_context( nullptr )
+  , m_free_on_destroy( ( flags & LIST_NO_FREE_ON_DESTROY ) == 0 ) {
   DS_ASSERT( m_head.get_prev() == nullptr );
   DS_ASSERT( m_tail.get_next() == nullptr );
 
   m_head.set_next( &m_tail );
   m_tail.set_prev( &m_head );
+  DS_LATENCY( m_latency = nullptr );
+}
+
+ListImpl::ListImpl( FreeNodeCtxFn *free_node_fn, void *context, unsigned flags )
+  : m_free_node_fn( nullptr )
+  , m_free_node_ctx_fn( free_node_fn )
+  , m_context( context )
+  , m_free_on_destroy( ( flags & LIST_NO_FREE_ON_DESTROY ) == 0 ) {
+  m_head.set_next( &m_tail );
+  m_tail.set_prev( &m_head );
+  DS_LATENCY( m_latency = nullptr );
 }
 
 ListImpl::~ListImpl() {
+  DS_LATENCY( delete m_latency );
+
+  // The nodes belong to an arena, which will free them all at once
+  if ( !m_free_on_destroy )
+    return;
+
   for ( auto p = get_first(); p != nullptr; ) {
     auto succ = next( p );
-    m_free_node_fn( p );
+    if ( m_free_node_ctx_fn != nullptr )
+      m_free_node_ctx_fn( p, m_context );
+    else
+      m_free_node_fn( p );
     p = succ;
   }
 }
@@ -53,6 +77,8 @@ ListNode *ListImpl::get_last() const {
 }
 
 void ListImpl::append( ListNode *node ) {
+  DS_LATENCY( LatencyTimer timer( m_latency != nullptr ? &m_latency->insert : nullptr ) );
+  DS_STAT( m_insertions.add( 1 ) );
   DS_ASSERT( m_tail.get_prev() != nullptr );
   node->set_prev( m_tail.get_prev() );
   node->set_next( &m_tail );
@@ -61,6 +87,8 @@ void ListImpl::append( ListNode *node ) {
 }
 
 void ListImpl::prepend( ListNode *node ) {
+  DS_LATENCY( LatencyTimer timer( m_latency != nullptr ? &m_latency->insert : nullptr ) );
+  DS_STAT( m_insertions.add( 1 ) );
   DS_ASSERT( m_head.get_next() != nullptr );
   node->set_prev( &m_head );
   node->set_next( m_head.get_next() );
@@ -69,6 +97,8 @@ void ListImpl::prepend( ListNode *node ) {
 }
 
 void ListImpl::insert_before( ListNode *node_to_insert, ListNode *existing ) {
+  DS_LATENCY( LatencyTimer timer( m_latency != nullptr ? &m_latency->insert : nullptr ) );
+  DS_STAT( m_insertions.add( 1 ) );
   node_to_insert->set_prev( existing->get_prev() );
   node_to_insert->set_next( existing );
   existing->get_prev()->set_next( node_to_insert );
@@ -76,6 +106,8 @@ void ListImpl::insert_before( ListNode *node_to_insert, ListNode *existing ) {
 }
 
 void ListImpl::insert_after( ListNode *node_to_insert, ListNode *existing ) {
+  DS_LATENCY( LatencyTimer timer( m_latency != nullptr ? &m_latency->insert : nullptr ) );
+  DS_STAT( m_insertions.add( 1 ) );
   node_to_insert->set_prev( existing );
   node_to_insert->set_next( existing->get_next() );
   existing->get_next()->set_prev( node_to_insert );
@@ -83,6 +115,12 @@ void ListImpl::insert_after( ListNode *node_to_insert, ListNode *existing ) {
 }
 
 void ListImpl::remove( ListNode *node_to_remove ) {
+  DS_LATENCY( LatencyTimer timer( m_latency != nullptr ? &m_latency->remove : nullptr ) );
+  unlink( node_to_remove );
+}
+
+void ListImpl::unlink( ListNode *node_to_remove ) {
+  DS_STAT( m_removals.add( 1 ) );
   auto pred = node_to_remove->get_prev(), succ = node_to_remove->get_next();
   pred->set_next( succ );
   succ->set_prev( pred );
@@ -94,15 +132,17 @@ void ListImpl::remove( ListNode *node_to_remove ) {
 
 ListNode *ListImpl::remove_first() {
   DS_ASSERT( !is_empty() );
+  DS_LATENCY( LatencyTimer timer( m_latency != nullptr ? &m_latency->remove : nullptr ) );
   ListNode *first = get_first();
-  remove( first );
+  unlink( first );
   return first;
 }
 
 ListNode *ListImpl::remove_last() {
   DS_ASSERT( !is_empty() );
+  DS_LATENCY( LatencyTimer timer( m_latency != nullptr ? &m_latency->remove : nullptr ) );
   ListNode *last = get_last();
-  remove( last );
+  unlink( last );
   return last;
 }
 
@@ -110,6 +150,7 @@ unsigned ListImpl::get_size() const {
   unsigned count = 0;
   for ( auto p = get_first(); p != nullptr; p = next( p ) )
     ++count;
+  DS_STAT( m_nodes_visited.add( count ) );
   return count;
 }
 
@@ -123,4 +164,49 @@ ListNode *ListImpl::prev( ListNode *node ) const {
   return ( pred == &m_head ) ? nullptr : pred;
 }
 
+#ifdef DSLIB_STATS
+ListStats ListImpl::get_stats() const {
+  ListStats stats;
+  stats.insertions = m_insertions.get();
+  stats.removals = m_removals.get();
+  stats.nodes_visited = m_nodes_visited.get();
+  return stats;
+}
+
+void ListImpl::reset_stats() {
+  m_insertions.reset();
+  m_removals.reset();
+  m_nodes_visited.reset();
+}
+#endif
+
+#ifdef DSLIB_LATENCY
+bool ListImpl::enable_latency() {
+  if ( m_latency == nullptr )
+    m_latency = new ( std::nothrow ) Latencies;
+  return m_latency != nullptr;
+}
+
+void ListImpl::disable_latency() {
+  delete m_latency;
+  m_latency = nullptr;
+}
+
+ListLatency ListImpl::get_latency() const {
+  ListLatency latency;
+  if ( m_latency != nullptr ) {
+    latency.insert = m_latency->insert.snapshot();
+    latency.remove = m_latency->remove.snapshot();
+  }
+  return latency;
+}
+
+void ListImpl::reset_latency() {
+  if ( m_latency == nullptr )
+    return;
+  m_latency->insert.reset();
+  m_latency->remove.reset();
+}
+#endif
+
 } // end namespace dslib
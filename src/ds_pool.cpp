@@ -0,0 +1,144 @@
+// Copyright 2025, David H. Hovemeyer <david.hovemeyer@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// “Software”), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+// THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <cstdlib>
+#include "ds_pool.h"
+
+namespace dslib {
+
+PoolImpl::PoolImpl( size_t object_size, size_t object_align, size_t max_empty_slabs )
+  : m_max_empty_slabs( max_empty_slabs )
+  , m_partial( &free_slab )
+  , m_full( &free_slab )
+  , m_empty( &free_slab )
+  , m_num_slabs( 0 )
+  , m_num_empty_slabs( 0 )
+  , m_num_allocated( 0 ) {
+  // Free objects hold a free list link, so each object must be
+  // able to hold a pointer (and be aligned for one)
+  if ( object_align < alignof( void* ) )
+    object_align = alignof( void* );
+  if ( object_size < sizeof( void* ) )
+    object_size = sizeof( void* );
+  m_object_size = round_up( object_size, object_align );
+  m_first_offset = round_up( sizeof( PoolSlab ), object_align );
+
+  // Objects must be small enough for a slab to hold several of them:
+  // if they aren't, every allocation fails
+  m_objects_per_slab = can_hold( object_size, object_align )
+                     ? ( POOL_SLAB_SIZE - m_first_offset ) / m_object_size
+                     : 0;
+}
+
+PoolImpl::~PoolImpl() {
+  // The slab lists free their slabs
+}
+
+void *PoolImpl::alloc() {
+  if ( m_objects_per_slab == 0 )
+    return nullptr; // objects are too large for a slab
+
+  PoolSlab *slab = m_partial.get_first();
+  if ( slab == nullptr ) {
+    // Reuse an empty slab, or allocate a new one
+    slab = m_empty.get_first();
+    if ( slab != nullptr ) {
+      m_empty.remove( slab );
+      --m_num_empty_slabs;
+    } else {
+      void *mem = aligned_alloc( POOL_SLAB_SIZE, POOL_SLAB_SIZE );
+      if ( mem == nullptr )
+        return nullptr;
+      slab = new ( mem ) PoolSlab( this, m_objects_per_slab );
+      ++m_num_slabs;
+    }
+    m_partial.prepend( slab );
+  }
+
+  // Take an object from the slab's free list, or else the first of
+  // its never-allocated objects (so that a new slab's memory is only
+  // touched as it is used)
+  void *obj = slab->m_free;
+  if ( obj != nullptr ) {
+    slab->m_free = *static_cast< void** >( obj );
+  } else {
+    DS_ASSERT( slab->m_num_unused > 0 );
+    size_t index = m_objects_per_slab - slab->m_num_unused;
+    obj = reinterpret_cast< char* >( slab ) + m_first_offset + index * m_object_size;
+    --slab->m_num_unused;
+  }
+
+  if ( --slab->m_num_free == 0 ) {
+    m_partial.remove( slab );
+    m_full.append( slab );
+  }
+  ++m_num_allocated;
+  return obj;
+}
+
+void PoolImpl::free( void *obj ) {
+  PoolSlab *slab = slab_of( obj );
+  DS_ASSERT( slab->m_pool == this );
+  DS_ASSERT( m_num_allocated > 0 );
+
+  *static_cast< void** >( obj ) = slab->m_free;
+  slab->m_free = obj;
+  --m_num_allocated;
+
+  if ( slab->m_num_free++ == 0 ) {
+    // The slab was full
+    m_full.remove( slab );
+    if ( slab->m_num_free == m_objects_per_slab )
+      slab_emptied( slab );
+    else
+      m_partial.prepend( slab );
+  } else if ( slab->m_num_free == m_objects_per_slab ) {
+    m_partial.remove( slab );
+    slab_emptied( slab );
+  }
+}
+
+void PoolImpl::release_empty_slabs() {
+  while ( !m_empty.is_empty() ) {
+    free_slab( m_empty.remove_first() );
+    --m_num_slabs;
+  }
+  m_num_empty_slabs = 0;
+}
+
+// Keep a slab which has become empty for reuse, or free it if
+// there are enough empty slabs already
+void PoolImpl::slab_emptied( PoolSlab *slab ) {
+  if ( m_num_empty_slabs < m_max_empty_slabs ) {
+    m_empty.prepend( slab );
+    ++m_num_empty_slabs;
+  } else {
+    free_slab( slab );
+    --m_num_slabs;
+  }
+}
+
+void PoolImpl::free_slab( ListNode *slab ) {
+  static_cast< PoolSlab* >( slab )->~PoolSlab();
+  std::free( slab );
+}
+
+} // end namespace dslib
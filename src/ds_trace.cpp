@@ -0,0 +1,206 @@
+// Copyright 2025, David H. Hovemeyer <david.hovemeyer@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// “Software”), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+// THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <cstring>
+#include "ds_trace.h"
+#include "ds_chunkwriter.h"
+#include "ds_chunkreader.h"
+#include "ds_binenc.h"
+
+namespace dslib {
+
+namespace {
+
+const char MAGIC[ 8 ] = { 'D', 'S', 'L', 'T', 'R', 'A', 'C', 'E' };
+const size_t HEADER_SIZE = 16;
+const size_t END_SIZE = 17;
+
+// Size of the chunks in which data is written and read
+const size_t CHUNK_SIZE = 64 * 1024;
+
+// Initial size of the buffer for encoding keys
+const size_t KEY_BUF_SIZE = 64;
+
+// Encode a key into buf (which grows if the encoding doesn't fit)
+template< typename NodeType, typename EncodeFn >
+size_t encode_key( const NodeType *node, EncodeFn *encode_fn, std::vector< unsigned char > &buf ) {
+  size_t size = encode_fn( node, buf.data(), buf.size() );
+  if ( size > buf.size() ) {
+    buf.resize( size );
+    size = encode_fn( node, buf.data(), buf.size() );
+    DS_ASSERT( size <= buf.size() );
+  }
+  return size;
+}
+
+} // end anonymous namespace
+
+////////////////////////////////////////////////////////////////////////
+// TraceRecorder implementation
+////////////////////////////////////////////////////////////////////////
+
+TraceRecorder::TraceRecorder( AATreeWriter &writer, TraceKind kind )
+  : m_out( new ChunkWriter( writer, CHUNK_SIZE ) )
+  , m_key( KEY_BUF_SIZE )
+  , m_last( std::chrono::steady_clock::now() )
+  , m_count( 0 )
+  , m_hash( FNV_OFFSET_BASIS )
+  , m_finished( false ) {
+  unsigned char header[ HEADER_SIZE ];
+  memcpy( header, MAGIC, sizeof( MAGIC ) );
+  put_le( header + 8, TRACE_VERSION, 4 );
+  put_le( header + 12, uint32_t( kind ), 4 );
+  m_out->write( header, HEADER_SIZE );
+}
+
+TraceRecorder::~TraceRecorder() {
+  if ( !m_finished )
+    finish();
+  delete m_out;
+}
+
+void TraceRecorder::record( TraceOp op, const AATreeNode *node, AATreeSerialImpl::EncodeNodeFn *encode_fn ) {
+  record_key( op, encode_key( node, encode_fn, m_key ) );
+}
+
+void TraceRecorder::record( TraceOp op, const ListNode *node, EncodeListNodeFn *encode_fn ) {
+  record_key( op, encode_key( node, encode_fn, m_key ) );
+}
+
+void TraceRecorder::record_key( TraceOp op, size_t key_size ) {
+  DS_ASSERT( !m_finished );
+
+  auto now = std::chrono::steady_clock::now();
+  uint64_t delta = uint64_t( std::chrono::duration_cast< std::chrono::nanoseconds >( now - m_last ).count() );
+  m_last = now;
+
+  unsigned char prefix[ 1 + 2*MAX_VARINT_SIZE ];
+  size_t prefix_size = 0;
+  prefix[ prefix_size++ ] = (unsigned char) op;
+  prefix_size += put_varint( prefix + prefix_size, delta );
+  prefix_size += put_varint( prefix + prefix_size, key_size );
+
+  m_out->write( prefix, prefix_size );
+  m_out->write( m_key.data(), key_size );
+  m_hash = fnv1a( m_hash, prefix, prefix_size );
+  m_hash = fnv1a( m_hash, m_key.data(), key_size );
+  ++m_count;
+}
+
+bool TraceRecorder::finish() {
+  DS_ASSERT( !m_finished );
+  m_finished = true;
+
+  unsigned char end[ END_SIZE ];
+  end[ 0 ] = 0;
+  put_le( end + 1, m_count, 8 );
+  put_le( end + 9, m_hash, 8 );
+  m_out->write( end, END_SIZE );
+  return m_out->flush();
+}
+
+////////////////////////////////////////////////////////////////////////
+// TraceReader implementation
+////////////////////////////////////////////////////////////////////////
+
+TraceReader::TraceReader( AATreeReader &reader )
+  : m_in( new ChunkReader( reader, CHUNK_SIZE ) )
+  , m_kind( TRACE_AATREE )
+  , m_time_ns( 0 )
+  , m_count( 0 )
+  , m_hash( FNV_OFFSET_BASIS )
+  , m_ok( false )
+  , m_done( false ) {
+  const unsigned char *header = m_in->peek( HEADER_SIZE );
+  if ( header == nullptr
+       || memcmp( header, MAGIC, sizeof( MAGIC ) ) != 0
+       || get_le( header + 8, 4 ) != TRACE_VERSION )
+    return;
+  uint64_t kind = get_le( header + 12, 4 );
+  if ( kind != TRACE_AATREE && kind != TRACE_LIST )
+    return;
+  m_kind = TraceKind( kind );
+  m_in->skip( HEADER_SIZE );
+  m_ok = true;
+}
+
+TraceReader::~TraceReader() {
+  delete m_in;
+}
+
+bool TraceReader::next( TraceRecord &rec ) {
+  if ( !m_ok || m_done )
+    return false;
+
+  const unsigned char *p = m_in->peek( 1 );
+  if ( p == nullptr ) {
+    // truncated
+    m_ok = false;
+    return false;
+  }
+  unsigned char op = *p;
+
+  if ( op == 0 ) {
+    // End marker: check the number of records and the hash
+    const unsigned char *end = m_in->peek( END_SIZE );
+    m_ok = end != nullptr
+           && get_le( end + 1, 8 ) == m_count
+           && get_le( end + 9, 8 ) == m_hash;
+    if ( end != nullptr )
+      m_in->skip( END_SIZE );
+    m_done = true;
+    return false;
+  }
+  m_in->skip( 1 );
+
+  uint64_t delta, key_size;
+  if ( op > TRACE_REMOVE_LAST
+       || m_in->read_varint( delta ) == 0
+       || m_in->read_varint( key_size ) == 0 ) {
+    m_ok = false;
+    return false;
+  }
+
+  m_key.clear();
+  if ( !m_in->read( m_key, key_size ) ) {
+    m_ok = false;
+    return false;
+  }
+
+  // Hash the record as it was written
+  unsigned char prefix[ 1 + 2*MAX_VARINT_SIZE ];
+  size_t prefix_size = 0;
+  prefix[ prefix_size++ ] = op;
+  prefix_size += put_varint( prefix + prefix_size, delta );
+  prefix_size += put_varint( prefix + prefix_size, key_size );
+  m_hash = fnv1a( m_hash, prefix, prefix_size );
+  m_hash = fnv1a( m_hash, m_key.data(), m_key.size() );
+  ++m_count;
+
+  m_time_ns += delta;
+  rec.op = TraceOp( op );
+  rec.time_ns = m_time_ns;
+  rec.key = m_key.data();
+  rec.key_size = m_key.size();
+  return true;
+}
+
+} // end namespace dslib
@@ -1,13 +1,29 @@
 #include <iostream>
+#include <cstring>
+#include <cstdint>
 #include <string>
 #include <sstream>
 #include <vector>
 #include <set>
 #include <algorithm>
 #include <random>
+#include <new>
+#include <atomic>
+#include <iterator>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include "tctest.h"
 #include "ds_aatree.h"
-#include "ds_aatreeprint.h"
+#include "ds_aatreesnapshot.h"
+#include "ds_aatreepar.h"
+#include "ds_aatreeserial.h"
+#include "ds_aatreeregion.h"
+#include "ds_aatreestatic.h"
+#include "ds_aatreecheck.h"
+#include "ds_aatreeexport.h"
+#include "ds_trace.h"
 
 ////////////////////////////////////////////////////////////////////////
 // Integer tree node type for testing
@@ -29,10 +45,24 @@ public:
   static void free_node_fn( dslib::AATreeNode *node );
   static void copy_node_fn( dslib::AATreeNode *from, dslib::AATreeNode *to );
   static bool less_than_fn( const dslib::AATreeNode *left, const dslib::AATreeNode *right );
+  static dslib::AATreeNode *relocate_node_fn( dslib::AATreeNode *from, void *to );
+  static int64_t get_key_fn( const dslib::AATreeNode *node );
+  static size_t encode_node_fn( const dslib::AATreeNode *node, void *buf, size_t size );
+  static dslib::AATreeNode *decode_node_fn( const void *data, size_t size );
+  static size_t label_fn( const dslib::AATreeNode *node, char *buf, size_t size );
 };
 
-void IntAATreeNode::free_node_fn( dslib::AATreeNode *node ) {
-  delete static_cast< IntAATreeNode* >( node );
+// Bounds of the buffer used by test_relayout(): nodes within it
+// must not be deleted individually
+char *relayout_buf_begin, *relayout_buf_end;
+
+void IntAATreeNode::free_node_fn( dslib::AATreeNode *node_ ) {
+  IntAATreeNode *node = static_cast< IntAATreeNode* >( node_ );
+  char *p = reinterpret_cast< char* >( node );
+  if ( p >= relayout_buf_begin && p < relayout_buf_end )
+    node->~IntAATreeNode();
+  else
+    delete node;
 }
 
 void IntAATreeNode::copy_node_fn( dslib::AATreeNode *from_, dslib::AATreeNode *to_ ) {
@@ -42,37 +72,194 @@ void IntAATreeNode::copy_node_fn( dslib::AATreeNode *from_, dslib::AATreeNode *t
   to->set_val( from->get_val() );
 }
 
+dslib::AATreeNode *IntAATreeNode::relocate_node_fn( dslib::AATreeNode *from_, void *to ) {
+  IntAATreeNode *from = static_cast< IntAATreeNode* >( from_ );
+  IntAATreeNode *moved = new ( to ) IntAATreeNode( from->get_val() );
+  delete from;
+  return moved;
+}
+
+int64_t IntAATreeNode::get_key_fn( const dslib::AATreeNode *node ) {
+  return static_cast< const IntAATreeNode* >( node )->get_val();
+}
+
+size_t IntAATreeNode::encode_node_fn( const dslib::AATreeNode *node, void *buf, size_t size ) {
+  int val = static_cast< const IntAATreeNode* >( node )->get_val();
+  if ( size >= sizeof( val ) )
+    memcpy( buf, &val, sizeof( val ) );
+  return sizeof( val );
+}
+
+size_t IntAATreeNode::label_fn( const dslib::AATreeNode *node, char *buf, size_t size ) {
+  int val = static_cast< const IntAATreeNode* >( node )->get_val();
+  return size_t( snprintf( buf, size, "%d", val ) );
+}
+
+dslib::AATreeNode *IntAATreeNode::decode_node_fn( const void *data, size_t size ) {
+  int val;
+  if ( size != sizeof( val ) )
+    return nullptr;
+  memcpy( &val, data, sizeof( val ) );
+  return new IntAATreeNode( val );
+}
+
+// Number of calls to IntAATreeNode::less_than_fn() (atomic, since
+// the parallel operations make comparisons from multiple threads)
+std::atomic< long > num_comparisons;
+
 bool IntAATreeNode::less_than_fn( const dslib::AATreeNode *left_, const dslib::AATreeNode *right_ ) {
+  ++num_comparisons;
   const IntAATreeNode *left = static_cast< const IntAATreeNode* >( left_ );
   const IntAATreeNode *right = static_cast< const IntAATreeNode* >( right_ );
   return left->m_val < right->m_val;
 }
 
 ////////////////////////////////////////////////////////////////////////
-// Support for printing the test AATree
+// Integer tree node type with parent links
 ////////////////////////////////////////////////////////////////////////
 
-class IntAATreePrint : public dslib::AATreePrint {
+class IntAATreeParentNode : public dslib::AATreeParentNode {
+private:
+  int m_val;
+
+  NO_VALUE_SEMANTICS( IntAATreeParentNode );
+
 public:
-  IntAATreePrint();
-  virtual ~IntAATreePrint();
+  IntAATreeParentNode( int val = 0 ) : m_val( val ) { }
+  ~IntAATreeParentNode() { }
 
-  virtual std::string node_contents_to_str( dslib::AATreeNode *t ) const;
-};
+  int get_val() const { return m_val; }
 
-IntAATreePrint::IntAATreePrint() {
+  static void free_node_fn( dslib::AATreeNode *node );
+  static bool less_than_fn( const dslib::AATreeNode *left, const dslib::AATreeNode *right );
+  static dslib::AATreeNode *relocate_node_fn( dslib::AATreeNode *from, void *to );
+};
 
+void IntAATreeParentNode::free_node_fn( dslib::AATreeNode *node_ ) {
+  IntAATreeParentNode *node = static_cast< IntAATreeParentNode* >( node_ );
+  char *p = reinterpret_cast< char* >( node );
+  if ( p >= relayout_buf_begin && p < relayout_buf_end )
+    node->~IntAATreeParentNode();
+  else
+    delete node;
 }
 
-IntAATreePrint::~IntAATreePrint() {
-
+bool IntAATreeParentNode::less_than_fn( const dslib::AATreeNode *left_, const dslib::AATreeNode *right_ ) {
+  ++num_comparisons;
+  const IntAATreeParentNode *left = static_cast< const IntAATreeParentNode* >( left_ );
+  const IntAATreeParentNode *right = static_cast< const IntAATreeParentNode* >( right_ );
+  return left->m_val < right->m_val;
 }
 
-std::string IntAATreePrint::node_contents_to_str( dslib::AATreeNode *t_ ) const {
-  IntAATreeNode *t = static_cast< IntAATreeNode* >( t_ );
-  return std::to_string( t->get_val() );
+dslib::AATreeNode *IntAATreeParentNode::relocate_node_fn( dslib::AATreeNode *from_, void *to ) {
+  IntAATreeParentNode *from = static_cast< IntAATreeParentNode* >( from_ );
+  IntAATreeParentNode *moved = new ( to ) IntAATreeParentNode( from->get_val() );
+  delete from;
+  return moved;
 }
 
+////////////////////////////////////////////////////////////////////////
+// Integer tree node type for region trees
+////////////////////////////////////////////////////////////////////////
+
+class IntRegionNode : public dslib::AATreeRegionNode {
+private:
+  int m_val;
+
+  NO_VALUE_SEMANTICS( IntRegionNode );
+
+public:
+  IntRegionNode( int val = 0 ) : m_val( val ) { }
+  ~IntRegionNode() { }
+
+  void set_val( int val ) { m_val = val; }
+  int get_val() const { return m_val; }
+
+  static bool less_than_fn( const dslib::AATreeRegionNode *left, const dslib::AATreeRegionNode *right ) {
+    return static_cast< const IntRegionNode* >( left )->m_val
+         < static_cast< const IntRegionNode* >( right )->m_val;
+  }
+};
+
+typedef dslib::AATreeRegion< IntRegionNode > IntRegionTree;
+
+////////////////////////////////////////////////////////////////////////
+// Node type for static trees
+////////////////////////////////////////////////////////////////////////
+
+class StaticNode : public dslib::AATreeNode {
+private:
+  int m_key;
+  const char *m_name;
+
+  NO_VALUE_SEMANTICS( StaticNode );
+
+public:
+  struct Value {
+    int key;
+    const char *name;
+  };
+
+  constexpr StaticNode( const dslib::AATreeStaticLinks &links, const Value &v )
+    : AATreeNode( links ), m_key( v.key ), m_name( v.name ) { }
+  StaticNode( int key ) : m_key( key ), m_name( nullptr ) { }
+
+  int get_key() const { return m_key; }
+  const char *get_name() const { return m_name; }
+
+  static bool less_than_fn( const dslib::AATreeNode *left, const dslib::AATreeNode *right ) {
+    ++num_comparisons;
+    return static_cast< const StaticNode* >( left )->m_key
+         < static_cast< const StaticNode* >( right )->m_key;
+  }
+};
+
+constexpr StaticNode::Value STATIC_VALS[] = {
+  { 2, "two" }, { 3, "three" }, { 5, "five" }, { 7, "seven" }, { 11, "eleven" },
+  { 13, "thirteen" }, { 17, "seventeen" }, { 19, "nineteen" }, { 23, "twenty-three" },
+  { 29, "twenty-nine" }, { 31, "thirty-one" }, { 37, "thirty-seven" },
+};
+
+constexpr dslib::AATreeStatic< StaticNode, 12 > STATIC_TREE( STATIC_VALS, &StaticNode::less_than_fn );
+
+////////////////////////////////////////////////////////////////////////
+// In-memory serialization
+////////////////////////////////////////////////////////////////////////
+
+class VectorWriter : public dslib::AATreeWriter {
+public:
+  std::vector< unsigned char > data;
+
+  virtual bool write( const void *p, size_t n ) {
+    const unsigned char *bytes = static_cast< const unsigned char* >( p );
+    data.insert( data.end(), bytes, bytes + n );
+    return true;
+  }
+};
+
+// Reads at most max_read bytes at a time, to exercise
+// records that span chunks
+class VectorReader : public dslib::AATreeReader {
+private:
+  const std::vector< unsigned char > &m_data;
+  size_t m_pos, m_max_read;
+
+public:
+  VectorReader( const std::vector< unsigned char > &data, size_t max_read = SIZE_MAX )
+    : m_data( data ), m_pos( 0 ), m_max_read( max_read ) { }
+
+  virtual size_t read( void *buf, size_t n ) {
+    n = std::min( n, std::min( m_max_read, m_data.size() - m_pos ) );
+    // (an empty vector's data() may be null, which memcpy() doesn't
+    // allow even when copying nothing)
+    if ( n == 0 )
+      return 0;
+    memcpy( buf, m_data.data() + m_pos, n );
+    m_pos += n;
+    return n;
+  }
+};
+
 ////////////////////////////////////////////////////////////////////////
 // Turn dslib assertions into tctest test failures
 ////////////////////////////////////////////////////////////////////////
@@ -93,10 +280,18 @@ void assert_fail( const char *msg, const char *filename, int line ) {
 ////////////////////////////////////////////////////////////////////////
 
 struct TestObjs {
+  // buffer for relayout(): it's declared before the tree so that
+  // it is destroyed after the tree
+  std::vector< char > buf;
   dslib::AATree< IntAATreeNode > itree;
+  dslib::AATree< IntAATreeNode > ttree; // threaded
+  dslib::AATree< IntAATreeParentNode > ptree; // with parent links
 
   TestObjs()
     : itree( &IntAATreeNode::less_than_fn, &IntAATreeNode::copy_node_fn, &IntAATreeNode::free_node_fn )
+    , ttree( &IntAATreeNode::less_than_fn, &IntAATreeNode::copy_node_fn, &IntAATreeNode::free_node_fn, dslib::AA_TREE_THREADED )
+    // nodes are never copied when a tree has parent links
+    , ptree( &IntAATreeParentNode::less_than_fn, nullptr, &IntAATreeParentNode::free_node_fn )
   { }
 };
 
@@ -113,15 +308,72 @@ constexpr const int MANY = 100000;
 // test fixture setup and cleanup
 TestObjs *setup();
 void cleanup( TestObjs *objs );
+// helper functions
+char *alloc_relayout_buf( TestObjs *objs, size_t num_nodes, size_t node_size = sizeof( IntAATreeNode ) );
+template< typename NodeType >
+void check_update_mix( dslib::AATree< NodeType > &tree );
+template< typename NodeType, typename BuildFn >
+void check_build( dslib::AATree< NodeType > &tree, int n, BuildFn build_fn );
+template< typename NodeType, typename SetOpFn >
+void check_set_ops( dslib::AATree< NodeType > &tree, dslib::AATree< NodeType > &other, SetOpFn set_op_fn );
 // test functions
 void test_insert( TestObjs *objs );
 void test_insert_many( TestObjs *objs );
+void test_find_many( TestObjs *objs );
+void test_find_sorted( TestObjs *objs );
+void test_find_sorted_many( TestObjs *objs );
 void test_remove_one( TestObjs *objs );
 void test_remove( TestObjs *objs );
 void test_remove_many( TestObjs *objs );
+void test_update_mix( TestObjs *objs );
 void test_iterator_empty( TestObjs *objs );
 void test_iterator( TestObjs *objs );
 void test_postfix_iterator( TestObjs *objs );
+void test_get_size( TestObjs *objs );
+void test_relayout( TestObjs *objs );
+void test_relayout_partial( TestObjs *objs );
+void test_snapshot( TestObjs *objs );
+void test_int_snapshot( TestObjs *objs );
+void test_int_snapshot_find_many( TestObjs *objs );
+void test_threaded_iterator( TestObjs *objs );
+void test_threaded_update_mix( TestObjs *objs );
+void test_threaded_relayout( TestObjs *objs );
+void test_parent_update_mix( TestObjs *objs );
+void test_parent_remove_node( TestObjs *objs );
+void test_parent_successor( TestObjs *objs );
+void test_parent_relayout( TestObjs *objs );
+void test_max_height_for_size( TestObjs *objs );
+void test_max_height( TestObjs *objs );
+void test_parallel_for_each( TestObjs *objs );
+void test_parallel_reduce( TestObjs *objs );
+void test_build( TestObjs *objs );
+void test_parallel_build( TestObjs *objs );
+void test_set_ops( TestObjs *objs );
+void test_parallel_set_ops( TestObjs *objs );
+void test_set_ops_refused( TestObjs *objs );
+void test_serialize( TestObjs *objs );
+void test_serialize_large_records( TestObjs *objs );
+void test_serialize_file( TestObjs *objs );
+void test_load_invalid( TestObjs *objs );
+void test_region( TestObjs *objs );
+void test_region_mmap( TestObjs *objs );
+void test_region_corrupt( TestObjs *objs );
+void test_static( TestObjs *objs );
+void test_static_sizes( TestObjs *objs );
+#ifdef DSLIB_STATS
+void test_stats( TestObjs *objs );
+#endif
+void test_checker( TestObjs *objs );
+void test_checker_invalid( TestObjs *objs );
+void test_export( TestObjs *objs );
+void test_export_limits( TestObjs *objs );
+#ifdef DSLIB_LATENCY
+void test_latency_histogram( TestObjs *objs );
+void test_latency( TestObjs *objs );
+#endif
+void test_trace( TestObjs *objs );
+void test_trace_invalid( TestObjs *objs );
+void test_context( TestObjs *objs );
 
 ////////////////////////////////////////////////////////////////////////
 // Test program
@@ -134,13 +386,62 @@ int main( int argc, char **argv ) {
   TEST_INIT();
 
   TEST( test_insert );
-  TEST( test_insert_many );
+  BENCH( test_insert_many, 20 );
+  TEST( test_find_many );
+  TEST( test_find_sorted );
+  TEST( test_find_sorted_many );
   TEST( test_remove_one );
   TEST( test_remove );
-  TEST( test_remove_many );
+  BENCH( test_remove_many, 20 );
+  TEST( test_update_mix );
   TEST( test_iterator_empty );
   TEST( test_iterator );
   TEST( test_postfix_iterator );
+  TEST( test_get_size );
+  TEST( test_relayout );
+  TEST( test_relayout_partial );
+  TEST( test_snapshot );
+  TEST( test_int_snapshot );
+  TEST( test_int_snapshot_find_many );
+  TEST( test_threaded_iterator );
+  TEST( test_threaded_update_mix );
+  TEST( test_threaded_relayout );
+  TEST( test_parent_update_mix );
+  TEST( test_parent_remove_node );
+  TEST( test_parent_successor );
+  TEST( test_parent_relayout );
+  TEST( test_max_height_for_size );
+  TEST( test_max_height );
+  TEST( test_parallel_for_each );
+  TEST( test_parallel_reduce );
+  TEST( test_build );
+  TEST( test_parallel_build );
+  TEST( test_set_ops );
+  TEST( test_parallel_set_ops );
+  TEST( test_set_ops_refused );
+  TEST( test_serialize );
+  TEST( test_serialize_large_records );
+  TEST( test_serialize_file );
+  TEST( test_load_invalid );
+  TEST( test_region );
+  TEST( test_region_mmap );
+  TEST( test_region_corrupt );
+  TEST( test_static );
+  TEST( test_static_sizes );
+#ifdef DSLIB_STATS
+  TEST( test_stats );
+#endif
+  TEST( test_checker );
+  TEST( test_checker_invalid );
+  TEST( test_export );
+  TEST( test_export_limits );
+#ifdef DSLIB_LATENCY
+  TEST( test_latency_histogram );
+  TEST( test_latency );
+#endif
+  TEST( test_trace );
+  TEST( test_trace_invalid );
+  TEST( test_context );
 
   TEST_FINI();
 }
@@ -156,6 +457,16 @@ TestObjs *setup() {
 
 void cleanup( TestObjs *objs ) {
   delete objs;
+  relayout_buf_begin = relayout_buf_end = nullptr;
+}
+
+// Allocate a buffer for relayout() with room for the given number of
+// nodes
+char *alloc_relayout_buf( TestObjs *objs, size_t num_nodes, size_t node_size ) {
+  objs->buf.resize( num_nodes * node_size );
+  relayout_buf_begin = objs->buf.data();
+  relayout_buf_end = relayout_buf_begin + objs->buf.size();
+  return relayout_buf_begin;
 }
 
 void test_insert( TestObjs *objs ) {
@@ -175,9 +486,10 @@ void test_insert( TestObjs *objs ) {
 }
 
 void test_insert_many( TestObjs *objs ) {
+  const int many = tctest_scale( MANY );
   auto rng = std::default_random_engine();
   std::vector<int> vals;
-  for ( int i = 0; i < MANY; ++i )
+  for ( int i = 0; i < many; ++i )
     vals.push_back( i );
   std::shuffle( vals.begin(), vals.end(), rng );
 
@@ -195,6 +507,94 @@ void test_insert_many( TestObjs *objs ) {
     ASSERT( itree.contains( IntAATreeNode( *i ) ) );
 }
 
+void test_find_many( TestObjs *objs ) {
+  auto &itree = objs->itree;
+
+  for ( auto i = TEST_VALS.begin(); i != TEST_VALS.end(); ++i )
+    itree.insert( new IntAATreeNode( *i ) );
+
+  // Search for every value from 0..99 (most of which aren't in the tree),
+  // in batches of various sizes
+  std::vector< IntAATreeNode* > keys;
+  for ( int i = 0; i < 100; ++i )
+    keys.push_back( new IntAATreeNode( i ) );
+
+  for ( size_t batch = 1; batch <= keys.size(); batch += 7 ) {
+    std::vector< IntAATreeNode* > results( keys.size(), nullptr );
+    for ( size_t i = 0; i < keys.size(); i += batch ) {
+      size_t count = std::min( batch, keys.size() - i );
+      itree.find_many( keys.data() + i, count, results.data() + i );
+    }
+
+    for ( size_t i = 0; i < keys.size(); ++i )
+      ASSERT( results[ i ] == itree.find( *keys[ i ] ) );
+  }
+
+  for ( auto i = keys.begin(); i != keys.end(); ++i )
+    delete *i;
+}
+
+void test_find_sorted( TestObjs *objs ) {
+  auto &itree = objs->itree;
+
+  // Searching an empty tree
+  IntAATreeNode key( 42 );
+  auto f = itree.finger();
+  ASSERT( f.find( key ) == nullptr );
+
+  for ( auto i = TEST_VALS.begin(); i != TEST_VALS.end(); ++i )
+    itree.insert( new IntAATreeNode( *i ) );
+
+  // Search for 0..99 (with some duplicates)
+  std::vector< IntAATreeNode* > keys;
+  for ( int i = 0; i < 100; ++i ) {
+    keys.push_back( new IntAATreeNode( i ) );
+    if ( i % 8 == 0 )
+      keys.push_back( new IntAATreeNode( i ) );
+  }
+
+  size_t count = 0;
+  itree.find_sorted( keys.data(), keys.size(),
+    [&]( const IntAATreeNode *key, IntAATreeNode *found ) {
+      ASSERT( key == keys[ count ] );
+      ASSERT( found == itree.find( *key ) );
+      ++count;
+    } );
+  ASSERT( keys.size() == count );
+
+  for ( auto i = keys.begin(); i != keys.end(); ++i )
+    delete *i;
+}
+
+void test_find_sorted_many( TestObjs *objs ) {
+  auto rng = std::default_random_engine();
+  std::vector<int> vals;
+  for ( int i = 0; i < MANY; ++i )
+    vals.push_back( 2*i );
+  std::shuffle( vals.begin(), vals.end(), rng );
+
+  auto &itree = objs->itree;
+
+  for ( auto i = vals.begin(); i != vals.end(); ++i )
+    itree.insert( new IntAATreeNode( *i ) );
+
+  // Search for every value in 0..2*MANY, half of which are in the
+  // tree. Each node should be compared a small number of times
+  // overall, rather than once per search.
+  num_comparisons = 0;
+  auto f = itree.finger();
+  for ( int i = 0; i < 2*MANY; ++i ) {
+    IntAATreeNode *found = f.find( IntAATreeNode( i ) );
+    if ( i % 2 == 0 ) {
+      ASSERT( found != nullptr );
+      ASSERT( i == found->get_val() );
+    } else {
+      ASSERT( found == nullptr );
+    }
+  }
+  ASSERT( num_comparisons < 8*2*MANY ); // fewer than 8 per search on average
+}
+
 void test_remove_one( TestObjs *objs ) {
   auto &itree = objs->itree;
   
@@ -219,9 +619,10 @@ void test_remove( TestObjs *objs ) {
 }
 
 void test_remove_many( TestObjs *objs ) {
+  const int many = tctest_scale( MANY );
   auto rng = std::default_random_engine();
   std::vector<int> vals;
-  for ( int i = 0; i < MANY; ++i )
+  for ( int i = 0; i < many; ++i )
     vals.push_back( i );
   std::shuffle( vals.begin(), vals.end(), rng );
 
@@ -246,6 +647,47 @@ void test_remove_many( TestObjs *objs ) {
   ASSERT( itree.is_empty() );
 }
 
+// Random insertions and removals on the given tree
+template< typename NodeType >
+void check_update_mix( dslib::AATree< NodeType > &itree ) {
+  auto rng = std::default_random_engine();
+  std::uniform_int_distribution< int > val_dist( 0, 999 );
+  std::uniform_int_distribution< int > op_dist( 0, 2 );
+
+  std::set< int > expected;
+
+  // Random insertions and removals, checking the tree after
+  // each one. Removals are less frequent, so the tree grows
+  // and then stays about half full.
+  for ( int i = 0; i < 20000; ++i ) {
+    int val = val_dist( rng );
+    if ( op_dist( rng ) != 0 ) {
+      NodeType *node = new NodeType( val );
+      bool inserted = itree.insert( node );
+      ASSERT( inserted == ( expected.count( val ) == 0 ) );
+      if ( !inserted )
+        delete node;
+      expected.insert( val );
+    } else {
+      bool removed = itree.remove( NodeType( val ) );
+      ASSERT( removed == ( expected.count( val ) == 1 ) );
+      expected.erase( val );
+    }
+    ASSERT( itree.is_valid() );
+  }
+
+  auto it = itree.iterator();
+  for ( auto i = expected.begin(); i != expected.end(); ++i ) {
+    ASSERT( it.has_next() );
+    ASSERT( it.next()->get_val() == *i );
+  }
+  ASSERT( !it.has_next() );
+}
+
+void test_update_mix( TestObjs *objs ) {
+  check_update_mix( objs->itree );
+}
+
 void test_iterator_empty( TestObjs *objs ) {
   auto &itree = objs->itree;
 
@@ -296,3 +738,1667 @@ void test_postfix_iterator( TestObjs *objs ) {
   for ( auto i = TEST_VALS.begin(); i != TEST_VALS.end(); ++i )
     ASSERT( seen.find( *i ) != seen.end() );
 }
+
+void test_get_size( TestObjs *objs ) {
+  auto &itree = objs->itree;
+
+  ASSERT( 0 == itree.get_size() );
+  for ( auto i = TEST_VALS.begin(); i != TEST_VALS.end(); ++i )
+    itree.insert( new IntAATreeNode( *i ) );
+  ASSERT( TEST_VALS.size() == itree.get_size() );
+}
+
+void test_relayout( TestObjs *objs ) {
+  auto rng = std::default_random_engine();
+  std::vector<int> vals;
+  for ( int i = 0; i < MANY; ++i )
+    vals.push_back( i );
+  std::shuffle( vals.begin(), vals.end(), rng );
+
+  auto &itree = objs->itree;
+
+  for ( auto i = vals.begin(); i != vals.end(); ++i )
+    itree.insert( new IntAATreeNode( *i ) );
+
+  char *buf = alloc_relayout_buf( objs, MANY );
+  size_t moved = itree.relayout( buf, MANY, &IntAATreeNode::relocate_node_fn );
+  ASSERT( size_t( MANY ) == moved );
+  ASSERT( itree.is_valid() );
+
+  // The root should be in the first slot of the buffer
+  IntAATreeNode *first = reinterpret_cast< IntAATreeNode* >( buf );
+  ASSERT( itree.find( IntAATreeNode( first->get_val() ) ) == first );
+
+  // Every node should now be in the buffer, and the nodes should
+  // still be in order
+  auto it = itree.iterator();
+  for ( int i = 0; i < MANY; ++i ) {
+    ASSERT( it.has_next() );
+    IntAATreeNode *n = it.next();
+    ASSERT( i == n->get_val() );
+    char *p = reinterpret_cast< char* >( n );
+    ASSERT( p >= relayout_buf_begin && p < relayout_buf_end );
+  }
+  ASSERT( !it.has_next() );
+
+  // The tree should still support modifications
+  for ( int i = 0; i < MANY; i += 2 )
+    ASSERT( itree.remove( IntAATreeNode( i ) ) );
+  for ( int i = 0; i < MANY; ++i )
+    ASSERT( itree.contains( IntAATreeNode( i ) ) == ( i % 2 == 1 ) );
+}
+
+void test_relayout_partial( TestObjs *objs ) {
+  auto &itree = objs->itree;
+
+  for ( int i = 0; i < 100; ++i )
+    itree.insert( new IntAATreeNode( i ) );
+
+  // Only the 10 nodes nearest the root fit in the buffer
+  char *buf = alloc_relayout_buf( objs, 10 );
+  size_t moved = itree.relayout( buf, 10, &IntAATreeNode::relocate_node_fn );
+  ASSERT( 10 == moved );
+  ASSERT( itree.is_valid() );
+
+  int num_in_buf = 0;
+  auto it = itree.iterator();
+  for ( int i = 0; i < 100; ++i ) {
+    ASSERT( it.has_next() );
+    IntAATreeNode *n = it.next();
+    ASSERT( i == n->get_val() );
+    char *p = reinterpret_cast< char* >( n );
+    if ( p >= relayout_buf_begin && p < relayout_buf_end )
+      ++num_in_buf;
+  }
+  ASSERT( !it.has_next() );
+  ASSERT( 10 == num_in_buf );
+}
+
+void test_snapshot( TestObjs *objs ) {
+  auto &itree = objs->itree;
+
+  // Use odd values, so that there are missing values between
+  // (and before and after) the values in the tree
+  for ( int n = 0; n < 70; ++n ) {
+    if ( n > 0 )
+      itree.insert( new IntAATreeNode( 2*n - 1 ) );
+
+    std::vector< dslib::AATreeNode* > buf( n + 1 );
+    dslib::AATreeSnapshot< IntAATreeNode > snap;
+    if ( n > 0 )
+      ASSERT( !snap.build( itree, buf.data(), n ) ); // too small
+    ASSERT( snap.build( itree, buf.data(), n + 1 ) );
+    ASSERT( size_t( n ) == snap.get_size() );
+
+    for ( int i = -1; i <= 2*n; ++i ) {
+      IntAATreeNode *found = snap.find( IntAATreeNode( i ) );
+      if ( i % 2 != 0 && i > 0 ) {
+        ASSERT( found != nullptr );
+        ASSERT( found == itree.find( IntAATreeNode( i ) ) );
+      } else {
+        ASSERT( found == nullptr );
+      }
+    }
+  }
+}
+
+void test_int_snapshot( TestObjs *objs ) {
+  auto &itree = objs->itree;
+
+  for ( int n = 0; n < 70; ++n ) {
+    if ( n > 0 )
+      itree.insert( new IntAATreeNode( 2*n - 1 ) );
+
+    std::vector< int64_t > key_buf( n + 1 );
+    std::vector< dslib::AATreeNode* > node_buf( n + 1 );
+    dslib::AATreeIntSnapshot< IntAATreeNode > snap;
+    ASSERT( snap.build( itree, &IntAATreeNode::get_key_fn, key_buf.data(), node_buf.data(), n + 1 ) );
+    ASSERT( size_t( n ) == snap.get_size() );
+
+    std::vector< int64_t > keys;
+    for ( int i = -1; i <= 2*n; ++i ) {
+      keys.push_back( i );
+      IntAATreeNode *found = snap.find( i );
+      if ( i % 2 != 0 && i > 0 ) {
+        ASSERT( found != nullptr );
+        ASSERT( i == found->get_val() );
+      } else {
+        ASSERT( found == nullptr );
+      }
+    }
+
+    // find_many() should agree with find()
+    std::vector< IntAATreeNode* > results( keys.size() );
+    snap.find_many( keys.data(), keys.size(), results.data() );
+    for ( size_t j = 0; j < keys.size(); ++j )
+      ASSERT( results[ j ] == snap.find( keys[ j ] ) );
+  }
+}
+
+void test_int_snapshot_find_many( TestObjs *objs ) {
+  auto &itree = objs->itree;
+
+  // Numbers of keys that aren't multiples of 4 leave some keys for
+  // the scalar search after the AVX2 search (if compiled in)
+  const size_t counts[] = { 0, 1, 2, 3, 4, 5, 7, 13, 16, 17, 31, 101, 1001 };
+
+  std::mt19937 gen( 27 );
+  std::uniform_int_distribution< int > dist( -10, 3000 );
+  for ( int n : { 1, 2, 3, 5, 100, 1000 } ) {
+    while ( int( itree.get_size() ) < n )
+      itree.insert( new IntAATreeNode( 2 * int( itree.get_size() ) ) );
+
+    std::vector< int64_t > key_buf( n + 1 );
+    std::vector< dslib::AATreeNode* > node_buf( n + 1 );
+    dslib::AATreeIntSnapshot< IntAATreeNode > snap;
+    ASSERT( snap.build( itree, &IntAATreeNode::get_key_fn, key_buf.data(), node_buf.data(), n + 1 ) );
+
+    for ( size_t count : counts ) {
+      // Hits and misses, including keys beyond either end
+      std::vector< int64_t > keys;
+      for ( size_t i = 0; i < count; ++i )
+        keys.push_back( dist( gen ) );
+      if ( count > 2 ) {
+        keys[ 0 ] = INT64_MIN;
+        keys[ count - 1 ] = INT64_MAX;
+      }
+
+      // (the results array is one larger, to check that find_many()
+      // doesn't write past the end)
+      IntAATreeNode sentinel( 0 );
+      std::vector< IntAATreeNode* > results( count + 1, &sentinel );
+      snap.find_many( keys.data(), count, results.data() );
+      for ( size_t j = 0; j < count; ++j )
+        ASSERT( results[ j ] == snap.find( keys[ j ] ) );
+      ASSERT( results[ count ] == &sentinel );
+    }
+  }
+}
+
+void test_threaded_iterator( TestObjs *objs ) {
+  auto &ttree = objs->ttree;
+
+  // A threaded iterator is just a pointer
+  ASSERT( sizeof( dslib::AATreeThreadedIter< IntAATreeNode > ) == sizeof( void* ) );
+
+  ASSERT( ttree.is_threaded() );
+  ASSERT( !objs->itree.is_threaded() );
+  ASSERT( !ttree.threaded_iterator().has_next() );
+
+  for ( auto i = TEST_VALS.begin(); i != TEST_VALS.end(); ++i )
+    ttree.insert( new IntAATreeNode( *i ) );
+  ASSERT( ttree.is_valid() );
+
+  std::vector< int > sorted_vals( TEST_VALS );
+  std::sort( sorted_vals.begin(), sorted_vals.end() );
+
+  auto it = ttree.threaded_iterator();
+  for ( auto i = sorted_vals.begin(); i != sorted_vals.end(); ++i ) {
+    ASSERT( it.has_next() );
+    ASSERT( it.next()->get_val() == *i );
+  }
+  ASSERT( !it.has_next() );
+
+  // The other iterators work on a threaded tree too
+  auto it2 = ttree.iterator();
+  for ( auto i = sorted_vals.begin(); i != sorted_vals.end(); ++i ) {
+    ASSERT( it2.has_next() );
+    ASSERT( it2.next()->get_val() == *i );
+  }
+  ASSERT( !it2.has_next() );
+
+  auto pit = ttree.postfix_iterator();
+  size_t count = 0;
+  while ( pit.has_next() ) {
+    pit.next();
+    ++count;
+  }
+  ASSERT( TEST_VALS.size() == count );
+}
+
+void test_threaded_update_mix( TestObjs *objs ) {
+  auto &ttree = objs->ttree;
+
+  // is_valid() checks the threads as well as the AA-tree properties
+  check_update_mix( ttree );
+
+  auto it = ttree.iterator();
+  auto tit = ttree.threaded_iterator();
+  while ( it.has_next() ) {
+    ASSERT( tit.has_next() );
+    IntAATreeNode *n = it.next();
+    ASSERT( tit.next() == n );
+    ASSERT( ttree.find( *n ) == n );
+  }
+  ASSERT( !tit.has_next() );
+}
+
+void test_threaded_relayout( TestObjs *objs ) {
+  auto rng = std::default_random_engine();
+  std::vector<int> vals;
+  for ( int i = 0; i < MANY; ++i )
+    vals.push_back( i );
+  std::shuffle( vals.begin(), vals.end(), rng );
+
+  auto &ttree = objs->ttree;
+
+  for ( auto i = vals.begin(); i != vals.end(); ++i )
+    ttree.insert( new IntAATreeNode( *i ) );
+
+  // Move only some of the nodes, so that threads in both moved and
+  // unmoved nodes need to be updated
+  char *buf = alloc_relayout_buf( objs, MANY/2 );
+  ttree.relayout( buf, MANY/2, &IntAATreeNode::relocate_node_fn );
+  ASSERT( ttree.is_valid() );
+
+  auto it = ttree.threaded_iterator();
+  for ( int i = 0; i < MANY; ++i ) {
+    ASSERT( it.has_next() );
+    ASSERT( i == it.next()->get_val() );
+  }
+  ASSERT( !it.has_next() );
+}
+
+void test_parent_update_mix( TestObjs *objs ) {
+  ASSERT( objs->ptree.get_impl().has_parent_links() );
+  ASSERT( !objs->itree.get_impl().has_parent_links() );
+
+  // is_valid() checks the parent links as well
+  check_update_mix( objs->ptree );
+}
+
+void test_parent_remove_node( TestObjs *objs ) {
+  auto rng = std::default_random_engine();
+  auto &ptree = objs->ptree;
+
+  const int N = 10000;
+  std::vector< IntAATreeParentNode* > nodes;
+  for ( int i = 0; i < N; ++i )
+    nodes.push_back( new IntAATreeParentNode( i ) );
+  std::shuffle( nodes.begin(), nodes.end(), rng );
+  for ( auto i = nodes.begin(); i != nodes.end(); ++i )
+    ASSERT( ptree.insert( *i ) );
+
+  // Remove half of the nodes, in random order: no comparisons
+  // should be needed
+  std::shuffle( nodes.begin(), nodes.end(), rng );
+  for ( int i = 0; i < N/2; ++i ) {
+    long before = num_comparisons;
+    ptree.remove_node( nodes[ i ] );
+    ASSERT( before == num_comparisons );
+    if ( i % 100 == 0 )
+      ASSERT( ptree.is_valid() );
+  }
+  ASSERT( ptree.is_valid() );
+
+  // The remaining nodes should be the same node objects as before
+  for ( int i = N/2; i < N; ++i )
+    ASSERT( ptree.find( IntAATreeParentNode( nodes[ i ]->get_val() ) ) == nodes[ i ] );
+  ASSERT( size_t( N/2 ) == ptree.get_size() );
+
+  // Removing by value doesn't move nodes either
+  IntAATreeParentNode *keep = nodes[ N - 1 ];
+  for ( int i = N/2; i < N - 1; ++i )
+    ASSERT( ptree.remove( IntAATreeParentNode( nodes[ i ]->get_val() ) ) );
+  ASSERT( ptree.is_valid() );
+  ASSERT( ptree.find( IntAATreeParentNode( keep->get_val() ) ) == keep );
+
+  ptree.remove_node( keep );
+  ASSERT( ptree.is_empty() );
+}
+
+void test_parent_successor( TestObjs *objs ) {
+  auto &ptree = objs->ptree;
+
+  for ( auto i = TEST_VALS.begin(); i != TEST_VALS.end(); ++i )
+    ptree.insert( new IntAATreeParentNode( *i ) );
+
+  std::vector< int > sorted_vals( TEST_VALS );
+  std::sort( sorted_vals.begin(), sorted_vals.end() );
+
+  IntAATreeParentNode *first = ptree.find( IntAATreeParentNode( sorted_vals.front() ) );
+  IntAATreeParentNode *last = ptree.find( IntAATreeParentNode( sorted_vals.back() ) );
+
+  // Forwards
+  IntAATreeParentNode *n = first;
+  for ( auto i = sorted_vals.begin(); i != sorted_vals.end(); ++i ) {
+    ASSERT( n != nullptr );
+    ASSERT( *i == n->get_val() );
+    n = ptree.successor( n );
+  }
+  ASSERT( n == nullptr );
+
+  // Backwards
+  n = last;
+  for ( auto i = sorted_vals.rbegin(); i != sorted_vals.rend(); ++i ) {
+    ASSERT( n != nullptr );
+    ASSERT( *i == n->get_val() );
+    n = ptree.predecessor( n );
+  }
+  ASSERT( n == nullptr );
+}
+
+void test_parent_relayout( TestObjs *objs ) {
+  auto rng = std::default_random_engine();
+  std::vector<int> vals;
+  for ( int i = 0; i < MANY; ++i )
+    vals.push_back( i );
+  std::shuffle( vals.begin(), vals.end(), rng );
+
+  auto &ptree = objs->ptree;
+  for ( auto i = vals.begin(); i != vals.end(); ++i )
+    ptree.insert( new IntAATreeParentNode( *i ) );
+
+  // Move only some of the nodes, so that the parent links of both
+  // moved and unmoved nodes need to be updated
+  char *buf = alloc_relayout_buf( objs, MANY/2, sizeof( IntAATreeParentNode ) );
+  ptree.relayout( buf, MANY/2, &IntAATreeParentNode::relocate_node_fn );
+  ASSERT( ptree.is_valid() );
+
+  IntAATreeParentNode *n = ptree.find( IntAATreeParentNode( 0 ) );
+  for ( int i = 0; i < MANY; ++i ) {
+    ASSERT( i == n->get_val() );
+    n = ptree.successor( n );
+  }
+  ASSERT( n == nullptr );
+}
+
+void test_max_height_for_size( TestObjs *objs ) {
+  typedef dslib::AATree< IntAATreeNode > IntAATree;
+
+  ASSERT( 2 == IntAATree::max_height_for_size( 0 ) );
+  ASSERT( 2 == IntAATree::max_height_for_size( 2 ) );
+  ASSERT( 4 == IntAATree::max_height_for_size( 3 ) );
+  ASSERT( 38 == IntAATree::max_height_for_size( 1000000 ) );
+
+  ASSERT( 62 == IntAATree::max_height_for_size( 4000000000UL ) );
+
+  // Trees start out with the largest possible maximum height
+  ASSERT( dslib::AA_TREE_MAX_HEIGHT == objs->itree.get_max_height() );
+}
+
+void test_max_height( TestObjs *objs ) {
+  auto &itree = objs->itree;
+
+  const int N = 1000;
+  int max_height = itree.max_height_for_size( N );
+  itree.set_max_height( max_height );
+  ASSERT( max_height == itree.get_max_height() );
+
+  // Ascending insertions produce a tree where every pseudo-node
+  // eventually has two nodes, so insertions will start failing
+  // (gracefully) at some point, but not before N nodes are inserted
+  int count = 0;
+  for ( ;; ) {
+    IntAATreeNode *node = new IntAATreeNode( count );
+    if ( !itree.insert( node ) ) {
+      delete node;
+      break;
+    }
+    ++count;
+    ASSERT( itree.get_height() <= max_height );
+  }
+  ASSERT( count >= N );
+  ASSERT( itree.is_valid() );
+  ASSERT( !itree.contains( IntAATreeNode( count ) ) );
+
+  // After a removal, there is room again
+  ASSERT( itree.remove( IntAATreeNode( 0 ) ) );
+  ASSERT( itree.insert( new IntAATreeNode( 0 ) ) );
+  ASSERT( itree.is_valid() );
+
+  // The maximum height can't exceed the size of the path stacks
+  itree.set_max_height( 1000 );
+  ASSERT( dslib::AA_TREE_MAX_HEIGHT == itree.get_max_height() );
+}
+
+void test_parallel_for_each( TestObjs *objs ) {
+  auto &itree = objs->itree;
+
+  // Empty tree
+  std::atomic< long > count( 0 );
+  dslib::parallel_for_each( itree, [&]( IntAATreeNode * ) { ++count; }, 4 );
+  ASSERT( 0 == count );
+
+  const int N = 10000;
+  for ( int i = 0; i < N; ++i )
+    itree.insert( new IntAATreeNode( i ) );
+
+  // Every node is visited exactly once, whatever the number of threads
+  for ( int num_threads = 1; num_threads <= 8; num_threads *= 2 ) {
+    std::vector< std::atomic< int > > visits( N );
+    for ( auto i = visits.begin(); i != visits.end(); ++i )
+      *i = 0;
+    dslib::parallel_for_each( itree, [&]( IntAATreeNode *node ) {
+      ++visits[ node->get_val() ];
+    }, num_threads );
+    for ( int i = 0; i < N; ++i )
+      ASSERT( 1 == visits[ i ] );
+  }
+
+  // Tree with too few nodes to fill the depth at which it is cut
+  auto &ttree = objs->ttree;
+  for ( int i = 0; i < 5; ++i )
+    ttree.insert( new IntAATreeNode( i ) );
+  count = 0;
+  dslib::parallel_for_each( ttree, [&]( IntAATreeNode *node ) { count += node->get_val(); }, 4 );
+  ASSERT( 10 == count );
+}
+
+void test_parallel_reduce( TestObjs *objs ) {
+  auto &itree = objs->itree;
+
+  typedef std::vector< int > IntVec;
+  auto map_fn = []( IntAATreeNode *node ) { return IntVec( 1, node->get_val() ); };
+  auto combine_fn = []( const IntVec &left, const IntVec &right ) {
+    IntVec result( left );
+    result.insert( result.end(), right.begin(), right.end() );
+    return result;
+  };
+
+  ASSERT( dslib::parallel_reduce( itree, IntVec(), map_fn, combine_fn, 2 ).empty() );
+
+  std::vector< int > vals;
+  std::mt19937 gen( 34 );
+  std::uniform_int_distribution< int > dist( 0, 1000000 );
+  const int N = 2000;
+  for ( int i = 0; i < N; ++i ) {
+    int val = dist( gen );
+    IntAATreeNode *node = new IntAATreeNode( val );
+    if ( itree.insert( node ) )
+      vals.push_back( val );
+    else
+      delete node;
+  }
+  std::sort( vals.begin(), vals.end() );
+
+  // Concatenation isn't commutative, so the result is only
+  // correct if the per-piece results are combined in order
+  for ( int num_threads = 1; num_threads <= 8; num_threads *= 2 )
+    ASSERT( vals == dslib::parallel_reduce( itree, IntVec(), map_fn, combine_fn, num_threads ) );
+
+  long sum = dslib::parallel_reduce( itree, 0L,
+    []( IntAATreeNode *node ) { return long( node->get_val() ); },
+    []( long left, long right ) { return left + right; }, 3 );
+  long expected = 0;
+  for ( auto i = vals.begin(); i != vals.end(); ++i )
+    expected += *i;
+  ASSERT( expected == sum );
+}
+
+// Build the given (empty) tree from n nodes with values 0, 2, 4, ...
+// using the given build function, check it, then insert and remove
+// nodes to make sure that the built tree behaves like any other.
+// The tree is empty again afterwards.
+template< typename NodeType, typename BuildFn >
+void check_build( dslib::AATree< NodeType > &tree, int n, BuildFn build_fn ) {
+  std::vector< NodeType* > nodes;
+  for ( int i = 0; i < n; ++i )
+    nodes.push_back( new NodeType( 2*i ) );
+  ASSERT( build_fn( tree, nodes.data(), nodes.size() ) );
+  ASSERT( tree.is_valid() );
+
+  // The tree is as short as possible
+  int min_height = 0;
+  for ( int m = n; m > 0; m >>= 1 )
+    ++min_height;
+  ASSERT( min_height == tree.get_height() );
+
+  auto it = tree.iterator();
+  for ( int i = 0; i < n; ++i ) {
+    ASSERT( it.has_next() );
+    ASSERT( 2*i == it.next()->get_val() );
+  }
+  ASSERT( !it.has_next() );
+
+  for ( int i = 0; i < n; ++i )
+    ASSERT( tree.insert( new NodeType( 2*i + 1 ) ) );
+  ASSERT( tree.is_valid() );
+  for ( int i = 0; i < 2*n; i += 2 )
+    ASSERT( tree.remove( NodeType( i ) ) );
+  ASSERT( tree.is_valid() );
+  for ( int i = 1; i < 2*n; i += 2 )
+    ASSERT( tree.remove( NodeType( i ) ) );
+  ASSERT( tree.is_empty() );
+}
+
+void test_build( TestObjs *objs ) {
+  auto build = []( auto &tree, auto nodes, size_t n ) { return tree.build( nodes, n ); };
+
+  for ( int n = 0; n <= 70; ++n ) {
+    check_build( objs->itree, n, build );
+    check_build( objs->ttree, n, build );
+    check_build( objs->ptree, n, build );
+  }
+  check_build( objs->itree, MANY, build );
+  check_build( objs->ttree, MANY, build );
+  check_build( objs->ptree, MANY, build );
+
+  // Building fails if the tree isn't empty
+  auto &itree = objs->itree;
+  itree.insert( new IntAATreeNode( 1 ) );
+  IntAATreeNode node( 2 );
+  IntAATreeNode *node_ptr = &node;
+  ASSERT( !itree.build( &node_ptr, 1 ) );
+
+  // ...or if the tree would be too tall
+  auto &ttree = objs->ttree;
+  ttree.set_max_height( 2 );
+  std::vector< IntAATreeNode > nodes( 4 );
+  std::vector< IntAATreeNode* > node_ptrs;
+  for ( int i = 0; i < 4; ++i ) {
+    nodes[ i ].set_val( i );
+    node_ptrs.push_back( &nodes[ i ] );
+  }
+  ASSERT( !ttree.build( node_ptrs.data(), 4 ) );
+  ASSERT( ttree.is_empty() );
+}
+
+void test_parallel_build( TestObjs *objs ) {
+  const int SIZES[] = { 0, 1, 2, 3, 10, 100, 1000, MANY };
+
+  for ( int num_threads = 1; num_threads <= 8; num_threads *= 2 ) {
+    auto build = [num_threads]( auto &tree, auto nodes, size_t n ) {
+      return dslib::parallel_build( tree, nodes, n, num_threads );
+    };
+    for ( int n : SIZES ) {
+      check_build( objs->itree, n, build );
+      check_build( objs->ttree, n, build );
+      check_build( objs->ptree, n, build );
+    }
+  }
+}
+
+// Carry out each set operation, using the given function, on pairs
+// of (empty) trees filled with various sets of values, and check
+// the results. The trees are empty again afterwards.
+template< typename NodeType, typename SetOpFn >
+void check_set_ops( dslib::AATree< NodeType > &tree, dslib::AATree< NodeType > &other, SetOpFn set_op_fn ) {
+  std::mt19937 gen( 36 );
+  auto random_set = [&]( int n, int max_val ) {
+    std::uniform_int_distribution< int > dist( 0, max_val );
+    std::set< int > vals;
+    while ( int( vals.size() ) < n )
+      vals.insert( dist( gen ) );
+    return std::vector< int >( vals.begin(), vals.end() );
+  };
+  std::vector< int > evens, odds;
+  for ( int i = 0; i < 1000; ++i )
+    ( ( i % 2 == 0 ) ? evens : odds ).push_back( i );
+
+  // Overlapping, very different sizes, empty, identical, and disjoint
+  const std::vector< std::pair< std::vector< int >, std::vector< int > > > inputs = {
+    { random_set( 1000, 2000 ), random_set( 1000, 2000 ) },
+    { random_set( MANY, 4*MANY ), random_set( 100, 4*MANY ) },
+    { random_set( 100, 4*MANY ), random_set( MANY, 4*MANY ) },
+    { {}, random_set( 1000, 2000 ) },
+    { random_set( 1000, 2000 ), {} },
+    { {}, {} },
+    { evens, evens },
+    { evens, odds },
+  };
+
+  const dslib::AATreeImpl::SetOp OPS[] = {
+    dslib::AATreeImpl::SET_UNION, dslib::AATreeImpl::SET_INTERSECTION, dslib::AATreeImpl::SET_DIFFERENCE,
+  };
+
+  for ( auto op : OPS ) {
+    for ( auto &input : inputs ) {
+      const std::vector< int > &a = input.first, &b = input.second;
+      for ( auto i = a.begin(); i != a.end(); ++i )
+        tree.insert( new NodeType( *i ) );
+      for ( auto i = b.begin(); i != b.end(); ++i )
+        other.insert( new NodeType( *i ) );
+
+      std::vector< int > expected;
+      if ( op == dslib::AATreeImpl::SET_UNION )
+        std::set_union( a.begin(), a.end(), b.begin(), b.end(), std::back_inserter( expected ) );
+      else if ( op == dslib::AATreeImpl::SET_INTERSECTION )
+        std::set_intersection( a.begin(), a.end(), b.begin(), b.end(), std::back_inserter( expected ) );
+      else
+        std::set_difference( a.begin(), a.end(), b.begin(), b.end(), std::back_inserter( expected ) );
+
+      set_op_fn( tree, other, op );
+      ASSERT( tree.is_valid() );
+      ASSERT( other.is_empty() );
+
+      auto it = tree.iterator();
+      for ( auto i = expected.begin(); i != expected.end(); ++i ) {
+        ASSERT( it.has_next() );
+        ASSERT( *i == it.next()->get_val() );
+      }
+      ASSERT( !it.has_next() );
+
+      // The result can be modified normally
+      NodeType *node = new NodeType( -1 );
+      ASSERT( tree.insert( node ) );
+      for ( auto i = expected.begin(); i != expected.end(); ++i )
+        ASSERT( tree.remove( NodeType( *i ) ) );
+      ASSERT( tree.remove( NodeType( -1 ) ) );
+      ASSERT( tree.is_empty() );
+    }
+  }
+}
+
+void test_set_ops( TestObjs *objs ) {
+  auto set_op = []( auto &tree, auto &other, dslib::AATreeImpl::SetOp op ) {
+    if ( op == dslib::AATreeImpl::SET_UNION )
+      ASSERT( tree.set_union( other ) );
+    else if ( op == dslib::AATreeImpl::SET_INTERSECTION )
+      ASSERT( tree.set_intersection( other ) );
+    else
+      ASSERT( tree.set_difference( other ) );
+  };
+
+  dslib::AATree< IntAATreeNode > other( &IntAATreeNode::less_than_fn, &IntAATreeNode::copy_node_fn, &IntAATreeNode::free_node_fn );
+  check_set_ops( objs->itree, other, set_op );
+
+  dslib::AATree< IntAATreeParentNode > pother( &IntAATreeParentNode::less_than_fn, nullptr, &IntAATreeParentNode::free_node_fn );
+  check_set_ops( objs->ptree, pother, set_op );
+}
+
+void test_parallel_set_ops( TestObjs *objs ) {
+  dslib::AATree< IntAATreeNode > other( &IntAATreeNode::less_than_fn, &IntAATreeNode::copy_node_fn, &IntAATreeNode::free_node_fn );
+  dslib::AATree< IntAATreeParentNode > pother( &IntAATreeParentNode::less_than_fn, nullptr, &IntAATreeParentNode::free_node_fn );
+
+  for ( int num_threads = 1; num_threads <= 8; num_threads *= 2 ) {
+    auto set_op = [num_threads]( auto &tree, auto &other, dslib::AATreeImpl::SetOp op ) {
+      if ( op == dslib::AATreeImpl::SET_UNION )
+        ASSERT( dslib::parallel_union( tree, other, num_threads ) );
+      else if ( op == dslib::AATreeImpl::SET_INTERSECTION )
+        ASSERT( dslib::parallel_intersection( tree, other, num_threads ) );
+      else
+        ASSERT( dslib::parallel_difference( tree, other, num_threads ) );
+    };
+    check_set_ops( objs->itree, other, set_op );
+    check_set_ops( objs->ptree, pother, set_op );
+  }
+}
+
+void test_set_ops_refused( TestObjs *objs ) {
+  auto &itree = objs->itree;
+  for ( int i = 0; i < 10; ++i ) {
+    itree.insert( new IntAATreeNode( 2*i ) );
+    objs->ttree.insert( new IntAATreeNode( 2*i + 1 ) );
+  }
+
+  // Incompatible trees are refused, and left unchanged
+  struct Greater {
+    static bool less_than_fn( const dslib::AATreeNode *left, const dslib::AATreeNode *right ) {
+      return static_cast< const IntAATreeNode* >( left )->get_val()
+           > static_cast< const IntAATreeNode* >( right )->get_val();
+    }
+  };
+  dslib::AATree< IntAATreeNode > greater( &Greater::less_than_fn, &IntAATreeNode::copy_node_fn, &IntAATreeNode::free_node_fn );
+  greater.insert( new IntAATreeNode( 1 ) );
+  ASSERT( !itree.set_union( greater ) );
+  ASSERT( !itree.set_intersection( objs->ttree ) );
+  ASSERT( !objs->ttree.set_difference( itree ) );
+  ASSERT( !itree.set_union( itree ) );
+  ASSERT( !dslib::parallel_union( itree, greater, 2 ) );
+  ASSERT( !dslib::parallel_intersection( itree, objs->ttree, 2 ) );
+  ASSERT( !dslib::parallel_difference( itree, itree, 2 ) );
+  ASSERT( 10 == itree.get_size() );
+  ASSERT( 10 == objs->ttree.get_size() );
+  ASSERT( 1 == greater.get_size() );
+
+  // A union that could exceed the maximum height is refused. With a
+  // maximum height of 4, the root can be at level 2, and a tree with
+  // 7 or more nodes could have its root at level 3.
+  dslib::AATree< IntAATreeNode > small( &IntAATreeNode::less_than_fn, &IntAATreeNode::copy_node_fn, &IntAATreeNode::free_node_fn );
+  dslib::AATree< IntAATreeNode > other( &IntAATreeNode::less_than_fn, &IntAATreeNode::copy_node_fn, &IntAATreeNode::free_node_fn );
+  small.set_max_height( 4 );
+  for ( int i = 0; i < 5; ++i ) {
+    small.insert( new IntAATreeNode( 2*i ) );
+    other.insert( new IntAATreeNode( 2*i + 1 ) );
+  }
+  ASSERT( 5 == small.get_size() );
+  ASSERT( !small.set_union( other ) );
+  ASSERT( !dslib::parallel_union( small, other, 2 ) );
+  ASSERT( 5 == small.get_size() );
+  ASSERT( 5 == other.get_size() );
+
+  // ...but a union that fits, or an intersection, is fine
+  ASSERT( other.remove( IntAATreeNode( 1 ) ) );
+  ASSERT( other.remove( IntAATreeNode( 3 ) ) );
+  ASSERT( other.remove( IntAATreeNode( 5 ) ) );
+  ASSERT( !small.set_union( other ) );
+  ASSERT( other.remove( IntAATreeNode( 7 ) ) );
+  ASSERT( small.set_union( other ) );
+  ASSERT( 6 == small.get_size() );
+  ASSERT( small.is_valid() );
+  other.insert( new IntAATreeNode( 8 ) );
+  ASSERT( small.set_intersection( other ) );
+  ASSERT( 1 == small.get_size() );
+}
+
+void test_serialize( TestObjs *objs ) {
+  auto &itree = objs->itree;
+
+  // Empty tree
+  VectorWriter empty;
+  ASSERT( dslib::serialize( itree, empty, &IntAATreeNode::encode_node_fn ) );
+  VectorReader empty_reader( empty.data );
+  ASSERT( dslib::load( objs->ttree, empty_reader, &IntAATreeNode::decode_node_fn ) );
+  ASSERT( objs->ttree.is_empty() );
+
+  std::vector< int > vals;
+  std::mt19937 gen( 37 );
+  std::uniform_int_distribution< int > dist( -MANY, MANY );
+  for ( int i = 0; i < MANY; ++i ) {
+    int val = dist( gen );
+    IntAATreeNode *node = new IntAATreeNode( val );
+    if ( itree.insert( node ) )
+      vals.push_back( val );
+    else
+      delete node;
+  }
+  std::sort( vals.begin(), vals.end() );
+
+  VectorWriter writer;
+  ASSERT( dslib::serialize( itree, writer, &IntAATreeNode::encode_node_fn ) );
+  // header, 1 byte length + 4 bytes per node, checksum
+  ASSERT( 24 + 5*vals.size() + 8 == writer.data.size() );
+
+  // Load, reading everything at once, and a few bytes at a time
+  for ( size_t max_read : { SIZE_MAX, size_t( 7 ) } ) {
+    dslib::AATree< IntAATreeNode > tree( &IntAATreeNode::less_than_fn, &IntAATreeNode::copy_node_fn,
+                                         &IntAATreeNode::free_node_fn, dslib::AA_TREE_THREADED );
+    VectorReader reader( writer.data, max_read );
+    ASSERT( dslib::load( tree, reader, &IntAATreeNode::decode_node_fn ) );
+    ASSERT( tree.is_valid() );
+
+    auto it = tree.threaded_iterator();
+    for ( auto i = vals.begin(); i != vals.end(); ++i ) {
+      ASSERT( it.has_next() );
+      ASSERT( *i == it.next()->get_val() );
+    }
+    ASSERT( !it.has_next() );
+  }
+}
+
+void test_serialize_large_records( TestObjs *objs ) {
+  auto &itree = objs->itree;
+
+  // Every tenth node's encoding is padded to be larger than a chunk
+  auto encode = []( const dslib::AATreeNode *node, void *buf, size_t size ) -> size_t {
+    int val = static_cast< const IntAATreeNode* >( node )->get_val();
+    size_t len = ( val % 10 == 0 ) ? 100000 : sizeof( val );
+    if ( size >= len ) {
+      memset( buf, 0, len );
+      memcpy( buf, &val, sizeof( val ) );
+    }
+    return len;
+  };
+  auto decode = []( const void *data, size_t size ) -> dslib::AATreeNode* {
+    int val;
+    memcpy( &val, data, sizeof( val ) );
+    return ( size == ( val % 10 == 0 ? 100000 : sizeof( val ) ) ) ? new IntAATreeNode( val ) : nullptr;
+  };
+
+  for ( int i = 0; i < 100; ++i )
+    itree.insert( new IntAATreeNode( i ) );
+
+  VectorWriter writer;
+  ASSERT( dslib::serialize( itree, writer, encode ) );
+  for ( size_t max_read : { SIZE_MAX, size_t( 1000 ) } ) {
+    VectorReader reader( writer.data, max_read );
+    ASSERT( dslib::load( objs->ttree, reader, decode ) );
+    ASSERT( objs->ttree.is_valid() );
+    ASSERT( 100 == objs->ttree.get_size() );
+    for ( int i = 0; i < 100; ++i )
+      ASSERT( objs->ttree.remove( IntAATreeNode( i ) ) );
+  }
+}
+
+void test_serialize_file( TestObjs *objs ) {
+  auto &itree = objs->itree;
+  for ( int i = 0; i < MANY; ++i )
+    itree.insert( new IntAATreeNode( i * 3 ) );
+
+  FILE *f = tmpfile();
+  ASSERT( f != nullptr );
+  dslib::AATreeFileWriter writer( f );
+  ASSERT( dslib::serialize( itree, writer, &IntAATreeNode::encode_node_fn ) );
+
+  rewind( f );
+  dslib::AATreeFileReader reader( f );
+  auto &ttree = objs->ttree;
+  bool loaded = dslib::load( ttree, reader, &IntAATreeNode::decode_node_fn );
+  fclose( f );
+  ASSERT( loaded );
+  ASSERT( ttree.is_valid() );
+
+  auto it = ttree.iterator();
+  for ( int i = 0; i < MANY; ++i ) {
+    ASSERT( it.has_next() );
+    ASSERT( i * 3 == it.next()->get_val() );
+  }
+  ASSERT( !it.has_next() );
+}
+
+void test_load_invalid( TestObjs *objs ) {
+  auto &itree = objs->itree;
+  auto &ttree = objs->ttree;
+  for ( int i = 0; i < 10; ++i )
+    itree.insert( new IntAATreeNode( i ) );
+
+  VectorWriter writer;
+  ASSERT( dslib::serialize( itree, writer, &IntAATreeNode::encode_node_fn ) );
+  const std::vector< unsigned char > good = writer.data;
+
+  auto load = [&]( const std::vector< unsigned char > &data ) {
+    VectorReader reader( data );
+    bool loaded = dslib::load( ttree, reader, &IntAATreeNode::decode_node_fn );
+    ASSERT( loaded || ttree.is_empty() );
+    return loaded;
+  };
+
+  // The tree must be empty
+  VectorReader reader( good );
+  ASSERT( !dslib::load( itree, reader, &IntAATreeNode::decode_node_fn ) );
+  ASSERT( 10 == itree.get_size() );
+
+  // Truncated
+  for ( size_t n = 0; n < good.size(); ++n )
+    ASSERT( !load( std::vector< unsigned char >( good.begin(), good.begin() + n ) ) );
+
+  // Any single corrupted byte is detected: in the header, a length
+  // (so the decode fails), or the data or checksum
+  for ( size_t i = 0; i < good.size(); ++i ) {
+    // (except in the reserved field)
+    if ( i >= 12 && i < 16 )
+      continue;
+    std::vector< unsigned char > bad = good;
+    bad[ i ] ^= 0x40;
+    ASSERT( !load( bad ) );
+  }
+
+  // Nodes out of order
+  auto encode_negated = []( const dslib::AATreeNode *node, void *buf, size_t size ) -> size_t {
+    int val = -static_cast< const IntAATreeNode* >( node )->get_val();
+    if ( size >= sizeof( val ) )
+      memcpy( buf, &val, sizeof( val ) );
+    return sizeof( val );
+  };
+  VectorWriter unsorted;
+  ASSERT( dslib::serialize( itree, unsorted, encode_negated ) );
+  ASSERT( !load( unsorted.data ) );
+
+  ASSERT( load( good ) );
+  ASSERT( 10 == ttree.get_size() );
+}
+
+// Insert a value into a region tree
+bool region_insert( IntRegionTree &tree, int val ) {
+  void *slot = tree.alloc();
+  if ( slot == nullptr )
+    return false;
+  IntRegionNode *node = new ( slot ) IntRegionNode( val );
+  if ( tree.insert( node ) )
+    return true;
+  tree.free( node );
+  return false;
+}
+
+// Check that a region tree contains exactly the given values
+void check_region( const IntRegionTree &tree, const std::set< int > &vals ) {
+  ASSERT( tree.is_valid() );
+  auto it = tree.iterator();
+  for ( auto i = vals.begin(); i != vals.end(); ++i ) {
+    ASSERT( it.has_next() );
+    ASSERT( *i == it.next()->get_val() );
+  }
+  ASSERT( !it.has_next() );
+}
+
+void test_region( TestObjs *objs ) {
+  // Room for the header and (at least) 10 nodes
+  std::vector< std::max_align_t > buf( 1024 / sizeof( std::max_align_t ) );
+  size_t size = buf.size() * sizeof( std::max_align_t );
+  ASSERT( !IntRegionTree::check( buf.data(), size ) );
+  ASSERT( !IntRegionTree::format( buf.data(), 16 ) );
+  ASSERT( IntRegionTree::format( buf.data(), size ) );
+  ASSERT( IntRegionTree::check( buf.data(), size ) );
+  // (a different node size doesn't match)
+  ASSERT( !dslib::AATreeRegionImpl::check( buf.data(), size, sizeof( IntRegionNode ) + 16 ) );
+
+  IntRegionTree tree( buf.data(), &IntRegionNode::less_than_fn );
+  ASSERT( tree.is_empty() );
+
+  std::set< int > vals;
+  for ( auto i = TEST_VALS.begin(); i != TEST_VALS.end(); ++i ) {
+    ASSERT( region_insert( tree, *i ) );
+    vals.insert( *i );
+  }
+  ASSERT( !region_insert( tree, TEST_VALS[ 0 ] ) );
+  check_region( tree, vals );
+
+  // Allocate until the region is full
+  int num_nodes = 0;
+  while ( region_insert( tree, 1000 + num_nodes ) )
+    vals.insert( 1000 + num_nodes++ );
+  ASSERT( nullptr == tree.alloc() );
+  check_region( tree, vals );
+
+  // Removed nodes are reused, and the other nodes stay where they are
+  IntRegionNode *node = tree.find( IntRegionNode( 53 ) );
+  ASSERT( node != nullptr );
+  ASSERT( tree.remove( IntRegionNode( 16 ) ) );
+  ASSERT( !tree.remove( IntRegionNode( 16 ) ) );
+  vals.erase( 16 );
+  ASSERT( node == tree.find( IntRegionNode( 53 ) ) );
+  ASSERT( region_insert( tree, 17000 ) );
+  vals.insert( 17000 );
+  ASSERT( nullptr == tree.alloc() );
+  check_region( tree, vals );
+
+  // Remove everything
+  for ( auto i = vals.begin(); i != vals.end(); ++i )
+    ASSERT( tree.remove( IntRegionNode( *i ) ) );
+  ASSERT( tree.is_empty() );
+  ASSERT( tree.is_valid() );
+}
+
+void test_region_mmap( TestObjs *objs ) {
+  const size_t size = 64 * 1024 * 1024;
+  char name[] = "/tmp/aatree_test_XXXXXX";
+  int fd = mkstemp( name );
+  ASSERT( fd >= 0 );
+  unlink( name );
+  ASSERT( ftruncate( fd, size ) == 0 );
+
+  auto map = [&]() {
+    void *p = mmap( nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    ASSERT( p != MAP_FAILED );
+    return p;
+  };
+
+  std::set< int > vals;
+  std::mt19937 gen( 38 );
+  std::uniform_int_distribution< int > dist( 0, MANY );
+
+  // Map the file, and insert some nodes
+  void *region = map();
+  ASSERT( IntRegionTree::format( region, size ) );
+  {
+    IntRegionTree tree( region, &IntRegionNode::less_than_fn );
+    for ( int i = 0; i < MANY; ++i ) {
+      int val = dist( gen );
+      if ( region_insert( tree, val ) )
+        vals.insert( val );
+    }
+    check_region( tree, vals );
+  }
+
+  // Map the file again (while the first mapping still exists, so it's
+  // at a different address), and use the tree from there
+  void *region2 = map();
+  ASSERT( region2 != region );
+  ASSERT( munmap( region, size ) == 0 );
+  ASSERT( IntRegionTree::check( region2, size ) );
+  {
+    IntRegionTree tree( region2, &IntRegionNode::less_than_fn );
+    check_region( tree, vals );
+
+    // Mutate it: a mix of insertions and removals
+    for ( int i = 0; i < MANY; ++i ) {
+      int val = dist( gen );
+      if ( i % 3 == 0 ) {
+        if ( region_insert( tree, val ) )
+          vals.insert( val );
+      } else {
+        ASSERT( tree.remove( IntRegionNode( val ) ) == ( vals.erase( val ) == 1 ) );
+      }
+    }
+    check_region( tree, vals );
+  }
+  ASSERT( munmap( region2, size ) == 0 );
+
+  // Remap it, and check that the changes are there
+  region = map();
+  close( fd );
+  ASSERT( IntRegionTree::check( region, size ) );
+  {
+    IntRegionTree tree( region, &IntRegionNode::less_than_fn );
+    check_region( tree, vals );
+    for ( auto i = vals.begin(); i != vals.end(); ++i )
+      ASSERT( *i == tree.find( IntRegionNode( *i ) )->get_val() );
+  }
+  ASSERT( munmap( region, size ) == 0 );
+}
+
+void test_region_corrupt( TestObjs * ) {
+  std::vector< std::max_align_t > buf( 4096 / sizeof( std::max_align_t ) );
+  size_t size = buf.size() * sizeof( std::max_align_t );
+  char *region = reinterpret_cast< char* >( buf.data() );
+  ASSERT( IntRegionTree::format( region, size ) );
+  {
+    IntRegionTree tree( region, &IntRegionNode::less_than_fn );
+    for ( int i = 0; i < 20; ++i )
+      ASSERT( region_insert( tree, i ) );
+    ASSERT( tree.remove( IntRegionNode( 7 ) ) ); // so the free list isn't empty
+  }
+  ASSERT( IntRegionTree::check( region, size ) );
+
+  // The root and free list links follow the magic number, version,
+  // node size, region size, and used size in the header
+  const size_t root_link = 32, free_list_link = 40;
+  std::vector< char > saved( region, region + size );
+  auto restore = [&]() { std::copy( saved.begin(), saved.end(), region ); };
+
+  // Links leading outside the region, outside the allocated slots,
+  // or into the middle of a slot are rejected
+  const int64_t bad_offsets[] = { -1000000, int64_t( size ), 4096 - int64_t( root_link ), 3, INT64_MAX, INT64_MIN };
+  for ( size_t link : { root_link, free_list_link } ) {
+    for ( int64_t bad : bad_offsets ) {
+      restore();
+      memcpy( region + link, &bad, sizeof( bad ) );
+      ASSERT( !IntRegionTree::check( region, size ) );
+    }
+  }
+
+  // A truncated region (the used size is past its end)
+  restore();
+  ASSERT( !IntRegionTree::check( region, size / 4 ) );
+
+  // Nodes out of order are caught by is_valid()
+  restore();
+  {
+    IntRegionTree tree( region, &IntRegionNode::less_than_fn );
+    ASSERT( tree.is_valid() );
+    tree.find( IntRegionNode( 3 ) )->set_val( 100 );
+    ASSERT( !tree.is_valid() );
+  }
+}
+
+void test_static( TestObjs *objs ) {
+  static_assert( STATIC_TREE.get_size() == 12, "wrong size" );
+
+  auto it = STATIC_TREE.iterator();
+  for ( const StaticNode::Value &v : STATIC_VALS ) {
+    ASSERT( it.has_next() );
+    const StaticNode *node = it.next();
+    ASSERT( v.key == node->get_key() );
+    ASSERT( 0 == strcmp( v.name, node->get_name() ) );
+  }
+  ASSERT( !it.has_next() );
+
+  for ( int key = 0; key < 40; ++key ) {
+    const StaticNode *found = STATIC_TREE.find( StaticNode( key ) );
+    auto v = std::find_if( std::begin( STATIC_VALS ), std::end( STATIC_VALS ),
+                           [key]( const StaticNode::Value &v ) { return v.key == key; } );
+    if ( v == std::end( STATIC_VALS ) )
+      ASSERT( nullptr == found );
+    else
+      ASSERT( found == &STATIC_TREE[ v - std::begin( STATIC_VALS ) ] );
+  }
+}
+
+// Check a static tree of N nodes with keys 0, 2, ..., 2*(N-1)
+template< size_t N >
+void check_static_size() {
+  struct Vals {
+    StaticNode::Value vals[ N ];
+    constexpr Vals() : vals() {
+      for ( size_t i = 0; i < N; ++i )
+        vals[ i ] = { int( 2*i ), "" };
+    }
+  };
+  static constexpr Vals VALS;
+  static constexpr dslib::AATreeStatic< StaticNode, N > tree( VALS.vals, &StaticNode::less_than_fn );
+
+  int expected = 0;
+  auto it = tree.iterator();
+  while ( it.has_next() ) {
+    ASSERT( expected == it.next()->get_key() );
+    expected += 2;
+  }
+  ASSERT( int( 2*N ) == expected );
+
+  // Searches in a valid AA tree visit at most 2*log2(N+1) nodes
+  int max_comparisons = 0;
+  for ( int key = -1; key <= int( 2*N ); ++key ) {
+    num_comparisons = 0;
+    bool found = tree.contains( StaticNode( key ) );
+    ASSERT( found == ( key >= 0 && key % 2 == 0 && key < int( 2*N ) ) );
+    max_comparisons = std::max( max_comparisons, int( num_comparisons ) );
+  }
+  int height = 0;
+  for ( size_t m = N + 1; m > 1; m >>= 1 )
+    ++height;
+  ASSERT( max_comparisons <= 2 * ( 2*height + 1 ) );
+}
+
+void test_static_sizes( TestObjs *objs ) {
+  check_static_size< 1 >();
+  check_static_size< 2 >();
+  check_static_size< 3 >();
+  check_static_size< 7 >();
+  check_static_size< 8 >();
+  check_static_size< 100 >();
+  check_static_size< 1000 >();
+}
+
+#ifdef DSLIB_STATS
+void test_stats( TestObjs *objs ) {
+  auto &itree = objs->itree;
+
+  dslib::AATreeStats stats = itree.get_stats();
+  ASSERT( 0 == stats.comparisons );
+  ASSERT( 0 == stats.nodes_visited );
+
+  // Random insertions need both skews and splits
+  std::vector< int > vals;
+  for ( int i = 0; i < 1000; ++i )
+    vals.push_back( i );
+  std::mt19937 gen( 42 );
+  std::shuffle( vals.begin(), vals.end(), gen );
+
+  num_comparisons = 0;
+  for ( int v : vals )
+    ASSERT( itree.insert( new IntAATreeNode( v ) ) );
+  stats = itree.get_stats();
+  ASSERT( long( stats.comparisons ) == num_comparisons );
+  ASSERT( stats.nodes_visited > 0 );
+  ASSERT( stats.skews > 0 );
+  ASSERT( stats.splits > 0 );
+  ASSERT( 0 == stats.level_decrements );
+  ASSERT( stats.max_path_depth > 0 );
+  // (the root's level is at most 9 with fewer than 1023 nodes, and
+  // each level contributes at most two nodes to a path)
+  ASSERT( stats.max_path_depth <= 2*9 );
+
+  // A search visits at most one node per level of the tree's height
+  itree.reset_stats();
+  num_comparisons = 0;
+  ASSERT( itree.find( IntAATreeNode( 500 ) ) != nullptr );
+  ASSERT( itree.find( IntAATreeNode( 1000 ) ) == nullptr );
+  stats = itree.get_stats();
+  ASSERT( long( stats.comparisons ) == num_comparisons );
+  ASSERT( stats.nodes_visited > 0 );
+  ASSERT( int( stats.nodes_visited ) <= 2 * itree.get_height() );
+  ASSERT( 0 == stats.skews );
+  ASSERT( 0 == stats.splits );
+  ASSERT( 0 == stats.max_path_depth );
+
+  // Removals lower levels
+  itree.reset_stats();
+  for ( int i = 0; i < 1000; i += 2 )
+    ASSERT( itree.remove( IntAATreeNode( i ) ) );
+  stats = itree.get_stats();
+  ASSERT( stats.level_decrements > 0 );
+  ASSERT( stats.max_path_depth > 0 );
+  ASSERT( itree.is_valid() );
+
+  itree.reset_stats();
+  stats = itree.get_stats();
+  ASSERT( 0 == stats.comparisons );
+  ASSERT( 0 == stats.nodes_visited );
+  ASSERT( 0 == stats.skews );
+  ASSERT( 0 == stats.splits );
+  ASSERT( 0 == stats.level_decrements );
+  ASSERT( 0 == stats.max_path_depth );
+}
+#endif
+
+void test_checker( TestObjs *objs ) {
+  auto &itree = objs->itree;
+
+  // An empty tree is valid
+  dslib::AATreeChecker< IntAATreeNode > empty_checker( itree );
+  ASSERT( empty_checker.check( 1 ) );
+  ASSERT( empty_checker.is_valid() );
+  ASSERT( 0 == empty_checker.get_shape().num_nodes );
+  ASSERT( 0 == empty_checker.get_shape().height );
+  ASSERT( 0.0 == empty_checker.get_shape().get_average_depth() );
+
+  std::vector< int > vals;
+  for ( int i = 0; i < 1000; ++i )
+    vals.push_back( i );
+  std::mt19937 gen( 17 );
+  std::shuffle( vals.begin(), vals.end(), gen );
+  for ( int v : vals )
+    itree.insert( new IntAATreeNode( v ) );
+
+  // Check 7 nodes at a time
+  dslib::AATreeChecker< IntAATreeNode > checker( itree );
+  int num_calls = 0;
+  while ( !checker.check( 7 ) ) {
+    ASSERT( !checker.is_done() );
+    ASSERT( checker.get_shape().num_nodes == size_t( 7 * ( num_calls + 1 ) ) );
+    ++num_calls;
+  }
+  ASSERT( 1000 / 7 == num_calls );
+  ASSERT( checker.is_done() );
+  ASSERT( checker.is_valid() );
+
+  const dslib::AATreeShape &shape = checker.get_shape();
+  ASSERT( 1000 == shape.num_nodes );
+  ASSERT( itree.get_height() == shape.height );
+  ASSERT( 1000 * sizeof( IntAATreeNode ) == shape.bytes_used );
+  size_t total = 0;
+  for ( int level = 1; level <= dslib::AA_TREE_MAX_HEIGHT; ++level )
+    total += shape.level_counts[ level ];
+  ASSERT( 1000 == total );
+  ASSERT( shape.level_counts[ 1 ] > shape.level_counts[ 2 ] );
+  ASSERT( shape.get_average_depth() > 5.0 );
+  ASSERT( shape.get_average_depth() < double( shape.height ) );
+
+  // Restart after modifying the tree
+  checker.check( 100 );
+  for ( int i = 0; i < 1000; i += 2 )
+    itree.remove( IntAATreeNode( i ) );
+  checker.restart();
+  ASSERT( checker.check_all() );
+  ASSERT( 500 == checker.get_shape().num_nodes );
+
+  // Threaded trees and trees with parent links
+  auto &ttree = objs->ttree;
+  auto &ptree = objs->ptree;
+  for ( int v : vals ) {
+    ttree.insert( new IntAATreeNode( v ) );
+    ptree.insert( new IntAATreeParentNode( v ) );
+  }
+  dslib::AATreeChecker< IntAATreeNode > tchecker( ttree );
+  ASSERT( tchecker.check_all() );
+  ASSERT( 1000 == tchecker.get_shape().num_nodes );
+  dslib::AATreeChecker< IntAATreeParentNode > pchecker( ptree );
+  ASSERT( pchecker.check_all() );
+  ASSERT( 1000 == pchecker.get_shape().num_nodes );
+  ASSERT( 1000 * sizeof( IntAATreeParentNode ) == pchecker.get_shape().bytes_used );
+}
+
+void test_checker_invalid( TestObjs *objs ) {
+  auto &itree = objs->itree;
+
+  for ( int i = 0; i < 100; ++i )
+    itree.insert( new IntAATreeNode( i ) );
+
+  // Put a node out of order
+  IntAATreeNode *node = itree.find( IntAATreeNode( 50 ) );
+  node->set_val( 500 );
+  dslib::AATreeChecker< IntAATreeNode > checker( itree );
+  ASSERT( checker.check( 10 ) == false );
+  ASSERT( checker.is_valid() );
+  ASSERT( checker.check( 1000 ) );
+  ASSERT( !checker.is_valid() );
+  ASSERT( !itree.is_valid() );
+
+  // Put it back
+  node->set_val( 50 );
+  checker.restart();
+  ASSERT( checker.check_all() );
+  ASSERT( itree.is_valid() );
+}
+
+std::string export_to_string( const dslib::AATree< IntAATreeNode > &tree,
+                              dslib::AATreeExportImpl::NodeLabelFn *label_fn,
+                              const dslib::AATreeExportOptions &options ) {
+  VectorWriter writer;
+  ASSERT( dslib::export_tree( tree, writer, label_fn, options ) );
+  return std::string( writer.data.begin(), writer.data.end() );
+}
+
+// Label that needs escaping
+size_t quote_label_fn( const dslib::AATreeNode *, char *buf, size_t size ) {
+  const char LABEL[] = "a\"b\\c\n";
+  memcpy( buf, LABEL, std::min( size, sizeof( LABEL ) - 1 ) );
+  return sizeof( LABEL ) - 1;
+}
+
+void test_export( TestObjs *objs ) {
+  auto &itree = objs->itree;
+
+  dslib::AATreeExportOptions dot, json;
+  json.format = dslib::AA_TREE_EXPORT_JSON;
+
+  ASSERT( "digraph aatree {\n  node [shape=box];\n}\n" == export_to_string( itree, &IntAATreeNode::label_fn, dot ) );
+  ASSERT( "{\"root\":null}\n" == export_to_string( itree, &IntAATreeNode::label_fn, json ) );
+
+  for ( int i = 1; i <= 4; ++i )
+    itree.insert( new IntAATreeNode( i ) );
+
+  // The tree is 2 at level 2, with children 1 and 3 at level 1,
+  // and a horizontal link from 3 to 4
+  ASSERT( "digraph aatree {\n"
+          "  node [shape=box];\n"
+          "  n0 [label=\"2: 2\"];\n"
+          "  n1 [label=\"1: 1\"];\n"
+          "  n0 -> n1 [label=\"L\"];\n"
+          "  n2 [label=\"1: 3\"];\n"
+          "  n0 -> n2 [label=\"R\"];\n"
+          "  n3 [label=\"1: 4\"];\n"
+          "  n2 -> n3 [label=\"R\", style=dashed];\n"
+          "}\n" == export_to_string( itree, &IntAATreeNode::label_fn, dot ) );
+  ASSERT( "{\"root\":{\"id\":0,\"level\":2,\"label\":\"2\","
+          "\"left\":{\"id\":1,\"level\":1,\"label\":\"1\",\"left\":null,\"right\":null},"
+          "\"right\":{\"id\":2,\"level\":1,\"label\":\"3\",\"left\":null,"
+          "\"right\":{\"id\":3,\"level\":1,\"label\":\"4\",\"left\":null,\"right\":null}}}}\n"
+          == export_to_string( itree, &IntAATreeNode::label_fn, json ) );
+
+  // Without labels, and with labels that need escaping
+  ASSERT( "{\"root\":{\"id\":0,\"level\":2,"
+          "\"left\":{\"id\":1,\"level\":1,\"left\":null,\"right\":null},"
+          "\"right\":{\"id\":2,\"level\":1,\"left\":null,"
+          "\"right\":{\"id\":3,\"level\":1,\"left\":null,\"right\":null}}}}\n"
+          == export_to_string( itree, nullptr, json ) );
+  std::string quoted = export_to_string( itree, &quote_label_fn, json );
+  ASSERT( quoted.find( "\"label\":\"a\\\"b\\\\c\\u000a\"" ) != std::string::npos );
+  quoted = export_to_string( itree, &quote_label_fn, dot );
+  ASSERT( quoted.find( "[label=\"1: a\\\"b\\\\c \"]" ) != std::string::npos );
+}
+
+void test_export_limits( TestObjs *objs ) {
+  auto &itree = objs->itree;
+
+  for ( int i = 1; i <= 3; ++i )
+    itree.insert( new IntAATreeNode( i ) );
+
+  dslib::AATreeExportOptions options;
+  options.format = dslib::AA_TREE_EXPORT_JSON;
+  options.max_depth = 0;
+  ASSERT( "{\"root\":{\"id\":0,\"level\":2,\"label\":\"2\",\"left\":\"elided\",\"right\":\"elided\"}}\n"
+          == export_to_string( itree, &IntAATreeNode::label_fn, options ) );
+
+  options.format = dslib::AA_TREE_EXPORT_DOT;
+  ASSERT( "digraph aatree {\n"
+          "  node [shape=box];\n"
+          "  n0 [label=\"2: 2\"];\n"
+          "  n0L [label=\"...\", shape=plaintext];\n"
+          "  n0 -> n0L [label=\"L\"];\n"
+          "  n0R [label=\"...\", shape=plaintext];\n"
+          "  n0 -> n0R [label=\"R\"];\n"
+          "}\n" == export_to_string( itree, &IntAATreeNode::label_fn, options ) );
+
+  // Sample every other subtree at depth 1
+  options.format = dslib::AA_TREE_EXPORT_JSON;
+  options.max_depth = -1;
+  options.sample_depth = 1;
+  options.sample_interval = 2;
+  ASSERT( "{\"root\":{\"id\":0,\"level\":2,\"label\":\"2\","
+          "\"left\":{\"id\":1,\"level\":1,\"label\":\"1\",\"left\":null,\"right\":null},"
+          "\"right\":\"elided\"}}\n"
+          == export_to_string( itree, &IntAATreeNode::label_fn, options ) );
+
+  // In a larger tree, sampling keeps about the right fraction of
+  // the nodes, and the output is still balanced
+  for ( int i = 4; i <= 10000; ++i )
+    itree.insert( new IntAATreeNode( i ) );
+  options.sample_depth = 4;
+  options.sample_interval = 4;
+  std::string json = export_to_string( itree, &IntAATreeNode::label_fn, options );
+  size_t num_nodes = 0;
+  for ( size_t pos = json.find( "\"id\"" ); pos != std::string::npos; pos = json.find( "\"id\"", pos + 1 ) )
+    ++num_nodes;
+  ASSERT( num_nodes > 10000 / 8 );
+  ASSERT( num_nodes < 10000 / 2 );
+  ASSERT( std::count( json.begin(), json.end(), '{' ) == std::count( json.begin(), json.end(), '}' ) );
+}
+
+#ifdef DSLIB_LATENCY
+void test_latency_histogram( TestObjs * ) {
+  // Every latency is recorded in a bucket whose upper bound is
+  // within 1/16 of it
+  for ( uint64_t ns = 0; ns < 100000; ns = ns + 1 + ns / 7 ) {
+    int bucket = dslib::LatencySnapshot::bucket_of( ns );
+    ASSERT( bucket >= 0 && bucket < dslib::LATENCY_NUM_BUCKETS );
+    uint64_t upper = dslib::LatencySnapshot::bucket_upper_bound( bucket );
+    ASSERT( upper >= ns );
+    ASSERT( upper - ns <= ns / 16 );
+    if ( bucket > 0 )
+      ASSERT( dslib::LatencySnapshot::bucket_upper_bound( bucket - 1 ) < ns );
+  }
+  ASSERT( dslib::LatencySnapshot::bucket_of( dslib::LATENCY_MAX_NS ) == dslib::LATENCY_NUM_BUCKETS - 1 );
+  ASSERT( dslib::LatencySnapshot::bucket_of( UINT64_MAX ) == dslib::LATENCY_NUM_BUCKETS - 1 );
+
+  // Latencies 1..1000
+  dslib::LatencyHistogram hist;
+  for ( uint64_t ns = 1000; ns >= 1; --ns )
+    hist.record( ns );
+  dslib::LatencySnapshot snap = hist.snapshot();
+  ASSERT( 1000 == snap.get_count() );
+  ASSERT( 1 == snap.get_min() );
+  ASSERT( 1000 == snap.get_max() );
+  ASSERT( snap.get_mean() == 500.5 );
+  ASSERT( 1 == snap.get_percentile( 0.0 ) );
+  ASSERT( snap.get_percentile( 50.0 ) >= 500 );
+  ASSERT( snap.get_percentile( 50.0 ) <= 500 + 500/16 );
+  ASSERT( snap.get_percentile( 99.0 ) >= 990 );
+  ASSERT( snap.get_percentile( 99.0 ) <= 1000 );
+  ASSERT( 1000 == snap.get_percentile( 100.0 ) );
+
+  // Merging adds the counts
+  dslib::LatencySnapshot merged;
+  ASSERT( 0 == merged.get_count() );
+  ASSERT( 0 == merged.get_percentile( 50.0 ) );
+  merged.merge( snap );
+  merged.merge( snap );
+  ASSERT( 2000 == merged.get_count() );
+  ASSERT( merged.get_percentile( 50.0 ) == snap.get_percentile( 50.0 ) );
+
+  hist.reset();
+  snap = hist.snapshot();
+  ASSERT( 0 == snap.get_count() );
+  ASSERT( 0 == snap.get_min() );
+  ASSERT( 0 == snap.get_max() );
+}
+
+void test_latency( TestObjs *objs ) {
+  auto &itree = objs->itree;
+  auto &ptree = objs->ptree;
+
+  // Nothing is recorded until latencies are enabled
+  ASSERT( !itree.is_latency_enabled() );
+  ASSERT( itree.insert( new IntAATreeNode( -1 ) ) );
+  ASSERT( itree.contains( -1 ) );
+  ASSERT( 0 == itree.get_latency().insert.get_count() );
+  ASSERT( 0 == itree.get_latency().find.get_count() );
+  ASSERT( itree.remove( IntAATreeNode( -1 ) ) );
+
+  ASSERT( itree.enable_latency() );
+  ASSERT( itree.is_latency_enabled() );
+  for ( int i = 0; i < 1000; ++i )
+    ASSERT( itree.insert( new IntAATreeNode( i ) ) );
+  IntAATreeNode dup( 0 );
+  ASSERT( !itree.insert( &dup ) );
+  for ( int i = 0; i < 1000; ++i )
+    ASSERT( itree.contains( i ) );
+  for ( int i = 0; i < 500; ++i )
+    ASSERT( itree.remove( IntAATreeNode( i ) ) );
+
+  dslib::AATreeLatency latency = itree.get_latency();
+  ASSERT( 1001 == latency.insert.get_count() );
+  ASSERT( 1000 == latency.find.get_count() );
+  ASSERT( 500 == latency.remove.get_count() );
+  ASSERT( latency.insert.get_max() >= latency.insert.get_percentile( 99.0 ) );
+  ASSERT( latency.insert.get_percentile( 99.0 ) >= latency.insert.get_percentile( 50.0 ) );
+  ASSERT( latency.insert.get_percentile( 50.0 ) >= latency.insert.get_min() );
+
+  itree.reset_latency();
+  latency = itree.get_latency();
+  ASSERT( 0 == latency.insert.get_count() );
+  ASSERT( 0 == latency.find.get_count() );
+  ASSERT( 0 == latency.remove.get_count() );
+
+  // Disabling discards the histograms
+  ASSERT( itree.insert( new IntAATreeNode( -1 ) ) );
+  itree.disable_latency();
+  ASSERT( !itree.is_latency_enabled() );
+  ASSERT( 0 == itree.get_latency().insert.get_count() );
+
+  // With parent links, remove() and remove_node() each record a
+  // single removal (and no search)
+  ASSERT( ptree.enable_latency() );
+  for ( int i = 0; i < 10; ++i )
+    ASSERT( ptree.insert( new IntAATreeParentNode( i ) ) );
+  ASSERT( ptree.remove( IntAATreeParentNode( 3 ) ) );
+  IntAATreeParentNode *node = ptree.find( IntAATreeParentNode( 4 ) );
+  ptree.remove_node( node );
+  latency = ptree.get_latency();
+  ASSERT( 10 == latency.insert.get_count() );
+  ASSERT( 1 == latency.find.get_count() );
+  ASSERT( 2 == latency.remove.get_count() );
+}
+#endif
+
+// Record a trace of some operations on a tree
+void record_trace( dslib::AATree< IntAATreeNode > &itree, std::vector< unsigned char > &data ) {
+  VectorWriter writer;
+  dslib::TraceRecorder recorder( writer, dslib::TRACE_AATREE );
+  dslib::TracedAATree< IntAATreeNode > traced( itree, recorder, &IntAATreeNode::encode_node_fn );
+
+  for ( int i = 0; i < 1000; ++i )
+    ASSERT( traced.insert( new IntAATreeNode( i ) ) );
+  for ( int i = 0; i < 1000; i += 3 )
+    ASSERT( traced.contains( IntAATreeNode( i ) ) );
+  ASSERT( traced.find( IntAATreeNode( 5000 ) ) == nullptr );
+  for ( int i = 0; i < 1000; i += 2 )
+    ASSERT( traced.remove( IntAATreeNode( i ) ) );
+  ASSERT( 1000 + 334 + 1 + 500 == recorder.get_count() );
+  ASSERT( recorder.finish() );
+  data = writer.data;
+}
+
+void test_trace( TestObjs *objs ) {
+  auto &itree = objs->itree;
+
+  std::vector< unsigned char > data;
+  record_trace( itree, data );
+  ASSERT( 500 == itree.get_size() );
+
+  // Build the expected sequence of operations
+  std::vector< std::pair< dslib::TraceOp, int > > expected;
+  for ( int i = 0; i < 1000; ++i )
+    expected.push_back( { dslib::TRACE_INSERT, i } );
+  for ( int i = 0; i < 1000; i += 3 )
+    expected.push_back( { dslib::TRACE_FIND, i } );
+  expected.push_back( { dslib::TRACE_FIND, 5000 } );
+  for ( int i = 0; i < 1000; i += 2 )
+    expected.push_back( { dslib::TRACE_REMOVE, i } );
+
+  // Read the trace back in small pieces, to exercise records that
+  // span chunks
+  VectorReader reader( data, 7 );
+  dslib::TraceReader trace( reader );
+  ASSERT( trace.is_valid() );
+  ASSERT( dslib::TRACE_AATREE == trace.get_kind() );
+
+  dslib::TraceRecord rec;
+  uint64_t last_time = 0;
+  for ( auto i = expected.begin(); i != expected.end(); ++i ) {
+    ASSERT( trace.next( rec ) );
+    ASSERT( i->first == rec.op );
+    ASSERT( sizeof( int ) == rec.key_size );
+    int key;
+    memcpy( &key, rec.key, sizeof( key ) );
+    ASSERT( i->second == key );
+    ASSERT( rec.time_ns >= last_time );
+    last_time = rec.time_ns;
+  }
+  ASSERT( !trace.next( rec ) );
+  ASSERT( trace.is_done() );
+  ASSERT( trace.is_valid() );
+}
+
+// Read a whole trace: returns true if it was valid
+bool read_trace( const std::vector< unsigned char > &data ) {
+  VectorReader reader( data );
+  dslib::TraceReader trace( reader );
+  dslib::TraceRecord rec;
+  while ( trace.next( rec ) )
+    ;
+  return trace.is_done() && trace.is_valid();
+}
+
+void test_trace_invalid( TestObjs *objs ) {
+  std::vector< unsigned char > data;
+  record_trace( objs->itree, data );
+  ASSERT( read_trace( data ) );
+
+  // Truncated
+  for ( size_t n : { size_t( 0 ), size_t( 10 ), data.size() / 2, data.size() - 1 } ) {
+    std::vector< unsigned char > truncated( data.begin(), data.begin() + n );
+    ASSERT( !read_trace( truncated ) );
+  }
+
+  // Corrupted: a changed key, or a changed record count
+  std::vector< unsigned char > corrupt( data );
+  corrupt[ data.size() / 2 ] ^= 0x10;
+  ASSERT( !read_trace( corrupt ) );
+  corrupt = data;
+  corrupt[ data.size() - 16 ] ^= 1;
+  ASSERT( !read_trace( corrupt ) );
+
+  // Wrong magic number
+  corrupt = data;
+  corrupt[ 0 ] = 'X';
+  VectorReader reader( corrupt );
+  dslib::TraceReader trace( reader );
+  ASSERT( !trace.is_valid() );
+}
+
+// Context for test_context(): the tree's ordering is chosen at
+// runtime, and the callbacks count how often they are called
+struct IntCollation {
+  bool descending;
+  int copies, frees;
+
+  static bool less_than_fn( const dslib::AATreeNode *left, const dslib::AATreeNode *right, void *ctx ) {
+    const IntCollation *coll = static_cast< const IntCollation* >( ctx );
+    int l = static_cast< const IntAATreeNode* >( left )->get_val();
+    int r = static_cast< const IntAATreeNode* >( right )->get_val();
+    return coll->descending ? r < l : l < r;
+  }
+
+  static void copy_node_fn( dslib::AATreeNode *from, dslib::AATreeNode *to, void *ctx ) {
+    ++static_cast< IntCollation* >( ctx )->copies;
+    IntAATreeNode::copy_node_fn( from, to );
+  }
+
+  static void free_node_fn( dslib::AATreeNode *node, void *ctx ) {
+    ++static_cast< IntCollation* >( ctx )->frees;
+    delete static_cast< IntAATreeNode* >( node );
+  }
+};
+
+void test_context( TestObjs * ) {
+  IntCollation coll = { true, 0, 0 };
+  {
+    dslib::AATree< IntAATreeNode > dtree( &IntCollation::less_than_fn, &IntCollation::copy_node_fn,
+                                          &IntCollation::free_node_fn, &coll );
+    for ( int i = 0; i < 100; ++i )
+      ASSERT( dtree.insert( new IntAATreeNode( i ) ) );
+    ASSERT( dtree.is_valid() );
+
+    // The tree is in descending order
+    auto it = dtree.iterator();
+    for ( int i = 99; i >= 0; --i ) {
+      ASSERT( it.has_next() );
+      ASSERT( i == it.next()->get_val() );
+    }
+    ASSERT( !it.has_next() );
+
+    // Searches (including with a finger and a snapshot) use the context
+    auto f = dtree.finger();
+    for ( int i = 99; i >= 0; --i )
+      ASSERT( i == f.find( IntAATreeNode( i ) )->get_val() );
+    std::vector< dslib::AATreeNode* > buf( 101 );
+    dslib::AATreeSnapshot< IntAATreeNode > snap;
+    ASSERT( snap.build( dtree, buf.data(), buf.size() ) );
+    for ( int i = 0; i < 100; ++i )
+      ASSERT( snap.find( IntAATreeNode( i ) ) == dtree.find( IntAATreeNode( i ) ) );
+    ASSERT( snap.find( IntAATreeNode( 100 ) ) == nullptr );
+
+    // Removals free nodes (and copy victims into interior nodes)
+    // through the context callbacks
+    for ( int i = 0; i < 100; i += 2 )
+      ASSERT( dtree.remove( IntAATreeNode( i ) ) );
+    ASSERT( dtree.is_valid() );
+    ASSERT( 50 == coll.frees );
+    ASSERT( coll.copies > 0 );
+  }
+
+  // The destructor freed the remaining nodes
+  ASSERT( 100 == coll.frees );
+}
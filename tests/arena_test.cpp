@@ -0,0 +1,306 @@
+#include <iostream>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <set>
+#include <algorithm>
+#include <random>
+#include "tctest.h"
+#include "ds_arena.h"
+#include "ds_aatree.h"
+#include "ds_list.h"
+
+////////////////////////////////////////////////////////////////////////
+// Node types for testing
+////////////////////////////////////////////////////////////////////////
+
+// Number of live nodes (to check which nodes are destroyed)
+int num_live_nodes;
+
+class IntAATreeNode : public dslib::AATreeNode {
+private:
+  int m_val;
+
+  NO_VALUE_SEMANTICS( IntAATreeNode );
+
+public:
+  IntAATreeNode( int val = 0 ) : m_val( val ) { ++num_live_nodes; }
+  ~IntAATreeNode() { --num_live_nodes; }
+
+  int get_val() const { return m_val; }
+
+  static void copy_node_fn( dslib::AATreeNode *from, dslib::AATreeNode *to ) {
+    static_cast< IntAATreeNode* >( to )->m_val = static_cast< IntAATreeNode* >( from )->m_val;
+  }
+
+  static bool less_than_fn( const dslib::AATreeNode *left, const dslib::AATreeNode *right ) {
+    return static_cast< const IntAATreeNode* >( left )->m_val
+         < static_cast< const IntAATreeNode* >( right )->m_val;
+  }
+};
+
+class IntListNode : public dslib::ListNode {
+private:
+  int m_val;
+
+  NO_VALUE_SEMANTICS( IntListNode );
+
+public:
+  IntListNode( int val ) : m_val( val ) { ++num_live_nodes; }
+  ~IntListNode() { --num_live_nodes; }
+
+  int get_val() const { return m_val; }
+};
+
+////////////////////////////////////////////////////////////////////////
+// Turn dslib assertions into tctest test failures
+////////////////////////////////////////////////////////////////////////
+
+namespace dslib {
+
+void assert_fail( const char *msg, const char *filename, int line ) {
+  std::stringstream ss;
+  ss << filename << ":" << line << ": " << msg;
+  FAIL( ss.str().c_str() ); // uses siglongjmp to "throw" to tctest failure handling code
+  for (;;);
+}
+
+} // end namespace dslib
+
+////////////////////////////////////////////////////////////////////////
+// Test fixture
+////////////////////////////////////////////////////////////////////////
+
+// Small chunks, so that the tests use several of them
+const size_t CHUNK_SIZE = 4096;
+
+struct TestObjs {
+  dslib::Arena arena;
+
+  TestObjs() : arena( CHUNK_SIZE ) { }
+};
+
+// Prototypes for setup and cleanup functions
+TestObjs *setup();
+void cleanup( TestObjs *objs );
+
+// Prototypes for test functions
+void test_alloc( TestObjs *objs );
+void test_large_alloc( TestObjs *objs );
+void test_oversized_alloc( TestObjs *objs );
+void test_reset( TestObjs *objs );
+void test_huge_pages( TestObjs *objs );
+void test_tree_teardown( TestObjs *objs );
+void test_list_teardown( TestObjs *objs );
+
+////////////////////////////////////////////////////////////////////////
+// Test program
+////////////////////////////////////////////////////////////////////////
+
+int main( int argc, char **argv ) {
+  if ( argc > 1 )
+    tctest_testname_to_execute = argv[1];
+
+  TEST_INIT();
+
+  TEST( test_alloc );
+  TEST( test_large_alloc );
+  TEST( test_oversized_alloc );
+  TEST( test_reset );
+  TEST( test_huge_pages );
+  TEST( test_tree_teardown );
+  TEST( test_list_teardown );
+
+  TEST_FINI();
+}
+
+////////////////////////////////////////////////////////////////////////
+// Function implementations
+////////////////////////////////////////////////////////////////////////
+
+TestObjs *setup() {
+  num_live_nodes = 0;
+  TestObjs *objs = new TestObjs;
+  return objs;
+}
+
+void cleanup( TestObjs *objs ) {
+  delete objs;
+}
+
+void test_alloc( TestObjs *objs ) {
+  auto &arena = objs->arena;
+
+  ASSERT( 0 == arena.get_num_chunks() );
+  ASSERT( 0 == arena.get_bytes_allocated() );
+
+  // Allocations of various sizes and alignments don't overlap, and
+  // are aligned
+  std::vector< std::pair< char*, size_t > > allocs;
+  std::mt19937 gen( 3 );
+  size_t total = 0;
+  for ( int i = 0; i < 1000; ++i ) {
+    size_t size = 1 + gen() % 100;
+    size_t align = size_t( 1 ) << ( gen() % 7 );
+    char *p = static_cast< char* >( arena.alloc( size, align ) );
+    ASSERT( p != nullptr );
+    ASSERT( reinterpret_cast< uintptr_t >( p ) % align == 0 );
+    memset( p, i & 0xff, size );
+    allocs.push_back( { p, size } );
+    total += size;
+  }
+  ASSERT( total == arena.get_bytes_allocated() );
+  ASSERT( arena.get_num_chunks() > 1 );
+
+  std::sort( allocs.begin(), allocs.end() );
+  for ( size_t i = 1; i < allocs.size(); ++i )
+    ASSERT( allocs[ i - 1 ].first + allocs[ i - 1 ].second <= allocs[ i ].first );
+
+  // create() constructs objects
+  IntListNode *node = arena.create< IntListNode >( 42 );
+  ASSERT( 42 == node->get_val() );
+  ASSERT( reinterpret_cast< uintptr_t >( node ) % alignof( IntListNode ) == 0 );
+  node->~IntListNode();
+}
+
+void test_large_alloc( TestObjs *objs ) {
+  auto &arena = objs->arena;
+
+  char *small1 = static_cast< char* >( arena.alloc( 16 ) );
+  ASSERT( 1 == arena.get_num_chunks() );
+
+  // An allocation larger than a chunk gets its own chunk, and the
+  // current chunk is still used for later allocations
+  char *large = static_cast< char* >( arena.alloc( 3 * CHUNK_SIZE ) );
+  ASSERT( large != nullptr );
+  memset( large, 1, 3 * CHUNK_SIZE );
+  ASSERT( 2 == arena.get_num_chunks() );
+  char *small2 = static_cast< char* >( arena.alloc( 16 ) );
+  ASSERT( small2 == small1 + 16 );
+  ASSERT( 2 == arena.get_num_chunks() );
+
+  // A large allocation in an empty arena
+  dslib::Arena empty( CHUNK_SIZE );
+  ASSERT( empty.alloc( 2 * CHUNK_SIZE ) != nullptr );
+  ASSERT( empty.alloc( 16 ) != nullptr );
+  empty.reset();
+  ASSERT( empty.get_num_chunks() <= 1 );
+  ASSERT( empty.alloc( 16 ) != nullptr );
+}
+
+void test_oversized_alloc( TestObjs *objs ) {
+  auto &arena = objs->arena;
+
+  char *small1 = static_cast< char* >( arena.alloc( 16, 16 ) );
+  ASSERT( small1 != nullptr );
+  size_t chunks = arena.get_num_chunks();
+
+  // Requests too large to allocate fail, without changing the arena
+  ASSERT( arena.alloc( SIZE_MAX - 8, 16 ) == nullptr );
+  ASSERT( arena.alloc( SIZE_MAX, 1 ) == nullptr );
+  ASSERT( arena.alloc( SIZE_MAX - sizeof( void* ), 64 ) == nullptr );
+  ASSERT( 16 == arena.get_bytes_allocated() );
+  ASSERT( chunks == arena.get_num_chunks() );
+
+  // Later allocations don't overlap earlier ones
+  char *small2 = static_cast< char* >( arena.alloc( 16, 16 ) );
+  ASSERT( small2 == small1 + 16 );
+
+  // Likewise with huge pages
+  dslib::Arena huge( dslib::ARENA_CHUNK_SIZE, dslib::ARENA_HUGE_PAGES );
+  ASSERT( huge.alloc( SIZE_MAX - 8, 16 ) == nullptr );
+  ASSERT( huge.alloc( SIZE_MAX - dslib::ARENA_CHUNK_SIZE, 16 ) == nullptr );
+  ASSERT( 0 == huge.get_bytes_allocated() );
+  ASSERT( huge.alloc( 16 ) != nullptr );
+}
+
+void test_reset( TestObjs *objs ) {
+  auto &arena = objs->arena;
+
+  for ( int i = 0; i < 1000; ++i )
+    ASSERT( arena.alloc( 64 ) != nullptr );
+  ASSERT( arena.alloc( 10 * CHUNK_SIZE ) != nullptr );
+  ASSERT( arena.get_num_chunks() > 10 );
+
+  // Resetting keeps one chunk, and starts allocating from its
+  // beginning again
+  arena.reset();
+  ASSERT( 1 == arena.get_num_chunks() );
+  ASSERT( 0 == arena.get_bytes_allocated() );
+  char *again = static_cast< char* >( arena.alloc( 64 ) );
+  ASSERT( again != nullptr );
+  ASSERT( 64 == arena.get_bytes_allocated() );
+  ASSERT( 1 == arena.get_num_chunks() );
+}
+
+void test_huge_pages( TestObjs * ) {
+  // Huge pages are only advice, so this works whether or not the
+  // system has them
+  dslib::Arena arena( dslib::ARENA_CHUNK_SIZE, dslib::ARENA_HUGE_PAGES );
+  std::vector< int* > vals;
+  for ( int i = 0; i < 1000000; ++i ) {
+    int *p = arena.create< int >( i );
+    ASSERT( p != nullptr );
+    vals.push_back( p );
+  }
+  for ( int i = 0; i < 1000000; ++i )
+    ASSERT( i == *vals[ i ] );
+  ASSERT( arena.get_num_chunks() >= 2 );
+  arena.reset();
+  ASSERT( 1 == arena.get_num_chunks() );
+}
+
+void test_tree_teardown( TestObjs *objs ) {
+  auto &arena = objs->arena;
+
+  {
+    dslib::AATree< IntAATreeNode > itree( &IntAATreeNode::less_than_fn, &IntAATreeNode::copy_node_fn,
+                                          &dslib::Arena::free_node_fn< IntAATreeNode, dslib::AATreeNode >,
+                                          dslib::AA_TREE_NO_FREE_ON_DESTROY );
+    for ( int i = 0; i < 1000; ++i )
+      ASSERT( itree.insert( arena.create< IntAATreeNode >( i ) ) );
+    ASSERT( itree.is_valid() );
+    ASSERT( 1000 == num_live_nodes );
+
+    // Removed nodes are still destroyed by the free node function
+    for ( int i = 0; i < 1000; i += 4 )
+      ASSERT( itree.remove( IntAATreeNode( i ) ) );
+    ASSERT( 750 == num_live_nodes );
+  }
+
+  // The tree's destructor didn't visit the remaining nodes
+  ASSERT( 750 == num_live_nodes );
+  arena.reset();
+
+  // A tree without the flag destroys its nodes as usual
+  {
+    dslib::AATree< IntAATreeNode > itree( &IntAATreeNode::less_than_fn, &IntAATreeNode::copy_node_fn,
+                                          &dslib::Arena::free_node_fn< IntAATreeNode, dslib::AATreeNode > );
+    for ( int i = 0; i < 100; ++i )
+      ASSERT( itree.insert( arena.create< IntAATreeNode >( i ) ) );
+  }
+  ASSERT( 750 == num_live_nodes );
+}
+
+void test_list_teardown( TestObjs *objs ) {
+  auto &arena = objs->arena;
+
+  {
+    dslib::List< IntListNode > ilist( &dslib::Arena::free_node_fn< IntListNode, dslib::ListNode >,
+                                      dslib::LIST_NO_FREE_ON_DESTROY );
+    for ( int i = 0; i < 1000; ++i )
+      ilist.append( arena.create< IntListNode >( i ) );
+    ASSERT( 1000 == ilist.get_size() );
+  }
+  ASSERT( 1000 == num_live_nodes );
+  arena.reset();
+
+  {
+    dslib::List< IntListNode > ilist( &dslib::Arena::free_node_fn< IntListNode, dslib::ListNode > );
+    for ( int i = 0; i < 10; ++i )
+      ilist.append( arena.create< IntListNode >( i ) );
+  }
+  ASSERT( 1000 == num_live_nodes );
+}
@@ -1,9 +1,12 @@
 #include <iostream>
+#include <cstring>
 #include <string>
 #include <sstream>
 #include <vector>
+#include <algorithm>
 #include "tctest.h"
 #include "ds_list.h"
+#include "ds_trace.h"
 
 ////////////////////////////////////////////////////////////////////////
 // Integer list for testing
@@ -22,12 +25,20 @@ public:
   void set_val( int val ) { m_val = val; }
 
   static void free_int_list_node( dslib::ListNode *node );
+  static size_t encode_node_fn( const dslib::ListNode *node, void *buf, size_t size );
 };
 
 void IntListNode::free_int_list_node( dslib::ListNode *node ) {
   delete static_cast< IntListNode* >( node );
 }
 
+size_t IntListNode::encode_node_fn( const dslib::ListNode *node, void *buf, size_t size ) {
+  int val = static_cast< const IntListNode* >( node )->get_val();
+  if ( size >= sizeof( val ) )
+    memcpy( buf, &val, sizeof( val ) );
+  return sizeof( val );
+}
+
 void check_list_contents( const std::vector<int> &expected, const dslib::List< IntListNode > &list ) {
   ASSERT( expected.size() == list.get_size() );
 
@@ -50,6 +61,39 @@ void check_list_contents( const std::vector<int> &expected, const dslib::List< I
   ASSERT( q == nullptr );
 }
 
+////////////////////////////////////////////////////////////////////////
+// In-memory traces
+////////////////////////////////////////////////////////////////////////
+
+class VectorWriter : public dslib::AATreeWriter {
+public:
+  std::vector< unsigned char > data;
+
+  virtual bool write( const void *p, size_t n ) {
+    const unsigned char *bytes = static_cast< const unsigned char* >( p );
+    data.insert( data.end(), bytes, bytes + n );
+    return true;
+  }
+};
+
+class VectorReader : public dslib::AATreeReader {
+private:
+  const std::vector< unsigned char > &m_data;
+  size_t m_pos;
+
+public:
+  VectorReader( const std::vector< unsigned char > &data ) : m_data( data ), m_pos( 0 ) { }
+
+  virtual size_t read( void *buf, size_t n ) {
+    n = std::min( n, m_data.size() - m_pos );
+    if ( n == 0 )
+      return 0;
+    memcpy( buf, m_data.data() + m_pos, n );
+    m_pos += n;
+    return n;
+  }
+};
+
 ////////////////////////////////////////////////////////////////////////
 // Turn dslib assertions into tctest test failures
 ////////////////////////////////////////////////////////////////////////
@@ -93,6 +137,13 @@ void test_insert_after( TestObjs *objs );
 void test_remove( TestObjs *objs );
 void test_remove_first( TestObjs *objs );
 void test_remove_last( TestObjs *objs );
+#ifdef DSLIB_STATS
+void test_stats( TestObjs *objs );
+#endif
+#ifdef DSLIB_LATENCY
+void test_latency( TestObjs *objs );
+#endif
+void test_trace( TestObjs *objs );
 
 ////////////////////////////////////////////////////////////////////////
 // Test program
@@ -112,6 +163,13 @@ int main( int argc, char **argv ) {
   TEST( test_remove );
   TEST( test_remove_first );
   TEST( test_remove_last );
+#ifdef DSLIB_STATS
+  TEST( test_stats );
+#endif
+#ifdef DSLIB_LATENCY
+  TEST( test_latency );
+#endif
+  TEST( test_trace );
 
   TEST_FINI();
 }
@@ -274,3 +332,118 @@ void test_remove_last( TestObjs *objs ) {
 
   ASSERT( ilist.is_empty() );
 }
+
+#ifdef DSLIB_STATS
+void test_stats( TestObjs *objs ) {
+  auto &ilist = objs->ilist;
+
+  auto middle = new IntListNode( 1 );
+  ilist.append( middle );
+  ilist.prepend( new IntListNode( 0 ) );
+  ilist.insert_before( new IntListNode( 2 ), middle );
+  ilist.insert_after( new IntListNode( 3 ), middle );
+  ASSERT( 4 == ilist.get_size() );
+
+  dslib::ListStats stats = ilist.get_stats();
+  ASSERT( 4 == stats.insertions );
+  ASSERT( 0 == stats.removals );
+  ASSERT( 4 == stats.nodes_visited );
+
+  ilist.remove( middle );
+  delete middle;
+  delete ilist.remove_first();
+  ASSERT( 2 == ilist.get_size() );
+
+  stats = ilist.get_stats();
+  ASSERT( 4 == stats.insertions );
+  ASSERT( 2 == stats.removals );
+  ASSERT( 6 == stats.nodes_visited );
+
+  ilist.reset_stats();
+  stats = ilist.get_stats();
+  ASSERT( 0 == stats.insertions );
+  ASSERT( 0 == stats.removals );
+  ASSERT( 0 == stats.nodes_visited );
+}
+#endif
+
+#ifdef DSLIB_LATENCY
+void test_latency( TestObjs *objs ) {
+  auto &ilist = objs->ilist;
+
+  // Nothing is recorded until latencies are enabled
+  ASSERT( !ilist.is_latency_enabled() );
+  ilist.append( new IntListNode( -1 ) );
+  delete ilist.remove_first();
+  ASSERT( 0 == ilist.get_latency().insert.get_count() );
+  ASSERT( 0 == ilist.get_latency().remove.get_count() );
+
+  ASSERT( ilist.enable_latency() );
+  auto middle = new IntListNode( 1 );
+  ilist.append( middle );
+  ilist.prepend( new IntListNode( 0 ) );
+  ilist.insert_before( new IntListNode( 2 ), middle );
+  ilist.insert_after( new IntListNode( 3 ), middle );
+
+  ilist.remove( middle );
+  delete middle;
+  delete ilist.remove_first();
+  delete ilist.remove_last();
+
+  dslib::ListLatency latency = ilist.get_latency();
+  ASSERT( 4 == latency.insert.get_count() );
+  ASSERT( 3 == latency.remove.get_count() );
+  ASSERT( latency.insert.get_max() >= latency.insert.get_percentile( 50.0 ) );
+
+  ilist.reset_latency();
+  latency = ilist.get_latency();
+  ASSERT( 0 == latency.insert.get_count() );
+  ASSERT( 0 == latency.remove.get_count() );
+}
+#endif
+
+void test_trace( TestObjs *objs ) {
+  auto &ilist = objs->ilist;
+
+  VectorWriter writer;
+  {
+    dslib::TraceRecorder recorder( writer, dslib::TRACE_LIST );
+    dslib::TracedList< IntListNode > traced( ilist, recorder, &IntListNode::encode_node_fn );
+
+    auto middle = new IntListNode( 1 );
+    traced.append( middle );
+    traced.prepend( new IntListNode( 0 ) );
+    traced.append( new IntListNode( 2 ) );
+    traced.remove( middle );
+    delete middle;
+    delete traced.remove_last();
+    delete traced.remove_first();
+    // (the recorder finishes the trace when it is destroyed)
+  }
+  ASSERT( ilist.is_empty() );
+
+  const std::vector< std::pair< dslib::TraceOp, int > > expected = {
+    { dslib::TRACE_APPEND, 1 },
+    { dslib::TRACE_PREPEND, 0 },
+    { dslib::TRACE_APPEND, 2 },
+    { dslib::TRACE_REMOVE, 1 },
+    { dslib::TRACE_REMOVE_LAST, 2 },
+    { dslib::TRACE_REMOVE_FIRST, 0 },
+  };
+
+  VectorReader reader( writer.data );
+  dslib::TraceReader trace( reader );
+  ASSERT( dslib::TRACE_LIST == trace.get_kind() );
+  dslib::TraceRecord rec;
+  for ( auto i = expected.begin(); i != expected.end(); ++i ) {
+    ASSERT( trace.next( rec ) );
+    ASSERT( i->first == rec.op );
+    int key;
+    ASSERT( sizeof( key ) == rec.key_size );
+    memcpy( &key, rec.key, sizeof( key ) );
+    ASSERT( i->second == key );
+  }
+  ASSERT( !trace.next( rec ) );
+  ASSERT( trace.is_done() );
+  ASSERT( trace.is_valid() );
+}
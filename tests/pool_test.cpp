@@ -0,0 +1,373 @@
+#include <iostream>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <set>
+#include <algorithm>
+#include <random>
+#include "tctest.h"
+#include "ds_pool.h"
+#include "ds_aatree.h"
+#include "ds_list.h"
+
+////////////////////////////////////////////////////////////////////////
+// Node types for testing
+////////////////////////////////////////////////////////////////////////
+
+// Number of live nodes (to check that nodes are destroyed)
+int num_live_nodes;
+
+class IntAATreeNode : public dslib::AATreeNode {
+private:
+  int m_val;
+
+  NO_VALUE_SEMANTICS( IntAATreeNode );
+
+public:
+  IntAATreeNode( int val = 0 ) : m_val( val ) { ++num_live_nodes; }
+  ~IntAATreeNode() { --num_live_nodes; }
+
+  int get_val() const { return m_val; }
+
+  static void copy_node_fn( dslib::AATreeNode *from, dslib::AATreeNode *to ) {
+    static_cast< IntAATreeNode* >( to )->m_val = static_cast< IntAATreeNode* >( from )->m_val;
+  }
+
+  static bool less_than_fn( const dslib::AATreeNode *left, const dslib::AATreeNode *right ) {
+    return static_cast< const IntAATreeNode* >( left )->m_val
+         < static_cast< const IntAATreeNode* >( right )->m_val;
+  }
+};
+
+class IntListNode : public dslib::ListNode {
+private:
+  int m_val;
+
+  NO_VALUE_SEMANTICS( IntListNode );
+
+public:
+  IntListNode( int val ) : m_val( val ) { ++num_live_nodes; }
+  ~IntListNode() { --num_live_nodes; }
+
+  int get_val() const { return m_val; }
+};
+
+// An object with a stricter alignment than its members need
+struct alignas( 64 ) AlignedObj {
+  char data[ 10 ];
+};
+
+////////////////////////////////////////////////////////////////////////
+// Turn dslib assertions into tctest test failures
+////////////////////////////////////////////////////////////////////////
+
+namespace dslib {
+
+void assert_fail( const char *msg, const char *filename, int line ) {
+  std::stringstream ss;
+  ss << filename << ":" << line << ": " << msg;
+  FAIL( ss.str().c_str() ); // uses siglongjmp to "throw" to tctest failure handling code
+  for (;;);
+}
+
+} // end namespace dslib
+
+////////////////////////////////////////////////////////////////////////
+// Test fixture
+////////////////////////////////////////////////////////////////////////
+
+struct TestObjs {
+  // The pools are declared before the containers, so that they are
+  // destroyed after them
+  dslib::Pool< IntAATreeNode > tree_pool;
+  dslib::Pool< IntListNode > list_pool;
+  dslib::AATree< IntAATreeNode > itree;
+  dslib::List< IntListNode > ilist;
+
+  TestObjs()
+    : itree( &IntAATreeNode::less_than_fn, &IntAATreeNode::copy_node_fn,
+             &dslib::Pool< IntAATreeNode >::free_node_fn< dslib::AATreeNode > )
+    , ilist( &dslib::Pool< IntListNode >::free_node_fn< dslib::ListNode > )
+  { }
+};
+
+// Prototypes for setup and cleanup functions
+TestObjs *setup();
+void cleanup( TestObjs *objs );
+
+// Prototypes for test functions
+void test_create_destroy( TestObjs *objs );
+void test_slabs( TestObjs *objs );
+void test_alignment( TestObjs *objs );
+void test_tree_nodes( TestObjs *objs );
+void test_list_nodes( TestObjs *objs );
+void test_churn( TestObjs *objs );
+void test_context( TestObjs *objs );
+void test_oversized( TestObjs *objs );
+
+////////////////////////////////////////////////////////////////////////
+// Test program
+////////////////////////////////////////////////////////////////////////
+
+int main( int argc, char **argv ) {
+  if ( argc > 1 )
+    tctest_testname_to_execute = argv[1];
+
+  TEST_INIT();
+
+  TEST( test_create_destroy );
+  TEST( test_slabs );
+  TEST( test_alignment );
+  TEST( test_tree_nodes );
+  TEST( test_list_nodes );
+  TEST( test_churn );
+  TEST( test_context );
+  TEST( test_oversized );
+
+  TEST_FINI();
+}
+
+////////////////////////////////////////////////////////////////////////
+// Function implementations
+////////////////////////////////////////////////////////////////////////
+
+TestObjs *setup() {
+  num_live_nodes = 0;
+  TestObjs *objs = new TestObjs;
+  return objs;
+}
+
+void cleanup( TestObjs *objs ) {
+  delete objs;
+}
+
+void test_create_destroy( TestObjs *objs ) {
+  auto &pool = objs->tree_pool;
+
+  ASSERT( 0 == pool.get_num_slabs() );
+  ASSERT( pool.get_object_size() >= sizeof( IntAATreeNode ) );
+  ASSERT( pool.get_object_size() % alignof( IntAATreeNode ) == 0 );
+
+  IntAATreeNode *a = pool.create( 1 );
+  IntAATreeNode *b = pool.create( 2 );
+  ASSERT( a != nullptr && b != nullptr && a != b );
+  ASSERT( 1 == a->get_val() );
+  ASSERT( 2 == b->get_val() );
+  ASSERT( 2 == num_live_nodes );
+  ASSERT( 2 == pool.get_num_allocated() );
+  ASSERT( 1 == pool.get_num_slabs() );
+
+  // Objects don't overlap
+  const char *pa = reinterpret_cast< const char* >( a ), *pb = reinterpret_cast< const char* >( b );
+  ASSERT( pa + sizeof( IntAATreeNode ) <= pb || pb + sizeof( IntAATreeNode ) <= pa );
+
+  pool.destroy( a );
+  dslib::Pool< IntAATreeNode >::destroy_pooled( b );
+  ASSERT( 0 == num_live_nodes );
+  ASSERT( 0 == pool.get_num_allocated() );
+
+  // The empty slab is kept for reuse
+  ASSERT( 1 == pool.get_num_slabs() );
+  pool.release_empty_slabs();
+  ASSERT( 0 == pool.get_num_slabs() );
+}
+
+void test_slabs( TestObjs *objs ) {
+  auto &pool = objs->list_pool;
+  const size_t per_slab = pool.get_objects_per_slab();
+  ASSERT( per_slab >= 8 );
+
+  // Fill three slabs
+  std::vector< IntListNode* > nodes;
+  for ( size_t i = 0; i < 3 * per_slab; ++i )
+    nodes.push_back( pool.create( int( i ) ) );
+  ASSERT( 3 == pool.get_num_slabs() );
+  std::set< IntListNode* > distinct( nodes.begin(), nodes.end() );
+  ASSERT( nodes.size() == distinct.size() );
+
+  // Freeing one object makes room for one more, without a new slab
+  pool.destroy( nodes[ per_slab + 5 ] );
+  IntListNode *again = pool.create( -1 );
+  ASSERT( again == nodes[ per_slab + 5 ] );
+  ASSERT( 3 == pool.get_num_slabs() );
+  nodes[ per_slab + 5 ] = again;
+
+  // Emptying the slabs keeps one of them (the default maximum) for
+  // reuse, and frees the others
+  for ( IntListNode *node : nodes )
+    pool.destroy( node );
+  ASSERT( 0 == pool.get_num_allocated() );
+  ASSERT( 1 == pool.get_num_slabs() );
+
+  // A pool which keeps no empty slabs
+  dslib::Pool< IntListNode > stingy( 0 );
+  IntListNode *node = stingy.create( 0 );
+  ASSERT( 1 == stingy.get_num_slabs() );
+  stingy.destroy( node );
+  ASSERT( 0 == stingy.get_num_slabs() );
+}
+
+void test_alignment( TestObjs * ) {
+  dslib::Pool< AlignedObj > pool;
+  ASSERT( 64 == pool.get_object_size() );
+  std::vector< AlignedObj* > objs;
+  for ( int i = 0; i < 5000; ++i ) {
+    AlignedObj *obj = pool.create();
+    ASSERT( reinterpret_cast< uintptr_t >( obj ) % 64 == 0 );
+    objs.push_back( obj );
+  }
+  for ( AlignedObj *obj : objs )
+    pool.destroy( obj );
+
+  // Tiny objects still have room for a free list link
+  dslib::Pool< char > char_pool;
+  ASSERT( char_pool.get_object_size() >= sizeof( void* ) );
+  char *c = char_pool.create( 'x' );
+  ASSERT( 'x' == *c );
+  char_pool.destroy( c );
+}
+
+void test_tree_nodes( TestObjs *objs ) {
+  auto &pool = objs->tree_pool;
+  auto &itree = objs->itree;
+
+  std::vector< int > vals;
+  for ( int i = 0; i < 10000; ++i )
+    vals.push_back( i );
+  std::shuffle( vals.begin(), vals.end(), std::default_random_engine() );
+
+  for ( int v : vals )
+    ASSERT( itree.insert( pool.create( v ) ) );
+  ASSERT( 10000 == num_live_nodes );
+  ASSERT( 10000 == pool.get_num_allocated() );
+
+  // Removals free nodes back to the pool, through the tree's free
+  // node function
+  for ( int i = 0; i < 10000; i += 2 )
+    ASSERT( itree.remove( IntAATreeNode( i ) ) );
+  ASSERT( 5000 == num_live_nodes );
+  ASSERT( 5000 == pool.get_num_allocated() );
+  ASSERT( itree.is_valid() );
+  for ( int i = 0; i < 10000; ++i )
+    ASSERT( itree.contains( IntAATreeNode( i ) ) == ( i % 2 == 1 ) );
+
+  // (the remaining nodes are freed when the tree is destroyed)
+}
+
+void test_list_nodes( TestObjs *objs ) {
+  auto &pool = objs->list_pool;
+  auto &ilist = objs->ilist;
+
+  for ( int i = 0; i < 1000; ++i )
+    ilist.append( pool.create( i ) );
+  ASSERT( 1000 == pool.get_num_allocated() );
+
+  for ( int i = 0; i < 500; ++i ) {
+    IntListNode *node = ilist.remove_first();
+    ASSERT( i == node->get_val() );
+    pool.destroy( node );
+  }
+  ASSERT( 500 == pool.get_num_allocated() );
+  ASSERT( 500 == num_live_nodes );
+}
+
+void test_churn( TestObjs *objs ) {
+  auto &pool = objs->list_pool;
+
+  // Random allocations and frees, checking that live objects keep
+  // their values
+  std::mt19937 gen( 7 );
+  std::vector< IntListNode* > live;
+  for ( int i = 0; i < 200000; ++i ) {
+    if ( live.empty() || gen() % 100 < 55 ) {
+      IntListNode *node = pool.create( i );
+      ASSERT( node != nullptr );
+      live.push_back( node );
+    } else {
+      size_t index = gen() % live.size();
+      std::swap( live[ index ], live.back() );
+      pool.destroy( live.back() );
+      live.pop_back();
+    }
+  }
+  ASSERT( live.size() == pool.get_num_allocated() );
+  ASSERT( int( live.size() ) == num_live_nodes );
+
+  std::set< int > vals;
+  for ( IntListNode *node : live )
+    vals.insert( node->get_val() );
+  ASSERT( live.size() == vals.size() );
+
+  // The pool uses no more slabs than needed for the peak number of
+  // live objects (plus partially used slabs)
+  ASSERT( pool.get_num_slabs() * pool.get_objects_per_slab() < 2 * 200000 );
+
+  for ( IntListNode *node : live )
+    pool.destroy( node );
+  ASSERT( 0 == num_live_nodes );
+  ASSERT( pool.get_num_slabs() <= 1 );
+}
+
+void test_context( TestObjs * ) {
+  typedef dslib::Pool< IntAATreeNode > TreePool;
+  typedef dslib::Pool< IntListNode > ListPool;
+
+  // Each container's context is its own pool, so that nodes are
+  // freed directly back to it
+  TreePool pool1, pool2;
+  ListPool list_pool;
+  {
+    dslib::AATree< IntAATreeNode > tree1( &IntAATreeNode::less_than_fn, &IntAATreeNode::copy_node_fn,
+                                          &TreePool::free_node_ctx_fn< dslib::AATreeNode >, &pool1 );
+    dslib::AATree< IntAATreeNode > tree2( &IntAATreeNode::less_than_fn, &IntAATreeNode::copy_node_fn,
+                                          &TreePool::free_node_ctx_fn< dslib::AATreeNode >, &pool2 );
+    dslib::List< IntListNode > ilist( &ListPool::free_node_ctx_fn< dslib::ListNode >, &list_pool );
+
+    for ( int i = 0; i < 1000; ++i ) {
+      ASSERT( tree1.insert( pool1.create( i ) ) );
+      ASSERT( tree2.insert( pool2.create( i ) ) );
+      ilist.append( list_pool.create( i ) );
+    }
+    ASSERT( 3000 == num_live_nodes );
+
+    for ( int i = 0; i < 1000; i += 2 )
+      ASSERT( tree1.remove( IntAATreeNode( i ) ) );
+    for ( int i = 0; i < 1000; i += 4 )
+      ASSERT( tree2.remove( IntAATreeNode( i ) ) );
+    ASSERT( 500 == pool1.get_num_allocated() );
+    ASSERT( 750 == pool2.get_num_allocated() );
+    ASSERT( tree1.is_valid() );
+    ASSERT( tree2.is_valid() );
+    ASSERT( 1000 == list_pool.get_num_allocated() );
+  }
+
+  // The containers' destructors freed the remaining nodes
+  ASSERT( 0 == pool1.get_num_allocated() );
+  ASSERT( 0 == pool2.get_num_allocated() );
+  ASSERT( 0 == list_pool.get_num_allocated() );
+  ASSERT( 0 == num_live_nodes );
+}
+
+// An object too large for a slab (Pool< HugeObj > doesn't compile)
+struct HugeObj {
+  char data[ 70000 ];
+};
+
+void test_oversized( TestObjs * ) {
+  static_assert( dslib::PoolImpl::can_hold( sizeof( IntAATreeNode ), alignof( IntAATreeNode ) ), "" );
+  static_assert( !dslib::PoolImpl::can_hold( sizeof( HugeObj ), alignof( HugeObj ) ), "" );
+
+  // Objects that would fit only a few to a slab are also refused
+  ASSERT( !dslib::PoolImpl::can_hold( dslib::POOL_SLAB_SIZE / 4, 8 ) );
+  ASSERT( dslib::PoolImpl::can_hold( dslib::POOL_SLAB_SIZE / 16, 8 ) );
+
+  // Allocation fails cleanly, rather than overrunning a slab
+  dslib::PoolImpl huge( sizeof( HugeObj ), alignof( HugeObj ) );
+  ASSERT( 0 == huge.get_objects_per_slab() );
+  ASSERT( huge.alloc() == nullptr );
+  ASSERT( huge.alloc() == nullptr );
+  ASSERT( 0 == huge.get_num_slabs() );
+  ASSERT( 0 == huge.get_num_allocated() );
+}
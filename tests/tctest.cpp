@@ -25,6 +25,8 @@
 #include <signal.h>
 #include <unistd.h>
 #include <stdarg.h>
+#include <stdlib.h>
+#include <time.h>
 #include "tctest.h"
 
 typedef struct {
@@ -49,6 +51,14 @@ int tctest_num_executed;
 const char *tctest_testname_to_execute;
 void (*tctest_on_test_executed)(const char *testname, int passed);
 void (*tctest_on_complete)(int num_passed, int num_executed);
+void (*tctest_on_bench_complete)(const char *testname, int iterations,
+	double min_ms, double median_ms, double p99_ms);
+
+/* benchmark mode state: samples are recorded only after the warm-up runs */
+static int tctest_bench_warmup;
+static int tctest_bench_iterations;
+static int tctest_bench_count;
+static double *tctest_bench_samples;
 
 /*
  * Special version of write to work around the fact that
@@ -150,3 +160,91 @@ void tctest_fail(const char *fmt, ...) {
 	/* jump back to the TEST context */
 	siglongjmp(tctest_env, 1);
 }
+
+int tctest_bench_enabled(void) {
+	const char *val = getenv("TCTEST_BENCH");
+	return val != NULL && atoi(val) != 0;
+}
+
+long tctest_scale(long n) {
+	const char *val = getenv("TCTEST_SCALE");
+	double factor = val != NULL ? atof(val) : 1.0;
+	long scaled;
+
+	if (factor <= 0.0) {
+		factor = 1.0;
+	}
+	scaled = (long) (n * factor);
+	return scaled > 0 ? scaled : 1;
+}
+
+/*
+ * Prepare to record the timings of the given number of runs:
+ * returns the total number of runs, including the warm-up runs,
+ * or 0 if there is no memory to record the timings.
+ */
+int tctest_bench_begin(int iterations) {
+	if (iterations < 1) {
+		iterations = 1;
+	}
+	tctest_bench_warmup = iterations >= 20 ? iterations / 10 : 2;
+	tctest_bench_iterations = iterations;
+	tctest_bench_count = 0;
+	free(tctest_bench_samples);
+	tctest_bench_samples = (double *) malloc(iterations * sizeof(double));
+	if (tctest_bench_samples == NULL) {
+		return 0;
+	}
+	return tctest_bench_warmup + iterations;
+}
+
+double tctest_bench_now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void tctest_bench_record(double secs) {
+	if (tctest_bench_warmup > 0) {
+		tctest_bench_warmup--;
+	} else if (tctest_bench_count < tctest_bench_iterations) {
+		tctest_bench_samples[tctest_bench_count++] = secs;
+	}
+}
+
+static int tctest_compare_samples(const void *lhs, const void *rhs) {
+	double a = *(const double *) lhs, b = *(const double *) rhs;
+	return (a > b) - (a < b);
+}
+
+void tctest_bench_end(const char *testname) {
+	int n = tctest_bench_count;
+	double min_ms, median_ms, p99_ms;
+	int p99_index;
+
+	qsort(tctest_bench_samples, n, sizeof(double), &tctest_compare_samples);
+
+	/* nearest-rank percentiles */
+	p99_index = (n * 99 + 99) / 100 - 1;
+	min_ms = tctest_bench_samples[0] * 1000.0;
+	median_ms = tctest_bench_samples[(n - 1) / 2] * 1000.0;
+	p99_ms = tctest_bench_samples[p99_index] * 1000.0;
+
+	printf("passed! (%d runs: min %.3f ms, median %.3f ms, p99 %.3f ms)\n",
+		n, min_ms, median_ms, p99_ms);
+
+	free(tctest_bench_samples);
+	tctest_bench_samples = NULL;
+
+	if (tctest_on_bench_complete) {
+		tctest_on_bench_complete(testname, n, min_ms, median_ms, p99_ms);
+	}
+}
+
+/*
+ * Discard the timings recorded for a benchmark test that failed.
+ */
+void tctest_bench_abort(void) {
+	free(tctest_bench_samples);
+	tctest_bench_samples = NULL;
+}
@@ -86,6 +86,39 @@ extern void (*tctest_on_test_executed)(const char *testname, int passed);
  */
 extern void (*tctest_on_complete)(int num_passed, int num_executed);
 
+/*
+ * Benchmark mode.  Tests registered with BENCH() rather than TEST()
+ * run once, as ordinary tests, unless the TCTEST_BENCH environment
+ * variable is set to a nonzero value.  In benchmark mode, each such
+ * test is run repeatedly (with a fresh setup() and cleanup() for each
+ * run) after a few untimed warm-up runs, and the minimum, median, and
+ * 99th percentile run times are reported.
+ *
+ * The TCTEST_SCALE environment variable sets a (floating point)
+ * factor by which tests may scale their problem sizes, using
+ * tctest_scale().  It applies whether or not benchmark mode is
+ * enabled, and defaults to 1.
+ */
+int tctest_bench_enabled(void);
+long tctest_scale(long n);
+
+/*
+ * If this function pointer is set to a non-null value, it will
+ * be called after a test has been run in benchmark mode and has
+ * passed.  The timings are in milliseconds.  This is useful for
+ * comparing the timings against a baseline, so that benchmarks
+ * can serve as performance regression checks.
+ */
+extern void (*tctest_on_bench_complete)(const char *testname, int iterations,
+	double min_ms, double median_ms, double p99_ms);
+
+/* These functions are used by the BENCH() macro. */
+int tctest_bench_begin(int iterations);
+double tctest_bench_now(void);
+void tctest_bench_record(double secs);
+void tctest_bench_end(const char *testname);
+void tctest_bench_abort(void);
+
 #ifdef __cplusplus
 /*
  * For tests implemented in C++, attempt to
@@ -151,6 +184,51 @@ extern void (*tctest_on_complete)(int num_passed, int num_executed);
 	} \
 } while (0)
 
+#define BENCH(func, iterations) do { \
+	if (!tctest_bench_enabled()) { \
+		TEST(func); \
+	} else if (!tctest_testname_to_execute || strcmp(tctest_testname_to_execute, #func) == 0) { \
+		TestObjs *volatile t = 0; \
+		volatile int tctest_iter; \
+		int tctest_runs = tctest_bench_begin(iterations); \
+		if (tctest_runs == 0) { \
+			/* no memory for the samples: run as an ordinary test */ \
+			TEST(func); \
+			break; \
+		} \
+		tctest_num_executed++; \
+		tctest_assertion_line = -1; \
+		TCTEST_TRY \
+		if (sigsetjmp(tctest_env, 1) == 0) { \
+			printf("%s...", #func); \
+			fflush(stdout); \
+			for (tctest_iter = 0; tctest_iter < tctest_runs; tctest_iter++) { \
+				double tctest_start; \
+				t = setup(); \
+				tctest_start = tctest_bench_now(); \
+				func(t); \
+				tctest_bench_record(tctest_bench_now() - tctest_start); \
+				cleanup(t); \
+				t = 0; \
+			} \
+			tctest_bench_end(#func); \
+			if (tctest_on_test_executed) { \
+				tctest_on_test_executed(#func, 1); \
+			} \
+		} else { \
+			tctest_bench_abort(); \
+			tctest_failures++; \
+			if (tctest_on_test_executed) { \
+				tctest_on_test_executed(#func, 0); \
+			} \
+		} \
+		TCTEST_CATCH(func) \
+		if (t) { \
+			cleanup(t); \
+		} \
+	} \
+} while (0)
+
 #define ASSERT(cond) do { \
 	tctest_assertion_line = __LINE__; \
 	if (!(cond)) { \